@@ -1,3 +1,5 @@
+#include <karm-gfx/context.h>
+#include <karm-image/saver.h>
 #include <karm-print/pdf.h>
 #include <karm-sys/entry.h>
 #include <karm-sys/file.h>
@@ -7,12 +9,12 @@
 
 namespace Vaev {
 
-Style::Media constructMedia(Print::PaperStock paper) {
+Style::Media constructMedia(Math::Vec2f size) {
     return {
         .type = MediaType::SCREEN,
-        .width = Px{paper.width},
-        .height = Px{paper.height},
-        .aspectRatio = paper.width / paper.height,
+        .width = Px{size.width},
+        .height = Px{size.height},
+        .aspectRatio = size.width / size.height,
         .orientation = Orientation::LANDSCAPE,
 
         .resolution = Resolution::fromDpi(96),
@@ -41,39 +43,72 @@ Style::Media constructMedia(Print::PaperStock paper) {
     };
 }
 
-} // namespace Vaev
-
-Async::Task<> entryPointAsync(Sys::Context &ctx) {
-    auto args = Sys::useArgs(ctx);
-    if (args.len() != 2) {
-        Sys::errln("usage: html2pdf <input.html> <output.pdf>\n");
-        co_return Error::invalidInput();
-    }
-
-    auto input = co_try$(Mime::parseUrlOrPath(args[0]));
-    auto output = co_try$(Mime::parseUrlOrPath(args[1]));
-
-    auto dom = co_try$(Vaev::Driver::fetchDocument(input));
+// Snapshots are rendered like a window of this size would show them
+static constexpr Math::Vec2i SNAPSHOT_SIZE = {1280, 720};
 
+static Res<> _writePdf(Dom::Document &dom, Mime::Url const &output) {
     auto paper = Print::A4;
-    auto media = Vaev::constructMedia(paper);
+    auto media = constructMedia({paper.width, paper.height});
 
     auto start = Sys::now();
-    auto [layout, paint] = Vaev::Driver::render(*dom, media, paper);
+    auto [layout, paint] = Driver::render(dom, media, paper);
     auto elapsed = Sys::now() - start;
     logInfo("render time: {}", elapsed);
 
     logDebug("layout tree: {}", layout);
     logDebug("paint tree: {}", paint);
 
-    Print::PdfPrinter printer;
-    paint->print(printer);
-
-    auto file = co_try$(Sys::File::create(output));
+    auto file = try$(Sys::File::create(output));
     Io::TextEncoder<> encoder{file};
     Io::Emit e{encoder};
-    printer.write(e);
-    co_try$(e.flush());
 
-    co_return Ok();
+    // Pages go to the file as they are printed
+    Print::PdfStreamPrinter printer{e, paper};
+    paint->print(printer);
+    try$(printer.finish());
+
+    return Ok();
+}
+
+static Res<> _writeImage(Dom::Document &dom, Mime::Url const &output) {
+    auto media = constructMedia(SNAPSHOT_SIZE.cast<f64>());
+
+    auto start = Sys::now();
+    auto [layout, paint] = Driver::render(dom, media, SNAPSHOT_SIZE.cast<Px>());
+    auto elapsed = Sys::now() - start;
+    logInfo("render time: {}", elapsed);
+
+    auto img = Gfx::Surface::alloc(SNAPSHOT_SIZE);
+    Gfx::Context g;
+    g.begin(img->mutPixels());
+    g.clear(Gfx::WHITE);
+    paint->paint(g);
+    g.end();
+
+    // Snapshots are mostly flat areas, the fastest level already catches them
+    start = Sys::now();
+    try$(Image::save(img->pixels(), output, 1));
+    elapsed = Sys::now() - start;
+    logInfo("encode time: {}", elapsed);
+
+    return Ok();
+}
+
+} // namespace Vaev
+
+Async::Task<> entryPointAsync(Sys::Context &ctx) {
+    auto args = Sys::useArgs(ctx);
+    if (args.len() != 2) {
+        Sys::errln("usage: html2pdf <input.html> <output.pdf|png|qoi|bmp>\n");
+        co_return Error::invalidInput();
+    }
+
+    auto input = co_try$(Mime::parseUrlOrPath(args[0]));
+    auto output = co_try$(Mime::parseUrlOrPath(args[1]));
+
+    auto dom = co_try$(Vaev::Driver::fetchDocument(input));
+
+    if (Image::formatOf(output))
+        co_return Vaev::_writeImage(*dom, output);
+    co_return Vaev::_writePdf(*dom, output);
 }
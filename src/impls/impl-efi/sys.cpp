@@ -328,6 +328,10 @@ Res<Vec<DirEntry>> readDir(Mime::Url const &) {
     return Error::notImplemented();
 }
 
+Res<> createDir(Mime::Url const &) {
+    return Error::notImplemented();
+}
+
 Res<Strong<Fd>> createFile(Mime::Url const &) {
     return Error::notImplemented();
 }
@@ -456,4 +460,18 @@ Res<> exit(i32) {
         ;
 }
 
+// MARK: Threads ---------------------------------------------------------------
+
+usize concurrency() {
+    return 1;
+}
+
+Res<> runThreads(usize, Func<void(usize)> const &) {
+    return Error::notImplemented();
+}
+
+Res<> spawnThread(Func<void()>) {
+    return Error::notImplemented();
+}
+
 } // namespace Karm::Sys::_Embed
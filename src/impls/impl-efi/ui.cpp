@@ -21,7 +21,7 @@ struct EfiHost :
           _stip(stip),
           _front(front),
           _back(back) {
-        _dirty.pushBack(front.bound());
+        _dirty.add(front.bound());
     }
 
     Gfx::MutPixels mutPixels() override {
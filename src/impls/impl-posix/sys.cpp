@@ -3,6 +3,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <sys/mman.h>
 #include <sys/socket.h>
@@ -174,6 +175,13 @@ Res<Vec<DirEntry>> readDir(Mime::Url const &url) {
     return Ok(entries);
 }
 
+Res<> createDir(Mime::Url const &url) {
+    String str = try$(resolve(url)).str();
+    if (::mkdir(str.buf(), 0755) < 0)
+        return Posix::fromLastErrno();
+    return Ok();
+}
+
 Res<Stat> stat(Mime::Url const &url) {
     String str = try$(resolve(url)).str();
     struct stat buf;
@@ -422,4 +430,64 @@ Res<> exit(i32 res) {
     return Ok();
 }
 
+// MARK: Threads ---------------------------------------------------------------
+
+usize concurrency() {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? count : 1;
+}
+
+Res<> runThreads(usize count, Func<void(usize)> const &task) {
+    struct Thread {
+        Func<void(usize)> const *task;
+        usize index;
+        pthread_t handle;
+        bool started;
+    };
+
+    Vec<Thread> threads;
+    for (usize i = 1; i < count; i++)
+        threads.pushBack({&task, i, {}, false});
+
+    for (auto &t : threads) {
+        auto entry = [](void *arg) -> void * {
+            auto &t = *static_cast<Thread *>(arg);
+            (*t.task)(t.index);
+            return nullptr;
+        };
+        t.started = pthread_create(&t.handle, nullptr, entry, &t) == 0;
+    }
+
+    task(0);
+
+    // Tasks that did not get a thread of their own run here instead
+    for (auto &t : threads) {
+        if (t.started)
+            pthread_join(t.handle, nullptr);
+        else
+            task(t.index);
+    }
+
+    return Ok();
+}
+
+Res<> spawnThread(Func<void()> task) {
+    auto *boxed = new Func<void()>(std::move(task));
+    auto entry = [](void *arg) -> void * {
+        auto *task = static_cast<Func<void()> *>(arg);
+        (*task)();
+        delete task;
+        return nullptr;
+    };
+
+    pthread_t handle;
+    if (int err = pthread_create(&handle, nullptr, entry, boxed); err != 0) {
+        delete boxed;
+        return Posix::fromErrno(err);
+    }
+
+    pthread_detach(handle);
+    return Ok();
+}
+
 } // namespace Karm::Sys::_Embed
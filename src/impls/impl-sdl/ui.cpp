@@ -316,7 +316,7 @@ struct SdlHost :
                 break;
 
             case SDL_WINDOWEVENT_EXPOSED:
-                _dirty.pushBack(pixels().bound());
+                _dirty.add(pixels().bound());
                 break;
             }
             break;
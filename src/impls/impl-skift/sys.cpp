@@ -53,6 +53,10 @@ Res<Vec<Sys::DirEntry>> readDir(Mime::Url const &) {
     notImplemented();
 }
 
+Res<> createDir(Mime::Url const &) {
+    notImplemented();
+}
+
 Res<Stat> stat(Mime::Url const &) {
     notImplemented();
 }
@@ -163,4 +167,18 @@ Res<> exit(i32) {
     notImplemented();
 }
 
+// MARK: Threads ---------------------------------------------------------------
+
+usize concurrency() {
+    return 1;
+}
+
+Res<> runThreads(usize, Func<void(usize)> const &) {
+    return Error::notImplemented();
+}
+
+Res<> spawnThread(Func<void()>) {
+    return Error::notImplemented();
+}
+
 } // namespace Karm::Sys::_Embed
@@ -119,4 +119,19 @@ Res<> populate(Sys::UserInfo &) {
 Res<> populate(Vec<Sys::UserInfo> &) {
     return Ok();
 }
+
+// MARK: Threads ---------------------------------------------------------------
+
+usize concurrency() {
+    return 1;
+}
+
+Res<> runThreads(usize, Func<void(usize)> const &) {
+    return Error::notImplemented();
+}
+
+Res<> spawnThread(Func<void()>) {
+    return Error::notImplemented();
+}
+
 } // namespace Karm::Sys::_Embed
\ No newline at end of file
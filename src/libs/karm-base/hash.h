@@ -62,4 +62,15 @@ struct Hasher<T> {
     }
 };
 
+// FNV-1a, for keys hashed field by field. Unlike the slice hasher above, the
+// order of the values matters so anagrams don't collide.
+struct Fnv {
+    u64 h = 0xcbf29ce484222325;
+
+    constexpr void mix(u64 v) {
+        h ^= v;
+        h *= 0x100000001b3;
+    }
+};
+
 } // namespace Karm
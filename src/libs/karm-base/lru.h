@@ -1,5 +1,6 @@
 #pragma once
 
+#include "hash.h"
 #include "list.h"
 #include "map.h"
 
@@ -61,6 +62,20 @@ struct Lru {
         return item->value;
     }
 
+    // Removes the least recently used item, for caches bounded by
+    // something else than their length
+    Opt<V> removeOldest() {
+        auto *item = _ll.tail();
+        if (not item)
+            return NONE;
+
+        _ll.detach(item);
+        _map.removeFirst(item);
+        V value = std::move(item->value);
+        delete item;
+        return value;
+    }
+
     Opt<V> tryGet(K const &key) {
         auto item = _lookup(key);
         if (item) {
@@ -78,4 +93,139 @@ struct Lru {
     }
 };
 
+// An intrusive hash table that keeps its entries in least recently used
+// order and evicts them once their total size exceeds a budget in bytes.
+// Entries are allocated with new and owned by the table, they carry their
+// `hash`, their size in `bytes`, the `chain` of their bucket and the `item`
+// of the recency list.
+template <typename E>
+struct BudgetLru {
+    usize _budget;
+    usize _minBuckets;
+    Vec<E *> _buckets{};
+    Ll<E> _ll{};
+    usize _bytes = 0;
+    usize _evictions = 0;
+
+    BudgetLru(usize budget, usize minBuckets = 64)
+        : _budget(budget), _minBuckets(minBuckets) {}
+
+    ~BudgetLru() {
+        clear();
+    }
+
+    BudgetLru(BudgetLru const &) = delete;
+
+    BudgetLru &operator=(BudgetLru const &) = delete;
+
+    // The entry with this hash for which `eq` holds, its recency is left
+    // untouched.
+    E *lookup(Hash hash, auto const &eq) {
+        if (isEmpty(_buckets))
+            return nullptr;
+
+        auto *entry = _buckets[hash % _buckets.len()];
+        while (entry) {
+            if (entry->hash == hash and eq(*entry))
+                return entry;
+            entry = entry->chain;
+        }
+        return nullptr;
+    }
+
+    void touch(E *entry) {
+        _ll.detach(entry);
+        _ll.prepend(entry, _ll.head());
+    }
+
+    // The entry becomes the most recently used, nothing is evicted until
+    // the next call to evict().
+    E *insert(E *entry) {
+        if (_ll.len() + 1 > _buckets.len())
+            _rehash(max(_buckets.len() * 2, _minBuckets));
+
+        auto &bucket = _buckets[entry->hash % _buckets.len()];
+        entry->chain = bucket;
+        bucket = entry;
+
+        _ll.prepend(entry, _ll.head());
+        _bytes += entry->bytes;
+        return entry;
+    }
+
+    void remove(E *entry) {
+        auto *slot = &_buckets[entry->hash % _buckets.len()];
+        while (*slot != entry)
+            slot = &(*slot)->chain;
+        *slot = entry->chain;
+
+        _ll.detach(entry);
+        _bytes -= entry->bytes;
+        delete entry;
+    }
+
+    // Evicts the least recently used entries until the table fits its
+    // budget, except for `keep` so an entry larger than the whole budget
+    // is still returned to the caller that just inserted it.
+    void evict(E *keep = nullptr) {
+        while (_bytes > _budget) {
+            auto *victim = _ll.tail();
+            if (not victim or victim == keep)
+                break;
+            remove(victim);
+            _evictions++;
+        }
+    }
+
+    void budget(usize bytes) {
+        _budget = bytes;
+        evict();
+    }
+
+    void clear() {
+        _ll.clearApply([](E *entry) {
+            delete entry;
+        });
+
+        for (auto &bucket : _buckets)
+            bucket = nullptr;
+
+        _bytes = 0;
+    }
+
+    // From the most to the least recently used.
+    E *head() {
+        return _ll.head();
+    }
+
+    E *next(E *entry) {
+        return _ll.next(entry);
+    }
+
+    usize len() const {
+        return _ll.len();
+    }
+
+    usize bytes() const {
+        return _bytes;
+    }
+
+    usize evictions() const {
+        return _evictions;
+    }
+
+    void _rehash(usize cap) {
+        Vec<E *> buckets;
+        buckets.resize(cap, nullptr);
+
+        for (auto *entry = _ll.head(); entry; entry = _ll.next(entry)) {
+            auto &bucket = buckets[entry->hash % cap];
+            entry->chain = bucket;
+            bucket = entry;
+        }
+
+        _buckets = std::move(buckets);
+    }
+};
+
 } // namespace Karm
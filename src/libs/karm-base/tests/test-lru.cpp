@@ -72,4 +72,85 @@ test$("lru-evict") {
     return Ok();
 }
 
+test$("lru-remove-oldest") {
+    Lru<int, int> cache{10};
+
+    for (int i = 0; i < 3; i++) {
+        (void)cache.access(i, [&] {
+            return i * 10;
+        });
+    }
+
+    // Accessing an item makes it the most recently used
+    (void)cache.tryGet(0);
+
+    expectEq$(cache.removeOldest(), 10);
+    expect$(not cache.contains(1));
+    expectEq$(cache.removeOldest(), 20);
+    expectEq$(cache.removeOldest(), 0);
+    expect$(not cache.removeOldest());
+    expectEq$(cache.len(), 0uz);
+
+    return Ok();
+}
+
+struct _BudgetEntry {
+    int key;
+    Hash hash;
+    usize bytes;
+
+    _BudgetEntry *chain = nullptr;
+    LlItem<_BudgetEntry> item{};
+};
+
+static _BudgetEntry *_budgetLookup(BudgetLru<_BudgetEntry> &cache, int key) {
+    // Every key lands in the same bucket so the chains get walked
+    return cache.lookup(0, [&](_BudgetEntry const &e) {
+        return e.key == key;
+    });
+}
+
+test$("budget-lru-evict") {
+    BudgetLru<_BudgetEntry> cache{30, 4};
+
+    for (int i = 0; i < 10; i++)
+        cache.insert(new _BudgetEntry{i, 0, 10});
+    expectEq$(cache.len(), 10uz);
+    expectEq$(cache.bytes(), 100uz);
+    expect$(_budgetLookup(cache, 7) != nullptr);
+
+    // Touching an entry makes it the most recently used
+    cache.touch(_budgetLookup(cache, 2));
+    cache.evict();
+
+    expectEq$(cache.len(), 3uz);
+    expectEq$(cache.bytes(), 30uz);
+    expectEq$(cache.evictions(), 7uz);
+    expect$(_budgetLookup(cache, 2) != nullptr);
+    expect$(_budgetLookup(cache, 9) != nullptr);
+    expect$(_budgetLookup(cache, 8) != nullptr);
+    expect$(_budgetLookup(cache, 7) == nullptr);
+
+    return Ok();
+}
+
+test$("budget-lru-keep") {
+    BudgetLru<_BudgetEntry> cache{30};
+
+    cache.insert(new _BudgetEntry{0, hash(0), 10});
+    auto *large = cache.insert(new _BudgetEntry{1, hash(1), 100});
+
+    // An entry larger than the budget outlives its insertion
+    cache.evict(large);
+    expectEq$(cache.len(), 1uz);
+    expect$(cache.head() == large);
+
+    cache.budget(200);
+    cache.remove(large);
+    expectEq$(cache.len(), 0uz);
+    expectEq$(cache.bytes(), 0uz);
+
+    return Ok();
+}
+
 } // namespace Karm::Base::Tests
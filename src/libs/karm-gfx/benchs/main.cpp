@@ -1,62 +1,382 @@
-#include <karm-cli/cursor.h>
 #include <karm-gfx/context.h>
+#include <karm-io/aton.h>
+#include <karm-io/funcs.h>
+#include <karm-json/parse.h>
+#include <karm-json/stringify.h>
+#include <karm-math/rand.h>
+#include <karm-mime/url.h>
 #include <karm-sys/entry.h>
+#include <karm-sys/file.h>
 #include <karm-sys/time.h>
+#include <karm-text/font.h>
+#include <karm-text/run.h>
 
-Async::Task<> entryPointAsync(Sys::Context &) {
-    Vec<TimeSpan> samples;
-    auto surface = Gfx::Surface::alloc({1000, 1000});
+namespace Karm::Gfx::Benchs {
 
-    for (isize i = 0; i < 100; i++) {
-        auto start = Sys::now();
-        for (isize size = 100; size < 1000; size += 10) {
-            f64 scale = size / 100.0;
-
-            Gfx::Context g;
-            g.begin(surface->mutPixels());
-            g.scale(scale);
-
-            for (isize i = 0; i < 50; i++) {
-                Math::Rand rand{};
-
-                f64 s = rand.nextInt(4, 10);
-                s *= s;
-
-                g.beginPath();
-                g.ellipse({
-                    rand.nextVec2(Math::Recti{100, 100}).cast<f64>(),
-                    s,
-                });
-
-                g.strokeStyle(
-                    Gfx::stroke(Gfx::randomColor(rand))
-                        .withWidth(rand.nextInt(2, s))
-                );
-                g.stroke();
-            }
+// All scenarios draw on a surface of this size, they must be deterministic
+// so their output can be compared against golden checksums.
+static constexpr Math::Vec2i SIZE = {1000, 1000};
+
+struct Scenario {
+    Str name;
+    void (*draw)(Canvas &g);
+};
+
+// MARK: Scenarios -------------------------------------------------------------
+
+static void _strokeEllipses(Canvas &g) {
+    Math::Rand rand{0x5eed};
+
+    for (isize size = 100; size < 1000; size += 100) {
+        g.push();
+        g.scale(size / 100.0);
+
+        for (isize i = 0; i < 50; i++) {
+            f64 s = rand.nextInt(4, 10);
+            s *= s;
+
+            g.beginPath();
+            g.ellipse({
+                rand.nextVec2(Math::Recti{100, 100}).cast<f64>(),
+                s,
+            });
+
+            g.strokeStyle(
+                Gfx::stroke(Gfx::randomColor(rand))
+                    .withWidth(rand.nextInt(2, s))
+            );
+            g.stroke();
         }
 
-        auto elapsed = Sys::now() - start;
-        samples.pushBack(elapsed);
+        g.pop();
+    }
+}
+
+static void _textRun(Canvas &g) {
+    static Opt<Text::Font> font = NONE;
+    if (not font)
+        font = Text::Font::fallback();
+
+    auto run = Text::Run::from(*font, "The quick brown fox jumps over the lazy dog 0123456789"s);
+    run.layout();
+
+    g.fillStyle(Gfx::WHITE);
+    for (isize y = 16; y < SIZE.y; y += 16)
+        g.fill(*font, run, {4, (f64)y});
+}
+
+static void _textSizes(Canvas &g) {
+    // UI sizes go through the glyph cache, the last one is too large and is
+    // rasterized from the outlines.
+    f64 y = 0;
+    for (f64 size : Array<f64, 5>{11, 12, 13, 14, 64}) {
+        auto font = Text::Font::fallback();
+        font.fontsize = size;
+
+        auto run = Text::Run::from(font, "The quick brown fox jumps over the lazy dog 0123456789"s);
+        run.layout();
+
+        g.fillStyle(Gfx::WHITE);
+        for (isize i = 0; i < 8; i++) {
+            y += size * 1.2;
+            g.fill(font, run, {4.25 * i, y});
+        }
+    }
+}
+
+static void _smallRects(Canvas &g) {
+    Math::Rand rand{0x5eed};
+
+    for (isize i = 0; i < 10000; i++) {
+        g.fillStyle(Gfx::randomColor(rand).withOpacity(rand.nextDouble(0.5, 1)));
+        g.fill(Math::Recti{rand.nextVec2(SIZE).cast<isize>(), {8, 8}});
+    }
+}
+
+static void _largeGradient(Canvas &g) {
+    g.fillStyle(Gfx::Gradient::linear().withHsv().bake());
+    g.fill(Math::Recti{SIZE});
+}
+
+static void _complexPath(Canvas &g) {
+    Math::Rand rand{0x5eed};
+    Math::Path path;
 
-        Sys::print("sampling {}/100: {}\r", i + 1, elapsed);
+    path.moveTo(rand.nextVec2(SIZE.cast<f64>()));
+    for (isize i = 0; i < 200; i++) {
+        path.cubicTo(
+            rand.nextVec2(SIZE.cast<f64>()),
+            rand.nextVec2(SIZE.cast<f64>()),
+            rand.nextVec2(SIZE.cast<f64>())
+        );
     }
+    path.close();
+
+    g.fillStyle(Gfx::BLUE500);
+    g.fill(path);
+}
+
+static void _blur(Canvas &g) {
+    Math::Rand rand{0x5eed};
+
+    for (isize i = 0; i < 32; i++) {
+        g.fillStyle(Gfx::randomColor(rand));
+        g.fill(Math::Recti{rand.nextVec2(SIZE).cast<isize>(), {100, 100}});
+    }
+
+    g.apply(Gfx::BlurFilter{16});
+}
+
+static void _blitScale(Canvas &g) {
+    static Opt<Strong<Surface>> src = NONE;
+    if (not src) {
+        src = Surface::alloc({256, 256});
+        Context sg;
+        sg.begin((*src)->mutPixels());
+        _smallRects(sg);
+        sg.end();
+    }
+
+    g.blit({0, 0, 256, 256}, Math::Recti{SIZE}, (*src)->pixels());
+}
+
+static void _star(Canvas &g, FillRule rule) {
+    // A self intersecting star, the center is covered twice so the two
+    // fill rules disagree on it.
+    g.beginPath();
+    isize points = 101;
+    for (isize i = 0; i < points; i++) {
+        f64 a = Math::TAU * ((i * 50) % points) / points;
+        Math::Vec2f p = SIZE.cast<f64>() / 2 + Math::Vec2f{Math::cos(a), Math::sin(a)} * 480;
+        if (i == 0)
+            g.moveTo(p);
+        else
+            g.lineTo(p);
+    }
+    g.closePath();
+
+    g.fillStyle(Gfx::GREEN500);
+    g.fill(rule);
+}
+
+static void _fillEvenOdd(Canvas &g) {
+    _star(g, FillRule::EVENODD);
+}
+
+static void _fillNonZero(Canvas &g) {
+    _star(g, FillRule::NONZERO);
+}
+
+static Array SCENARIOS = {
+    Scenario{"stroke-ellipses", _strokeEllipses},
+    Scenario{"text-run", _textRun},
+    Scenario{"text-sizes", _textSizes},
+    Scenario{"small-rects", _smallRects},
+    Scenario{"large-gradient", _largeGradient},
+    Scenario{"complex-path", _complexPath},
+    Scenario{"blur", _blur},
+    Scenario{"blit-scale", _blitScale},
+    Scenario{"fill-evenodd", _fillEvenOdd},
+    Scenario{"fill-nonzero", _fillNonZero},
+};
+
+// MARK: Runner ----------------------------------------------------------------
+
+struct Options {
+    usize warmup = 3;
+    usize iterations = 30;
+    Opt<Str> filter = NONE;
+    bool json = false;
+    Opt<Str> golden = NONE;
+    bool bless = false;
+};
 
-    // median
-    sort(samples, [](auto &a, auto &b) {
+struct Result {
+    Str name;
+    Vec<TimeSpan> samples;
+    Hash checksum;
+
+    TimeSpan percentile(f64 p) const {
+        usize i = min((usize)(p * samples.len()), samples.len() - 1);
+        return samples[i];
+    }
+
+    TimeSpan mean() const {
+        f64 sum = 0;
+        for (auto &s : samples)
+            sum += s.toUSecs();
+        return TimeSpan::fromUSecs(sum / samples.len());
+    }
+
+    Json::Value toJson() const {
+        Json::Object obj;
+        obj.put("name"s, String{name});
+        obj.put("iterations"s, (Json::Integer)samples.len());
+        obj.put("min"s, (Json::Integer)first(samples).toUSecs());
+        obj.put("p50"s, (Json::Integer)percentile(0.5).toUSecs());
+        obj.put("p90"s, (Json::Integer)percentile(0.9).toUSecs());
+        obj.put("p99"s, (Json::Integer)percentile(0.99).toUSecs());
+        obj.put("max"s, (Json::Integer)last(samples).toUSecs());
+        obj.put("mean"s, (Json::Integer)mean().toUSecs());
+        obj.put("checksum"s, (Json::Integer)checksum);
+        return obj;
+    }
+};
+
+static Hash _render(Scenario const &scenario, Surface &surface) {
+    Context g;
+    g.begin(surface.mutPixels());
+    g.clear(Gfx::BLACK);
+    scenario.draw(g);
+    g.end();
+    return hash(surface.pixels().bytes());
+}
+
+static Result _run(Scenario const &scenario, Options const &options) {
+    auto surface = Surface::alloc(SIZE);
+
+    for (usize i = 0; i < options.warmup; i++)
+        _render(scenario, *surface);
+
+    Result result{scenario.name, {}, _render(scenario, *surface)};
+    for (usize i = 0; i < options.iterations; i++) {
+        auto start = Sys::now();
+        _render(scenario, *surface);
+        result.samples.pushBack(Sys::now() - start);
+
+        if (not options.json)
+            Sys::print("{}: sampling {}/{}\r", scenario.name, i + 1, options.iterations);
+    }
+
+    sort(result.samples, [](auto &a, auto &b) {
         return a.toUSecs() <=> b.toUSecs();
     });
 
-    // average
-    f64 sum = 0;
-    for (auto &s : samples)
-        sum += s.toUSecs();
+    return result;
+}
+
+static Res<Options> _parseOptions(Sys::Context &ctx) {
+    auto &args = Sys::useArgs(ctx);
+    Options options;
+
+    auto next = [&](usize &i) -> Res<Str> {
+        if (i + 1 >= args.len())
+            return Error::invalidInput("missing option value");
+        return Ok(args[++i]);
+    };
+
+    auto nextCount = [&](usize &i) -> Res<usize> {
+        auto count = Io::atoi(try$(next(i)));
+        if (not count or *count < 0)
+            return Error::invalidInput("expected a positive number");
+        return Ok(*count);
+    };
+
+    for (usize i = 0; i < args.len(); i++) {
+        auto arg = args[i];
+        if (arg == "--warmup") {
+            options.warmup = try$(nextCount(i));
+        } else if (arg == "--iterations") {
+            options.iterations = max(try$(nextCount(i)), 1uz);
+        } else if (arg == "--filter") {
+            options.filter = try$(next(i));
+        } else if (arg == "--json") {
+            options.json = true;
+        } else if (arg == "--golden") {
+            options.golden = try$(next(i));
+        } else if (arg == "--bless") {
+            options.bless = true;
+        } else {
+            return Error::invalidInput("unknown option");
+        }
+    }
+
+    if (options.bless and not options.golden)
+        return Error::invalidInput("--bless requires --golden");
+
+    return Ok(options);
+}
+
+// Compare the checksums against the golden file, or write them to it when
+// blessing a new reference after an intentional change of the output.
+static Res<> _checkGolden(Str path, Vec<Result> const &results, bool bless) {
+    auto url = try$(Mime::parseUrlOrPath(path));
+
+    if (bless) {
+        Json::Object golden;
+        for (auto &r : results)
+            golden.put(String{r.name}, (Json::Integer)r.checksum);
+        auto file = try$(Sys::File::create(url));
+        Io::TextEncoder<> encoder{file};
+        Io::Emit e{encoder};
+        e("{}\n", try$(Json::stringify(golden)));
+        try$(e.flush());
+        return Ok();
+    }
+
+    auto file = try$(Sys::File::open(url));
+    auto golden = try$(Json::parse(try$(Io::readAllUtf8(file))));
+
+    bool mismatch = false;
+    for (auto &r : results) {
+        auto expected = golden.get(r.name);
+        if (expected.isNull()) {
+            Sys::errln("{}: no golden checksum", r.name);
+            continue;
+        }
+
+        if ((Hash)expected.asInt() != r.checksum) {
+            Sys::errln("{}: checksum mismatch, expected {:x} got {:x}", r.name, (Hash)expected.asInt(), r.checksum);
+            mismatch = true;
+        }
+    }
+
+    if (mismatch)
+        return Error::invalidData("output differs from golden checksums");
+
+    return Ok();
+}
+
+} // namespace Karm::Gfx::Benchs
+
+Async::Task<> entryPointAsync(Sys::Context &ctx) {
+    using namespace Gfx::Benchs;
+
+    auto options = co_try$(_parseOptions(ctx));
+
+    Vec<Result> results;
+    for (auto &scenario : SCENARIOS) {
+        if (options.filter and scenario.name != *options.filter)
+            continue;
+
+        auto result = _run(scenario, options);
+
+        if (not options.json) {
+            Sys::println(
+                "{}: min {} p50 {} p90 {} p99 {} max {} mean {} checksum {:x}",
+                result.name,
+                first(result.samples),
+                result.percentile(0.5),
+                result.percentile(0.9),
+                result.percentile(0.99),
+                last(result.samples),
+                result.mean(),
+                result.checksum
+            );
+        }
+
+        results.pushBack(std::move(result));
+    }
+
+    if (options.json) {
+        Json::Array arr;
+        for (auto &r : results)
+            arr.pushBack(r.toJson());
+        Sys::println("{}", co_try$(Json::stringify(arr)));
+    }
 
-    Sys::println("\n");
-    Sys::println("median: {}", samples[samples.len() / 2]);
-    Sys::println("average: {}", TimeSpan::fromUSecs(sum / samples.len()));
-    Sys::println("min: {}", first(samples));
-    Sys::println("max: {}", last(samples));
+    if (options.golden)
+        co_try$(_checkGolden(*options.golden, results, options.bless));
 
     co_return Ok();
 }
@@ -119,7 +119,7 @@ void Canvas::fill(Text::Font &font, Text::Glyph glyph, Math::Vec2f baseline) {
 void Canvas::fill(Text::Font &font, Text::Run const &run, Math::Vec2f baseline) {
     push();
     for (auto &cell : run._cells)
-        fill(font, cell.glyph, baseline + Math::Vec2f{cell.xpos, 0});
+        fill(font, cell.glyph, baseline + Math::Vec2f{cell.xpos, cell.ypos});
     pop();
 }
 
@@ -1,6 +1,7 @@
 #include <karm-base/ring.h>
 #include <karm-logger/logger.h>
 #include <karm-math/funcs.h>
+#include <karm-text/font.h>
 
 #include "context.h"
 #include "stroke.h"
@@ -114,6 +115,107 @@ void Context::_fill(Fill fill, FillRule fillRule) {
     });
 }
 
+[[gnu::flatten]] void Context::_strokeHairline(Math::Path const &path, Color color) {
+    auto const &trans = current().trans;
+    auto clip = current().clip;
+
+    pixels().fmt().visit([&](auto format) {
+        auto plot = [&](isize x, isize y, f64 a) {
+            if (not clip.contains(Math::Vec2i{x, y}))
+                return;
+            auto *pixel = mutPixels().pixelUnsafe({x, y});
+            auto c = format.load(pixel);
+            c = color.withOpacity(a).blendOver(c);
+            format.store(pixel, c);
+        };
+
+        auto fract = [](f64 v) {
+            return v - Math::floor(v);
+        };
+
+        for (auto contour : path.iterContours()) {
+            if (contour.len() < 2)
+                continue;
+
+            auto l = contour.close ? contour.len() : contour.len() - 1;
+            for (usize i = 0; i < l; i++) {
+                // Xiaolin Wu's line algorithm, pixel centers are at +0.5
+                auto e = trans.apply(Math::Edgef{contour[i], contour[(i + 1) % contour.len()]}) - Math::Vec2f{0.5, 0.5};
+
+                // Every vertex is plotted once so joints don't come out
+                // darker, by the segment ending on it and in full. Only the
+                // ends of open contours get the coverage of their half pixel.
+                struct End {
+                    bool draw;
+                    bool open;
+                };
+                End start{i == 0 and not contour.close, true};
+                End end{true, i == l - 1 and not contour.close};
+
+                bool steep = Math::abs(e.ey - e.sy) > Math::abs(e.ex - e.sx);
+                if (steep)
+                    e = {e.sy, e.sx, e.ey, e.ex};
+                if (e.sx > e.ex) {
+                    e = e.swap();
+                    std::swap(start, end);
+                }
+
+                auto put = [&](isize x, isize y, f64 a) {
+                    if (steep)
+                        plot(y, x, a);
+                    else
+                        plot(x, y, a);
+                };
+
+                f64 dx = e.ex - e.sx;
+                f64 gradient = dx < 0.001 ? 1.0 : (e.ey - e.sy) / dx;
+
+                isize x1 = Math::roundi(e.sx);
+                f64 y1 = e.sy + gradient * (x1 - e.sx);
+                if (start.draw) {
+                    f64 gap1 = start.open ? 1 - fract(e.sx + 0.5) : 1;
+                    put(x1, Math::floori(y1), (1 - fract(y1)) * gap1);
+                    put(x1, Math::floori(y1) + 1, fract(y1) * gap1);
+                }
+
+                isize x2 = Math::roundi(e.ex);
+                f64 y2 = e.ey + gradient * (x2 - e.ex);
+                if (end.draw) {
+                    f64 gap2 = end.open ? fract(e.ex + 0.5) : 1;
+                    put(x2, Math::floori(y2), (1 - fract(y2)) * gap2);
+                    put(x2, Math::floori(y2) + 1, fract(y2) * gap2);
+                }
+
+                f64 y = y1 + gradient;
+                for (isize x = x1 + 1; x < x2; x++) {
+                    put(x, Math::floori(y), 1 - fract(y));
+                    put(x, Math::floori(y) + 1, fract(y));
+                    y += gradient;
+                }
+            }
+        }
+    });
+}
+
+void Context::_stroke(Math::Path const &path) {
+    auto const &trans = current().trans;
+    auto const &stroke = current().stroke;
+    f64 scale = sqrt(Math::abs(trans.xx * trans.yy - trans.xy * trans.yx));
+
+    // Hairlines are centered on the path, aligned strokes keep to their
+    // side of it through the rasterizer
+    if (stroke.align == CENTER_ALIGN and stroke.width * scale <= 1 and stroke.fill.is<Color>()) {
+        auto color = stroke.fill.unwrap<Color>();
+        _strokeHairline(path, color.withOpacity(stroke.width * scale));
+        return;
+    }
+
+    _poly.clear();
+    createStroke(_poly, path, stroke, scale);
+    _poly.transform(trans);
+    _fill(stroke.fill);
+}
+
 void Context::beginPath() {
     _path.clear();
 }
@@ -178,10 +280,7 @@ void Context::fill(FillRule rule) {
 }
 
 void Context::stroke() {
-    _poly.clear();
-    createStroke(_poly, _path, current().stroke);
-    _poly.transform(current().trans);
-    _fill(current().stroke.fill);
+    _stroke(_path);
 }
 
 void Context::clip(FillRule) {
@@ -232,10 +331,7 @@ void Context::clip(Math::Rectf rect) {
 }
 
 void Context::stroke(Math::Path const &path) {
-    _poly.clear();
-    createStroke(_poly, path, current().stroke);
-    _poly.transform(current().trans);
-    _fill(current().stroke.fill);
+    _stroke(path);
 }
 
 void Context::fill(Math::Path const &path, FillRule rule) {
@@ -245,6 +341,142 @@ void Context::fill(Math::Path const &path, FillRule rule) {
     _fill(current().fill, rule);
 }
 
+// MARK: Text Operations -------------------------------------------------------
+
+GlyphMask Context::_rasterizeGlyph(Text::Fontface &face, Text::Glyph glyph, f64 size, f64 subpixel, bool gridFit) {
+    auto metrics = face.metrics();
+
+    f64 sy = 1;
+    if (gridFit and metrics.captop > 0) {
+        auto captop = metrics.captop * size;
+        sy = max(1.0, Math::round(captop)) / captop;
+    }
+
+    // Leave some room around the advance box for overhanging glyphs, the
+    // mask is trimmed to the inked pixels afterward.
+    isize pad = Math::ceili(size / 4) + 1;
+    isize ascend = Math::ceili(metrics.ascend * size * sy);
+    isize descend = Math::ceili(metrics.descend * size * sy);
+    isize width = Math::ceili(face.advance(glyph) * size) + pad * 2;
+    isize height = ascend + descend + pad * 2;
+
+    push();
+    current().trans = {};
+    origin({pad + subpixel, (f64)(ascend + pad)});
+    scale({size, size * sy});
+    beginPath();
+    face.contour(*this, glyph);
+    _poly.clear();
+    createSolid(_poly, _path);
+    _poly.transform(current().trans);
+    pop();
+
+    Vec<u8> alpha;
+    alpha.resize(width * height, 0);
+    isize minX = width, minY = height, maxX = 0, maxY = 0;
+    _rast.fill(_poly, {width, height}, FillRule::NONZERO, [&](Rast::Frag frag) {
+        u8 a = clamp(Math::roundi(frag.a * 255), 0, 255);
+        if (not a)
+            return;
+
+        alpha[frag.xy.y * width + frag.xy.x] = a;
+        minX = min(minX, frag.xy.x);
+        minY = min(minY, frag.xy.y);
+        maxX = max(maxX, frag.xy.x + 1);
+        maxY = max(maxY, frag.xy.y + 1);
+    });
+
+    GlyphMask mask;
+    if (minX >= maxX or minY >= maxY)
+        return mask;
+
+    mask.origin = {minX - pad, minY - ascend - pad};
+    mask.size = {maxX - minX, maxY - minY};
+    mask.alpha.ensure(mask.size.x * mask.size.y);
+    for (isize y = minY; y < maxY; y++)
+        mask.alpha.insertMany(mask.alpha.len(), sub(alpha, y * width + minX, y * width + maxX));
+
+    return mask;
+}
+
+[[gnu::flatten]] void Context::_blitMask(GlyphMask const &mask, Math::Vec2i pos, Color color) {
+    Math::Recti dest{pos + mask.origin, mask.size};
+    auto clipped = current().clip.clipTo(dest);
+    if (clipped.width <= 0 or clipped.height <= 0)
+        return;
+
+    pixels().fmt().visit([&](auto format) {
+        auto pixels = mutPixels();
+        for (isize y = clipped.top(); y < clipped.bottom(); y++) {
+            u8 const *row = mask.alpha.buf() + (y - dest.y) * mask.size.x;
+            for (isize x = clipped.start(); x < clipped.end(); x++) {
+                u8 a = row[x - dest.x];
+                if (not a)
+                    continue;
+
+                auto *pixel = pixels.pixelUnsafe({x, y});
+                auto c = format.load(pixel);
+                c = color.withOpacity(a / 255.0).blendOver(c);
+                format.store(pixel, c);
+            }
+        }
+    });
+}
+
+void Context::fill(Text::Font &font, Text::Glyph glyph, Math::Vec2f baseline) {
+    auto const &trans = current().trans;
+    auto *color = current().fill.is<Color>();
+
+    f64 size = font.fontsize * trans.xx;
+    bool cacheable =
+        _useGlyphCache and
+        not _useSpaa and
+        color and
+        trans.xy == 0 and trans.yx == 0 and
+        trans.xx == trans.yy and
+        size > 0 and size <= GlyphCache::MAX_SIZE;
+
+    if (not cacheable) {
+        Canvas::fill(font, glyph, baseline);
+        return;
+    }
+
+    auto pos = trans.apply(baseline);
+    auto x = Math::floori(pos.x);
+    auto y = Math::roundi(pos.y);
+
+    auto &cache = globalGlyphCache();
+    auto face = cache.faceId(font.fontface);
+    if (not face) {
+        Canvas::fill(font, glyph, baseline);
+        return;
+    }
+
+    GlyphCache::Key key{
+        .face = *face,
+        .glyph = glyph,
+        .size = (u16)Math::roundi(size * GlyphCache::SUBPIXELS),
+        .subpixel = (u8)min(Math::floori((pos.x - x) * GlyphCache::SUBPIXELS), (isize)GlyphCache::SUBPIXELS - 1),
+        .gridFit = _gridFitGlyphs,
+    };
+
+    auto const *mask = cache.lookup(key);
+    if (not mask) {
+        mask = &cache.insert(
+            key,
+            _rasterizeGlyph(
+                *font.fontface,
+                glyph,
+                key.size / (f64)GlyphCache::SUBPIXELS,
+                key.subpixel / (f64)GlyphCache::SUBPIXELS,
+                key.gridFit
+            )
+        );
+    }
+
+    _blitMask(*mask, {x, y}, *color);
+}
+
 // MARK: Clear Operations ------------------------------------------------------
 
 void Context::clear(Color color) {
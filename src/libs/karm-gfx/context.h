@@ -4,6 +4,7 @@
 #include "canvas.h"
 #include "fill.h"
 #include "filters.h"
+#include "glyphs.h"
 #include "rast.h"
 #include "stroke.h"
 
@@ -34,6 +35,8 @@ struct Context : public Canvas {
     Rast _rast{};
     LcdLayout _lcdLayout = RGB;
     bool _useSpaa = false;
+    bool _useGlyphCache = true;
+    bool _gridFitGlyphs = false;
 
     // MARK: Buffers -----------------------------------------------------------
 
@@ -75,6 +78,12 @@ struct Context : public Canvas {
     void _FillSmoothImpl(auto fill, auto format, FillRule fillRule);
     void _fill(Fill fill, FillRule rule = FillRule::NONZERO);
 
+    // (internal) Stroke a path thinner than a pixel without going through
+    // the rasterizer, the opacity of the color carries the coverage. Only
+    // used for centered strokes, caps and joins are ignored.
+    void _strokeHairline(Math::Path const &path, Color color);
+    void _stroke(Math::Path const &path);
+
     void beginPath() override;
 
     void closePath() override;
@@ -121,6 +130,20 @@ struct Context : public Canvas {
 
     void fill(Math::Path const &path, FillRule rule = FillRule::NONZERO) override;
 
+    // MARK: Text Operations ---------------------------------------------------
+
+    // (internal) Rasterize a glyph into a coverage mask, the pen is placed
+    // `subpixel` pixels to the right of a pixel boundary. When `gridFit` is
+    // set the glyph is scaled vertically so its cap height is a whole number
+    // of pixels.
+    GlyphMask _rasterizeGlyph(Text::Fontface &face, Text::Glyph glyph, f64 size, f64 subpixel, bool gridFit);
+
+    void _blitMask(GlyphMask const &mask, Math::Vec2i pos, Color color);
+
+    // Small glyphs drawn with a solid color and without rotation or skew are
+    // blitted from the glyph cache, anything else goes through the rasterizer.
+    void fill(Text::Font &font, Text::Glyph glyph, Math::Vec2f baseline) override;
+
     // MARK: Clear Operations --------------------------------------------------
 
     void clear(Color color = BLACK) override;
@@ -0,0 +1,251 @@
+#include <karm-io/impls.h>
+#include <karm-logger/logger.h>
+#include <karm-sys/dir.h>
+#include <karm-sys/file.h>
+#include <karm-sys/mmap.h>
+#include <karm-text/font.h>
+
+#include "glyphs.h"
+
+namespace Karm::Gfx {
+
+static Hash _hashKey(GlyphCache::Key const &key) {
+    Fnv fnv;
+    fnv.mix(key.face);
+    fnv.mix(key.glyph.index);
+    fnv.mix(key.glyph.font);
+    fnv.mix(key.size);
+    fnv.mix(key.subpixel);
+    fnv.mix(key.gridFit);
+    return fnv.h;
+}
+
+GlyphCache::GlyphCache(usize budget)
+    : _lru(budget, 256) {}
+
+GlyphCache::~GlyphCache() {
+    clear();
+}
+
+Opt<u64> GlyphCache::faceId(Strong<Text::Fontface> const &face) {
+    if (not _lastFace or &_lastFace->unwrap() != &face.unwrap()) {
+        _lastFace = face;
+        _lastId = face->digest();
+    }
+
+    if (not _lastId)
+        return NONE;
+    return _lastId;
+}
+
+GlyphMask const *GlyphCache::lookup(Key const &key) {
+    auto hash = _hashKey(key);
+
+    auto *entry = _lookup(hash, key);
+
+    // The first lookup in a strike pulls its cache file in
+    if (not entry and _persist) {
+        usize strikes = _strikes.len();
+        _strike(key);
+        if (_strikes.len() != strikes)
+            entry = _lookup(hash, key);
+    }
+
+    if (not entry) {
+        _stats.misses++;
+        return nullptr;
+    }
+
+    _stats.hits++;
+    _lru.touch(entry);
+    return &entry->mask;
+}
+
+GlyphMask const &GlyphCache::insert(Key const &key, GlyphMask mask) {
+    auto *entry = _insert(key, _hashKey(key), std::move(mask));
+    _strike(key).dirty = true;
+    _lru.evict(entry);
+    return entry->mask;
+}
+
+void GlyphCache::clear() {
+    _lru.clear();
+    _lastFace = NONE;
+}
+
+GlyphStats GlyphCache::stats() const {
+    auto stats = _stats;
+    stats.entries = _lru.len();
+    stats.bytes = _lru.bytes();
+    return stats;
+}
+
+Res<> GlyphCache::flush() {
+    if (not _persist)
+        return Ok();
+
+    for (auto &strike : _strikes) {
+        if (not strike.dirty)
+            continue;
+
+        Io::BufferWriter buf;
+        Io::BEmit e{buf};
+        writeStrike(strike, e);
+
+        auto url = strikeUrl(strike);
+        try$(Sys::Dir::create(url.parent()));
+        auto file = try$(Sys::File::create(url));
+        try$(file.write(buf.bytes()));
+        strike.dirty = false;
+    }
+
+    return Ok();
+}
+
+// MARK: Cache Files -----------------------------------------------------------
+
+Mime::Url GlyphCache::strikeUrl(Strike const &strike) {
+    auto name = Io::format(
+        "karm-glyphs-{:016x}-{}{}.cache",
+        strike.face,
+        strike.size,
+        Str{strike.gridFit ? "-fit" : ""}
+    );
+    return "location://home/.cache"_url / name.unwrap();
+}
+
+Res<> GlyphCache::readStrike(Strike const &strike, Bytes bytes) {
+    Io::BScan s{bytes};
+    if (s.rem() < 24 or
+        s.nextU32le() != FILE_MAGIC or
+        s.nextU32le() != FILE_VERSION or
+        s.nextU64le() != strike.face or
+        s.nextU16le() != strike.size or
+        s.nextU16le() != strike.gridFit)
+        return Error::invalidData("glyph cache doesn't match the strike");
+
+    usize count = s.nextU32le();
+    for (usize i = 0; i < count; i++) {
+        if (s.rem() < 13)
+            return Error::invalidData("truncated glyph cache");
+
+        Key key{
+            .face = strike.face,
+            .glyph = {s.nextU16le(), s.nextU16le()},
+            .size = strike.size,
+            .subpixel = s.nextU8le(),
+            .gridFit = strike.gridFit,
+        };
+
+        GlyphMask mask;
+        mask.origin.x = (i16)s.nextU16le();
+        mask.origin.y = (i16)s.nextU16le();
+        mask.size.x = s.nextU16le();
+        mask.size.y = s.nextU16le();
+
+        usize len = mask.size.x * mask.size.y;
+        if (s.rem() < len)
+            return Error::invalidData("truncated glyph cache");
+
+        mask.alpha.resize(len);
+        for (usize j = 0; j < len; j++)
+            mask.alpha[j] = s.nextU8le();
+
+        auto hash = _hashKey(key);
+        if (_lookup(hash, key))
+            continue;
+
+        _insert(key, hash, std::move(mask));
+        _stats.loaded++;
+    }
+
+    _lru.evict();
+    return Ok();
+}
+
+void GlyphCache::writeStrike(Strike const &strike, Io::BEmit &e) {
+    usize count = 0;
+    for (auto *entry = _lru.head(); entry; entry = _lru.next(entry)) {
+        auto &k = entry->key;
+        if (k.face == strike.face and k.size == strike.size and k.gridFit == strike.gridFit)
+            count++;
+    }
+
+    e.writeU32le(FILE_MAGIC);
+    e.writeU32le(FILE_VERSION);
+    e.writeU64le(strike.face);
+    e.writeU16le(strike.size);
+    e.writeU16le(strike.gridFit);
+    e.writeU32le(count);
+
+    for (auto *entry = _lru.head(); entry; entry = _lru.next(entry)) {
+        auto &k = entry->key;
+        if (k.face != strike.face or k.size != strike.size or k.gridFit != strike.gridFit)
+            continue;
+
+        auto &mask = entry->mask;
+        e.writeU16le(k.glyph.index);
+        e.writeU16le(k.glyph.font);
+        e.writeU8le(k.subpixel);
+        e.writeU16le((u16)mask.origin.x);
+        e.writeU16le((u16)mask.origin.y);
+        e.writeU16le(mask.size.x);
+        e.writeU16le(mask.size.y);
+        e.writeBytes(mask.alpha);
+    }
+}
+
+// MARK: Internals -------------------------------------------------------------
+
+GlyphCache::Strike &GlyphCache::_strike(Key const &key) {
+    for (auto &strike : _strikes) {
+        if (strike.face == key.face and
+            strike.size == key.size and
+            strike.gridFit == key.gridFit)
+            return strike;
+    }
+
+    _strikes.pushBack({
+        .face = key.face,
+        .size = key.size,
+        .gridFit = key.gridFit,
+    });
+    auto &strike = last(_strikes);
+
+    if (_persist) {
+        auto url = strikeUrl(strike);
+        auto res = [&]() -> Res<> {
+            auto file = try$(Sys::File::open(url));
+            auto map = try$(Sys::mmap().map(file));
+            return readStrike(strike, map.bytes());
+        }();
+
+        if (not res and res.none().code() != Error::NOT_FOUND)
+            logWarn("failed to load glyph cache {}: {}", url, res.none());
+    }
+
+    return strike;
+}
+
+GlyphCache::Entry *GlyphCache::_lookup(Hash hash, Key const &key) {
+    return _lru.lookup(hash, [&](Entry const &e) {
+        return e.key == key;
+    });
+}
+
+GlyphCache::Entry *GlyphCache::_insert(Key const &key, Hash hash, GlyphMask mask) {
+    auto *entry = new Entry{
+        .key = key,
+        .hash = hash,
+        .mask = std::move(mask),
+    };
+    entry->bytes = sizeof(Entry) + entry->mask.alpha.len();
+    return _lru.insert(entry);
+}
+
+GlyphCache &globalGlyphCache() {
+    static GlyphCache cache;
+    return cache;
+}
+
+} // namespace Karm::Gfx
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <karm-base/lru.h>
+#include <karm-base/rc.h>
+#include <karm-base/vec.h>
+#include <karm-io/bscan.h>
+#include <karm-math/vec.h>
+#include <karm-mime/url.h>
+#include <karm-text/base.h>
+
+namespace Karm::Text {
+struct Fontface;
+} // namespace Karm::Text
+
+namespace Karm::Gfx {
+
+// The coverage of a glyph rasterized at a given size, `origin` is the
+// position of the top left corner of the mask relative to the pen position
+// on the baseline.
+struct GlyphMask {
+    Math::Vec2i origin;
+    Math::Vec2i size;
+    Vec<u8> alpha; //< size.x * size.y, row major
+};
+
+struct GlyphStats {
+    usize hits = 0;
+    usize misses = 0;
+    usize loaded = 0; //< Masks loaded from cache files
+    usize entries = 0;
+    usize bytes = 0;
+
+    void repr(Io::Emit &e) const {
+        e("(glyph-stats hits:{} misses:{} loaded:{} entries:{} bytes:{})", hits, misses, loaded, entries, bytes);
+    }
+};
+
+// Pre-rasterized glyph masks for small text sizes, so UI text is blitted
+// instead of going through the polygon rasterizer for every glyph. Once
+// persistence is enabled, the masks of a face at a given size (a strike)
+// are saved to a cache file on flush() and loaded back the first time the
+// strike is used.
+struct GlyphCache {
+    static constexpr usize DEFAULT_BUDGET = 2 * 1024 * 1024;
+    static constexpr f64 MAX_SIZE = 48; //< Larger text goes through the rasterizer
+    static constexpr usize SUBPIXELS = 4;
+    static constexpr u32 FILE_MAGIC = 0x594c'474b; // "KGLY"
+    static constexpr u32 FILE_VERSION = 1;
+
+    struct Key {
+        u64 face; //< See faceId()
+        Text::Glyph glyph;
+        u16 size;    //< In 1/SUBPIXELS of a pixel
+        u8 subpixel; //< Horizontal pen position in 1/SUBPIXELS of a pixel
+        bool gridFit;
+
+        bool operator==(Key const &) const = default;
+    };
+
+    struct Entry {
+        Key key;
+        Hash hash;
+        GlyphMask mask;
+        usize bytes = 0;
+
+        Entry *chain = nullptr; //< Next entry in the same bucket
+        LlItem<Entry> item{};
+    };
+
+    struct Strike {
+        u64 face;
+        u16 size;
+        bool gridFit;
+        bool dirty = false;
+    };
+
+    BudgetLru<Entry> _lru;
+    Vec<Strike> _strikes{};
+    Opt<Strong<Text::Fontface>> _lastFace = NONE; //< Text runs draw many glyphs of the same face
+    u64 _lastId = 0;
+    GlyphStats _stats{};
+    bool _persist = false;
+
+    GlyphCache(usize budget = DEFAULT_BUDGET);
+
+    ~GlyphCache();
+
+    GlyphCache(GlyphCache const &) = delete;
+
+    GlyphCache &operator=(GlyphCache const &) = delete;
+
+    // Off by default, so only the apps that turn it on write to the disk.
+    void persist(bool enabled) {
+        _persist = enabled;
+    }
+
+    // The identity of a fontface is its digest, so it's the same across
+    // runs and changes with the font file. Faces without a digest have no
+    // identity and aren't cached, their address could be reused by
+    // another face once they are gone.
+    Opt<u64> faceId(Strong<Text::Fontface> const &face);
+
+    // The returned mask is only valid until the next call to insert().
+    GlyphMask const *lookup(Key const &key);
+
+    GlyphMask const &insert(Key const &key, GlyphMask mask);
+
+    void clear();
+
+    GlyphStats stats() const;
+
+    // Write the strikes that got new masks since they were loaded.
+    Res<> flush();
+
+    // MARK: Cache Files -------------------------------------------------------
+
+    static Mime::Url strikeUrl(Strike const &strike);
+
+    Res<> readStrike(Strike const &strike, Bytes bytes);
+
+    void writeStrike(Strike const &strike, Io::BEmit &e);
+
+    // MARK: Internals ---------------------------------------------------------
+
+    Strike &_strike(Key const &key);
+
+    Entry *_lookup(Hash hash, Key const &key);
+
+    Entry *_insert(Key const &key, Hash hash, GlyphMask mask);
+};
+
+GlyphCache &globalGlyphCache();
+
+} // namespace Karm::Gfx
@@ -2,203 +2,263 @@
 
 namespace Karm::Gfx {
 
-// MARK: Common ----------------------------------------------------------------
-
-static void _createArc(Math::Polyf &poly, Math::Vec2f center, Math::Vec2f start, Math::Vec2f end, f64 startAngle, f64 delta, f64 radius) {
-    isize divs = 32; // FIXME: determine this procedurally
-    f64 step = delta / divs;
-    for (isize i = 0; i < divs; i++) {
-        f64 sa = startAngle + step * i;
-        f64 ea = startAngle + step * (i + 1);
-
-        auto sp = i == 0 ? start : center + Math::Vec2f{radius * Math::cos(sa), radius * Math::sin(sa)};
-        auto ep = i + 1 == divs ? end : center + Math::Vec2f{radius * Math::cos(ea), radius * Math::sin(ea)};
+// Maximum distance in device pixels between an arc and the chords used to
+// approximate it, this matches the tolerance used when flattening curves.
+static constexpr f64 ARC_TOLERANCE = 0.25;
+
+// MARK: Stroker ---------------------------------------------------------------
+
+// Build the outline of a stroke as one closed polygon per side of each
+// contour, joins and caps are inserted inline so the rasterizer doesn't have
+// to fill the same pixels over and over.
+struct Stroker {
+    struct ArcStep {
+        f64 radius;
+        f64 angle;
+        f64 cos;
+        f64 sin;
+    };
+
+    Math::Polyf &_poly;
+    Stroke _stroke;
+    f64 _scale;
+    f64 _outerDist = 0;
+    f64 _innerDist = 0;
+
+    Vec<Math::Vec2f> _pts{};
+    Vec<Math::Vec2f> _outline{};
+    Vec<ArcStep> _steps{};
+
+    Stroker(Math::Polyf &poly, Stroke stroke, f64 scale)
+        : _poly(poly), _stroke(stroke), _scale(scale) {
+        if (stroke.align == CENTER_ALIGN) {
+            _outerDist = -stroke.width / 2;
+        } else if (stroke.align == OUTSIDE_ALIGN) {
+            _outerDist = -stroke.width;
+        }
 
-        poly.pushBack({sp, ep});
+        _innerDist = _outerDist + stroke.width;
     }
-}
-
-// MARK: Line Join -------------------------------------------------------------
-
-static void _createJoinBevel(Math::Polyf &poly, Math::Edgef curr, Math::Edgef next) {
-    poly.pushBack({curr.end, next.start});
-}
 
-static void _createJoinMiter(Math::Polyf &poly, Math::Edgef curr, Math::Edgef next, Math::Vec2f corner, f64 width) {
-    auto currVec = curr.dir();
-    auto nextVec = next.invDir();
-    auto diffVec = next.start - curr.end;
+    // MARK: Arcs --------------------------------------------------------------
 
-    f64 mitterLimit = width * 4;
-    auto c = nextVec.cross(currVec);
-
-    if (Math::abs(c) < 0.001) {
-        // parallel
-        return;
-    }
+    // All the joins and caps of a stroke share the same couple of radii,
+    // so the step used to walk an arc is only computed once per radius.
+    ArcStep const &_arcStep(f64 radius) {
+        for (auto const &step : _steps) {
+            if (step.radius == radius)
+                return step;
+        }
 
-    auto j = nextVec.cross(diffVec) / c;
-    auto v = curr.end + (currVec * j);
+        // Pick the largest angle whose chord stays within the tolerance
+        // once the arc is projected to device space.
+        f64 r = radius * _scale;
+        f64 angle = Math::PI / 2;
+        if (r > ARC_TOLERANCE)
+            angle = min(angle, 2 * acos(1 - ARC_TOLERANCE / r));
+        angle = max(angle, Math::TAU / 256);
 
-    if (j < 0 or (corner - v).lenSq() > mitterLimit * mitterLimit) {
-        _createJoinBevel(poly, curr, next);
-        return;
+        _steps.pushBack({radius, angle, Math::cos(angle), Math::sin(angle)});
+        return last(_steps);
     }
 
-    poly.pushBack({curr.end, v});
-    poly.pushBack({v, next.start});
-}
+    void _arc(Math::Vec2f center, Math::Vec2f from, Math::Vec2f to, f64 delta, f64 radius) {
+        auto const &step = _arcStep(radius);
+        f64 c = step.cos;
+        f64 s = delta < 0 ? -step.sin : step.sin;
 
-static void _createJoinRound(Math::Polyf &poly, Math::Edgef curr, Math::Edgef next, Math::Vec2f corner, f64 radius) {
-    f64 startAngle = (curr.end - corner).angle();
-    f64 endAngle = (next.start - corner).angle();
+        auto v = from - center;
+        for (f64 a = step.angle; a < Math::abs(delta); a += step.angle) {
+            v = {v.x * c - v.y * s, v.x * s + v.y * c};
+            _outline.pushBack(center + v);
+        }
 
-    if (startAngle > endAngle) {
-        startAngle -= Math::TAU;
+        _outline.pushBack(to);
     }
 
-    f64 delta = endAngle - startAngle;
+    // MARK: Line Join ---------------------------------------------------------
 
-    if (delta > Math::PI) {
-        _createJoinBevel(poly, curr, next);
-        return;
-    }
+    void _joinMiter(Math::Edgef currOff, Math::Edgef nextOff, Math::Vec2f corner) {
+        auto currVec = currOff.dir();
+        auto nextVec = nextOff.invDir();
+        auto diffVec = nextOff.start - currOff.end;
 
-    _createArc(poly, corner, curr.end, next.start, startAngle, delta, radius);
-}
-
-static void _createJoin(Math::Polyf &poly, Stroke stroke, Math::Edgef curr, Math::Edgef next, Math::Vec2f corner, f64 radius) {
-    // Make sure that the edge is not degenerate
-    if (Math::Edgef{curr.end, next.start}.degenerated())
-        return;
+        f64 mitterLimit = _stroke.width * 4;
+        auto c = nextVec.cross(currVec);
 
-    switch (stroke.join) {
-    case BEVEL_JOIN:
-        _createJoinBevel(poly, curr, next);
-        break;
+        if (Math::abs(c) < 0.001) {
+            // parallel
+            _outline.pushBack(nextOff.start);
+            return;
+        }
 
-    case MITER_JOIN:
-        _createJoinMiter(poly, curr, next, corner, stroke.width);
-        break;
+        auto j = nextVec.cross(diffVec) / c;
+        auto v = currOff.end + (currVec * j);
 
-    case ROUND_JOIN:
-        _createJoinRound(poly, curr, next, corner, radius);
-        break;
+        if (j < 0 or (corner - v).lenSq() > mitterLimit * mitterLimit) {
+            _outline.pushBack(nextOff.start);
+            return;
+        }
 
-    default:
-        panic("unknown join type");
+        _outline.pushBack(v);
+        _outline.pushBack(nextOff.start);
     }
-}
 
-// MARK: Line Cap --------------------------------------------------------------
+    void _joinRound(Math::Edgef currOff, Math::Edgef nextOff, Math::Vec2f corner, f64 radius) {
+        f64 delta = (currOff.end - corner).angleWith(nextOff.start - corner);
+        _arc(corner, currOff.end, nextOff.start, delta, radius);
+    }
 
-struct Cap {
-    Math::Vec2f start;
-    Math::Vec2f end;
-    Math::Vec2f center;
-};
+    void _join(Math::Edgef curr, Math::Edgef currOff, Math::Edgef next, Math::Edgef nextOff, f64 dist) {
+        auto corner = curr.end;
 
-static void _createCapButt(Math::Polyf &poly, Cap cap) {
-    poly.pushBack({cap.start, cap.end});
-}
+        if (Math::abs(dist) < 0.001 or
+            Math::epsilonEq(currOff.end, nextOff.start, 0.001)) {
+            _outline.pushBack(nextOff.start);
+            return;
+        }
 
-static void _createCapSquare(Math::Polyf &poly, Cap cap, f64 width) {
-    auto e = Math::Edgef{cap.start, cap.end}.offset(-width / 2);
-    poly.pushBack({cap.start, e.start});
-    poly.pushBack(e);
-    poly.pushBack({e.end, cap.end});
-}
+        // On the inner side of the turn the offset segments overlap,
+        // pivot around the corner so the outline stays a single loop.
+        if (curr.dir().cross(next.dir()) * dist > 0) {
+            _outline.pushBack(corner);
+            _outline.pushBack(nextOff.start);
+            return;
+        }
 
-static void _createCapRound(Math::Polyf &poly, Cap cap, f64 width) {
-    f64 startAngle = (cap.start - cap.center).angle();
-    f64 endAngle = (cap.end - cap.center).angle();
+        switch (_stroke.join) {
+        case BEVEL_JOIN:
+            _outline.pushBack(nextOff.start);
+            break;
 
-    if (startAngle > endAngle) {
-        startAngle -= Math::TAU;
-    }
+        case MITER_JOIN:
+            _joinMiter(currOff, nextOff, corner);
+            break;
 
-    f64 delta = endAngle - startAngle;
+        case ROUND_JOIN:
+            _joinRound(currOff, nextOff, corner, Math::abs(dist));
+            break;
 
-    _createArc(poly, cap.center, cap.start, cap.end, startAngle, delta, width / 2);
-}
-
-static void _createCap(Math::Polyf &poly, Stroke stroke, Cap cap) {
-    switch (stroke.cap) {
-    case BUTT_CAP:
-        _createCapButt(poly, cap);
-        break;
-    case SQUARE_CAP:
-        _createCapSquare(poly, cap, stroke.width);
-        break;
-    case ROUND_CAP:
-        _createCapRound(poly, cap, stroke.width);
-        break;
-    default:
-        panic("unknown cap type");
+        default:
+            panic("unknown join type");
+        }
     }
-}
 
-// MARK: Public Api ------------------------------------------------------------
+    // MARK: Line Cap ----------------------------------------------------------
+
+    // Connect the end of the side at `fromDist` to the end of the side at
+    // `toDist` around the last point of the segment.
+    void _cap(Math::Edgef seg, f64 fromDist, f64 toDist) {
+        auto from = seg.offset(fromDist).end;
+        auto to = seg.offset(toDist).end;
+
+        switch (_stroke.cap) {
+        case BUTT_CAP:
+            _outline.pushBack(to);
+            break;
+
+        case SQUARE_CAP: {
+            auto ext = seg.dir().unit() * (_stroke.width / 2);
+            _outline.pushBack(from + ext);
+            _outline.pushBack(to + ext);
+            _outline.pushBack(to);
+            break;
+        }
 
-[[gnu::flatten]] void createStroke(Math::Polyf &poly, Math::Path const &path, Stroke stroke) {
-    f64 outerDist = 0;
+        case ROUND_CAP: {
+            auto center = (from + to) / 2;
+            f64 delta = (from - center).normal().dot(seg.dir()) > 0 ? Math::PI : -Math::PI;
+            _arc(center, from, to, delta, _stroke.width / 2);
+            break;
+        }
 
-    if (stroke.align == CENTER_ALIGN) {
-        outerDist = -stroke.width / 2;
-    } else if (stroke.align == OUTSIDE_ALIGN) {
-        outerDist = -stroke.width;
+        default:
+            panic("unknown cap type");
+        }
     }
 
-    f64 innerDist = outerDist + stroke.width;
-
-    for (auto contour : path.iterContours()) {
-        auto l = contour.close ? contour.len() : contour.len() - 1;
+    // MARK: Outline -----------------------------------------------------------
 
-        for (usize i = 0; i < l; i++) {
-            Math::Edgef curr = {contour[i], contour[(i + 1) % contour.len()]};
+    Math::Edgef _segment(usize i) const {
+        return {_pts[i % _pts.len()], _pts[(i + 1) % _pts.len()]};
+    }
 
-            if (curr.degenerated()) {
-                continue;
-            }
+    // Append the offset of the current contour at the given distance,
+    // with joins inserted between consecutive segments.
+    void _side(f64 dist, bool close) {
+        usize l = close ? _pts.len() : _pts.len() - 1;
 
-            auto outerCurr = curr.offset(outerDist);
-            auto innerCurr = curr.offset(innerDist).swap();
+        auto curr = _segment(0);
+        auto currOff = curr.offset(dist);
 
-            poly.pushBack(outerCurr);
-            poly.pushBack(innerCurr);
+        if (not close)
+            _outline.pushBack(currOff.start);
 
-            if (i == 0 and not contour.close) {
-                auto center = (innerCurr.end + outerCurr.start) / 2;
-                _createCap(poly, stroke, {innerCurr.end, outerCurr.start, center});
-            }
+        for (usize i = 0; i < l; i++) {
+            _outline.pushBack(currOff.end);
 
-            if (i + 1 == l and not contour.close) {
-                auto center = (outerCurr.end + innerCurr.start) / 2;
-                _createCap(poly, stroke, {outerCurr.end, innerCurr.start, center});
-            }
+            if (not close and i + 1 == l)
+                break;
 
-            if (contour.close or i + 1 != l) {
-                Math::Edgef next = {
-                    contour[(i + 1) % contour.len()],
-                    contour[(i + 2) % contour.len()],
-                };
+            auto next = _segment(i + 1);
+            auto nextOff = next.offset(dist);
+            _join(curr, currOff, next, nextOff, dist);
 
-                // Make sure that the edge is not degenerate
-                if (next.degenerated()) {
-                    continue;
-                }
+            curr = next;
+            currOff = nextOff;
+        }
+    }
 
-                auto outerNext = outerDist > -0.001 ? next : next.offset(outerDist);
-                auto innerNext = innerDist < 0.001 ? next.swap() : next.offset(innerDist).swap();
+    void _emit() {
+        for (usize i = 0; i < _outline.len(); i++) {
+            Math::Edgef e = {_outline[i], _outline[(i + 1) % _outline.len()]};
+            if (not e.degenerated(0.001))
+                _poly.pushBack(e);
+        }
+        _outline.clear();
+    }
 
-                if (outerDist < -0.001)
-                    _createJoin(poly, stroke, outerCurr, outerNext, curr.end, Math::abs(outerDist));
+    void contour(Slice<Math::Vec2f> verts, bool close) {
+        _pts.clear();
+        for (auto p : verts) {
+            if (_pts.len() and Math::epsilonEq(last(_pts), p, 0.001))
+                continue;
+            _pts.pushBack(p);
+        }
 
-                if (innerDist > 0.001)
-                    _createJoin(poly, stroke, innerNext, innerCurr, curr.end, Math::abs(innerDist));
-            }
+        if (close and _pts.len() > 1 and Math::epsilonEq(first(_pts), last(_pts), 0.001))
+            _pts.popBack();
+
+        if (_pts.len() < 2)
+            return;
+
+        if (close) {
+            // Two loops winding in opposite directions
+            _side(_outerDist, true);
+            _emit();
+
+            reverse(mutSub(_pts));
+            _side(-_innerDist, true);
+            _emit();
+        } else {
+            // A single loop going forward on one side and back on the other
+            _side(_outerDist, false);
+            _cap(_segment(_pts.len() - 2), _outerDist, _innerDist);
+
+            reverse(mutSub(_pts));
+            _side(-_innerDist, false);
+            _cap(_segment(_pts.len() - 2), -_innerDist, -_outerDist);
+            _emit();
         }
     }
+};
+
+// MARK: Public Api ------------------------------------------------------------
+
+[[gnu::flatten]] void createStroke(Math::Polyf &poly, Math::Path const &path, Stroke stroke, f64 scale) {
+    Stroker stroker{poly, stroke, scale};
+    for (auto contour : path.iterContours())
+        stroker.contour(contour, contour.close);
 }
 
 void createSolid(Math::Polyf &poly, Math::Path const &path) {
@@ -66,7 +66,10 @@ inline Stroke stroke(auto... args) {
     return {args...};
 }
 
-void createStroke(Math::Polyf &poly, Math::Path const &path, Stroke stroke);
+// Create the outline of the stroke of a path, `scale` is the factor between
+// path space and device space, it's used to pick how finely arcs are
+// subdivided.
+void createStroke(Math::Polyf &poly, Math::Path const &path, Stroke stroke, f64 scale = 1);
 
 void createSolid(Math::Polyf &poly, Math::Path const &path);
 
@@ -0,0 +1,44 @@
+#include <karm-gfx/glyphs.h>
+#include <karm-test/macros.h>
+#include <karm-text/font.h>
+
+namespace Karm::Gfx::Tests {
+
+test$("glyph-cache-face-id") {
+    GlyphCache lhs, rhs;
+    auto face = Text::Fontface::fallback();
+
+    // Faces are known by their data, not by their instance
+    auto id = lhs.faceId(face);
+    expect$(id);
+    expectEq$(lhs.faceId(face), id);
+    expectEq$(rhs.faceId(Text::Fontface::fallback()), id);
+
+    return Ok();
+}
+
+test$("glyph-cache-no-persist") {
+    // Nothing is written unless persistence is turned on
+    GlyphCache cache;
+    auto face = cache.faceId(Text::Fontface::fallback()).unwrap();
+
+    GlyphCache::Key key{
+        .face = face,
+        .glyph = {'a', 0},
+        .size = 12 * GlyphCache::SUBPIXELS,
+        .subpixel = 0,
+        .gridFit = true,
+    };
+    expect$(cache.lookup(key) == nullptr);
+
+    cache.insert(key, {.origin = {0, -8}, .size = {1, 1}, .alpha = {255}});
+    expect$(cache.lookup(key) != nullptr);
+    expect$(last(cache._strikes).dirty);
+
+    try$(cache.flush());
+    expect$(last(cache._strikes).dirty);
+
+    return Ok();
+}
+
+} // namespace Karm::Gfx::Tests
@@ -0,0 +1,166 @@
+#include <karm-gfx/context.h>
+#include <karm-test/macros.h>
+
+namespace Karm::Gfx::Tests {
+
+// Black strokes on white, how dark a pixel is tells how much it's covered
+static Strong<Surface> _stroke(Stroke stroke, Math::Path const &path) {
+    auto img = Surface::alloc({64, 64});
+    Context ctx;
+    ctx.begin(img->mutPixels());
+    ctx.clear(WHITE);
+
+    Canvas &g = ctx;
+    g.beginPath();
+    g.path(path);
+    g.stroke(stroke);
+
+    ctx.end();
+    return img;
+}
+
+static u8 _at(Strong<Surface> const &img, isize x, isize y) {
+    return img->pixels().load({x, y}).red;
+}
+
+// Edges falling on pixel boundaries can leave a rounding error behind
+static bool _covered(Strong<Surface> const &img, isize x, isize y) {
+    return _at(img, x, y) < 8;
+}
+
+static bool _blank(Strong<Surface> const &img, isize x, isize y) {
+    return _at(img, x, y) > 247;
+}
+
+static bool _partial(Strong<Surface> const &img, isize x, isize y) {
+    return not _covered(img, x, y) and not _blank(img, x, y);
+}
+
+static Math::Path _polyline(std::initializer_list<Math::Vec2f> points) {
+    Math::Path path;
+    bool first = true;
+    for (auto p : points) {
+        if (first)
+            path.moveTo(p);
+        else
+            path.lineTo(p);
+        first = false;
+    }
+    return path;
+}
+
+test$("stroke-caps") {
+    auto path = _polyline({{10, 10}, {20, 10}});
+    auto butt = _stroke(Stroke{.width = 4, .cap = BUTT_CAP}, path);
+    auto square = _stroke(Stroke{.width = 4, .cap = SQUARE_CAP}, path);
+    auto round = _stroke(Stroke{.width = 4, .cap = ROUND_CAP}, path);
+
+    // Inside the line, every cap agrees
+    expect$(_covered(butt, 15, 10));
+    expect$(_covered(square, 15, 10));
+    expect$(_covered(round, 15, 10));
+
+    // Past the end, only square and round caps reach
+    expect$(_blank(butt, 8, 10));
+    expect$(_covered(square, 8, 10));
+    expect$(_at(round, 8, 10) < 128);
+
+    // The corner of the square cap is cut off by the round one
+    expect$(_covered(square, 8, 8));
+    expect$(_partial(round, 8, 8));
+
+    return Ok();
+}
+
+test$("stroke-joins") {
+    // A right turn, the outer corner of the stroke is at (33, 27)
+    auto path = _polyline({{10, 30}, {30, 30}, {30, 50}});
+    auto bevel = _stroke(Stroke{.width = 6, .join = BEVEL_JOIN}, path);
+    auto miter = _stroke(Stroke{.width = 6, .join = MITER_JOIN}, path);
+    auto round = _stroke(Stroke{.width = 6, .join = ROUND_JOIN}, path);
+
+    expect$(_blank(bevel, 31, 27));
+    expect$(_covered(miter, 31, 27));
+    expect$(_partial(round, 31, 27));
+
+    // The inner side of the turn is filled whatever the join
+    for (auto const &img : {bevel, miter, round}) {
+        expect$(_covered(img, 28, 32));
+        expect$(_covered(img, 29, 29));
+    }
+
+    return Ok();
+}
+
+test$("stroke-closed") {
+    // Closed contours are joined at their first point too
+    auto path = _polyline({{10, 10}, {40, 10}, {40, 40}, {10, 40}});
+    path.close();
+    auto miter = _stroke(Stroke{.width = 4, .join = MITER_JOIN}, path);
+
+    expect$(_covered(miter, 8, 8));
+    expect$(_covered(miter, 41, 41));
+    expect$(_blank(miter, 25, 25));
+
+    return Ok();
+}
+
+test$("stroke-hairline") {
+    // Half a pixel wide, drawn at half opacity
+    auto stroke = Stroke{.width = 0.5};
+
+    // Pixel centers on a straight line through a vertex
+    auto straight = _stroke(stroke, _polyline({{2.5, 2.5}, {8.5, 2.5}, {14.5, 2.5}}));
+    u8 inside = _at(straight, 5, 2);
+    expect$(inside > 0 and inside < 255);
+    expectEq$(_at(straight, 8, 2), inside);
+    expectEq$(_at(straight, 11, 2), inside);
+    expect$(_blank(straight, 5, 1));
+    expect$(_blank(straight, 5, 3));
+
+    // The vertex of a turn isn't darker than the lines around it
+    auto turn = _stroke(stroke, _polyline({{2.5, 20.5}, {10.5, 20.5}, {10.5, 28.5}}));
+    expectEq$(_at(turn, 10, 20), _at(turn, 6, 20));
+    expectEq$(_at(turn, 10, 24), _at(turn, 6, 20));
+
+    // Closed contours have no ends, all of their corners are joints
+    auto box = _polyline({{30.5, 30.5}, {40.5, 30.5}, {40.5, 40.5}, {30.5, 40.5}});
+    box.close();
+    auto closed = _stroke(stroke, box);
+    expectEq$(_at(closed, 30, 30), _at(closed, 35, 30));
+    expectEq$(_at(closed, 40, 40), _at(closed, 35, 30));
+
+    return Ok();
+}
+
+test$("stroke-hairline-aligned") {
+    // A 1px border drawn inside a box stays on its first row and column of
+    // pixels, like box borders do
+    Math::Path path;
+    path.rect({10, 10, 20, 20});
+    auto inside = _stroke(Stroke{.width = 1, .align = INSIDE_ALIGN}, path);
+
+    for (isize i = 10; i < 30; i++) {
+        expect$(_covered(inside, 10, i));
+        expect$(_covered(inside, 29, i));
+        expect$(_covered(inside, i, 10));
+        expect$(_covered(inside, i, 29));
+
+        expect$(_blank(inside, 9, i));
+        expect$(_blank(inside, 30, i));
+        expect$(_blank(inside, i, 9));
+        expect$(_blank(inside, i, 30));
+    }
+    expect$(_blank(inside, 11, 20));
+    expect$(_blank(inside, 28, 20));
+
+    // Outside, the border hugs the box from the other side
+    auto outside = _stroke(Stroke{.width = 1, .align = OUTSIDE_ALIGN}, path);
+    expect$(_covered(outside, 9, 20));
+    expect$(_blank(outside, 10, 20));
+    expect$(_blank(outside, 8, 20));
+
+    return Ok();
+}
+
+} // namespace Karm::Gfx::Tests
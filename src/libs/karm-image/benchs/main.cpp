@@ -0,0 +1,712 @@
+#include <stdlib.h>
+
+#include <karm-base/atomic.h>
+#include <karm-image/bmp/decoder.h>
+#include <karm-image/bmp/encoder.h>
+#include <karm-image/jpeg/decoder.h>
+#include <karm-image/png/decoder.h>
+#include <karm-image/qoi/decoder.h>
+#include <karm-image/saver.h>
+#include <karm-io/aton.h>
+#include <karm-io/impls.h>
+#include <karm-io/inflate.h>
+#include <karm-json/stringify.h>
+#include <karm-sys/entry.h>
+#include <karm-sys/file.h>
+#include <karm-sys/time.h>
+
+namespace Karm::Image::Benchs {
+
+// Scenarios return a checksum of their output, the decoded pixels or the
+// encoded bytes, so a change in the output of a codec shows up next to its
+// timings.
+struct Scenario {
+    Str name;
+    usize (*size)();
+    Hash (*run)();
+};
+
+// MARK: Memory ----------------------------------------------------------------
+
+// The global allocator is replaced to keep track of the heap in use, so the
+// peak memory of a scenario can be reported next to its timings.
+static constinit Atomic<usize> _heapUsed;
+static constinit Atomic<usize> _heapPeak;
+
+static constexpr usize HEAP_HEADER = 16;
+
+static void *_heapAlloc(usize size) {
+    auto *header = static_cast<usize *>(malloc(size + HEAP_HEADER));
+    if (not header)
+        panic("out of memory");
+    *header = size;
+
+    usize used = _heapUsed.fetchAdd(size) + size;
+    usize peak = _heapPeak.load();
+    while (used > peak and not _heapPeak.cmpxchg(peak, used))
+        peak = _heapPeak.load();
+
+    return reinterpret_cast<u8 *>(header) + HEAP_HEADER;
+}
+
+static void _heapFree(void *ptr) {
+    if (not ptr)
+        return;
+    auto *header = reinterpret_cast<usize *>(static_cast<u8 *>(ptr) - HEAP_HEADER);
+    _heapUsed.fetchSub(*header);
+    free(header);
+}
+
+// MARK: Corpus ----------------------------------------------------------------
+
+static void _pushU32be(Vec<u8> &out, u32 v) {
+    out.pushBack(v >> 24);
+    out.pushBack(v >> 16);
+    out.pushBack(v >> 8);
+    out.pushBack(v);
+}
+
+static void _pushChunk(Vec<u8> &out, Str sig, Bytes data) {
+    _pushU32be(out, data.len());
+    Io::Crc32 crc;
+    crc.update(bytes(sig));
+    crc.update(data);
+    out.insertMany(out.len(), bytes(sig));
+    out.insertMany(out.len(), data);
+    _pushU32be(out, crc.digest());
+}
+
+// A PNG whose image data is kept in stored deflate blocks, decoding it
+// measures the filters and the color conversion rather than inflate.
+static Vec<u8> _synthPng(isize width, isize height, u8 colorType, usize channels, bool interlaced) {
+    Vec<u8> raw;
+    auto rows = [&](isize pw, isize ph) {
+        for (isize y = 0; y < ph; y++) {
+            raw.pushBack(y % 5);
+            for (isize x = 0; x < pw * (isize)channels; x++)
+                raw.pushBack((x * 7 + y * 3) ^ (x >> 3));
+        }
+    };
+
+    if (interlaced) {
+        struct Pass {
+            isize x, y, dx, dy;
+        };
+
+        Array const ADAM7 = {
+            Pass{0, 0, 8, 8},
+            Pass{4, 0, 8, 8},
+            Pass{0, 4, 4, 8},
+            Pass{2, 0, 4, 4},
+            Pass{0, 2, 2, 4},
+            Pass{1, 0, 2, 2},
+            Pass{0, 1, 1, 2},
+        };
+        for (auto [x, y, dx, dy] : ADAM7)
+            rows((width - x + dx - 1) / dx, (height - y + dy - 1) / dy);
+    } else {
+        rows(width, height);
+    }
+
+    Vec<u8> zlib;
+    zlib.pushBack(0x78);
+    zlib.pushBack(0x01);
+    for (usize i = 0; i < raw.len(); i += 0xffff) {
+        usize len = min(raw.len() - i, 0xffffuz);
+        zlib.pushBack(i + len == raw.len());
+        zlib.pushBack(len);
+        zlib.pushBack(len >> 8);
+        zlib.pushBack(~len);
+        zlib.pushBack(~len >> 8);
+        zlib.insertMany(zlib.len(), sub(raw, i, i + len));
+    }
+    Io::Adler32 adler;
+    adler.update(raw);
+    _pushU32be(zlib, adler.digest());
+
+    Vec<u8> png;
+    png.insertMany(0, Png::Decoder::SIG);
+
+    Vec<u8> ihdr;
+    _pushU32be(ihdr, width);
+    _pushU32be(ihdr, height);
+    ihdr.pushBack(8);
+    ihdr.pushBack(colorType);
+    ihdr.pushBack(0);
+    ihdr.pushBack(0);
+    ihdr.pushBack(interlaced);
+    _pushChunk(png, "IHDR", ihdr);
+
+    // Split the image data like encoders usually do
+    for (usize i = 0; i < zlib.len(); i += 8192)
+        _pushChunk(png, "IDAT", sub(zlib, i, min(i + 8192, zlib.len())));
+
+    _pushChunk(png, "IEND", {});
+    return png;
+}
+
+static Hash _decodePng(Bytes bytes) {
+    auto png = Png::Decoder::init(bytes).unwrap();
+    auto img = Gfx::Surface::alloc({png.width(), png.height()});
+    png.decode(*img).unwrap();
+    return hash(img->pixels().bytes());
+}
+
+// Photos are kept as files, writing a JPEG encoder only for the benchmarks
+// is not worth it
+static Sys::Mmap _map(Mime::Url url) {
+    auto file = Sys::File::open(url).unwrap();
+    return Sys::mmap().map(file).unwrap();
+}
+
+static Sys::Mmap _mapRes(Str name) {
+    return _map("bundle://karm-image.benchs"_url / name);
+}
+
+// The QOI test images are reused as they are
+static Sys::Mmap _mapQoi(Str name) {
+    return _map("bundle://karm-image.qoi.tests"_url / name);
+}
+
+static Hash _decodeJpeg(Bytes bytes, bool parallel = false, usize scale = 1) {
+    auto jpeg = Jpeg::Decoder::init(bytes).unwrap();
+    auto img = Gfx::Surface::alloc(jpeg.scaledSize(scale));
+    if (parallel)
+        jpeg.decodeParallel(*img, scale).unwrap();
+    else
+        jpeg.decode(*img, scale).unwrap();
+    return hash(img->pixels().bytes());
+}
+
+// MARK: Scenarios -------------------------------------------------------------
+
+static Vec<u8> const &_rgba() {
+    static auto png = _synthPng(2048, 2048, 6, 4, false);
+    return png;
+}
+
+static Vec<u8> const &_rgb() {
+    static auto png = _synthPng(2048, 2048, 2, 3, false);
+    return png;
+}
+
+static Vec<u8> const &_adam7() {
+    static auto png = _synthPng(2048, 2048, 6, 4, true);
+    return png;
+}
+
+static usize _rgbaSize() {
+    return _rgba().len();
+}
+
+static Hash _pngRgba() {
+    return _decodePng(_rgba());
+}
+
+static usize _rgbSize() {
+    return _rgb().len();
+}
+
+static Hash _pngRgb() {
+    return _decodePng(_rgb());
+}
+
+static usize _adam7Size() {
+    return _adam7().len();
+}
+
+static Hash _pngAdam7() {
+    return _decodePng(_adam7());
+}
+
+static Bytes _photo444() {
+    static auto map = _mapRes("photo-444.jpg");
+    return map.bytes();
+}
+
+static Bytes _photo420() {
+    static auto map = _mapRes("photo-420.jpg");
+    return map.bytes();
+}
+
+// The same photo with a restart marker every MCU row
+static Bytes _photo420Rst() {
+    static auto map = _mapRes("photo-420-rst.jpg");
+    return map.bytes();
+}
+
+static usize _jpeg444Size() {
+    return _photo444().len();
+}
+
+static Hash _jpeg444() {
+    return _decodeJpeg(_photo444());
+}
+
+static usize _jpeg420Size() {
+    return _photo420().len();
+}
+
+static Hash _jpeg420() {
+    return _decodeJpeg(_photo420());
+}
+
+// Thumbnails only need the lowest frequencies of every block
+static Hash _jpeg420Eighth() {
+    return _decodeJpeg(_photo420(), false, 8);
+}
+
+static Hash _jpeg444Parallel() {
+    return _decodeJpeg(_photo444(), true);
+}
+
+static usize _jpeg420RstSize() {
+    return _photo420Rst().len();
+}
+
+static Hash _jpeg420Rst() {
+    return _decodeJpeg(_photo420Rst());
+}
+
+static Hash _jpeg420RstParallel() {
+    return _decodeJpeg(_photo420Rst(), true);
+}
+
+// Files from the QOI test suite, a render with large flat areas, a photo
+// and a test card with alpha
+static Bytes _dice() {
+    static auto map = _mapQoi("dice.qoi");
+    return map.bytes();
+}
+
+static Bytes _kodim() {
+    static auto map = _mapQoi("kodim23.qoi");
+    return map.bytes();
+}
+
+static Bytes _testcard() {
+    static auto map = _mapQoi("testcard_rgba.qoi");
+    return map.bytes();
+}
+
+static Hash _decodeQoi(Bytes bytes, bool generic = false) {
+    auto qoi = Qoi::Decoder::init(bytes).unwrap();
+    auto img = Gfx::Surface::alloc({qoi.width(), qoi.height()});
+    if (generic)
+        qoi.decodeGeneric(*img).unwrap();
+    else
+        qoi.decode(*img).unwrap();
+    return hash(img->pixels().bytes());
+}
+
+static usize _qoiDiceSize() {
+    return _dice().len();
+}
+
+static Hash _qoiDice() {
+    return _decodeQoi(_dice());
+}
+
+static Hash _qoiDiceGeneric() {
+    return _decodeQoi(_dice(), true);
+}
+
+static usize _qoiKodimSize() {
+    return _kodim().len();
+}
+
+static Hash _qoiKodim() {
+    return _decodeQoi(_kodim());
+}
+
+static Hash _qoiKodimGeneric() {
+    return _decodeQoi(_kodim(), true);
+}
+
+static usize _qoiTestcardSize() {
+    return _testcard().len();
+}
+
+static Hash _qoiTestcard() {
+    return _decodeQoi(_testcard());
+}
+
+static Hash _qoiTestcardGeneric() {
+    return _decodeQoi(_testcard(), true);
+}
+
+// Opaque images are encoded with 24 bits per pixel, the others with 32 and
+// the masks of their alpha
+static Vec<u8> _synthBmp(isize width, isize height, bool alpha) {
+    auto img = Gfx::Surface::alloc({width, height});
+    auto pixels = img->mutPixels();
+    for (isize y = 0; y < height; y++) {
+        for (isize x = 0; x < width; x++) {
+            pixels.store(
+                {x, y},
+                Gfx::Color::fromRgba((x * 7 + y * 3) ^ (x >> 3), y ^ (x >> 2), x + y, alpha ? x : 255)
+            );
+        }
+    }
+
+    Io::BufferWriter buf;
+    Bmp::Encoder bmp{buf, {width, height}, alpha};
+    bmp.writeRows(img->pixels()).unwrap();
+    bmp.finish().unwrap();
+
+    Vec<u8> out;
+    out.insertMany(0, buf.bytes());
+    return out;
+}
+
+// Every row starts with a literal stretch followed by runs of one color,
+// the encoders of RLE8 images give about the same mix
+static Vec<u8> _synthRle8(isize width, isize height) {
+    Io::BufferWriter buf;
+    Io::BEmit e{buf};
+
+    usize dataOffset = 14 + 40 + 256 * 4;
+    e.writeU8le('B');
+    e.writeU8le('M');
+    e.writeU32le(0); // file size
+    e.writeU32le(0); // reserved
+    e.writeU32le(dataOffset);
+
+    e.writeU32le(40);
+    e.writeI32le(width);
+    e.writeI32le(height);
+    e.writeU16le(1); // planes
+    e.writeU16le(8);
+    e.writeU32le(Bmp::Decoder::RLE8);
+    e.writeU32le(0); // image size
+    e.writeU32le(2835);
+    e.writeU32le(2835);
+    e.writeU32le(256);
+    e.writeU32le(0);
+
+    for (usize i = 0; i < 256; i++)
+        e.writeU32le(i * 0x010101);
+
+    for (isize y = 0; y < height; y++) {
+        e.writeU8le(0);
+        e.writeU8le(16);
+        for (isize x = 0; x < 16; x++)
+            e.writeU8le(x * 16 + y);
+        for (isize x = 16; x < width; x += 16) {
+            e.writeU8le(16);
+            e.writeU8le(x / 16 + y);
+        }
+        e.writeU8le(0); // end of line
+        e.writeU8le(0);
+    }
+    e.writeU8le(0); // end of bitmap
+    e.writeU8le(1);
+
+    Vec<u8> out;
+    out.insertMany(0, buf.bytes());
+    return out;
+}
+
+static Vec<u8> const &_bmp24() {
+    static auto bmp = _synthBmp(2048, 2048, false);
+    return bmp;
+}
+
+static Vec<u8> const &_bmp32() {
+    static auto bmp = _synthBmp(2048, 2048, true);
+    return bmp;
+}
+
+static Vec<u8> const &_rle8() {
+    static auto bmp = _synthRle8(2048, 2048);
+    return bmp;
+}
+
+static Hash _decodeBmp(Bytes bytes, bool parallel = false) {
+    auto bmp = Bmp::Decoder::init(bytes).unwrap();
+    auto img = Gfx::Surface::alloc({bmp.width(), bmp.height()});
+    if (parallel)
+        bmp.decodeParallel(*img).unwrap();
+    else
+        bmp.decode(*img).unwrap();
+    return hash(img->pixels().bytes());
+}
+
+static usize _bmp24Size() {
+    return _bmp24().len();
+}
+
+static Hash _bmp24Decode() {
+    return _decodeBmp(_bmp24());
+}
+
+static Hash _bmp24Parallel() {
+    return _decodeBmp(_bmp24(), true);
+}
+
+static usize _bmp32Size() {
+    return _bmp32().len();
+}
+
+static Hash _bmp32Decode() {
+    return _decodeBmp(_bmp32());
+}
+
+static Hash _bmp32Parallel() {
+    return _decodeBmp(_bmp32(), true);
+}
+
+static usize _rle8Size() {
+    return _rle8().len();
+}
+
+static Hash _rle8Decode() {
+    return _decodeBmp(_rle8());
+}
+
+// A rendered page, flat backgrounds, a few boxes and rows of glyph-like
+// strokes, which is what encoders see most of the time
+static Gfx::Surface const &_screenshot() {
+    static auto img = [] {
+        auto img = Gfx::Surface::alloc({1920, 1080});
+        auto pixels = img->mutPixels();
+        pixels.clear(Gfx::Color::fromHex(0xf6f6f6));
+        for (isize y = 0; y < 1080; y++) {
+            for (isize x = 0; x < 1920; x++) {
+                bool text = x >= 320 and x < 1600 and y >= 96 and y < 1040 and
+                            (y - 96) % 24 < 14 and ((x * 13) ^ (y * 7)) % 11 < 4;
+                if (y < 48)
+                    pixels.store({x, y}, Gfx::Color::fromHex(0x1f2937));
+                else if (x < 240)
+                    pixels.store({x, y}, Gfx::Color::fromHex(0xe5e7eb));
+                else if (text)
+                    pixels.store({x, y}, Gfx::Color::fromHex(0x222222));
+            }
+        }
+        return img;
+    }();
+    return *img;
+}
+
+static usize _screenshotSize() {
+    return _screenshot().pixels().bytes().len();
+}
+
+static Hash _encode(Gfx::Pixels pixels, Saver saver) {
+    Io::BufferWriter buf{pixels.bytes().len() / 4};
+    save(pixels, buf, saver).unwrap();
+    return hash(buf.bytes());
+}
+
+static Hash _encodePng0() {
+    return _encode(_screenshot().pixels(), {Format::PNG, 0});
+}
+
+static Hash _encodePng1() {
+    return _encode(_screenshot().pixels(), {Format::PNG, 1});
+}
+
+static Hash _encodePng6() {
+    return _encode(_screenshot().pixels(), {Format::PNG, 6});
+}
+
+static Hash _encodeQoi() {
+    return _encode(_screenshot().pixels(), {Format::QOI});
+}
+
+static Hash _encodeBmp() {
+    return _encode(_screenshot().pixels(), {Format::BMP});
+}
+
+static Array SCENARIOS = {
+    Scenario{"png-rgba", _rgbaSize, _pngRgba},
+    Scenario{"png-rgb", _rgbSize, _pngRgb},
+    Scenario{"png-adam7", _adam7Size, _pngAdam7},
+    Scenario{"jpeg-444", _jpeg444Size, _jpeg444},
+    Scenario{"jpeg-420", _jpeg420Size, _jpeg420},
+    Scenario{"jpeg-420-eighth", _jpeg420Size, _jpeg420Eighth},
+    Scenario{"jpeg-444-parallel", _jpeg444Size, _jpeg444Parallel},
+    Scenario{"jpeg-420-rst", _jpeg420RstSize, _jpeg420Rst},
+    Scenario{"jpeg-420-rst-parallel", _jpeg420RstSize, _jpeg420RstParallel},
+    Scenario{"qoi-dice", _qoiDiceSize, _qoiDice},
+    Scenario{"qoi-dice-generic", _qoiDiceSize, _qoiDiceGeneric},
+    Scenario{"qoi-kodim23", _qoiKodimSize, _qoiKodim},
+    Scenario{"qoi-kodim23-generic", _qoiKodimSize, _qoiKodimGeneric},
+    Scenario{"qoi-testcard", _qoiTestcardSize, _qoiTestcard},
+    Scenario{"qoi-testcard-generic", _qoiTestcardSize, _qoiTestcardGeneric},
+    Scenario{"bmp-24", _bmp24Size, _bmp24Decode},
+    Scenario{"bmp-24-parallel", _bmp24Size, _bmp24Parallel},
+    Scenario{"bmp-32", _bmp32Size, _bmp32Decode},
+    Scenario{"bmp-32-parallel", _bmp32Size, _bmp32Parallel},
+    Scenario{"bmp-rle8", _rle8Size, _rle8Decode},
+    Scenario{"encode-png-0", _screenshotSize, _encodePng0},
+    Scenario{"encode-png-1", _screenshotSize, _encodePng1},
+    Scenario{"encode-png-6", _screenshotSize, _encodePng6},
+    Scenario{"encode-qoi", _screenshotSize, _encodeQoi},
+    Scenario{"encode-bmp", _screenshotSize, _encodeBmp},
+};
+
+// MARK: Runner ----------------------------------------------------------------
+
+struct Options {
+    usize warmup = 3;
+    usize iterations = 30;
+    Opt<Str> filter = NONE;
+    bool json = false;
+};
+
+struct Result {
+    Str name;
+    usize size;
+    Vec<TimeSpan> samples;
+    Hash checksum;
+
+    // Most heap allocated at once by a run, output included
+    usize peakMemory;
+
+    TimeSpan percentile(f64 p) const {
+        usize i = min((usize)(p * samples.len()), samples.len() - 1);
+        return samples[i];
+    }
+
+    // Megabytes of input processed per second at the median
+    f64 throughput() const {
+        return size / (f64)max(percentile(0.5).toUSecs(), 1uz);
+    }
+
+    Json::Value toJson() const {
+        Json::Object obj;
+        obj.put("name"s, String{name});
+        obj.put("size"s, (Json::Integer)size);
+        obj.put("iterations"s, (Json::Integer)samples.len());
+        obj.put("min"s, (Json::Integer)first(samples).toUSecs());
+        obj.put("p50"s, (Json::Integer)percentile(0.5).toUSecs());
+        obj.put("p90"s, (Json::Integer)percentile(0.9).toUSecs());
+        obj.put("max"s, (Json::Integer)last(samples).toUSecs());
+        obj.put("throughput"s, throughput());
+        obj.put("checksum"s, (Json::Integer)checksum);
+        obj.put("peakMemory"s, (Json::Integer)peakMemory);
+        return obj;
+    }
+};
+
+static Result _run(Scenario const &scenario, Options const &options) {
+    for (usize i = 0; i < options.warmup; i++)
+        scenario.run();
+
+    Result result{scenario.name, scenario.size(), {}, 0, 0};
+
+    usize baseline = _heapUsed.load();
+    _heapPeak.store(baseline);
+    result.checksum = scenario.run();
+    result.peakMemory = _heapPeak.load() - baseline;
+
+    for (usize i = 0; i < options.iterations; i++) {
+        auto start = Sys::now();
+        scenario.run();
+        result.samples.pushBack(Sys::now() - start);
+    }
+
+    sort(result.samples, [](auto &a, auto &b) {
+        return a.toUSecs() <=> b.toUSecs();
+    });
+
+    return result;
+}
+
+static Res<Options> _parseOptions(Sys::Context &ctx) {
+    auto &args = Sys::useArgs(ctx);
+    Options options;
+
+    auto next = [&](usize &i) -> Res<Str> {
+        if (i + 1 >= args.len())
+            return Error::invalidInput("missing option value");
+        return Ok(args[++i]);
+    };
+
+    auto nextCount = [&](usize &i) -> Res<usize> {
+        auto count = Io::atoi(try$(next(i)));
+        if (not count or *count < 0)
+            return Error::invalidInput("expected a positive number");
+        return Ok(*count);
+    };
+
+    for (usize i = 0; i < args.len(); i++) {
+        auto arg = args[i];
+        if (arg == "--warmup") {
+            options.warmup = try$(nextCount(i));
+        } else if (arg == "--iterations") {
+            options.iterations = max(try$(nextCount(i)), 1uz);
+        } else if (arg == "--filter") {
+            options.filter = try$(next(i));
+        } else if (arg == "--json") {
+            options.json = true;
+        } else {
+            return Error::invalidInput("unknown option");
+        }
+    }
+
+    return Ok(options);
+}
+
+} // namespace Karm::Image::Benchs
+
+void *operator new(usize size) {
+    return Image::Benchs::_heapAlloc(size);
+}
+
+void *operator new[](usize size) {
+    return Image::Benchs::_heapAlloc(size);
+}
+
+void operator delete(void *ptr) {
+    Image::Benchs::_heapFree(ptr);
+}
+
+void operator delete[](void *ptr) {
+    Image::Benchs::_heapFree(ptr);
+}
+
+void operator delete(void *ptr, usize) {
+    Image::Benchs::_heapFree(ptr);
+}
+
+void operator delete[](void *ptr, usize) {
+    Image::Benchs::_heapFree(ptr);
+}
+
+Async::Task<> entryPointAsync(Sys::Context &ctx) {
+    using namespace Image::Benchs;
+
+    auto options = co_try$(_parseOptions(ctx));
+
+    Json::Array arr;
+    for (auto &scenario : SCENARIOS) {
+        if (options.filter and scenario.name != *options.filter)
+            continue;
+
+        auto result = _run(scenario, options);
+
+        if (options.json) {
+            arr.pushBack(result.toJson());
+            continue;
+        }
+
+        Sys::println(
+            "{}: min {} p50 {} p90 {} max {} {} MB/s peak {} KiB checksum {:x}",
+            result.name,
+            first(result.samples),
+            result.percentile(0.5),
+            result.percentile(0.9),
+            last(result.samples),
+            result.throughput(),
+            result.peakMemory / 1024,
+            result.checksum
+        );
+    }
+
+    if (options.json)
+        Sys::println("{}", co_try$(Json::stringify(arr)));
+
+    co_return Ok();
+}
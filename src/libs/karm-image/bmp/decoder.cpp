@@ -1,3 +1,6 @@
+#include <karm-base/simd.h>
+#include <karm-sys/thread.h>
+
 #include "decoder.h"
 
 namespace Bmp {
@@ -39,6 +42,9 @@ Res<> Decoder::readInfoHeader(Io::BScan &s) {
 
     _width = s.nextI32le();
     _height = s.nextI32le();
+    if (_width == 0 or _height == 0 or width() > MAX_SIZE or height() > MAX_SIZE) {
+        return Error::invalidData("invalid image size");
+    }
 
     auto planes = s.nextI16le();
     logDebug("planes: {}", planes);
@@ -47,27 +53,58 @@ Res<> Decoder::readInfoHeader(Io::BScan &s) {
     }
 
     _bpp = s.nextI16le();
+    if (_bpp != 1 and _bpp != 4 and _bpp != 8 and _bpp != 16 and _bpp != 24 and _bpp != 32) {
+        return Error::invalidData("invalid bpp");
+    }
 
     auto comporession = s.nextI32le();
-    if (comporession != RGB and comporession != RLE8 and comporession != RLE4) {
+    if (comporession != RGB and comporession != RLE8 and comporession != RLE4 and comporession != BITFIELDS) {
         return Error::invalidData("invalid compression");
     }
+    _compression = (Compression)comporession;
+
+    if (_compression == BITFIELDS and _bpp != 16 and _bpp != 32) {
+        return Error::invalidData("invalid bpp for bitfields");
+    }
+
+    if ((_compression == RLE8 and _bpp != 8) or (_compression == RLE4 and _bpp != 4)) {
+        return Error::invalidData("invalid bpp for run-length encoding");
+    }
 
     s.skip(4); // image size
     s.skip(4); // x pixels per meter
     s.skip(4); // y pixels per meter
-    _numsColors = s.nextI32le();
+    _numsColors = s.nextU32le();
     if (_numsColors == 0 and _bpp <= 8) {
         _numsColors = 1 << _bpp;
     }
 
+    if (_numsColors > 256) {
+        return Error::invalidData("invalid number of colors");
+    }
+
     s.skip(4); // important colors
-    s.skip(size - (s.tell() - start));
+
+    // The masks follow the header when it's too short to hold them
+    if (_compression == BITFIELDS) {
+        _masks[0] = s.nextU32le();
+        _masks[1] = s.nextU32le();
+        _masks[2] = s.nextU32le();
+        if (size >= 56)
+            _masks[3] = s.nextU32le();
+    }
+
+    if (s.tell() - start < size)
+        s.skip(size - (s.tell() - start));
 
     return Ok();
 }
 
 Res<> Decoder::readPalette(Io::BScan &s) {
+    if (s.rem() < _numsColors * 4) {
+        return Error::invalidData("palette too small");
+    }
+
     for (usize i = 0; i < _numsColors; ++i) {
         auto b = s.nextU8le();
         auto g = s.nextU8le();
@@ -75,82 +112,275 @@ Res<> Decoder::readPalette(Io::BScan &s) {
         s.skip(1); // reserved
 
         logDebug("palette[{}]: r: {}, g: {}, b: {}", i, r, g, b);
-        _palette.pushBack(Gfx::Color{r, g, b});
+        _palette.pushBack(Gfx::Color::fromRgba(r, g, b, 255));
     }
 
     return Ok();
 }
 
 Res<> Decoder::readPixels(Io::BScan &s) {
+    if (_dataOffset > s.rem() + s.tell()) {
+        return Error::invalidData("pixel data out of bounds");
+    }
+
     s.seek(_dataOffset);
     _pixels = s.remBytes();
+
+    // The padding of the last row is sometimes left out
+    if (_compression != RLE8 and _compression != RLE4 and
+        _pixels.len() < stride() * (height() - 1) + (width() * _bpp + 7) / 8) {
+        return Error::invalidData("pixel data too small");
+    }
+
     return Ok();
 }
 
-Res<> Decoder::decode(Gfx::MutPixels pixels) {
-    Io::BScan s{_pixels};
+// MARK: Fast Paths ------------------------------------------------------------
 
-    for (isize y = 0; y < height(); ++y) {
-        for (isize x = 0; x < width(); ++x) {
-            auto color = Gfx::Color{};
-            if (_bpp == 1) {
-                auto bit = s.nextBitbe();
-                if (bit >= _palette.len())
-                    return Error::invalidData("invalid palette index");
-                color = _palette[bit];
-            } else if (_bpp == 4) {
-                auto index = s.nextBitsbe(4);
+always_inline static u32 _pack(Gfx::Color c, bool bgra) {
+    if (bgra)
+        c = {c.blue, c.green, c.red, c.alpha};
+    u32 px;
+    memcpy(&px, &c, sizeof(px));
+    return px;
+}
+
+// Four pixels at a time, sixteen bytes are loaded for the twelve of four
+// BGR triplets so the last pixels of a row are done one by one.
+static void _swizzle24(u8 const *src, u8 *out, isize width, bool bgra) {
+    u8x16 const opaque = {
+        255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255
+    };
+
+    isize x = 0;
+    for (; x + 6 <= width; x += 4) {
+        u8x16 v, px;
+        memcpy(&v, src + x * 3, sizeof(v));
+        if (bgra)
+            px = __builtin_shufflevector(v, opaque, 0, 1, 2, 16, 3, 4, 5, 16, 6, 7, 8, 16, 9, 10, 11, 16);
+        else
+            px = __builtin_shufflevector(v, opaque, 2, 1, 0, 16, 5, 4, 3, 16, 8, 7, 6, 16, 11, 10, 9, 16);
+        memcpy(out + x * 4, &px, sizeof(px));
+    }
+
+    for (; x < width; x++) {
+        u8 const *p = src + x * 3;
+        u32 px = _pack({p[2], p[1], p[0], 255}, bgra);
+        memcpy(out + x * 4, &px, sizeof(px));
+    }
+}
+
+// BGRA or BGRX pixels, the fourth byte is ignored for opaque images
+static void _swizzle32(u8 const *src, u8 *out, isize width, bool bgra, bool opaque) {
+    u8 a = opaque ? 255 : 0;
+    u8x16 const alpha = {0, 0, 0, a, 0, 0, 0, a, 0, 0, 0, a, 0, 0, 0, a};
+
+    isize x = 0;
+    for (; x + 4 <= width; x += 4) {
+        u8x16 v;
+        memcpy(&v, src + x * 4, sizeof(v));
+        if (not bgra)
+            v = __builtin_shufflevector(v, v, 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        v |= alpha;
+        memcpy(out + x * 4, &v, sizeof(v));
+    }
+
+    for (; x < width; x++) {
+        u8 const *p = src + x * 4;
+        u32 px = _pack({p[2], p[1], p[0], (u8)(p[3] | a)}, bgra);
+        memcpy(out + x * 4, &px, sizeof(px));
+    }
+}
+
+// MARK: Decoding --------------------------------------------------------------
+
+// A channel of a pixel, scaled from the bits of its mask to 8 bits
+static u8 _channel(u32 pixel, u32 mask) {
+    if (not mask)
+        return 0;
+    u32 value = (pixel & mask) >> __builtin_ctz(mask);
+    usize bits = popcount(mask);
+    if (bits >= 8)
+        return value >> (bits - 8);
+    return value * 255 / ((1u << bits) - 1);
+}
+
+static Gfx::Color _unmask(u32 pixel, Array<u32, 4> const &masks) {
+    return Gfx::Color::fromRgba(
+        _channel(pixel, masks[0]),
+        _channel(pixel, masks[1]),
+        _channel(pixel, masks[2]),
+        masks[3] ? _channel(pixel, masks[3]) : 255
+    );
+}
+
+static u8 _index(u8 const *row, isize x, isize bpp) {
+    if (bpp == 8)
+        return row[x];
+    usize bit = x * bpp;
+    return (row[bit / 8] >> (8 - bpp - bit % 8)) & ((1 << bpp) - 1);
+}
+
+Res<Gfx::Color> Decoder::load(u8 const *row, isize x) const {
+    if (_bpp <= 8) {
+        auto index = _index(row, x, _bpp);
+        if (index >= _palette.len())
+            return Error::invalidData("invalid palette index");
+        return Ok(_palette[index]);
+    }
+
+    u8 const *p = row + x * _bpp / 8;
+    if (_compression == BITFIELDS) {
+        u32 pixel = p[0] | p[1] << 8;
+        if (_bpp == 32)
+            pixel |= p[2] << 16 | (u32)p[3] << 24;
+        return Ok(_unmask(pixel, _masks));
+    }
+
+    if (_bpp == 16) {
+        u16 pixel = p[0] | p[1] << 8;
+        return Ok(Gfx::Color::fromRgba(
+            ((pixel >> 10) & 0x1F) << 3,
+            ((pixel >> 5) & 0x1F) << 3,
+            (pixel & 0x1F) << 3,
+            255
+        ));
+    }
+
+    // The fourth byte of 32 bits pixels is reserved without masks
+    return Ok(Gfx::Color::fromRgba(p[2], p[1], p[0], 255));
+}
+
+Res<> Decoder::decodeRows(Gfx::MutPixels pixels, isize start, isize end) const {
+    bool bgra = pixels.fmt().is<Gfx::Bgra8888>();
+    bool fast = (bgra or pixels.fmt().is<Gfx::Rgba8888>()) and _width > 0 and
+                pixels.width() >= width() and pixels.height() >= height();
+
+    // Palettes are packed in the layout of the destination once
+    Array<u32, 256> palette{};
+    for (usize i = 0; i < _palette.len(); i++)
+        palette[i] = _pack(_palette[i], bgra);
+
+    bool opaqueMasks = _masks[0] == 0xff0000 and _masks[1] == 0xff00 and _masks[2] == 0xff;
+    bool direct32 = _bpp == 32 and (_compression == RGB or (opaqueMasks and (_masks[3] == 0 or _masks[3] == 0xff000000)));
+
+    for (isize r = start; r < end; r++) {
+        u8 const *src = _pixels.buf() + r * stride();
+        isize y = destRow(r);
+
+        if (fast and _bpp == 24) {
+            _swizzle24(src, static_cast<u8 *>(pixels.scanline(y)), width(), bgra);
+        } else if (fast and direct32) {
+            _swizzle32(src, static_cast<u8 *>(pixels.scanline(y)), width(), bgra, _masks[3] == 0);
+        } else if (fast and _bpp <= 8) {
+            u8 *out = static_cast<u8 *>(pixels.scanline(y));
+            for (isize x = 0; x < width(); x++) {
+                auto index = _index(src, x, _bpp);
                 if (index >= _palette.len())
                     return Error::invalidData("invalid palette index");
-                color = _palette[index];
-            } else if (_bpp == 8) {
-                auto index = s.nextU8le();
-                if (index >= _palette.len()) {
-                    return Error::invalidData("invalid palette index");
-                }
-                color = _palette[index];
-            } else if (_bpp == 16) {
-                auto pixel = s.nextU16le();
-                color.blue = (pixel & 0x1F) << 3;
-                color.green = ((pixel >> 5) & 0x1F) << 3;
-                color.red = ((pixel >> 10) & 0x1F) << 3;
-                color.alpha = 255;
-            } else if (_bpp == 24) {
-                color.blue = s.nextU8le();
-                color.green = s.nextU8le();
-                color.red = s.nextU8le();
-                color.alpha = 255;
-            } else if (_bpp == 32) {
-                color.blue = s.nextU8le();
-                color.green = s.nextU8le();
-                color.red = s.nextU8le();
-                color.alpha = 255 - s.nextU8le();
-            } else {
-                return Error::invalidData("invalid bpp");
+                memcpy(out + x * 4, &palette[index], 4);
             }
+        } else {
+            // Rows with a negative width are stored right to left
+            for (isize x = 0; x < width(); x++)
+                pixels.store({_width < 0 ? width() - x - 1 : x, y}, try$(load(src, x)));
+        }
+    }
 
-            Math::Vec2i pos{x, y};
-
-            // if _width is negative, flip horizontally.
-            if (_width < 0) {
-                pos.x = width() - x - 1;
-            }
+    return Ok();
+}
 
-            // if _height is negative, flip vertically.
-            if (not(_height < 0)) {
-                pos.y = height() - y - 1;
-            }
+Res<> Decoder::decodeRle(Gfx::MutPixels pixels) const {
+    pixels.clear(Gfx::ALPHA);
 
-            pixels.store(pos, color);
+    Io::BScan s{_pixels};
+    isize x = 0;
+    isize r = 0;
+
+    auto put = [&](u8 index) -> Res<> {
+        if (index >= _palette.len())
+            return Error::invalidData("invalid palette index");
+        if (x < width() and r < height())
+            pixels.store({x, destRow(r)}, _palette[index]);
+        x++;
+        return Ok();
+    };
+
+    // RLE4 pixels take a nibble each, the high one first
+    auto nibble = [&](u8 byte, usize i) -> u8 {
+        return _compression == RLE8 ? byte : (i % 2 ? byte & 0xf : byte >> 4);
+    };
+
+    while (r < height()) {
+        // Streams that stop without an end of bitmap marker are accepted
+        if (s.ended())
+            break;
+
+        if (s.rem() < 2)
+            return Error::invalidData("unexpected end of pixel data");
+
+        u8 count = s.nextU8le();
+        u8 value = s.nextU8le();
+
+        if (count > 0) {
+            for (usize i = 0; i < count; i++)
+                try$(put(nibble(value, i)));
+        } else if (value == 0) {
+            // End of line
+            x = 0;
+            r++;
+        } else if (value == 1) {
+            // End of bitmap
+            break;
+        } else if (value == 2) {
+            // Delta
+            if (s.rem() < 2)
+                return Error::invalidData("unexpected end of pixel data");
+            x += s.nextU8le();
+            r += s.nextU8le();
+        } else {
+            // Absolute run, padded to 16 bits
+            usize len = _compression == RLE8 ? value : (value + 1) / 2;
+            if (s.rem() < len)
+                return Error::invalidData("unexpected end of pixel data");
+
+            Bytes literal = s.nextBytes(len);
+            for (usize i = 0; i < value; i++)
+                try$(put(nibble(literal[_compression == RLE8 ? i : i / 2], i)));
+            s.skip(len % 2);
         }
-
-        // Skip padding.
-        s.skip((4 - (_width * _bpp / 8) % 4) % 4);
     }
 
     return Ok();
 }
 
+Res<> Decoder::decode(Gfx::MutPixels pixels) {
+    if (_compression == RLE8 or _compression == RLE4)
+        return decodeRle(pixels);
+    return decodeRows(pixels, 0, height());
+}
+
+Res<> Decoder::decodeParallel(Gfx::MutPixels pixels) {
+    if (_compression == RLE8 or _compression == RLE4)
+        return decodeRle(pixels);
+
+    // A few bands per thread so a slow one doesn't hold the others back
+    usize bands = clamp(Sys::concurrency() * 4, 1uz, (usize)height());
+    Vec<Res<>> results;
+    results.resize(bands, Ok());
+    Sys::parallelFor(bands, [&](usize i) {
+        isize start = height() * i / bands;
+        isize end = height() * (i + 1) / bands;
+        results[i] = decodeRows(pixels, start, end);
+    });
+
+    for (auto &res : results)
+        try$(res);
+
+    return Ok();
+}
+
 void Decoder::repr(Io::Emit &e) {
     e("BMP image");
     e.indentNewline();
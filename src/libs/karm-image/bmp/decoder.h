@@ -16,6 +16,7 @@
 namespace Bmp {
 
 struct Decoder {
+    static constexpr isize MAX_SIZE = 1 << 16;
 
     // MARK: Loading -----------------------------------------------------------
 
@@ -49,10 +50,15 @@ struct Decoder {
         RGB = 0,
         RLE8 = 1,
         RLE4 = 2,
+        BITFIELDS = 3,
     } _compression;
 
     usize _numsColors;
 
+    // Where red, green, blue and alpha are in 16 and 32 bits pixels with
+    // BITFIELDS compression, no alpha if its mask is empty
+    Array<u32, 4> _masks{};
+
     Res<> readInfoHeader(Io::BScan &s);
 
     // MARK: Palette -----------------------------------------------------------
@@ -65,12 +71,33 @@ struct Decoder {
 
     Bytes _pixels;
 
+    // Rows are padded to 4 bytes
+    usize stride() const {
+        return (width() * _bpp + 31) / 32 * 4;
+    }
+
     Res<> readPixels(Io::BScan &s);
 
     // MARK: Decoding ----------------------------------------------------------
 
+    // Rows are stored bottom to top unless the height is negative
+    isize destRow(isize row) const {
+        return _height < 0 ? row : height() - 1 - row;
+    }
+
+    Res<Gfx::Color> load(u8 const *row, isize x) const;
+
+    Res<> decodeRows(Gfx::MutPixels pixels, isize start, isize end) const;
+
+    // Pixels the stream skips over are left transparent
+    Res<> decodeRle(Gfx::MutPixels pixels) const;
+
     Res<> decode(Gfx::MutPixels pixels);
 
+    // Like decode(), spreading bands of rows over threads, compressed
+    // images are decoded on the calling thread
+    Res<> decodeParallel(Gfx::MutPixels pixels);
+
     // MARK: Dumping -----------------------------------------------------------
 
     void repr(Io::Emit &e);
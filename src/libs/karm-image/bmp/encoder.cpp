@@ -0,0 +1,100 @@
+#include <karm-io/bscan.h>
+#include <karm-io/impls.h>
+
+#include "decoder.h"
+#include "encoder.h"
+
+namespace Bmp {
+
+Encoder::Encoder(Io::Writer &writer, Math::Vec2i size, bool alpha)
+    : _writer(writer),
+      _size(size),
+      _alpha(alpha) {
+    _row.resize(rowBytes());
+}
+
+Res<> Encoder::_begin() {
+    if (_started)
+        return Ok();
+    _started = true;
+
+    usize infoSize = _alpha ? V4_HEADER : INFO_HEADER;
+    usize dataOffset = FILE_HEADER + infoSize;
+    usize imageSize = rowBytes() * _size.y;
+
+    Io::BufferWriter buf{dataOffset};
+    Io::BEmit e{buf};
+
+    e.writeU8le('B');
+    e.writeU8le('M');
+    e.writeU32le(dataOffset + imageSize);
+    e.writeU32le(0); // reserved
+    e.writeU32le(dataOffset);
+
+    e.writeU32le(infoSize);
+    e.writeI32le(_size.x);
+    e.writeI32le(-_size.y); // top-down
+    e.writeU16le(1);        // planes
+    e.writeU16le(bpp());
+    e.writeU32le(_alpha ? Decoder::BITFIELDS : Decoder::RGB);
+    e.writeU32le(imageSize);
+    e.writeU32le(2835); // 72 dpi
+    e.writeU32le(2835);
+    e.writeU32le(0); // colors used
+    e.writeU32le(0); // important colors
+
+    if (_alpha) {
+        e.writeU32le(0x00ff0000);
+        e.writeU32le(0x0000ff00);
+        e.writeU32le(0x000000ff);
+        e.writeU32le(0xff000000);
+        e.writeU32le(0x73524742); // 'sRGB' color space
+        for (usize i = 0; i < 12; i++)
+            e.writeU32le(0); // endpoints and gamma, unused with sRGB
+    }
+
+    try$(_writer.write(buf.bytes()));
+    return Ok();
+}
+
+Res<> Encoder::writeRows(Gfx::Pixels rows) {
+    if (rows.width() != _size.x or _rows + rows.height() > _size.y)
+        return Error::invalidInput("rows don't fit the image");
+
+    try$(_begin());
+
+    bool bgra = rows.fmt().is<Gfx::Bgra8888>();
+    usize r = bgra ? 2 : 0;
+    usize b = bgra ? 0 : 2;
+
+    for (isize y = 0; y < rows.height(); y++) {
+        u8 const *src = static_cast<u8 const *>(rows.scanline(y));
+        if (_alpha and bgra) {
+            try$(_writer.write({src, rowBytes()}));
+            _rows++;
+            continue;
+        }
+
+        u8 *row = _row.buf();
+        for (isize x = 0; x < _size.x; x++, src += 4) {
+            *row++ = src[b];
+            *row++ = src[1];
+            *row++ = src[r];
+            if (_alpha)
+                *row++ = src[3];
+        }
+
+        try$(_writer.write(_row));
+        _rows++;
+    }
+
+    return Ok();
+}
+
+Res<> Encoder::finish() {
+    if (_rows != _size.y)
+        return Error::invalidInput("missing rows");
+    return _begin();
+}
+
+} // namespace Bmp
@@ -0,0 +1,50 @@
+#pragma once
+
+// BMP image encoder
+// References:
+//  - https://en.wikipedia.org/wiki/BMP_file_format
+//  - https://learn.microsoft.com/en-us/windows/win32/api/wingdi/ns-wingdi-bitmapv4header
+
+#include <karm-base/vec.h>
+#include <karm-gfx/buffer.h>
+#include <karm-io/traits.h>
+
+namespace Bmp {
+
+// Rows are stored top to bottom, with a negative height, so each of them
+// goes out as soon as it's written. Opaque images take 24 bits per pixel,
+// the others 32 with the masks of a BITMAPV4HEADER to tell where alpha is,
+// and BGRA rows are written as they are.
+struct Encoder {
+    static constexpr usize FILE_HEADER = 14;
+    static constexpr usize INFO_HEADER = 40;
+    static constexpr usize V4_HEADER = 108;
+
+    Io::Writer &_writer;
+    Math::Vec2i _size;
+    bool _alpha;
+
+    bool _started = false;
+    isize _rows = 0;
+    Vec<u8> _row;
+
+    Encoder(Io::Writer &writer, Math::Vec2i size, bool alpha = true);
+
+    usize bpp() const {
+        return _alpha ? 32 : 24;
+    }
+
+    // Rows are padded to 4 bytes
+    usize rowBytes() const {
+        return alignUp(_size.x * bpp() / 8, 4);
+    }
+
+    // Encode the next rows of the image, top to bottom
+    Res<> writeRows(Gfx::Pixels rows);
+
+    Res<> finish();
+
+    Res<> _begin();
+};
+
+} // namespace Bmp
@@ -0,0 +1,139 @@
+#include <karm-image/bmp/decoder.h>
+#include <karm-image/loader.h>
+#include <karm-sys/file.h>
+#include <karm-sys/mmap.h>
+#include <karm-test/macros.h>
+
+namespace Bmp::Tests {
+
+static Mime::Url _res(Str name) {
+    return "bundle://karm-image.bmp.tests/bmpsuite"_url / name;
+}
+
+static Res<Sys::Mmap> _map(Str name) {
+    auto file = try$(Sys::File::open(_res(name)));
+    return Sys::mmap().map(file);
+}
+
+test$("bmp-suite") {
+    // The same picture in every depth and compression
+    auto ref = try$(Image::load(_res("valid/24bpp-320x240.bmp")));
+
+    Array const NAMES = {
+        "valid/4bpp-320x240.bmp"s,
+        "valid/4bpp-topdown-320x240.bmp"s,
+        "valid/8bpp-320x240.bmp"s,
+        "valid/8bpp-topdown-320x240.bmp"s,
+        "valid/24bpp-topdown-320x240.bmp"s,
+        "valid/32bpp-320x240.bmp"s,
+        "valid/32bpp-topdown-320x240.bmp"s,
+        "valid/565-320x240.bmp"s,
+        "valid/rle4-absolute-320x240.bmp"s,
+        "valid/rle4-encoded-320x240.bmp"s,
+        "valid/rle8-absolute-320x240.bmp"s,
+        "valid/rle8-encoded-320x240.bmp"s,
+    };
+
+    for (auto name : NAMES) {
+        auto image = try$(Image::load(_res(name)));
+        expectEq$(image.pixels().bytes(), ref.pixels().bytes());
+    }
+
+    return Ok();
+}
+
+test$("bmp-sizes") {
+    struct {
+        Str name;
+        Math::Vec2i size;
+    } SIZES[] = {
+        {"valid/1bpp-1x1.bmp", {1, 1}},
+        {"valid/1bpp-335x240.bmp", {335, 240}},
+        {"valid/4bpp-327x240.bmp", {327, 240}},
+        {"valid/8bpp-323x240.bmp", {323, 240}},
+        {"valid/8bpp-1x64000.bmp", {1, 64000}},
+        {"valid/24bpp-323x240.bmp", {323, 240}},
+        {"valid/555-321x240.bmp", {321, 240}},
+        {"valid/565-322x240-topdown.bmp", {322, 240}},
+        {"valid/rle8-64000x1.bmp", {64000, 1}},
+        {"valid/rle8-blank-160x120.bmp", {160, 120}},
+        {"valid/rle4-delta-320x240.bmp", {320, 240}},
+    };
+
+    for (auto const &[name, size] : SIZES) {
+        auto image = try$(Image::load(_res(name)));
+        expectEq$(image.width(), size.x);
+        expectEq$(image.height(), size.y);
+    }
+
+    return Ok();
+}
+
+test$("bmp-formats") {
+    // Rows decoded in bands, or straight into BGRA scanlines, give the same
+    // colors as a plain decode
+    Array const NAMES = {
+        "valid/1bpp-323x240.bmp"s,
+        "valid/4bpp-321x240.bmp"s,
+        "valid/8bpp-1x64000.bmp"s,
+        "valid/24bpp-321x240.bmp"s,
+        "valid/24bpp-1x1.bmp"s,
+        "valid/32bpp-101110-320x240.bmp"s,
+        "valid/555-321x240.bmp"s,
+        "valid/rle4-delta-320x240.bmp"s,
+    };
+
+    for (auto name : NAMES) {
+        auto map = try$(_map(name));
+        auto bmp = try$(Decoder::init(map.bytes()));
+
+        auto rgba = Gfx::Surface::alloc({bmp.width(), bmp.height()});
+        try$(bmp.decode(*rgba));
+
+        auto parallel = Gfx::Surface::alloc({bmp.width(), bmp.height()});
+        try$(bmp.decodeParallel(*parallel));
+        expectEq$(parallel->pixels().bytes(), rgba->pixels().bytes());
+
+        auto bgra = Gfx::Surface::alloc({bmp.width(), bmp.height()}, Gfx::BGRA8888);
+        try$(bmp.decode(*bgra));
+        for (isize y = 0; y < bmp.height(); y++)
+            for (isize x = 0; x < bmp.width(); x++)
+                expectEq$(bgra->pixels().load({x, y}), rgba->pixels().load({x, y}));
+    }
+
+    return Ok();
+}
+
+test$("bmp-corrupt") {
+    Array const NAMES = {
+        "corrupt/1bpp-pixeldata-cropped.bmp"s,
+        "corrupt/24bpp-pixeldata-cropped.bmp"s,
+        "corrupt/32bpp-pixeldata-cropped.bmp"s,
+        "corrupt/8bpp-colorsused-large.bmp"s,
+        "corrupt/8bpp-colorsused-negative.bmp"s,
+        "corrupt/bitdepth-large.bmp"s,
+        "corrupt/bitdepth-odd.bmp"s,
+        "corrupt/bitdepth-zero.bmp"s,
+        "corrupt/colormasks-missing.bmp"s,
+        "corrupt/compression-bad-rle4-for-8bpp.bmp"s,
+        "corrupt/compression-bad-rle8-for-4bpp.bmp"s,
+        "corrupt/compression-unknown.bmp"s,
+        "corrupt/height-zero.bmp"s,
+        "corrupt/infoheadersize-small.bmp"s,
+        "corrupt/offbits-large.bmp"s,
+        "corrupt/palette-missing.bmp"s,
+        "corrupt/pixeldata-missing.bmp"s,
+        "corrupt/rle4-runlength-cropped.bmp"s,
+        "corrupt/rle8-delta-cropped.bmp"s,
+        "corrupt/rle8-runlength-cropped.bmp"s,
+        "corrupt/width-times-height-overflow.bmp"s,
+        "corrupt/width-zero.bmp"s,
+    };
+
+    for (auto name : NAMES)
+        expect$(not Image::load(_res(name)));
+
+    return Ok();
+}
+
+} // namespace Bmp::Tests
@@ -0,0 +1,62 @@
+#include "cache.h"
+
+namespace Karm::Image {
+
+Cache::Cache(usize budget)
+    : _budget(budget) {
+    _stats.budget = budget;
+}
+
+Opt<Picture> Cache::lookup(Key const &key) {
+    auto entry = _lru.tryGet(key);
+    if (not entry) {
+        _stats.misses++;
+        return NONE;
+    }
+
+    _stats.hits++;
+    return entry->picture;
+}
+
+void Cache::insert(Key const &key, Picture picture) {
+    if (_lru.contains(key))
+        return;
+
+    usize bytes = sizeof(Gfx::Surface) + picture.pixels().bytes().len();
+    (void)_lru.access(key, [&] {
+        return Entry{picture, bytes};
+    });
+
+    _stats.entries++;
+    _stats.bytes += bytes;
+    _evict();
+}
+
+void Cache::budget(usize bytes) {
+    _budget = bytes;
+    _stats.budget = bytes;
+    _evict();
+}
+
+void Cache::clear() {
+    _lru.clear();
+    _stats.entries = 0;
+    _stats.bytes = 0;
+}
+
+void Cache::_evict() {
+    // The most recent picture is kept even when it's over budget by itself
+    while (_stats.bytes > _budget and _lru.len() > 1) {
+        auto entry = _lru.removeOldest();
+        _stats.entries--;
+        _stats.bytes -= entry->bytes;
+        _stats.evictions++;
+    }
+}
+
+Cache &globalCache() {
+    static Cache cache;
+    return cache;
+}
+
+} // namespace Karm::Image
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <karm-base/async.h>
+#include <karm-base/limits.h>
+#include <karm-base/lru.h>
+#include <karm-base/time.h>
+#include <karm-io/emit.h>
+#include <karm-mime/url.h>
+
+#include "loader.h"
+
+namespace Karm::Image {
+
+struct CacheStats {
+    usize hits = 0;
+    usize misses = 0;
+    usize evictions = 0;
+    usize entries = 0;
+    usize bytes = 0;
+    usize budget = 0;
+
+    f64 hitRate() const {
+        auto lookups = hits + misses;
+        if (not lookups)
+            return 0;
+        return hits / (f64)lookups;
+    }
+
+    void repr(Io::Emit &e) const {
+        e("(image-cache-stats hits:{} misses:{} hit-rate:{} evictions:{} entries:{} bytes:{}/{})", hits, misses, hitRate(), evictions, entries, bytes, budget);
+    }
+};
+
+// Decoded pictures by url, modification time and scale, so every view
+// showing the same icon or wallpaper shares its pixels. Pictures are evicted
+// in least recently used order once they take more than the budget. Meant
+// to be used from the UI loop only, it's not thread safe.
+struct Cache {
+    static constexpr usize DEFAULT_BUDGET = 64 * 1024 * 1024;
+
+    struct Key {
+        Mime::Url url;
+        TimeStamp mtime;
+        Scale scale;
+
+        bool operator==(Key const &) const = default;
+    };
+
+    struct Entry {
+        Picture picture;
+        usize bytes;
+    };
+
+    usize _budget;
+    Lru<Key, Entry> _lru{Limits<usize>::MAX};
+    CacheStats _stats{};
+
+    // Pictures being decoded by loadAsync(), later requests for them wait
+    // on the same decode
+    Map<Key, Async::Future<Picture>> _pending{};
+
+    Cache(usize budget = DEFAULT_BUDGET);
+
+    Cache(Cache const &) = delete;
+
+    Cache &operator=(Cache const &) = delete;
+
+    Opt<Picture> lookup(Key const &key);
+
+    void insert(Key const &key, Picture picture);
+
+    void budget(usize bytes);
+
+    void clear();
+
+    CacheStats stats() const {
+        return _stats;
+    }
+
+    void _evict();
+};
+
+Cache &globalCache();
+
+} // namespace Karm::Image
@@ -1,9 +1,12 @@
+#include <karm-base/simd.h>
+#include <karm-sys/thread.h>
+
 #include "decoder.h"
 
 namespace Jpeg {
 
 bool Decoder::sniff(Bytes slice) {
-    return slice[0] == 0xFF and slice[1] == SOI;
+    return slice.len() >= 2 and slice[0] == 0xFF and slice[1] == SOI;
 }
 
 Res<Decoder> Decoder::init(Bytes slice) {
@@ -39,15 +42,21 @@ Res<Decoder> Decoder::init(Bytes slice) {
             dec.skipMarker(s);
         } else if (marker == DQT) {
             try$(dec.defineQuantizationTable(s));
-        } else if (marker == SOF0) {
+        } else if (marker == SOF0 or marker == SOF1 or marker == SOF2) {
+            dec._progressive = marker == SOF2;
             try$(dec.startOfFrame(s));
+        } else if (SOF2 <= marker and marker <= SOF15 and marker != DHT and marker != JPG and marker != DAC) {
+            logError("jpeg: unsupported frame type: SOF{}", marker - SOF0);
+            return Error::invalidData("unsupported frame type");
         } else if (marker == DRI) {
             try$(dec.defineRestartInterval(s));
         } else if (marker == DHT) {
             try$(dec.defineHuffmanTable(s));
         } else if (marker == SOS) {
             try$(dec.startOfScan(s));
-            try$(dec.decodeHuffman(s));
+            dec.skipScan(s);
+            if (dec._progressive)
+                try$(dec.recordScan());
         } else if (marker == EOI) {
             reachedEoi = true;
         } else if (marker == TEM) {
@@ -70,7 +79,7 @@ Res<Decoder> Decoder::init(Bytes slice) {
         return Error::invalidData("missing EOI marker");
     }
 
-    return Ok(dec);
+    return Ok(std::move(dec));
 };
 
 void Decoder::skipMarker(Io::BScan &s) {
@@ -102,6 +111,10 @@ Res<> Decoder::defineQuantizationTable(Io::BScan &x) {
             // NOTE: Quantization tables are stored in zig-zag order.
             quant[ZIGZAG[i]] = is16bit ? s.nextU16be() : s.nextU8be();
         }
+
+        IdctQuant &idctQuant = _idctQuant[id];
+        for (usize i = 0; i < 64; ++i)
+            idctQuant[i] = (quant[i] * AAN_SCALES[i] + (1 << 11)) >> 12;
     }
 
     return Ok();
@@ -122,6 +135,11 @@ Res<> Decoder::startOfFrame(Io::BScan &x) {
     _height = s.nextU16be();
     _width = s.nextU16be();
 
+    if (_width == 0 or _height == 0) {
+        logError("jpeg: invalid image size: {}x{}", _width, _height);
+        return Error::invalidData("invalid image size");
+    }
+
     u8 componentCount = s.nextU8be();
     if (componentCount != 1 and componentCount != 3) {
         logError("jpeg: invalid component count: {}", componentCount);
@@ -153,13 +171,28 @@ Res<> Decoder::startOfFrame(Io::BScan &x) {
         u8 factors = s.nextU8be();
         u8 quantId = s.nextU8be();
 
-        _components[id].emplace(Component{
-            (u8)(factors >> 4),
-            (u8)(factors & 0xF),
-            quantId,
-        });
+        u8 hFactor = factors >> 4;
+        u8 vFactor = factors & 0xF;
+        if (hFactor < 1 or hFactor > 4 or vFactor < 1 or vFactor > 4) {
+            logError("jpeg: invalid sampling factors: {}x{}", hFactor, vFactor);
+            return Error::invalidData("invalid sampling factors");
+        }
+
+        if (quantId > 3) {
+            logError("jpeg: invalid quantization table id: {}", quantId);
+            return Error::invalidData("invalid quantization table id");
+        }
+
+        // A lone component is never interleaved, its MCUs are single blocks
+        // whatever its sampling factors
+        if (componentCount == 1)
+            hFactor = vFactor = 1;
+
+        _components[id].emplace(Component{hFactor, vFactor, quantId});
 
         _componentCount = max(_componentCount, (usize)id + 1);
+        _hMax = max(_hMax, hFactor);
+        _vMax = max(_vMax, vFactor);
     }
 
     return Ok();
@@ -181,34 +214,59 @@ Res<> Decoder::defineRestartInterval(Io::BScan &x) {
     return Ok();
 }
 
-Array<usize, 256> const &Decoder::HuffmanTable::codes() {
-    if (not _codes) {
-        _codes.emplace();
-        usize code = 0;
-        for (usize i = 0; i < 16; ++i) {
-            for (usize j = offs[i]; j < offs[i + 1]; ++j) {
-                (*_codes)[j] = code;
-                ++code;
+Res<> Decoder::HuffmanTable::build() {
+    for (auto &f : fast)
+        f = 0xFF;
+
+    u32 code = 0;
+    for (usize len = 1; len <= 16; ++len) {
+        delta[len] = (i32)offs[len - 1] - (i32)code;
+
+        for (usize j = offs[len - 1]; j < offs[len]; ++j) {
+            if (code >= (1u << len)) {
+                logError("jpeg: invalid huffman table, too many codes of length {}", len);
+                return Error::invalidData("invalid huffman table");
+            }
+
+            sizes[j] = len;
+            if (len <= FAST_BITS) {
+                usize first = code << (FAST_BITS - len);
+                for (usize k = 0; k < (1uz << (FAST_BITS - len)); ++k)
+                    fast[first + k] = j;
             }
-            code <<= 1;
+            ++code;
         }
+
+        // Codes are left aligned on 16 bits so they can be compared with
+        // the next 16 bits of the stream
+        maxCode[len] = code << (16 - len);
+        code <<= 1;
     }
-    return *_codes;
+    maxCode[17] = 0xFFFFFFFF;
+
+    return Ok();
 }
 
-Res<Byte> Decoder::HuffmanTable::next(BitStream &bs) {
-    usize code = 0;
-    for (usize i = 0; i < 16; ++i) {
-        code = (code << 1) | try$(bs.nextBit());
-        for (usize j = offs[i]; j < offs[i + 1]; ++j) {
-            if (code == codes()[j]) {
-                return Ok(syms[j]);
-            }
-        }
+Res<Byte> Decoder::HuffmanTable::nextSlow(BitStream &bs) const {
+    u32 bits = bs.peekBits(16);
+
+    usize len = FAST_BITS + 1;
+    while (bits >= maxCode[len])
+        ++len;
+
+    if (len > 16) {
+        logError("jpeg: invalid huffman code {x}", bits);
+        return Error::invalidData("invalid huffman code");
     }
 
-    logError("jpeg: invalid huffman code {x}", code);
-    return Error::invalidData("invalid huffman code");
+    isize i = (isize)(bits >> (16 - len)) + delta[len];
+    if (i < 0 or i >= offs[16]) {
+        logError("jpeg: invalid huffman code {x}", bits);
+        return Error::invalidData("invalid huffman code");
+    }
+
+    bs.skipBits(len);
+    return Ok(syms[i]);
 }
 
 Res<> Decoder::defineHuffmanTable(Io::BScan &x) {
@@ -235,7 +293,7 @@ Res<> Decoder::defineHuffmanTable(Io::BScan &x) {
             table.offs[i] = sum;
         }
 
-        if (sum > 162) {
+        if (sum > 256) {
             logError("jpeg: invalid huffman table length: {}", sum);
             return Error::invalidData("invalid huffman table length");
         }
@@ -243,6 +301,8 @@ Res<> Decoder::defineHuffmanTable(Io::BScan &x) {
         for (usize i = 0; i < sum; ++i) {
             table.syms[i] = s.nextU8be();
         }
+
+        try$(table.build());
     }
 
     return Ok();
@@ -260,11 +320,17 @@ Res<> Decoder::startOfScan(Io::BScan &x) {
     Io::BScan s = x.nextBytes(len - 2);
 
     u8 componentCount = s.nextU8be();
-    if (componentCount != _componentCount) {
+    bool validCount = _progressive
+                          ? componentCount >= 1 and componentCount <= _componentCount
+                          : componentCount == _componentCount;
+    if (not validCount) {
         logError("jpeg: invalid component count: {}", componentCount);
         return Error::invalidData("invalid component count");
     }
 
+    _scanComponents = {};
+    _scanLength = componentCount;
+
     for (u8 i = 0; i < componentCount; ++i) {
         u8 id = s.nextU8be();
 
@@ -301,7 +367,13 @@ Res<> Decoder::startOfScan(Io::BScan &x) {
             return Error::invalidData("invalid ac huffman table id");
         }
 
+        if (_scanComponents[id]) {
+            logError("jpeg: duplicate component id: {}", id);
+            return Error::invalidData("duplicate component id");
+        }
+
         _scanComponents[id].emplace(ScanComponent{dcHuffId, acHuffId});
+        _scanOrder[i] = id;
     }
 
     _ss = s.nextU8be();
@@ -310,14 +382,29 @@ Res<> Decoder::startOfScan(Io::BScan &x) {
     _ah = ahAl >> 4;
     _al = ahAl & 0xF;
 
-    if (_ss != 0 or _se != 63) {
-        logError("jpeg: unexpected spectral selection");
-        return Error::invalidData("unexpected spectral selection");
-    }
+    if (_progressive) {
+        // DC and AC coefficients never share a scan, and AC scans only
+        // ever have one component, see G.1.1.1.1
+        bool dc = _ss == 0;
+        if (_se > 63 or _ss > _se or (dc and _se != 0) or (not dc and componentCount != 1)) {
+            logError("jpeg: invalid spectral selection: {}..{}", _ss, _se);
+            return Error::invalidData("invalid spectral selection");
+        }
+
+        if (_al > 13 or (_ah != 0 and _ah != _al + 1)) {
+            logError("jpeg: invalid successive approximation: {} {}", _ah, _al);
+            return Error::invalidData("invalid successive approximation");
+        }
+    } else {
+        if (_ss != 0 or _se != 63) {
+            logError("jpeg: unexpected spectral selection");
+            return Error::invalidData("unexpected spectral selection");
+        }
 
-    if (_ah != 0 or _al != 0) {
-        logError("jpeg: unexpected successive approximation");
-        return Error::invalidData("unexpected successive approximation");
+        if (_ah != 0 or _al != 0) {
+            logError("jpeg: unexpected successive approximation");
+            return Error::invalidData("unexpected successive approximation");
+        }
     }
 
     if (not s.ended()) {
@@ -328,295 +415,1022 @@ Res<> Decoder::startOfScan(Io::BScan &x) {
     return Ok();
 }
 
-Res<> Decoder::decodeHuffman(Io::BScan &s) {
-    _mcus.resize(mcuWidth() * mcuHeight() * _componentCount);
+// MARK: Huffman Data ----------------------------------------------------------
 
-    Array<isize, 3> prevDc = {};
+Res<> Decoder::decodeBlock(BitStream &bs, HuffmanTable &dc, HuffmanTable &ac, isize &pred, Block &block) {
+    block = {};
+    i16 *coeffs = block.buf();
 
-    BitStream bs{s};
+    Byte len = try$(dc.next(bs));
+    if (len > 11) {
+        logError("jpeg: invalid dc huffman code length: {}", len);
+        return Error::invalidData("invalid dc huffman code length");
+    }
 
-    for (usize i = 0; i < _mcus.len(); ++i) {
-        Mcu &mcu = _mcus[i];
-        usize cid = i % _componentCount;
+    pred += bs.nextExtend(len);
+    coeffs[0] = pred;
 
-        // logDebug("jpeg: decoding mcu {} of {} (cid: {})", i + 1, _mcus.len(), cid);
+    usize k = 1;
+    while (k < 64) {
+        Byte sym = try$(ac.next(bs));
+        Byte run = sym >> 4;
+        Byte len = sym & 0xF;
 
-        // handle restart interval
-        if (_restartInterval > 0 and (i / _componentCount) % _restartInterval == 0) {
-            prevDc = {};
-            bs.reset();
+        if (len == 0) {
+            // End of block, or a run of 16 zeroes
+            if (run != 15)
+                break;
+            k += 16;
+            continue;
         }
 
-        if (not _scanComponents[cid]) {
-            logError("jpeg: undefined component id: {}", cid);
-            return Error::invalidData("undefined component id");
+        if (len > 10) {
+            logError("jpeg: invalid ac huffman code length: {}", len);
+            return Error::invalidData("invalid ac huffman code length");
         }
 
-        auto &c = _scanComponents[cid].unwrap();
+        k += run;
+        if (k >= 64) {
+            logError("jpeg: zero run length exceeds block size: {}", k);
+            return Error::invalidData("zero run length exceeds block size");
+        }
 
-        // logDebug("jpeg: decoding using huffman table (dc: {}, ac: {})", c.dcHuffId, c.acHuffId);
+        coeffs[ZIGZAG[k++]] = bs.nextExtend(len);
+    }
+
+    return Ok();
+}
 
-        if (not _dcHuff[c.dcHuffId]) {
-            logError("jpeg: undefined dc huffman table id: {}", c.dcHuffId);
-            return Error::invalidData("undefined dc huffman table id");
+void Decoder::skipScan(Io::BScan &s) {
+    auto start = s.remBytes();
+    auto offset = [&] {
+        return start.len() - s.rem();
+    };
+
+    // Moves past the padding at the end of the scan to the next marker,
+    // splitting it at the RSTn markers on the way
+    _segments.clear();
+    usize segment = 0;
+    while (true) {
+        if (s.rem() < 2) {
+            s.skip(s.rem());
+            break;
         }
 
-        auto &dcHuff = _dcHuff[c.dcHuffId].unwrap();
+        if (s.peekU8be() == 0xFF) {
+            u8 next = s.peek(1).peekU8be();
+            if (RST0 <= next and next <= RST7) {
+                _segments.pushBack(sub(start, segment, offset()));
+                s.skip(2);
+                segment = offset();
+                continue;
+            }
+
+            if (next != 0x00 and next != 0xFF)
+                break;
+        }
+        s.skip(1);
+    }
+
+    _segments.pushBack(sub(start, segment, offset()));
+    _scan = sub(start, 0, offset());
+}
 
-        if (not _acHuff[c.acHuffId]) {
-            logError("jpeg: undefined ac huffman table id: {}", c.acHuffId);
-            return Error::invalidData("undefined ac huffman table id");
+// MARK: Progressive -----------------------------------------------------------
+
+Res<> Decoder::recordScan() {
+    Scan scan;
+    scan.componentCount = _scanLength;
+
+    for (usize i = 0; i < _scanLength; ++i) {
+        u8 id = _scanOrder[i];
+        auto &sc = _scanComponents[id].unwrap();
+        scan.components[i] = id;
+
+        // Refinements of DC coefficients are raw bits
+        if (_ss == 0 and _ah == 0) {
+            if (not _dcHuff[sc.dcHuffId]) {
+                logError("jpeg: undefined dc huffman table id: {}", sc.dcHuffId);
+                return Error::invalidData("undefined dc huffman table id");
+            }
+            scan.dcHuff[i] = _dcHuff[sc.dcHuffId];
         }
 
-        auto &acHuff = _acHuff[c.acHuffId].unwrap();
+        if (_ss > 0) {
+            if (not _acHuff[sc.acHuffId]) {
+                logError("jpeg: undefined ac huffman table id: {}", sc.acHuffId);
+                return Error::invalidData("undefined ac huffman table id");
+            }
+            scan.acHuff[i] = _acHuff[sc.acHuffId];
+        }
+    }
 
-        Byte len = try$(dcHuff.next(bs));
+    scan.ss = _ss;
+    scan.se = _se;
+    scan.ah = _ah;
+    scan.al = _al;
+    scan.restartInterval = _restartInterval;
+    scan.data = *_scan;
+    _scans.pushBack(std::move(scan));
 
+    return Ok();
+}
+
+// The coefficients of every block of every component
+using _Coeffs = Array<Vec<Decoder::Block>, 4>;
+
+// Decodes the coefficients refined by a scan of a progressive image, see
+// G.1.2 and jdphuff.c in libjpeg
+struct _Refiner {
+    Decoder::Scan const &scan;
+    Io::BScan s;
+    BitStream bs;
+    Array<isize, 4> pred = {};
+    usize eobrun = 0;
+
+    _Refiner(Decoder::Scan const &scan)
+        : scan(scan), s(scan.data), bs(s) {}
+
+    Res<> restart() {
+        try$(bs.restart());
+        pred = {};
+        eobrun = 0;
+        return Ok();
+    }
+
+    Res<> dcFirst(usize i, i16 *coeffs) {
+        Byte len = try$(scan.dcHuff[i].unwrap().next(bs));
         if (len > 11) {
             logError("jpeg: invalid dc huffman code length: {}", len);
             return Error::invalidData("invalid dc huffman code length");
         }
 
-        isize coeff = try$(bs.nextBits(len));
+        pred[i] += bs.nextExtend(len);
+        coeffs[0] = pred[i] * (1 << scan.al);
+        return Ok();
+    }
 
-        if (len != 0 and coeff < (1 << (len - 1))) {
-            coeff -= (1 << len) - 1;
-        }
+    void dcRefine(i16 *coeffs) {
+        if (bs.nextBits(1))
+            coeffs[0] |= 1 << scan.al;
+    }
 
-        mcu[0] = prevDc[cid] + coeff;
-        prevDc[cid] = mcu[0];
+    Res<> acFirst(i16 *coeffs) {
+        if (eobrun > 0) {
+            eobrun--;
+            return Ok();
+        }
 
-        usize k = 1;
-        while (k < 64) {
-            Byte sym = try$(acHuff.next(bs));
+        auto &ac = scan.acHuff[0].unwrap();
+        usize k = scan.ss;
+        while (k <= scan.se) {
+            Byte sym = try$(ac.next(bs));
+            Byte run = sym >> 4;
+            Byte len = sym & 0xF;
 
-            if (sym == 0) {
+            if (len == 0) {
+                // A run of 16 zeroes, or the end of this band and of the
+                // ones of the next 2^run - 1 blocks
+                if (run == 15) {
+                    k += 16;
+                    continue;
+                }
+                eobrun = (1 << run) - 1 + bs.nextBits(run);
                 break;
             }
 
-            Byte numZeroes = sym >> 4;
-
-            if (sym == 0xF0) {
-                numZeroes = 16;
+            k += run;
+            if (k > scan.se) {
+                logError("jpeg: zero run length exceeds band: {}", k);
+                return Error::invalidData("zero run length exceeds band");
             }
 
-            if (k + numZeroes >= 64) {
-                logError("jpeg: zero run length exceeds block size: {}", k + numZeroes);
-                return Error::invalidData("zero run length exceeds block size");
-            }
+            coeffs[ZIGZAG[k++]] = bs.nextExtend(len) * (1 << scan.al);
+        }
 
-            k += numZeroes;
+        return Ok();
+    }
 
-            Byte len = sym & 0xF;
+    // Coefficients already known get one more bit when they are met, the
+    // sign of the ones new to this scan comes with them
+    void refine(i16 &coeff) {
+        if (bs.nextBits(1) and (coeff & (1 << scan.al)) == 0)
+            coeff += coeff >= 0 ? (1 << scan.al) : -(1 << scan.al);
+    }
+
+    Res<> acRefine(i16 *coeffs) {
+        usize k = scan.ss;
+
+        if (eobrun == 0) {
+            auto &ac = scan.acHuff[0].unwrap();
+            for (; k <= scan.se; ++k) {
+                Byte sym = try$(ac.next(bs));
+                isize run = sym >> 4;
+                isize value = 0;
+
+                if ((sym & 0xF) != 0) {
+                    value = bs.nextBits(1) ? (1 << scan.al) : -(1 << scan.al);
+                } else if (run != 15) {
+                    eobrun = (1 << run) + bs.nextBits(run);
+                    break;
+                }
+
+                // Skips run zeroes, refining the coefficients in between
+                for (; k <= scan.se; ++k) {
+                    i16 &coeff = coeffs[ZIGZAG[k]];
+                    if (coeff != 0)
+                        refine(coeff);
+                    else if (run-- == 0)
+                        break;
+                }
+
+                if (value != 0) {
+                    if (k > scan.se) {
+                        logError("jpeg: zero run length exceeds band: {}", k);
+                        return Error::invalidData("zero run length exceeds band");
+                    }
+                    coeffs[ZIGZAG[k]] = value;
+                }
+            }
+        }
 
-            if (len > 10) {
-                logError("jpeg: invalid ac huffman code length: {}", len);
-                return Error::invalidData("invalid ac huffman code length");
+        if (eobrun > 0) {
+            for (; k <= scan.se; ++k) {
+                i16 &coeff = coeffs[ZIGZAG[k]];
+                if (coeff != 0)
+                    refine(coeff);
             }
+            eobrun--;
+        }
 
-            if (len) {
-                coeff = try$(bs.nextBits(len));
+        return Ok();
+    }
+
+    Res<> decodeBlock(usize i, Decoder::Block &block) {
+        i16 *coeffs = block.buf();
+        if (scan.ss == 0) {
+            if (scan.ah == 0)
+                return dcFirst(i, coeffs);
+            dcRefine(coeffs);
+            return Ok();
+        }
+        return scan.ah == 0 ? acFirst(coeffs) : acRefine(coeffs);
+    }
 
-                if (coeff < (1 << (len - 1))) {
-                    coeff -= (1 << len) - 1;
+    Res<> decode(Decoder &dec, _Coeffs &coeffs) {
+        usize ri = scan.restartInterval;
+        auto maybeRestart = [&](usize n) -> Res<> {
+            if (ri > 0 and n > 0 and n % ri == 0)
+                try$(restart());
+            return Ok();
+        };
+
+        // A lone component is coded one block at a time, over the blocks
+        // it covers rather than whole MCUs, see A.2.2
+        if (scan.componentCount == 1) {
+            u8 c = scan.components[0];
+            auto &comp = dec._components[c].unwrap();
+            isize perLine = dec.blocksPerLine(comp);
+            isize width = (dec.componentWidth(comp) + 7) / 8;
+            isize height = (dec.componentHeight(comp) + 7) / 8;
+
+            usize n = 0;
+            for (isize by = 0; by < height; ++by) {
+                for (isize bx = 0; bx < width; ++bx, ++n) {
+                    try$(maybeRestart(n));
+                    try$(decodeBlock(0, coeffs[c][by * perLine + bx]));
                 }
+            }
+            return Ok();
+        }
 
-                mcu[ZIGZAG[k++]] = coeff;
+        usize mcu = 0;
+        for (isize my = 0; my < dec.mcuHeight(); ++my) {
+            for (isize mx = 0; mx < dec.mcuWidth(); ++mx, ++mcu) {
+                try$(maybeRestart(mcu));
+                for (usize i = 0; i < scan.componentCount; ++i) {
+                    u8 c = scan.components[i];
+                    auto &comp = dec._components[c].unwrap();
+                    isize perLine = dec.blocksPerLine(comp);
+                    for (isize by = 0; by < comp.vFactor; ++by) {
+                        for (isize bx = 0; bx < comp.hFactor; ++bx) {
+                            isize index = (my * comp.vFactor + by) * perLine + mx * comp.hFactor + bx;
+                            try$(decodeBlock(i, coeffs[c][index]));
+                        }
+                    }
+                }
             }
         }
+
+        return Ok();
     }
+};
 
-    return Ok();
+// MARK: Inverse DCT -----------------------------------------------------------
+
+// Fixed point constants of the AAN IDCT, with 8 fractional bits
+static constexpr i32 FIX_1_082392200 = 277;
+static constexpr i32 FIX_1_414213562 = 362;
+static constexpr i32 FIX_1_847759065 = 473;
+static constexpr i32 FIX_2_613125930 = 669;
+
+// The dequantized coefficients carry 2 extra bits of precision, and the
+// output of the two passes is 8 times too large
+static constexpr i32 PASS1_BITS = 2;
+static constexpr i32 OUTPUT_SHIFT = PASS1_BITS + 3;
+
+always_inline static i32 _clampSample(i32 v) {
+    return clamp(v, 0, 255);
 }
 
-void Decoder::idct(Array<short, 64> &mcu) {
-    f32 m0 = 2.0 * Math::cos(1.0 / 16.0 * 2.0 * Math::PI);
-    f32 m1 = 2.0 * Math::cos(2.0 / 16.0 * 2.0 * Math::PI);
-    f32 m3 = 2.0 * Math::cos(2.0 / 16.0 * 2.0 * Math::PI);
-    f32 m5 = 2.0 * Math::cos(3.0 / 16.0 * 2.0 * Math::PI);
-    f32 m2 = m0 - m5;
-    f32 m4 = m0 + m5;
+always_inline static i32x8 _clampSamples(i32x8 v) {
+    v &= ~(v >> 31);
+    v |= (255 - v) >> 31;
+    return v & 255;
+}
 
-    f32 s0 = Math::cos(0.0 / 16.0 * Math::PI) / Math::sqrt(8.0);
-    f32 s1 = Math::cos(1.0 / 16.0 * Math::PI) / 2.0;
-    f32 s2 = Math::cos(2.0 / 16.0 * Math::PI) / 2.0;
-    f32 s3 = Math::cos(3.0 / 16.0 * Math::PI) / 2.0;
-    f32 s4 = Math::cos(4.0 / 16.0 * Math::PI) / 2.0;
-    f32 s5 = Math::cos(5.0 / 16.0 * Math::PI) / 2.0;
-    f32 s6 = Math::cos(6.0 / 16.0 * Math::PI) / 2.0;
-    f32 s7 = Math::cos(7.0 / 16.0 * Math::PI) / 2.0;
+always_inline static i32x8 _mul(i32x8 v, i32 c) {
+    return (v * c) >> 8;
+}
 
-    for (usize i = 0; i < 8; ++i) {
-        f32 g0 = mcu[0 * 8 + i] * s0;
-        f32 g1 = mcu[4 * 8 + i] * s4;
-        f32 g2 = mcu[2 * 8 + i] * s2;
-        f32 g3 = mcu[6 * 8 + i] * s6;
-        f32 g4 = mcu[5 * 8 + i] * s5;
-        f32 g5 = mcu[1 * 8 + i] * s1;
-        f32 g6 = mcu[7 * 8 + i] * s7;
-        f32 g7 = mcu[3 * 8 + i] * s3;
-
-        f32 f0 = g0;
-        f32 f1 = g1;
-        f32 f2 = g2;
-        f32 f3 = g3;
-        f32 f4 = g4 - g7;
-        f32 f5 = g5 + g6;
-        f32 f6 = g5 - g6;
-        f32 f7 = g4 + g7;
-
-        f32 e0 = f0;
-        f32 e1 = f1;
-        f32 e2 = f2 - f3;
-        f32 e3 = f2 + f3;
-        f32 e4 = f4;
-        f32 e5 = f5 - f7;
-        f32 e6 = f6;
-        f32 e7 = f5 + f7;
-        f32 e8 = f4 + f6;
-
-        f32 d0 = e0;
-        f32 d1 = e1;
-        f32 d2 = e2 * m1;
-        f32 d3 = e3;
-        f32 d4 = e4 * m2;
-        f32 d5 = e5 * m3;
-        f32 d6 = e6 * m4;
-        f32 d7 = e7;
-        f32 d8 = e8 * m5;
-
-        f32 c0 = d0 + d1;
-        f32 c1 = d0 - d1;
-        f32 c2 = d2 - d3;
-        f32 c3 = d3;
-        f32 c4 = d4 + d8;
-        f32 c5 = d5 + d7;
-        f32 c6 = d6 - d8;
-        f32 c7 = d7;
-        f32 c8 = c5 - c6;
-
-        f32 b0 = c0 + c3;
-        f32 b1 = c1 + c2;
-        f32 b2 = c1 - c2;
-        f32 b3 = c0 - c3;
-        f32 b4 = c4 - c8;
-        f32 b5 = c8;
-        f32 b6 = c6 - c7;
-        f32 b7 = c7;
-
-        mcu[0 * 8 + i] = b0 + b7;
-        mcu[1 * 8 + i] = b1 + b6;
-        mcu[2 * 8 + i] = b2 + b5;
-        mcu[3 * 8 + i] = b3 + b4;
-        mcu[4 * 8 + i] = b3 - b4;
-        mcu[5 * 8 + i] = b2 - b5;
-        mcu[6 * 8 + i] = b1 - b6;
-        mcu[7 * 8 + i] = b0 - b7;
+// One dimensional IDCT of the 8 lanes of the rows, see jidctfst.c in libjpeg
+always_inline static void _idct8(Array<i32x8, 8> &v) {
+    // Even part
+    i32x8 tmp10 = v[0] + v[4];
+    i32x8 tmp11 = v[0] - v[4];
+    i32x8 tmp13 = v[2] + v[6];
+    i32x8 tmp12 = _mul(v[2] - v[6], FIX_1_414213562) - tmp13;
+
+    i32x8 tmp0 = tmp10 + tmp13;
+    i32x8 tmp3 = tmp10 - tmp13;
+    i32x8 tmp1 = tmp11 + tmp12;
+    i32x8 tmp2 = tmp11 - tmp12;
+
+    // Odd part
+    i32x8 z13 = v[5] + v[3];
+    i32x8 z10 = v[5] - v[3];
+    i32x8 z11 = v[1] + v[7];
+    i32x8 z12 = v[1] - v[7];
+
+    i32x8 tmp7 = z11 + z13;
+    i32x8 z5 = _mul(z10 + z12, FIX_1_847759065);
+    tmp10 = _mul(z12, FIX_1_082392200) - z5;
+    tmp11 = _mul(z11 - z13, FIX_1_414213562);
+    tmp12 = _mul(z10, -FIX_2_613125930) + z5;
+
+    i32x8 tmp6 = tmp12 - tmp7;
+    i32x8 tmp5 = tmp11 - tmp6;
+    i32x8 tmp4 = tmp10 + tmp5;
+
+    v[0] = tmp0 + tmp7;
+    v[7] = tmp0 - tmp7;
+    v[1] = tmp1 + tmp6;
+    v[6] = tmp1 - tmp6;
+    v[2] = tmp2 + tmp5;
+    v[5] = tmp2 - tmp5;
+    v[4] = tmp3 + tmp4;
+    v[3] = tmp3 - tmp4;
+}
+
+always_inline static void _transpose(Array<i32x8, 8> &v) {
+    Array<i32x8, 8> t;
+    for (usize i = 0; i < 8; ++i)
+        for (usize j = 0; j < 8; ++j)
+            t[j][i] = v[i][j];
+    v = t;
+}
+
+void Decoder::idct(Block const &block, IdctQuant const &quant, u8 *out, usize stride) {
+    Array<i16x8, 8> rows;
+    memcpy(rows.buf(), block.buf(), sizeof(Block));
+
+    // Most blocks only have a DC coefficient left after quantization and
+    // are a flat color
+    i16x8 const AC_MASK = {0, -1, -1, -1, -1, -1, -1, -1};
+    i16x8 ac = rows[0] & AC_MASK;
+    for (usize i = 1; i < 8; ++i)
+        ac |= rows[i];
+
+    u64x2 any;
+    memcpy(&any, &ac, sizeof(any));
+    if ((any[0] | any[1]) == 0) {
+        u8 dc = _clampSample(((block[0] * quant[0]) >> OUTPUT_SHIFT) + 128);
+        for (usize y = 0; y < 8; ++y)
+            memset(out + y * stride, dc, 8);
+        return;
     }
 
+    Array<i32x8, 8> v;
     for (usize i = 0; i < 8; ++i) {
-        f32 g0 = mcu[i * 8 + 0] * s0;
-        f32 g1 = mcu[i * 8 + 4] * s4;
-        f32 g2 = mcu[i * 8 + 2] * s2;
-        f32 g3 = mcu[i * 8 + 6] * s6;
-        f32 g4 = mcu[i * 8 + 5] * s5;
-        f32 g5 = mcu[i * 8 + 1] * s1;
-        f32 g6 = mcu[i * 8 + 7] * s7;
-        f32 g7 = mcu[i * 8 + 3] * s3;
-
-        f32 f0 = g0;
-        f32 f1 = g1;
-        f32 f2 = g2;
-        f32 f3 = g3;
-        f32 f4 = g4 - g7;
-        f32 f5 = g5 + g6;
-        f32 f6 = g5 - g6;
-        f32 f7 = g4 + g7;
-
-        f32 e0 = f0;
-        f32 e1 = f1;
-        f32 e2 = f2 - f3;
-        f32 e3 = f2 + f3;
-        f32 e4 = f4;
-        f32 e5 = f5 - f7;
-        f32 e6 = f6;
-        f32 e7 = f5 + f7;
-        f32 e8 = f4 + f6;
-
-        f32 d0 = e0;
-        f32 d1 = e1;
-        f32 d2 = e2 * m1;
-        f32 d3 = e3;
-        f32 d4 = e4 * m2;
-        f32 d5 = e5 * m3;
-        f32 d6 = e6 * m4;
-        f32 d7 = e7;
-        f32 d8 = e8 * m5;
-
-        f32 c0 = d0 + d1;
-        f32 c1 = d0 - d1;
-        f32 c2 = d2 - d3;
-        f32 c3 = d3;
-        f32 c4 = d4 + d8;
-        f32 c5 = d5 + d7;
-        f32 c6 = d6 - d8;
-        f32 c7 = d7;
-        f32 c8 = c5 - c6;
-
-        f32 b0 = c0 + c3;
-        f32 b1 = c1 + c2;
-        f32 b2 = c1 - c2;
-        f32 b3 = c0 - c3;
-        f32 b4 = c4 - c8;
-        f32 b5 = c8;
-        f32 b6 = c6 - c7;
-        f32 b7 = c7;
-
-        mcu[i * 8 + 0] = b0 + b7;
-        mcu[i * 8 + 1] = b1 + b6;
-        mcu[i * 8 + 2] = b2 + b5;
-        mcu[i * 8 + 3] = b3 + b4;
-        mcu[i * 8 + 4] = b3 - b4;
-        mcu[i * 8 + 5] = b2 - b5;
-        mcu[i * 8 + 6] = b1 - b6;
-        mcu[i * 8 + 7] = b0 - b7;
-    }
-}
-
-Res<> Decoder::decode(Gfx::MutPixels pixels) {
-    for (usize i = 0; i < _mcus.len(); i += _componentCount) {
-        usize x = (i / _componentCount) % mcuWidth();
-        usize y = (i / _componentCount) / mcuWidth();
-
-        for (usize j = 0; j < _componentCount; j++) {
-            auto &mcu = _mcus[i + j];
-
-            if (not _quant[_components[j]->quantId]) {
-                logError("jpeg: undefined quantization table id: {}", _components[j]->quantId);
+        i32x8 q;
+        memcpy(&q, quant.buf() + i * 8, sizeof(q));
+        v[i] = __builtin_convertvector(rows[i], i32x8) * q;
+    }
+
+    _idct8(v);
+    _transpose(v);
+    _idct8(v);
+    _transpose(v);
+
+    for (usize y = 0; y < 8; ++y) {
+        u8x8 px = __builtin_convertvector(_clampSamples((v[y] >> OUTPUT_SHIFT) + 128), u8x8);
+        memcpy(out + y * stride, &px, sizeof(px));
+    }
+}
+
+// MARK: Reduced IDCT ----------------------------------------------------------
+
+// Decoding at 1/2, 1/4 or 1/8 of the size only computes the 4x4, 2x2 or 1x1
+// samples of the lowest frequencies of each block, with the fixed point
+// constants of libjpeg on 13 bits, see jidctred.c
+static constexpr i32 RED_CONST_BITS = 13;
+static constexpr i64 RED_FIX_0_211164243 = 1730;
+static constexpr i64 RED_FIX_0_509795579 = 4176;
+static constexpr i64 RED_FIX_0_601344887 = 4926;
+static constexpr i64 RED_FIX_0_720959822 = 5906;
+static constexpr i64 RED_FIX_0_765366865 = 6270;
+static constexpr i64 RED_FIX_0_850430095 = 6967;
+static constexpr i64 RED_FIX_0_899976223 = 7373;
+static constexpr i64 RED_FIX_1_061594337 = 8697;
+static constexpr i64 RED_FIX_1_272758580 = 10426;
+static constexpr i64 RED_FIX_1_451774981 = 11893;
+static constexpr i64 RED_FIX_1_847759065 = 15137;
+static constexpr i64 RED_FIX_2_172734803 = 17799;
+static constexpr i64 RED_FIX_2_562915447 = 20995;
+static constexpr i64 RED_FIX_3_624509785 = 29692;
+
+always_inline static i64 _descale(i64 v, i32 n) {
+    return (v + (1ll << (n - 1))) >> n;
+}
+
+// One dimensional IDCT of 8 coefficients down to N samples, scaled up by
+// 2^(RED_CONST_BITS + 8 / N / 2)
+template <usize N>
+always_inline static Array<i64, N> _idctLow(Array<i64, 8> const &in) {
+    if constexpr (N == 4) {
+        i64 tmp0 = in[0] << (RED_CONST_BITS + 1);
+        i64 tmp2 = in[2] * RED_FIX_1_847759065 - in[6] * RED_FIX_0_765366865;
+        i64 tmp10 = tmp0 + tmp2;
+        i64 tmp12 = tmp0 - tmp2;
+
+        tmp0 = -in[7] * RED_FIX_0_211164243 + in[5] * RED_FIX_1_451774981 -
+               in[3] * RED_FIX_2_172734803 + in[1] * RED_FIX_1_061594337;
+        tmp2 = -in[7] * RED_FIX_0_509795579 - in[5] * RED_FIX_0_601344887 +
+               in[3] * RED_FIX_0_899976223 + in[1] * RED_FIX_2_562915447;
+
+        return {tmp10 + tmp2, tmp12 + tmp0, tmp12 - tmp0, tmp10 - tmp2};
+    } else {
+        i64 tmp10 = in[0] << (RED_CONST_BITS + 2);
+        i64 tmp0 = -in[7] * RED_FIX_0_720959822 + in[5] * RED_FIX_0_850430095 -
+                   in[3] * RED_FIX_1_272758580 + in[1] * RED_FIX_3_624509785;
+
+        return {tmp10 + tmp0, tmp10 - tmp0};
+    }
+}
+
+template <usize N>
+static void _idctReduced(i16 const *coeffs, usize const *quant, u8 *out, usize stride) {
+    constexpr i32 EXTRA = N == 4 ? 1 : 2;
+
+    // Columns first, keeping PASS1_BITS of extra precision like idct()
+    Array<i32, 8 * N> ws;
+    for (usize x = 0; x < 8; ++x) {
+        Array<i64, 8> in;
+        for (usize k = 0; k < 8; ++k)
+            in[k] = coeffs[k * 8 + x] * (i64)quant[k * 8 + x];
+
+        auto col = _idctLow<N>(in);
+        for (usize y = 0; y < N; ++y)
+            ws[y * 8 + x] = _descale(col[y], RED_CONST_BITS - PASS1_BITS + EXTRA);
+    }
+
+    for (usize y = 0; y < N; ++y) {
+        Array<i64, 8> in;
+        for (usize k = 0; k < 8; ++k)
+            in[k] = ws[y * 8 + k];
+
+        auto row = _idctLow<N>(in);
+        for (usize x = 0; x < N; ++x)
+            out[y * stride + x] = _clampSample(_descale(row[x], RED_CONST_BITS + OUTPUT_SHIFT + EXTRA) + 128);
+    }
+}
+
+void Decoder::idctReduced(Block const &block, Quant const &quant, usize size, u8 *out, usize stride) {
+    i16 const *coeffs = block.buf();
+
+    bool flat = true;
+    if (size > 1)
+        for (usize i = 1; i < 64 and flat; ++i)
+            flat = coeffs[i] == 0;
+
+    // Blocks without AC coefficients come out flat at any size, which is
+    // all there is to the 1x1 one
+    if (flat) {
+        u8 dc = _clampSample(_descale(coeffs[0] * (i64)quant[0], 3) + 128);
+        for (usize y = 0; y < size; ++y)
+            memset(out + y * stride, dc, size);
+    } else if (size == 4) {
+        _idctReduced<4>(coeffs, quant.buf(), out, stride);
+    } else {
+        _idctReduced<2>(coeffs, quant.buf(), out, stride);
+    }
+}
+
+// MARK: Upsampling ------------------------------------------------------------
+
+// Subsampled components are upsampled with the "fancy" triangle filters of
+// libjpeg, weighting the nearest samples 3:1, see jdsample.c
+
+static void _upsampleH2V1(u8 const *in, usize width, u8 *out) {
+    out[0] = in[0];
+    out[1] = (in[0] * 3 + in[1] + 2) >> 2;
+    for (usize x = 1; x + 1 < width; ++x) {
+        u32 v = in[x] * 3;
+        out[x * 2] = (v + in[x - 1] + 1) >> 2;
+        out[x * 2 + 1] = (v + in[x + 1] + 2) >> 2;
+    }
+    out[width * 2 - 2] = (in[width - 1] * 3 + in[width - 2] + 1) >> 2;
+    out[width * 2 - 1] = in[width - 1];
+}
+
+static void _upsampleH1V2(u8 const *near, u8 const *far, usize width, u8 bias, u8 *out) {
+    for (usize x = 0; x < width; ++x)
+        out[x] = (near[x] * 3 + far[x] + bias) >> 2;
+}
+
+static void _upsampleH2V2(u8 const *near, u8 const *far, usize width, u8 *out) {
+    u32 last = 0;
+    u32 curr = near[0] * 3 + far[0];
+    u32 next = near[1] * 3 + far[1];
+
+    out[0] = (curr * 4 + 8) >> 4;
+    out[1] = (curr * 3 + next + 7) >> 4;
+    for (usize x = 1; x + 1 < width; ++x) {
+        last = curr;
+        curr = next;
+        next = near[x + 1] * 3 + far[x + 1];
+        out[x * 2] = (curr * 3 + last + 8) >> 4;
+        out[x * 2 + 1] = (curr * 3 + next + 7) >> 4;
+    }
+    last = curr;
+    curr = next;
+    out[width * 2 - 2] = (curr * 3 + last + 8) >> 4;
+    out[width * 2 - 1] = (curr * 4 + 7) >> 4;
+}
+
+static void _upsampleNearest(u8 const *in, usize num, usize den, usize width, u8 *out) {
+    for (usize x = 0; x < width; ++x)
+        out[x] = in[x * num / den];
+}
+
+// MARK: Color Conversion ------------------------------------------------------
+
+// YCbCr to RGB with the fixed point constants of libjpeg, see jdcolor.c
+static constexpr i32 FIX_0_34414 = 22554;
+static constexpr i32 FIX_0_71414 = 46802;
+static constexpr i32 FIX_1_40200 = 91881;
+static constexpr i32 FIX_1_77200 = 116130;
+static constexpr i32 ONE_HALF = 1 << 15;
+
+static void _yCbCrToRgba(u8 const *y, u8 const *cb, u8 const *cr, usize width, bool bgra, u8 *out) {
+    usize x = 0;
+    for (; x + 8 <= width; x += 8) {
+        u8x8 yv, cbv, crv;
+        memcpy(&yv, y + x, sizeof(yv));
+        memcpy(&cbv, cb + x, sizeof(cbv));
+        memcpy(&crv, cr + x, sizeof(crv));
+
+        i32x8 l = __builtin_convertvector(yv, i32x8);
+        i32x8 u = __builtin_convertvector(cbv, i32x8) - 128;
+        i32x8 v = __builtin_convertvector(crv, i32x8) - 128;
+
+        i32x8 r = _clampSamples(l + ((FIX_1_40200 * v + ONE_HALF) >> 16));
+        i32x8 g = _clampSamples(l + ((-FIX_0_34414 * u - FIX_0_71414 * v + ONE_HALF) >> 16));
+        i32x8 b = _clampSamples(l + ((FIX_1_77200 * u + ONE_HALF) >> 16));
+        if (bgra)
+            std::swap(r, b);
+
+        // Pixels are packed little endian, red first in memory
+        u32x8 px = __builtin_convertvector(r, u32x8) |
+                   __builtin_convertvector(g, u32x8) << 8 |
+                   __builtin_convertvector(b, u32x8) << 16 |
+                   0xFF000000;
+        memcpy(out + x * 4, &px, sizeof(px));
+    }
+
+    for (; x < width; ++x) {
+        i32 l = y[x];
+        i32 u = cb[x] - 128;
+        i32 v = cr[x] - 128;
+
+        u8 r = _clampSample(l + ((FIX_1_40200 * v + ONE_HALF) >> 16));
+        u8 g = _clampSample(l + ((-FIX_0_34414 * u - FIX_0_71414 * v + ONE_HALF) >> 16));
+        u8 b = _clampSample(l + ((FIX_1_77200 * u + ONE_HALF) >> 16));
+        if (bgra)
+            std::swap(r, b);
+
+        out[x * 4 + 0] = r;
+        out[x * 4 + 1] = g;
+        out[x * 4 + 2] = b;
+        out[x * 4 + 3] = 255;
+    }
+}
+
+static void _grayToRgba(u8 const *y, usize width, u8 *out) {
+    for (usize x = 0; x < width; ++x) {
+        out[x * 4 + 0] = y[x];
+        out[x * 4 + 1] = y[x];
+        out[x * 4 + 2] = y[x];
+        out[x * 4 + 3] = 255;
+    }
+}
+
+// MARK: Decoding --------------------------------------------------------------
+
+// The samples of a component. Decoding one MCU row at a time keeps a ring of
+// three of them so the rows above and below the one being upsampled are
+// always at hand, decoding in parallel keeps the whole component.
+struct _Plane {
+    Decoder::Component comp;
+    Decoder::Quant const *quant;
+    Decoder::IdctQuant const *idctQuant;
+    Decoder::HuffmanTable *dc;
+    Decoder::HuffmanTable *ac;
+
+    // Samples out of the IDCT of a block on each side, and the sampling
+    // factors they amount to once scaled
+    usize size;
+    u8 h;
+    u8 v;
+
+    usize stride;
+    isize rows;
+    isize width;
+    isize height;
+    Vec<u8> buf;
+
+    u8 *ring(isize y) {
+        return buf.buf() + (y % rows) * stride;
+    }
+
+    // Rows out of the component repeat its edges
+    u8 const *row(isize y) {
+        return ring(clamp(y, (isize)0, height - 1));
+    }
+
+    // Like libjpeg, the 1x1 blocks of images decoded at 1/8 are replicated
+    // rather than filtered
+    u8 const *upsample(isize y, u8 hMax, u8 vMax, bool fancy, usize outWidth, u8 *out) {
+        bool h2 = fancy and h * 2 == hMax and width > 2;
+
+        if (v == vMax) {
+            if (h == hMax)
+                return row(y);
+
+            if (h2)
+                _upsampleH2V1(row(y), width, out);
+            else
+                _upsampleNearest(row(y), h, hMax, outWidth, out);
+            return out;
+        }
+
+        if (fancy and v * 2 == vMax and (h == hMax or h2)) {
+            bool below = y & 1;
+            u8 const *near = row(y / 2);
+            u8 const *far = row(below ? y / 2 + 1 : y / 2 - 1);
+
+            if (h == hMax)
+                _upsampleH1V2(near, far, outWidth, below ? 2 : 1, out);
+            else
+                _upsampleH2V2(near, far, width, out);
+            return out;
+        }
+
+        _upsampleNearest(row(y * v / vMax), h, hMax, outWidth, out);
+        return out;
+    }
+};
+
+// Buffers of a thread turning samples into pixels
+struct _Scratch {
+    Array<Vec<u8>, 4> upsampled;
+
+    // Formats other than RGBA and BGRA go through Color one pixel at a time
+    Vec<u8> fallback;
+};
+
+// The planes of the frame being decoded and the pixels they end up in
+struct _Frame {
+    Decoder &dec;
+    Gfx::MutPixels pixels;
+    Array<_Plane, 4> planes = {};
+    bool bgra = false;
+    bool direct = false;
+
+    // Samples out of the IDCT of the blocks of the largest components
+    usize size = 8;
+    Math::Vec2i scaled = {};
+
+    Res<> init(bool whole, usize scale) {
+        if (scale != 1 and scale != 2 and scale != 4 and scale != 8)
+            return Error::invalidInput("unsupported scale");
+
+        size = 8 / scale;
+        scaled = dec.scaledSize(scale);
+        if (pixels.width() < scaled.x or pixels.height() < scaled.y)
+            return Error::invalidInput("destination is too small");
+
+        if (dec._progressive ? dec._scans.len() == 0 : not dec._scan) {
+            logError("jpeg: missing image data");
+            return Error::invalidData("missing image data");
+        }
+
+        for (usize c = 0; c < dec._componentCount; ++c) {
+            if (not dec._components[c]) {
+                logError("jpeg: undefined component id: {}", c);
+                return Error::invalidData("undefined component id");
+            }
+
+            auto &comp = dec._components[c].unwrap();
+            if (not dec._quant[comp.quantId]) {
+                logError("jpeg: undefined quantization table id: {}", comp.quantId);
                 return Error::invalidData("undefined quantization table id");
             }
 
-            auto &quant = _quant[_components[j]->quantId].unwrap();
-            for (usize k = 0; k < 64; k++) {
-                mcu[k] *= quant[k];
+            auto &p = planes[c];
+            p.comp = comp;
+            p.quant = &dec._quant[comp.quantId].unwrap();
+            p.idctQuant = &dec._idctQuant[comp.quantId];
+
+            // The scans of progressive images carry their own tables
+            if (not dec._progressive) {
+                if (not dec._scanComponents[c]) {
+                    logError("jpeg: undefined component id: {}", c);
+                    return Error::invalidData("undefined component id");
+                }
+
+                auto &sc = dec._scanComponents[c].unwrap();
+                if (not dec._dcHuff[sc.dcHuffId]) {
+                    logError("jpeg: undefined dc huffman table id: {}", sc.dcHuffId);
+                    return Error::invalidData("undefined dc huffman table id");
+                }
+
+                if (not dec._acHuff[sc.acHuffId]) {
+                    logError("jpeg: undefined ac huffman table id: {}", sc.acHuffId);
+                    return Error::invalidData("undefined ac huffman table id");
+                }
+
+                p.dc = &dec._dcHuff[sc.dcHuffId].unwrap();
+                p.ac = &dec._acHuff[sc.acHuffId].unwrap();
             }
 
-            idct(mcu);
+            // Subsampled components get larger IDCTs when that spares
+            // upsampling them, like libjpeg does, see jdmaster.c
+            p.size = size;
+            while (p.size < 8 and
+                   (dec._hMax * size) % (comp.hFactor * p.size * 2) == 0 and
+                   (dec._vMax * size) % (comp.vFactor * p.size * 2) == 0)
+                p.size *= 2;
+            p.h = comp.hFactor * p.size / size;
+            p.v = comp.vFactor * p.size / size;
+
+            p.stride = dec.blocksPerLine(comp) * p.size;
+            p.rows = comp.vFactor * p.size * (whole ? dec.mcuHeight() : 3);
+            p.width = dec.componentWidth(comp, p.size);
+            p.height = dec.componentHeight(comp, p.size);
+            p.buf.resize(p.stride * p.rows);
         }
 
-        auto &yMcu = _mcus[i + 0];
-        auto &cbMcu = _mcus[i + 1];
-        auto &crMcu = _mcus[i + 2];
+        bgra = pixels.fmt().is<Gfx::Bgra8888>();
+        direct = bgra or pixels.fmt().is<Gfx::Rgba8888>();
 
-        for (usize k = 0; k < 64; ++k) {
-            isize px = x * 8 + k % 8;
-            isize py = y * 8 + k / 8;
+        return Ok();
+    }
 
-            Gfx::YCbCr ycbcr{(float)yMcu[k], (float)cbMcu[k], (float)crMcu[k]};
-            pixels.storeUnsafe({px, py}, Gfx::yCbCrToRgb(ycbcr));
+    _Scratch scratch() const {
+        _Scratch scratch;
+        if (dec._componentCount > 1)
+            for (usize c = 0; c < dec._componentCount; ++c)
+                scratch.upsampled[c].resize(dec.mcuWidth() * size * dec._hMax);
+        if (not direct)
+            scratch.fallback.resize(scaled.x * 4);
+        return scratch;
+    }
+
+    // Decodes the blocks of an MCU in the order of the scan, handing each of
+    // them to sink(c, bx, by, block) with its position in its component
+    Res<> decodeMcu(BitStream &bs, Array<isize, 4> &pred, isize mx, isize my, Decoder::Block &block, auto sink) {
+        for (usize c = 0; c < dec._componentCount; ++c) {
+            auto &p = planes[c];
+            for (isize by = 0; by < p.comp.vFactor; ++by) {
+                for (isize bx = 0; bx < p.comp.hFactor; ++bx) {
+                    try$(dec.decodeBlock(bs, *p.dc, *p.ac, pred[c], block));
+                    sink(c, mx * p.comp.hFactor + bx, my * p.comp.vFactor + by, block);
+                }
+            }
+        }
+        return Ok();
+    }
+
+    void idct(usize c, isize bx, isize by, Decoder::Block const &block) {
+        auto &p = planes[c];
+        u8 *out = p.ring(by * p.size) + bx * p.size;
+        if (p.size == 8)
+            Decoder::idct(block, *p.idctQuant, out, p.stride);
+        else
+            Decoder::idctReduced(block, *p.quant, p.size, out, p.stride);
+    }
+
+    _Coeffs coeffs() const {
+        _Coeffs coeffs;
+        for (usize c = 0; c < dec._componentCount; ++c)
+            coeffs[c].resize(dec.blocksPerLine(planes[c].comp) * dec.mcuHeight() * planes[c].comp.vFactor);
+        return coeffs;
+    }
+
+    // Runs the IDCT of every block of the frame, one MCU row per task
+    void transform(_Coeffs const &coeffs) {
+        Sys::parallelFor(dec.mcuHeight(), [&](usize my) {
+            for (usize c = 0; c < dec._componentCount; ++c) {
+                auto &comp = planes[c].comp;
+                isize perLine = dec.blocksPerLine(comp);
+                for (isize by = my * comp.vFactor; by < (isize)(my + 1) * comp.vFactor; ++by)
+                    for (isize bx = 0; bx < perLine; ++bx)
+                        idct(c, bx, by, coeffs[c][by * perLine + bx]);
+            }
+        });
+    }
+
+    // Writes the pixels of an MCU row, the upsampling filters need the
+    // samples of the next one to be there already
+    void emit(isize my, _Scratch &scratch) {
+        isize start = my * size * dec._vMax;
+        isize end = min(start + (isize)size * dec._vMax, scaled.y);
+        isize width = scaled.x;
+
+        for (isize y = start; y < end; ++y) {
+            u8 *out = direct ? static_cast<u8 *>(pixels.scanline(y)) : scratch.fallback.buf();
+
+            if (dec._componentCount == 1) {
+                _grayToRgba(planes[0].row(y), width, out);
+            } else {
+                auto upsample = [&](usize c) {
+                    return planes[c].upsample(y, dec._hMax, dec._vMax, size > 1, width, scratch.upsampled[c].buf());
+                };
+                _yCbCrToRgba(upsample(0), upsample(1), upsample(2), width, bgra, out);
+            }
+
+            if (not direct) {
+                for (isize x = 0; x < width; ++x) {
+                    u8 const *px = out + x * 4;
+                    pixels.storeUnsafe({x, y}, Gfx::Color::fromRgba(px[0], px[1], px[2], px[3]));
+                }
+            }
+        }
+    }
+
+    // Once every sample is there, MCU rows can be upsampled and converted
+    // in any order
+    void emitAll() {
+        Sys::parallelFor(dec.mcuHeight(), [&](usize my) {
+            auto scratch = this->scratch();
+            emit(my, scratch);
+        });
+    }
+};
+
+// The scans of progressive images refine coefficients decoded by previous
+// ones, they are all kept until the last scan is done
+static Res<> _decodeProgressive(Decoder &dec, Gfx::MutPixels pixels, usize scale, Func<void()> const *onScan) {
+    _Frame frame{dec, pixels};
+    try$(frame.init(true, scale));
+    auto coeffs = frame.coeffs();
+
+    for (usize i = 0; i < dec._scans.len(); ++i) {
+        _Refiner refiner{dec._scans[i]};
+        try$(refiner.decode(dec, coeffs));
+
+        if (onScan or i + 1 == dec._scans.len()) {
+            frame.transform(coeffs);
+            frame.emitAll();
+        }
+
+        if (onScan)
+            (*onScan)();
+    }
+
+    return Ok();
+}
+
+Res<> Decoder::decode(Gfx::MutPixels pixels, usize scale) {
+    if (_progressive)
+        return _decodeProgressive(*this, pixels, scale, nullptr);
+
+    _Frame frame{*this, pixels};
+    try$(frame.init(false, scale));
+    auto scratch = frame.scratch();
+
+    Io::BScan s{*_scan};
+    BitStream bs{s};
+    Array<isize, 4> pred = {};
+    Block block;
+
+    auto idct = [&](usize c, isize bx, isize by, Block const &block) {
+        frame.idct(c, bx, by, block);
+    };
+
+    // Blocks go through the IDCT as soon as they are decoded, and an MCU row
+    // is upsampled once the next one is done, as the filters need the
+    // samples right below it
+    usize mcu = 0;
+    for (isize my = 0; my < mcuHeight(); ++my) {
+        for (isize mx = 0; mx < mcuWidth(); ++mx, ++mcu) {
+            if (_restartInterval > 0 and mcu > 0 and mcu % _restartInterval == 0) {
+                try$(bs.restart());
+                pred = {};
+            }
+
+            try$(frame.decodeMcu(bs, pred, mx, my, block, idct));
         }
+
+        if (my > 0)
+            frame.emit(my - 1, scratch);
     }
+    frame.emit(mcuHeight() - 1, scratch);
+
+    return Ok();
+}
+
+Res<> Decoder::decodeParallel(Gfx::MutPixels pixels, usize scale) {
+    if (_progressive)
+        return _decodeProgressive(*this, pixels, scale, nullptr);
+
+    _Frame frame{*this, pixels};
+    try$(frame.init(true, scale));
+
+    auto idct = [&](usize c, isize bx, isize by, Block const &block) {
+        frame.idct(c, bx, by, block);
+    };
+
+    usize mcus = mcuWidth() * mcuHeight();
+    if (_restartInterval > 0 and _segments.len() == (mcus + _restartInterval - 1) / _restartInterval) {
+        // Restart intervals don't depend on each other, each of them is
+        // decoded and transformed on its own
+        Vec<Res<>> results;
+        results.resize(_segments.len(), Ok());
+        Sys::parallelFor(_segments.len(), [&](usize i) {
+            Io::BScan s{_segments[i]};
+            BitStream bs{s};
+            Array<isize, 4> pred = {};
+            Block block;
+
+            usize end = min((i + 1) * _restartInterval, mcus);
+            for (usize mcu = i * _restartInterval; mcu < end and results[i]; ++mcu)
+                results[i] = frame.decodeMcu(bs, pred, mcu % mcuWidth(), mcu / mcuWidth(), block, idct);
+        });
+
+        for (auto &res : results)
+            try$(res);
+    } else {
+        // The entropy decoding can't be split without restart markers, the
+        // coefficients are kept for the IDCT to run in parallel afterward
+        auto coeffs = frame.coeffs();
+
+        Io::BScan s{*_scan};
+        BitStream bs{s};
+        Array<isize, 4> pred = {};
+        Block block;
+
+        auto store = [&](usize c, isize bx, isize by, Block const &block) {
+            coeffs[c][by * blocksPerLine(frame.planes[c].comp) + bx] = block;
+        };
+
+        usize mcu = 0;
+        for (isize my = 0; my < mcuHeight(); ++my) {
+            for (isize mx = 0; mx < mcuWidth(); ++mx, ++mcu) {
+                if (_restartInterval > 0 and mcu > 0 and mcu % _restartInterval == 0) {
+                    try$(bs.restart());
+                    pred = {};
+                }
+
+                try$(frame.decodeMcu(bs, pred, mx, my, block, store));
+            }
+        }
+
+        frame.transform(coeffs);
+    }
+
+    frame.emitAll();
+
+    return Ok();
+}
+
+Res<> Decoder::decodeIncremental(Gfx::MutPixels pixels, Func<void()> onScan, usize scale) {
+    if (_progressive)
+        return _decodeProgressive(*this, pixels, scale, &onScan);
 
+    try$(decode(pixels, scale));
+    onScan();
     return Ok();
 }
 
@@ -625,6 +1439,7 @@ void Decoder::repr(Io::Emit &e) {
     e.indentNewline();
     e.ln("width: {}", width());
     e.ln("height: {}", height());
+    e.ln("progressive: {}", _progressive);
 
     e("quantization tables:");
     e.indentNewline();
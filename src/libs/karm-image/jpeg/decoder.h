@@ -8,6 +8,7 @@
 //  - https://github.com/dannye/jed/blob/master/src/decoder.cpp
 //  - https://www.youtube.com/watch?v=CPT4FSkFUgs
 
+#include <karm-base/func.h>
 #include <karm-base/vec.h>
 #include <karm-gfx/buffer.h>
 #include <karm-gfx/colors.h>
@@ -120,64 +121,101 @@ inline constexpr Array<usize, 64> ZIGZAG = {
     53, 60, 61, 54, 47, 55, 62, 63
 };
 
+// Scale factors of the AAN IDCT for each coefficient, in natural order,
+// cos(k*pi/16)*sqrt(2) for its row and column on 14 bits
+inline constexpr Array<i32, 64> AAN_SCALES = {
+    16384, 22725, 21407, 19266, 16384, 12873, 8867, 4520,
+    22725, 31521, 29692, 26722, 22725, 17855, 12299, 6270,
+    21407, 29692, 27969, 25172, 21407, 16819, 11585, 5906,
+    19266, 26722, 25172, 22654, 19266, 15137, 10426, 5315,
+    16384, 22725, 21407, 19266, 16384, 12873, 8867, 4520,
+    12873, 17855, 16819, 15137, 12873, 10114, 6967, 3552,
+    8867, 12299, 11585, 10426, 8867, 6967, 4799, 2446,
+    4520, 6270, 5906, 5315, 4520, 3552, 2446, 1247
+};
+
 // MARK: Bit Stream ------------------------------------------------------------
 
+// Reads the entropy coded segment MSB first, a few bytes at a time. Stuffed
+// zero bytes are removed and the reader stops in front of the next marker,
+// feeding zeros past it like libjpeg does with truncated data.
 struct BitStream {
     Io::BScan &s;
 
-    u8 _buf = 0x0;
-    u8 _len = 0x0;
+    u32 _bits = 0;
+    u8 _len = 0;
+    bool _marker = false;
 
     always_inline BitStream(Io::BScan &s) : s(s) {}
 
     always_inline void reset() {
-        _buf = 0x0;
-        _len = 0x0;
+        _bits = 0;
+        _len = 0;
+        _marker = false;
     }
 
-    always_inline Res<> fill() {
-        if (_len)
-            return Ok();
-
-        _buf = s.nextU8be();
-        while (_buf == 0xFF) {
-            u8 marker = s.peekU8be();
-
-            while (marker == 0xFF) {
-                s.nextU8be();
-                marker = s.peekU8be();
-            }
-
-            if (marker == 0x00) {
-                s.nextU8be();
-                break;
-            } else if (RST0 <= marker and marker <= RST7) {
-                s.nextU8be();
-                _buf = s.nextU8be();
-            } else {
-                logError("jpeg: invalid marker");
-                return Error::invalidData("invalid marker");
+    always_inline void fill() {
+        while (_len <= 24) {
+            u32 byte = 0;
+            if (not _marker and not s.ended()) {
+                byte = s.peekU8be();
+                if (byte != 0xFF) {
+                    s.skip(1);
+                } else if (s.peek(1).peekU8be() == 0x00) {
+                    s.skip(2);
+                } else {
+                    _marker = true;
+                    byte = 0;
+                }
             }
+            _bits |= byte << (24 - _len);
+            _len += 8;
         }
+    }
 
-        _len = 8;
-        return Ok();
+    always_inline u32 peekBits(u8 n) {
+        fill();
+        return _bits >> (32 - n);
     }
 
-    always_inline Res<u8> nextBit() {
-        try$(fill());
-        u8 bit = _buf >> 7;
-        _buf <<= 1;
-        _len--;
-        return Ok(bit);
+    always_inline void skipBits(u8 n) {
+        _bits <<= n;
+        _len -= n;
     }
 
-    always_inline Res<usize> nextBits(u8 n) {
-        usize res = 0;
-        while (n--) {
-            res = (res << 1) | try$(nextBit());
-        }
-        return Ok(res);
+    always_inline usize nextBits(u8 n) {
+        if (n == 0)
+            return 0;
+        u32 v = peekBits(n);
+        skipBits(n);
+        return v;
+    }
+
+    // Reads a n bits magnitude category value, see F.2.2.1
+    always_inline isize nextExtend(u8 n) {
+        if (n == 0)
+            return 0;
+        isize v = nextBits(n);
+        if (v < (1 << (n - 1)))
+            v -= (1 << n) - 1;
+        return v;
+    }
+
+    // Skips the RSTn marker ending a restart interval
+    Res<> restart() {
+        reset();
+        while (s.rem() >= 2 and s.peekU8be() == 0xFF and s.peek(1).peekU8be() == 0xFF)
+            s.skip(1);
+
+        if (s.rem() < 2 or s.peekU8be() != 0xFF)
+            return Error::invalidData("missing restart marker");
+
+        u8 marker = s.peek(1).peekU8be();
+        if (marker < RST0 or marker > RST7)
+            return Error::invalidData("missing restart marker");
+
+        s.skip(2);
+        return Ok();
     }
 };
 
@@ -196,10 +234,19 @@ struct Decoder {
     Array<Opt<Quant>, 4> _quant;
     bool _quirkZeroBased = false;
 
+    // Quantization tables premultiplied by the scale factors of the IDCT,
+    // so dequantizing happens as part of it, see idct()
+    using IdctQuant = Array<i32, 64>;
+    Array<IdctQuant, 4> _idctQuant;
+
     Res<> defineQuantizationTable(Io::BScan &x);
 
     // MARK: Start of frame ----------------------------------------------------
 
+    // Progressive frames are coded as a series of scans, each refining some
+    // of the coefficients of the previous ones
+    bool _progressive = false;
+
     isize _width = 8;
     isize _height = 8;
 
@@ -207,9 +254,13 @@ struct Decoder {
 
     isize height() const { return _height; }
 
-    isize mcuWidth() const { return (_width + 7) / 8; }
+    // Largest sampling factors, an MCU covers 8 times as many pixels
+    u8 _hMax = 1;
+    u8 _vMax = 1;
+
+    isize mcuWidth() const { return (_width + 8 * _hMax - 1) / (8 * _hMax); }
 
-    isize mcuHeight() const { return (_height + 7) / 8; }
+    isize mcuHeight() const { return (_height + 8 * _vMax - 1) / (8 * _vMax); }
 
     struct Component {
         u8 hFactor;
@@ -222,6 +273,16 @@ struct Decoder {
 
     Res<> startOfFrame(Io::BScan &x);
 
+    // Size in samples of a component once downsampled, for blocks that
+    // come out of the IDCT as size x size samples
+    isize componentWidth(Component const &c, isize size = 8) const {
+        return (_width * c.hFactor * size + _hMax * 8 - 1) / (_hMax * 8);
+    }
+
+    isize componentHeight(Component const &c, isize size = 8) const {
+        return (_height * c.vFactor * size + _vMax * 8 - 1) / (_vMax * 8);
+    }
+
     // MARK: Restart interval --------------------------------------------------
 
     usize _restartInterval = 0;
@@ -231,13 +292,32 @@ struct Decoder {
     // MARK: Huffman Tables ----------------------------------------------------
 
     struct HuffmanTable {
-        Array<u8, 17> offs = {};
-        Array<u8, 162> syms = {};
-        Opt<Array<usize, 256>> _codes = {};
-
-        Array<usize, 256> const &codes();
+        static constexpr usize FAST_BITS = 9;
+
+        // Up to 162 symbols for baseline AC tables, 176 with the EOB runs of
+        // progressive ones, 256 at most
+        Array<u16, 17> offs = {};
+        Array<u8, 256> syms = {};
+
+        // Index of the symbol of every code of up to FAST_BITS bits, looked
+        // up with the next FAST_BITS bits of the stream, 0xFF for longer ones
+        Array<u8, 1 << FAST_BITS> fast = {};
+        Array<u8, 256> sizes = {};
+        Array<u32, 18> maxCode = {};
+        Array<i32, 17> delta = {};
+
+        Res<> build();
+
+        always_inline Res<Byte> next(BitStream &bs) const {
+            u8 i = fast[bs.peekBits(FAST_BITS)];
+            if (i != 0xFF) {
+                bs.skipBits(sizes[i]);
+                return Ok(syms[i]);
+            }
+            return nextSlow(bs);
+        }
 
-        Res<Byte> next(BitStream &bs);
+        Res<Byte> nextSlow(BitStream &bs) const;
     };
 
     Array<Opt<HuffmanTable>, 4> _dcHuff;
@@ -253,6 +333,11 @@ struct Decoder {
     };
 
     Array<Opt<ScanComponent>, 4> _scanComponents;
+
+    // Ids of the components of the scan, in the order of their blocks
+    Array<u8, 4> _scanOrder = {};
+    usize _scanLength = 0;
+
     u8 _ss = 0;
     u8 _se = 0;
     u8 _ah = 0;
@@ -262,17 +347,78 @@ struct Decoder {
 
     // MARK: Huffman Data ------------------------------------------------------
 
-    using Mcu = Array<i16, 64>;
+    // The entropy coded data of the scan, decoded one MCU row at a time by
+    // decode() so only a few rows of samples are ever held in memory
+    Opt<Bytes> _scan;
+
+    // The scan split at its RSTn markers, one slice per restart interval
+    Vec<Bytes> _segments;
+
+    // The coefficients of an 8x8 block, in natural order
+    using Block = Array<i16, 64>;
+
+    usize blocksPerLine(Component const &c) const {
+        return mcuWidth() * c.hFactor;
+    }
+
+    Res<> decodeBlock(BitStream &bs, HuffmanTable &dc, HuffmanTable &ac, isize &pred, Block &block);
 
-    Vec<Mcu> _mcus;
+    void skipScan(Io::BScan &s);
 
-    Res<> decodeHuffman(Io::BScan &s);
+    // MARK: Progressive -------------------------------------------------------
+
+    // A scan of a progressive image, refining the coefficients ss to se of
+    // some of the components, see G.1.1.1
+    struct Scan {
+        Array<u8, 4> components = {};
+        usize componentCount = 0;
+
+        // The tables as they were at the start of the scan, by position in
+        // it, later scans may redefine them
+        Array<Opt<HuffmanTable>, 4> dcHuff = {};
+        Array<Opt<HuffmanTable>, 4> acHuff = {};
+
+        u8 ss = 0;
+        u8 se = 0;
+        u8 ah = 0;
+        u8 al = 0;
+        usize restartInterval = 0;
+        Bytes data = {};
+    };
+
+    Vec<Scan> _scans;
+
+    Res<> recordScan();
 
     // MARK: Decoding ----------------------------------------------------------
 
-    void idct(Array<short, 64> &mcu);
+    static void idct(Block const &block, IdctQuant const &quant, u8 *out, usize stride);
+
+    // Outputs the size x size samples of the lowest frequencies of a block,
+    // size being 4, 2 or 1
+    static void idctReduced(Block const &block, Quant const &quant, usize size, u8 *out, usize stride);
+
+    // Size of the image decoded at 1/scale of its size, rounded up
+    Math::Vec2i scaledSize(usize scale) const {
+        return {
+            (_width + (isize)scale - 1) / (isize)scale,
+            (_height + (isize)scale - 1) / (isize)scale,
+        };
+    }
+
+    // Decodes at 1/scale of the size of the image, with scale being 1, 2,
+    // 4 or 8, by only keeping the lowest frequencies of every block
+    Res<> decode(Gfx::MutPixels pixels, usize scale = 1);
+
+    // Decodes on all the threads of the system, restart intervals side by
+    // side when there are some, at the cost of keeping the whole frame in
+    // memory
+    Res<> decodeParallel(Gfx::MutPixels pixels, usize scale = 1);
 
-    Res<> decode(Gfx::MutPixels pixels);
+    // Decodes progressive images one scan at a time, calling onScan once
+    // pixels hold the image as refined by each of them so it can be shown
+    // early. Baseline images only have the one scan.
+    Res<> decodeIncremental(Gfx::MutPixels pixels, Func<void()> onScan, usize scale = 1);
 
     // MARK: Dumping -----------------------------------------------------------
 
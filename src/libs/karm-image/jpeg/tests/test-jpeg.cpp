@@ -0,0 +1,174 @@
+#include <karm-image/jpeg/decoder.h>
+#include <karm-image/loader.h>
+#include <karm-sys/file.h>
+#include <karm-sys/mmap.h>
+#include <karm-test/macros.h>
+
+namespace Jpeg::Tests {
+
+static Mime::Url _res(Str name) {
+    return "bundle://karm-image.jpeg.tests"_url / name;
+}
+
+// Reference colors are the ones libjpeg decodes with its fast integer IDCT
+// and fancy upsampling, which this decoder reproduces exactly
+struct {
+    Str name;
+    Math::Vec2i pos;
+    Gfx::Color color;
+} PIXELS[] = {
+    {"cat-1mcu.jpg", {0, 0}, Gfx::Color::fromRgba(11, 3, 1, 255)},
+    {"cat-1mcu.jpg", {7, 7}, Gfx::Color::fromRgba(205, 218, 235, 255)},
+    {"cat-smaller.jpg", {480, 300}, Gfx::Color::fromRgba(208, 204, 193, 255)},
+    {"cat-smaller.jpg", {959, 599}, Gfx::Color::fromRgba(191, 202, 220, 255)},
+    {"gray-33x47.jpg", {0, 0}, Gfx::Color::fromRgba(67, 67, 67, 255)},
+    {"gray-33x47.jpg", {32, 46}, Gfx::Color::fromRgba(124, 124, 124, 255)},
+    {"420-33x47.jpg", {0, 0}, Gfx::Color::fromRgba(138, 0, 34, 255)},
+    {"420-33x47.jpg", {16, 23}, Gfx::Color::fromRgba(69, 119, 50, 255)},
+    {"420-33x47.jpg", {32, 46}, Gfx::Color::fromRgba(19, 252, 199, 255)},
+    {"422-33x47.jpg", {16, 23}, Gfx::Color::fromRgba(64, 128, 16, 255)},
+    {"422-33x47.jpg", {32, 46}, Gfx::Color::fromRgba(13, 250, 222, 255)},
+    {"440-33x47.jpg", {16, 23}, Gfx::Color::fromRgba(75, 114, 59, 255)},
+    {"440-33x47.jpg", {32, 46}, Gfx::Color::fromRgba(25, 249, 195, 255)},
+    {"411-33x47.jpg", {16, 23}, Gfx::Color::fromRgba(111, 101, 29, 255)},
+    {"411-33x47.jpg", {32, 46}, Gfx::Color::fromRgba(16, 250, 215, 255)},
+};
+
+test$("jpeg-pixels") {
+    for (auto const &[name, pos, color] : PIXELS) {
+        auto image = try$(Image::load(_res(name)));
+        expectEq$(image.pixels().load(pos), color);
+    }
+
+    return Ok();
+}
+
+test$("jpeg-sizes") {
+    struct {
+        Str name;
+        isize width;
+        isize height;
+    } SIZES[] = {
+        {"cat-1mcu.jpg", 8, 8},
+        {"cat-8mcu.jpg", 64, 64},
+        {"cat.jpg", 1920, 1200},
+        {"jpeg-home.jpg", 800, 400},
+        {"yosemite.jpg", 1920, 1080},
+        {"gray-33x47.jpg", 33, 47},
+        {"420-33x47.jpg", 33, 47},
+    };
+
+    for (auto const &[name, width, height] : SIZES) {
+        auto image = try$(Image::load(_res(name)));
+        expectEq$(image.width(), width);
+        expectEq$(image.height(), height);
+    }
+
+    return Ok();
+}
+
+test$("jpeg-restart") {
+    // The same image with a restart marker every two MCUs
+    auto ref = try$(Image::load(_res("420-33x47.jpg")));
+    auto image = try$(Image::load(_res("420-33x47-rst.jpg")));
+    expectEq$(image.pixels().bytes(), ref.pixels().bytes());
+
+    return Ok();
+}
+
+test$("jpeg-parallel") {
+    // Images with and without restart markers, the latter only get their
+    // IDCT and color conversion done in parallel
+    for (Str name : {"cat.jpg"s, "gray-33x47.jpg"s, "420-33x47.jpg"s, "420-33x47-rst.jpg"s, "411-33x47.jpg"s}) {
+        auto file = try$(Sys::File::open(_res(name)));
+        auto map = try$(Sys::mmap().map(file));
+        auto jpeg = try$(Decoder::init(map.bytes()));
+
+        auto serial = Gfx::Surface::alloc({jpeg.width(), jpeg.height()});
+        try$(jpeg.decode(*serial));
+
+        auto parallel = Gfx::Surface::alloc({jpeg.width(), jpeg.height()});
+        try$(jpeg.decodeParallel(*parallel));
+
+        expectEq$(parallel->pixels().bytes(), serial->pixels().bytes());
+    }
+
+    return Ok();
+}
+
+test$("jpeg-scaled") {
+    // Reference colors are the ones libjpeg decodes at the same scale
+    struct {
+        Str name;
+        Image::Scale scale;
+        Math::Vec2i size;
+        Math::Vec2i pos;
+        Gfx::Color color;
+    } SCALED[] = {
+        {"cat.jpg", Image::Scale::HALF, {960, 600}, {480, 300}, Gfx::Color::fromRgba(207, 200, 190, 255)},
+        {"cat.jpg", Image::Scale::HALF, {960, 600}, {959, 599}, Gfx::Color::fromRgba(192, 203, 221, 255)},
+        {"cat.jpg", Image::Scale::EIGHTH, {240, 150}, {120, 75}, Gfx::Color::fromRgba(202, 195, 185, 255)},
+        {"420-33x47.jpg", Image::Scale::HALF, {17, 24}, {8, 11}, Gfx::Color::fromRgba(90, 117, 36, 255)},
+        {"420-33x47.jpg", Image::Scale::HALF, {17, 24}, {16, 23}, Gfx::Color::fromRgba(24, 249, 217, 255)},
+        {"422-33x47.jpg", Image::Scale::QUARTER, {9, 12}, {4, 5}, Gfx::Color::fromRgba(116, 100, 103, 255)},
+        {"411-33x47.jpg", Image::Scale::EIGHTH, {5, 6}, {4, 5}, Gfx::Color::fromRgba(15, 235, 101, 255)},
+    };
+
+    for (auto const &[name, scale, size, pos, color] : SCALED) {
+        auto image = try$(Image::load(_res(name), scale));
+        expectEq$(image.width(), size.x);
+        expectEq$(image.height(), size.y);
+        expectEq$(image.pixels().load(pos), color);
+    }
+
+    return Ok();
+}
+
+test$("jpeg-progressive") {
+    auto birch = try$(Image::load(_res("birch.jpg")));
+    expectEq$(birch.width(), 400);
+    expectEq$(birch.height(), 300);
+    expectEq$(birch.pixels().load({0, 0}), Gfx::Color::fromRgba(38, 55, 19, 255));
+    expectEq$(birch.pixels().load({200, 150}), Gfx::Color::fromRgba(80, 96, 59, 255));
+    expectEq$(birch.pixels().load({399, 299}), Gfx::Color::fromRgba(125, 149, 97, 255));
+
+    // The same coefficients losslessly recoded as progressive scans, with a
+    // restart marker every two MCUs
+    auto ref = try$(Image::load(_res("420-33x47.jpg")));
+    auto image = try$(Image::load(_res("420-33x47-progressive.jpg")));
+    expectEq$(image.pixels().bytes(), ref.pixels().bytes());
+
+    auto scaled = try$(Image::load(_res("birch.jpg"), Image::Scale::QUARTER));
+    expectEq$(scaled.width(), 100);
+    expectEq$(scaled.height(), 75);
+
+    return Ok();
+}
+
+test$("jpeg-incremental") {
+    // Progressive images are handed out after each of their scans, baseline
+    // ones only once
+    struct {
+        Str name;
+        usize scans;
+    } SCANS[] = {
+        {"birch.jpg", 10},
+        {"420-33x47-progressive.jpg", 10},
+        {"420-33x47.jpg", 1},
+    };
+
+    for (auto const &[name, scans] : SCANS) {
+        usize calls = 0;
+        auto image = try$(Image::loadIncremental(_res(name), [&](Image::Picture) {
+            calls++;
+        }));
+        expectEq$(calls, scans);
+
+        auto ref = try$(Image::load(_res(name)));
+        expectEq$(image.pixels().bytes(), ref.pixels().bytes());
+    }
+
+    return Ok();
+}
+
+} // namespace Jpeg::Tests
@@ -1,6 +1,9 @@
+#include <karm-base/enum.h>
 #include <karm-sys/file.h>
+#include <karm-sys/thread.h>
 
 #include "bmp/decoder.h"
+#include "cache.h"
 #include "jpeg/decoder.h"
 #include "png/decoder.h"
 #include "qoi/decoder.h"
@@ -10,58 +13,193 @@
 
 namespace Karm::Image {
 
-static Res<Picture> loadBmp(Bytes bytes) {
+// Averages every scale x scale box of pixels weighted by their alpha, one
+// row of boxes at a time, the partial boxes on the edges included
+static Strong<Gfx::Surface> _downscale(Gfx::Pixels src, usize scale) {
+    isize s = scale;
+    auto dst = Gfx::Surface::alloc({(src.width() + s - 1) / s, (src.height() + s - 1) / s});
+    auto out = dst->mutPixels();
+
+    Vec<u32> sums;
+    sums.resize(out.width() * 4);
+
+    for (isize dy = 0; dy < out.height(); ++dy) {
+        for (auto &sum : sums)
+            sum = 0;
+
+        isize y0 = dy * s;
+        isize y1 = min(y0 + s, src.height());
+        for (isize y = y0; y < y1; ++y) {
+            u8 const *row = static_cast<u8 const *>(src.scanline(y));
+            for (isize x = 0; x < src.width(); ++x) {
+                u8 const *px = row + x * 4;
+                u32 *sum = sums.buf() + x / s * 4;
+                sum[0] += px[0] * px[3];
+                sum[1] += px[1] * px[3];
+                sum[2] += px[2] * px[3];
+                sum[3] += px[3];
+            }
+        }
+
+        u8 *row = static_cast<u8 *>(out.scanline(dy));
+        for (isize dx = 0; dx < out.width(); ++dx) {
+            u32 const *sum = sums.buf() + dx * 4;
+            u32 alpha = sum[3];
+            u32 count = (y1 - y0) * (min(dx * s + s, src.width()) - dx * s);
+            for (usize c = 0; c < 3; ++c)
+                row[dx * 4 + c] = alpha ? (sum[c] + alpha / 2) / alpha : 0;
+            row[dx * 4 + 3] = (alpha + count / 2) / count;
+        }
+    }
+
+    return dst;
+}
+
+// Decoders without a way to scale their output decode at full size first
+static Res<Picture> _scaled(Strong<Gfx::Surface> img, Scale scale) {
+    if (scale == Scale::FULL)
+        return Ok(img);
+    return Ok(_downscale(*img, toUnderlyingType(scale)));
+}
+
+static Res<Picture> loadBmp(Bytes bytes, Scale scale) {
     auto bmp = try$(Bmp::Decoder::init(bytes));
     auto img = Gfx::Surface::alloc({bmp.width(), bmp.height()});
-    try$(bmp.decode(*img));
-    return Ok(img);
+
+    if (Sys::concurrency() > 1 and img->width() * img->height() >= 1024 * 1024)
+        try$(bmp.decodeParallel(*img));
+    else
+        try$(bmp.decode(*img));
+    return _scaled(img, scale);
 }
 
-static Res<Picture> loadQoi(Bytes bytes) {
+static Res<Picture> loadQoi(Bytes bytes, Scale scale) {
     auto qoi = try$(Qoi::Decoder::init(bytes));
     auto img = Gfx::Surface::alloc({qoi.width(), qoi.height()});
     try$(qoi.decode(*img));
-    return Ok(img);
+    return _scaled(img, scale);
 }
 
-static Res<Picture> loadPng(Bytes bytes) {
+static Res<Picture> loadPng(Bytes bytes, Scale scale) {
     auto png = try$(Png::Decoder::init(bytes));
     auto img = Gfx::Surface::alloc({png.width(), png.height()});
     try$(png.decode(*img));
-    return Ok(img);
+    return _scaled(img, scale);
 }
 
-static Res<Picture> loadJpeg(Bytes bytes) {
+static Res<Picture> loadJpeg(Bytes bytes, Scale scale) {
     auto jpeg = try$(Jpeg::Decoder::init(bytes));
-    auto img = Gfx::Surface::alloc({jpeg.width(), jpeg.height()});
-    try$(jpeg.decode(*img));
+    auto img = Gfx::Surface::alloc(jpeg.scaledSize(toUnderlyingType(scale)));
+
+    // Spreading small images over threads costs more than it saves
+    if (Sys::concurrency() > 1 and img->width() * img->height() >= 1024 * 1024)
+        try$(jpeg.decodeParallel(*img, toUnderlyingType(scale)));
+    else
+        try$(jpeg.decode(*img, toUnderlyingType(scale)));
     return Ok(img);
 }
 
-Res<Picture> load(Sys::Mmap &&map) {
+Res<Picture> load(Sys::Mmap &&map, Scale scale) {
     if (Bmp::Decoder::sniff(map.bytes())) {
-        return loadBmp(map.bytes());
+        return loadBmp(map.bytes(), scale);
     } else if (Qoi::Decoder::sniff(map.bytes())) {
-        return loadQoi(map.bytes());
+        return loadQoi(map.bytes(), scale);
     } else if (Png::Decoder::sniff(map.bytes())) {
-        return loadPng(map.bytes());
+        return loadPng(map.bytes(), scale);
     } else if (Jpeg::Decoder::sniff(map.bytes())) {
-        return loadJpeg(map.bytes());
+        return loadJpeg(map.bytes(), scale);
     } else {
         return Error::invalidData("unknown image format");
     }
 }
 
-Res<Picture> load(Mime::Url url) {
+static Cache::Key _cacheKey(Mime::Url const &url, Sys::FileReader &file, Scale scale) {
+    // Files that can't tell when they were modified are keyed by url alone
+    auto stat = file.stat();
+    return {url, stat ? stat.unwrap().modifyTime : TimeStamp::epoch(), scale};
+}
+
+Res<Picture> load(Mime::Url url, Scale scale) {
     auto file = try$(Sys::File::open(url));
+    auto key = _cacheKey(url, file, scale);
+    auto &cache = globalCache();
+    if (auto picture = cache.lookup(key))
+        return Ok(picture.take());
+
     auto map = try$(Sys::mmap().map(file));
-    return load(std::move(map));
+    auto picture = try$(load(std::move(map), scale));
+    cache.insert(key, picture);
+    return Ok(picture);
+}
+
+// Handed to the decoding thread as a plain pointer, nothing in it is shared
+// with the loop while the thread runs
+struct _Decode {
+    Sys::Mmap map;
+    Scale scale;
+    Res<Picture> result = Error::other("image not decoded");
+};
+
+Async::Task<Picture> loadAsync(Mime::Url url, Scale scale) {
+    auto file = co_try$(Sys::File::open(url));
+    auto key = _cacheKey(url, file, scale);
+    auto &cache = globalCache();
+    if (auto picture = cache.lookup(key))
+        co_return Ok(picture.take());
+
+    if (auto pending = cache._pending.tryGet(key))
+        co_return co_await pending.take();
+
+    auto map = co_try$(Sys::mmap().map(file));
+    Async::Promise<Picture> promise;
+    cache._pending.put(key, promise.future());
+
+    // Only the decoding happens on the other thread, the cache is left to
+    // this one. offloadAsync() returns once the thread is done, this side
+    // frees what it was handed and takes the picture back.
+    auto *decode = new _Decode{std::move(map), scale};
+    auto offloaded = co_await Sys::offloadAsync([decode] {
+        decode->result = load(std::move(decode->map), decode->scale);
+    });
+
+    Res<Picture> result = std::move(decode->result);
+    delete decode;
+    if (not offloaded)
+        result = offloaded.none();
+
+    cache._pending.del(key);
+    if (result)
+        cache.insert(key, result.unwrap());
+    promise.resolve(result);
+    co_return result;
 }
 
-Res<Picture> loadOrFallback(Mime::Url url) {
-    if (auto result = load(url); result)
+Res<Picture> loadOrFallback(Mime::Url url, Scale scale) {
+    if (auto result = load(url, scale); result)
         return result;
     return Ok(Gfx::Surface::fallback());
 }
 
+Res<Picture> loadIncremental(Mime::Url url, Func<void(Picture)> onProgress, Scale scale) {
+    auto file = try$(Sys::File::open(url));
+    auto map = try$(Sys::mmap().map(file));
+
+    if (not Jpeg::Decoder::sniff(map.bytes())) {
+        auto picture = try$(load(std::move(map), scale));
+        onProgress(picture);
+        return Ok(picture);
+    }
+
+    auto jpeg = try$(Jpeg::Decoder::init(map.bytes()));
+    auto img = Gfx::Surface::alloc(jpeg.scaledSize(toUnderlyingType(scale)));
+    try$(jpeg.decodeIncremental(
+        *img,
+        [&] {
+            onProgress(img);
+        },
+        toUnderlyingType(scale)
+    ));
+    return Ok(img);
+}
+
 } // namespace Karm::Image
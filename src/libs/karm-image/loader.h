@@ -1,15 +1,36 @@
 #pragma once
 
+#include <karm-base/async.h>
+#include <karm-base/func.h>
 #include <karm-sys/mmap.h>
 
 #include "picture.h"
 
 namespace Karm::Image {
 
-Res<Picture> load(Sys::Mmap &&map);
+// Fraction of their size images are decoded at. JPEG images only decode the
+// frequencies they keep, other formats are box filtered down.
+enum struct Scale : u8 {
+    FULL = 1,
+    HALF = 2,
+    QUARTER = 4,
+    EIGHTH = 8,
+};
 
-Res<Picture> load(Mime::Url url);
+Res<Picture> load(Sys::Mmap &&map, Scale scale = Scale::FULL);
 
-Res<Picture> loadOrFallback(Mime::Url url);
+// Pictures loaded from an url are kept in the global cache, see cache.h
+Res<Picture> load(Mime::Url url, Scale scale = Scale::FULL);
+
+// Like load(), decoding on a thread of its own while the loop keeps running
+Async::Task<Picture> loadAsync(Mime::Url url, Scale scale = Scale::FULL);
+
+Res<Picture> loadOrFallback(Mime::Url url, Scale scale = Scale::FULL);
+
+// Like load(), also handing the picture to onProgress as it gets refined, the
+// same picture every time. Progressive JPEG images are handed out after each
+// of their scans, other images once they are whole. The cache is bypassed so
+// the scans are always there to show.
+Res<Picture> loadIncremental(Mime::Url url, Func<void(Picture)> onProgress, Scale scale = Scale::FULL);
 
 } // namespace Karm::Image
@@ -5,6 +5,13 @@
 
 namespace Karm::Image {
 
+enum struct Format : u8 {
+    PNG,
+    QOI,
+    BMP,
+    JPEG,
+};
+
 struct Picture {
     Strong<Gfx::Surface const> _surface;
 
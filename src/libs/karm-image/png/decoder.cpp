@@ -0,0 +1,491 @@
+#include <karm-base/simd.h>
+#include <karm-io/inflate.h>
+
+#include "decoder.h"
+
+namespace Png {
+
+// MARK: Chunks ----------------------------------------------------------------
+
+static constexpr isize MAX_SIZE = 1 << 24;
+
+static bool _validDepth(ColorType type, u8 depth) {
+    switch (type) {
+    case ColorType::GRAY:
+        return depth == 1 or depth == 2 or depth == 4 or depth == 8 or depth == 16;
+    case ColorType::INDEXED:
+        return depth == 1 or depth == 2 or depth == 4 or depth == 8;
+    case ColorType::RGB:
+    case ColorType::GRAY_ALPHA:
+    case ColorType::RGBA:
+        return depth == 8 or depth == 16;
+    }
+    return false;
+}
+
+Res<Decoder> Decoder::init(Bytes slice) {
+    if (not sniff(slice))
+        return Error::invalidData("invalid signature");
+
+    Decoder dec{slice};
+
+    auto s = dec.begin().skip(8);
+    while (true) {
+        if (s.rem() < 12)
+            return Error::invalidData("unexpected end of file");
+
+        usize len = s.nextU32be();
+        if (len > 0x7fffffff or s.rem() < len + 8)
+            return Error::invalidData("chunk length out of bounds");
+
+        Io::Crc32 crc;
+        crc.update(sub(s.remBytes(), 0, len + 4));
+
+        Str sig = s.nextStr(4);
+        Bytes data = s.nextBytes(len);
+        if (s.nextU32be() != crc.digest())
+            return Error::invalidData("chunk checksum mismatch");
+
+        if (not dec._ihdr.present() and sig != Ihdr::SIG)
+            return Error::invalidData("missing IHDR chunk");
+
+        if (sig == Ihdr::SIG) {
+            if (dec._ihdr.present() or len != 13)
+                return Error::invalidData("invalid IHDR chunk");
+            dec._ihdr = Ihdr{data};
+        } else if (sig == Plte::SIG) {
+            if (len == 0 or len % 3 != 0 or len > 256 * 3)
+                return Error::invalidData("invalid PLTE chunk");
+            dec._plte = Plte{data};
+        } else if (sig == Trns::SIG) {
+            dec._trns = Trns{data};
+        } else if (sig == Idat::SIG) {
+            dec._idats.pushBack(Idat{data});
+        } else if (sig == Iend::SIG) {
+            break;
+        } else if (not(sig[0] & 0x20)) {
+            // Ancillary chunks have a lowercase first letter and may be
+            // ignored, the others are needed to display the image.
+            return Error::invalidData("unknown critical chunk");
+        }
+    }
+
+    auto size = dec._ihdr.size();
+    if (size.x <= 0 or size.y <= 0 or size.x > MAX_SIZE or size.y > MAX_SIZE)
+        return Error::invalidData("invalid image size");
+
+    if (not _validDepth(dec.colorType(), dec.bitDepth()))
+        return Error::invalidData("invalid color type or bit depth");
+
+    if (dec._ihdr.compressionMethod() != 0 or dec._ihdr.filterMethod() != 0)
+        return Error::invalidData("unknown compression or filter method");
+
+    if (dec._ihdr.interlaceMethod() > 1)
+        return Error::invalidData("unknown interlace method");
+
+    if (dec.colorType() == ColorType::INDEXED and not dec._plte.present())
+        return Error::invalidData("missing PLTE chunk");
+
+    if (not dec._idats.len())
+        return Error::invalidData("missing IDAT chunk");
+
+    return Ok(dec);
+}
+
+// MARK: Image Data ------------------------------------------------------------
+
+// Reads the IDAT chunks back to back as a single zlib stream.
+struct IdatReader : public Io::Reader {
+    Slice<Idat> _idats;
+    usize _chunk = 0;
+    usize _off = 0;
+
+    IdatReader(Slice<Idat> idats)
+        : _idats(idats) {}
+
+    Res<usize> read(MutBytes bytes) override {
+        while (_chunk < _idats.len()) {
+            auto data = _idats[_chunk].bytes();
+            if (_off == data.len()) {
+                _chunk++;
+                _off = 0;
+                continue;
+            }
+
+            usize n = min(bytes.len(), data.len() - _off);
+            memcpy(bytes.buf(), data.buf() + _off, n);
+            _off += n;
+            return Ok(n);
+        }
+        return Ok(0uz);
+    }
+};
+
+static Res<> _readExact(Io::Reader &reader, MutBytes bytes) {
+    while (bytes.len()) {
+        auto n = try$(reader.read(bytes));
+        if (n == 0)
+            return Error::invalidData("unexpected end of image data");
+        bytes = mutNext(bytes, n);
+    }
+    return Ok();
+}
+
+// MARK: Filters ---------------------------------------------------------------
+
+// Rows are stored after a few zero bytes so the bytes of the pixel left of
+// the first one read as zero, like the filters expect.
+static constexpr usize PAD = 8;
+
+static void _unfilterUp(u8 *row, u8 const *prior, usize len) {
+    usize i = 0;
+    for (; i + 16 <= len; i += 16) {
+        u8x16 x, b;
+        memcpy(&x, row + i, 16);
+        memcpy(&b, prior + i, 16);
+        x += b;
+        memcpy(row + i, &x, 16);
+    }
+
+    for (; i < len; i++)
+        row[i] += prior[i];
+}
+
+template <usize BPP>
+always_inline static i16x8 _loadPixel(u8 const *p) {
+    u8x8 v{};
+    memcpy(&v, p, BPP);
+    return __builtin_convertvector(v, i16x8);
+}
+
+template <usize BPP>
+always_inline static void _storePixel(u8 *p, i16x8 v) {
+    u8x8 b = __builtin_convertvector(v, u8x8);
+    memcpy(p, &b, BPP);
+}
+
+always_inline static i16x8 _abs(i16x8 v) {
+    i16x8 sign = v >> 15;
+    return (v ^ sign) - sign;
+}
+
+// Sub, Average and Paeth depend on the pixel just decoded, so the bytes of
+// a pixel are decoded together in the lanes of one vector.
+template <usize BPP>
+static void _unfilterPixels(Filter filter, u8 *row, u8 const *prior, usize len) {
+    i16x8 a{};
+    i16x8 c{};
+
+    switch (filter) {
+    case Filter::SUB:
+        for (usize i = 0; i < len; i += BPP) {
+            a = (_loadPixel<BPP>(row + i) + a) & 0xff;
+            _storePixel<BPP>(row + i, a);
+        }
+        break;
+
+    case Filter::AVERAGE:
+        for (usize i = 0; i < len; i += BPP) {
+            i16x8 b = _loadPixel<BPP>(prior + i);
+            a = (_loadPixel<BPP>(row + i) + ((a + b) >> 1)) & 0xff;
+            _storePixel<BPP>(row + i, a);
+        }
+        break;
+
+    case Filter::PAETH:
+        for (usize i = 0; i < len; i += BPP) {
+            i16x8 b = _loadPixel<BPP>(prior + i);
+            i16x8 pa = _abs(b - c);
+            i16x8 pb = _abs(a - c);
+            i16x8 pc = _abs(a + b - c - c);
+
+            i16x8 useA = (pa <= pb) & (pa <= pc);
+            i16x8 useB = ~useA & (pb <= pc);
+            i16x8 useC = ~(useA | useB);
+            i16x8 pred = (a & useA) | (b & useB) | (c & useC);
+
+            a = (_loadPixel<BPP>(row + i) + pred) & 0xff;
+            _storePixel<BPP>(row + i, a);
+            c = b;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+static u8 _paeth(u8 a, u8 b, u8 c) {
+    isize p = (isize)a + b - c;
+    isize pa = Math::abs(p - a);
+    isize pb = Math::abs(p - b);
+    isize pc = Math::abs(p - c);
+    if (pa <= pb and pa <= pc)
+        return a;
+    if (pb <= pc)
+        return b;
+    return c;
+}
+
+static void _unfilterBytes(Filter filter, u8 *row, u8 const *prior, usize len, usize bpp) {
+    switch (filter) {
+    case Filter::SUB:
+        for (usize i = 0; i < len; i++)
+            row[i] += row[i - bpp];
+        break;
+
+    case Filter::AVERAGE:
+        for (usize i = 0; i < len; i++)
+            row[i] += (row[i - bpp] + prior[i]) >> 1;
+        break;
+
+    case Filter::PAETH:
+        for (usize i = 0; i < len; i++)
+            row[i] += _paeth(row[i - bpp], prior[i], prior[i - bpp]);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static Res<> _unfilter(u8 type, u8 *row, u8 const *prior, usize len, usize bpp) {
+    if (type > toUnderlyingType(Filter::PAETH))
+        return Error::invalidData("invalid filter type");
+
+    Filter filter{type};
+    if (filter == Filter::NONE)
+        return Ok();
+
+    if (filter == Filter::UP) {
+        _unfilterUp(row, prior, len);
+        return Ok();
+    }
+
+    switch (bpp) {
+    case 3:
+        _unfilterPixels<3>(filter, row, prior, len);
+        break;
+    case 4:
+        _unfilterPixels<4>(filter, row, prior, len);
+        break;
+    case 6:
+        _unfilterPixels<6>(filter, row, prior, len);
+        break;
+    case 8:
+        _unfilterPixels<8>(filter, row, prior, len);
+        break;
+    default:
+        _unfilterBytes(filter, row, prior, len, bpp);
+        break;
+    }
+
+    return Ok();
+}
+
+// MARK: Color Conversion ------------------------------------------------------
+
+struct _Pass {
+    isize x;
+    isize y;
+    isize dx;
+    isize dy;
+};
+
+static constexpr Array<_Pass, 7> ADAM7 = {
+    _Pass{0, 0, 8, 8},
+    _Pass{4, 0, 8, 8},
+    _Pass{0, 4, 4, 8},
+    _Pass{2, 0, 4, 4},
+    _Pass{0, 2, 2, 4},
+    _Pass{1, 0, 2, 2},
+    _Pass{0, 1, 1, 2},
+};
+
+static constexpr Array<_Pass, 1> SEQUENTIAL = {
+    _Pass{0, 0, 1, 1},
+};
+
+struct _Converter {
+    ColorType type;
+    u8 depth;
+    usize channels;
+    Array<Gfx::Color, 256> palette;
+    bool keyed = false;
+    Array<u16, 3> key{};
+
+    always_inline u16 sample(u8 const *row, usize i) const {
+        if (depth == 8)
+            return row[i];
+        if (depth == 16)
+            return row[i * 2] << 8 | row[i * 2 + 1];
+        usize bit = i * depth;
+        return (row[bit / 8] >> (8 - depth - bit % 8)) & ((1 << depth) - 1);
+    }
+
+    always_inline u8 scale(u16 v) const {
+        if (depth == 16)
+            return v >> 8;
+        if (depth == 8)
+            return v;
+        return v * (255 / ((1 << depth) - 1));
+    }
+
+    Gfx::Color load(u8 const *row, usize x) const {
+        usize i = x * channels;
+        switch (type) {
+        case ColorType::GRAY: {
+            u16 g = sample(row, i);
+            u8 v = scale(g);
+            return Gfx::Color::fromRgba(v, v, v, keyed and g == key[0] ? 0 : 255);
+        }
+
+        case ColorType::RGB: {
+            u16 r = sample(row, i);
+            u16 g = sample(row, i + 1);
+            u16 b = sample(row, i + 2);
+            bool transparent = keyed and r == key[0] and g == key[1] and b == key[2];
+            return Gfx::Color::fromRgba(scale(r), scale(g), scale(b), transparent ? 0 : 255);
+        }
+
+        case ColorType::INDEXED:
+            return palette[sample(row, i)];
+
+        case ColorType::GRAY_ALPHA: {
+            u8 v = scale(sample(row, i));
+            return Gfx::Color::fromRgba(v, v, v, scale(sample(row, i + 1)));
+        }
+
+        case ColorType::RGBA:
+            return Gfx::Color::fromRgba(
+                scale(sample(row, i)),
+                scale(sample(row, i + 1)),
+                scale(sample(row, i + 2)),
+                scale(sample(row, i + 3))
+            );
+        }
+
+        return Gfx::BLACK;
+    }
+
+    // Eight bit images without a color key are copied straight into RGBA
+    // scanlines, everything else goes through Color.
+    bool storeFast(u8 const *row, usize width, u8 *out) const {
+        if (depth != 8 or keyed)
+            return false;
+
+        switch (type) {
+        case ColorType::RGBA:
+            memcpy(out, row, width * 4);
+            return true;
+
+        case ColorType::RGB:
+            for (usize x = 0; x < width; x++) {
+                out[x * 4 + 0] = row[x * 3 + 0];
+                out[x * 4 + 1] = row[x * 3 + 1];
+                out[x * 4 + 2] = row[x * 3 + 2];
+                out[x * 4 + 3] = 255;
+            }
+            return true;
+
+        case ColorType::GRAY:
+            for (usize x = 0; x < width; x++) {
+                u8 v = row[x];
+                out[x * 4 + 0] = v;
+                out[x * 4 + 1] = v;
+                out[x * 4 + 2] = v;
+                out[x * 4 + 3] = 255;
+            }
+            return true;
+
+        case ColorType::INDEXED:
+            for (usize x = 0; x < width; x++)
+                Gfx::RGBA8888.store(out + x * 4, palette[row[x]]);
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    void store(u8 const *row, usize width, Gfx::MutPixels dest, isize y, _Pass pass) const {
+        if (pass.dx == 1 and dest.fmt().is<Gfx::Rgba8888>() and
+            storeFast(row, width, static_cast<u8 *>(dest.scanline(y))))
+            return;
+
+        for (usize x = 0; x < width; x++)
+            dest.storeUnsafe({pass.x + (isize)x * pass.dx, y}, load(row, x));
+    }
+};
+
+// MARK: Decoding --------------------------------------------------------------
+
+Res<> Decoder::decode(Gfx::MutPixels dest) {
+    if (dest.width() < width() or dest.height() < height())
+        return Error::invalidInput("destination is too small");
+
+    _Converter conv{
+        .type = colorType(),
+        .depth = bitDepth(),
+        .channels = channels(),
+        .palette = {},
+    };
+
+    for (auto &c : conv.palette)
+        c = Gfx::BLACK;
+
+    auto plte = _plte.bytes();
+    for (usize i = 0; i < plte.len() / 3; i++)
+        conv.palette[i] = Gfx::Color::fromRgba(plte[i * 3], plte[i * 3 + 1], plte[i * 3 + 2], 255);
+
+    auto trns = _trns.bytes();
+    if (conv.type == ColorType::INDEXED) {
+        for (usize i = 0; i < min(trns.len(), 256uz); i++)
+            conv.palette[i].alpha = trns[i];
+    } else if (conv.type == ColorType::GRAY and trns.len() >= 2) {
+        conv.keyed = true;
+        conv.key[0] = trns[0] << 8 | trns[1];
+    } else if (conv.type == ColorType::RGB and trns.len() >= 6) {
+        conv.keyed = true;
+        for (usize i = 0; i < 3; i++)
+            conv.key[i] = trns[i * 2] << 8 | trns[i * 2 + 1];
+    }
+
+    IdatReader idats{_idats};
+    Io::Inflate inflate{idats};
+
+    usize bpp = filterBpp();
+    usize capacity = PAD + rowBytes(width()) + 16;
+    Vec<u8> rowBuf;
+    rowBuf.resize(capacity, 0);
+    Vec<u8> priorBuf;
+    priorBuf.resize(capacity, 0);
+    u8 *row = rowBuf.buf() + PAD;
+    u8 *prior = priorBuf.buf() + PAD;
+
+    Slice<_Pass> passes = interlaced() ? Slice<_Pass>{ADAM7} : Slice<_Pass>{SEQUENTIAL};
+    for (auto pass : passes) {
+        usize pw = (width() - pass.x + pass.dx - 1) / pass.dx;
+        usize ph = (height() - pass.y + pass.dy - 1) / pass.dy;
+        if (pw == 0 or ph == 0)
+            continue;
+
+        usize len = rowBytes(pw);
+        memset(prior, 0, len);
+
+        for (usize j = 0; j < ph; j++) {
+            // The filter type byte goes in the padding and is cleared after
+            try$(_readExact(inflate, {row - 1, len + 1}));
+            u8 filter = row[-1];
+            row[-1] = 0;
+
+            try$(_unfilter(filter, row, prior, len, bpp));
+            conv.store(row, pw, dest, pass.y + j * pass.dy, pass);
+            std::swap(row, prior);
+        }
+    }
+
+    return Ok();
+}
+
+} // namespace Png
@@ -1,9 +1,14 @@
 #pragma once
 
+// PNG image decoder
+// References:
+//  - https://www.w3.org/TR/png/
+//  - http://www.schaik.com/pngsuite/
+
 #include <karm-base/string.h>
-#include <karm-gfx/canvas.h>
+#include <karm-base/vec.h>
+#include <karm-gfx/buffer.h>
 #include <karm-io/bscan.h>
-#include <karm-logger/logger.h>
 
 namespace Png {
 
@@ -43,6 +48,10 @@ struct Plte : public Io::BChunk {
     static constexpr Str SIG = "PLTE";
 };
 
+struct Trns : public Io::BChunk {
+    static constexpr Str SIG = "tRNS";
+};
+
 struct Idat : public Io::BChunk {
     static constexpr Str SIG = "IDAT";
 };
@@ -51,6 +60,22 @@ struct Iend : public Io::BChunk {
     static constexpr Str SIG = "IEND";
 };
 
+enum struct ColorType : u8 {
+    GRAY = 0,
+    RGB = 2,
+    INDEXED = 3,
+    GRAY_ALPHA = 4,
+    RGBA = 6,
+};
+
+enum struct Filter : u8 {
+    NONE = 0,
+    SUB = 1,
+    UP = 2,
+    AVERAGE = 3,
+    PAETH = 4,
+};
+
 struct Decoder {
     static constexpr Array<u8, 8> SIG = {
         0x89, 0x50, 0x4E, 0x47,
@@ -61,7 +86,11 @@ struct Decoder {
 
     Ihdr _ihdr;
     Plte _plte;
-    Idat _idat;
+    Trns _trns;
+
+    // The image data may be split across any number of chunks, they
+    // form a single zlib stream once concatenated.
+    Vec<Idat> _idats;
 
     Bytes sig() {
         return begin().nextBytes(8);
@@ -71,18 +100,7 @@ struct Decoder {
         return slice.len() >= 8 and sub(slice, 0, 8) == SIG;
     }
 
-    static Res<Decoder> init(Bytes slice) {
-        Decoder dec{slice};
-
-        if (dec.sig() == SIG)
-            return Error::invalidData("invalid signature");
-
-        dec._ihdr = dec.lookupChunk<Ihdr>();
-        dec._plte = dec.lookupChunk<Plte>();
-        dec._idat = dec.lookupChunk<Idat>();
-
-        return Ok(dec);
-    }
+    static Res<Decoder> init(Bytes slice);
 
     Decoder(Bytes slice)
         : _slice(slice) {}
@@ -91,56 +109,52 @@ struct Decoder {
         return _slice;
     }
 
-    auto iterChunks() {
-        auto s = begin();
-        s.skip(8);
-
-        struct Chunk {
-            Str sig;
-            usize len;
-            Bytes data;
-            u32 crc32;
-        };
+    isize width() {
+        return _ihdr.size().x;
+    }
 
-        return Iter{[s] mutable -> Opt<Chunk> {
-            Chunk c;
+    isize height() {
+        return _ihdr.size().y;
+    }
 
-            c.len = s.nextI32be();
-            c.sig = s.nextStr(4);
-            c.data = s.nextBytes(c.len);
-            c.crc32 = s.nextI32be();
+    ColorType colorType() {
+        return ColorType{_ihdr.colorType()};
+    }
 
-            if (c.sig == Iend::SIG) {
-                return NONE;
-            }
+    u8 bitDepth() {
+        return _ihdr.bitDepth();
+    }
 
-            return c;
-        }};
+    bool interlaced() {
+        return _ihdr.interlaceMethod() == 1;
     }
 
-    template <typename T>
-    T lookupChunk() {
-        for (auto chunk : iterChunks()) {
-            if (chunk.sig == T::SIG) {
-                return T{chunk.data};
-            }
+    usize channels() {
+        switch (colorType()) {
+        case ColorType::GRAY:
+        case ColorType::INDEXED:
+            return 1;
+        case ColorType::GRAY_ALPHA:
+            return 2;
+        case ColorType::RGB:
+            return 3;
+        case ColorType::RGBA:
+            return 4;
         }
-
-        logWarn("png: '{}' chunk not found", T::SIG);
-        return T{};
+        return 0;
     }
 
-    isize width() {
-        return _ihdr.size().x;
+    // Distance in bytes between a byte and the one of the previous pixel
+    // it's filtered against, at least one for sub-byte depths.
+    usize filterBpp() {
+        return max(channels() * bitDepth() / 8, 1uz);
     }
 
-    isize height() {
-        return _ihdr.size().y;
+    usize rowBytes(usize width) {
+        return (width * channels() * bitDepth() + 7) / 8;
     }
 
-    Res<> decode(Gfx::MutPixels) {
-        return Ok();
-    }
+    Res<> decode(Gfx::MutPixels dest);
 };
 
 } // namespace Png
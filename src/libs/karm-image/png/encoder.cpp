@@ -0,0 +1,193 @@
+#include <karm-base/limits.h>
+#include <karm-io/inflate.h>
+
+#include "encoder.h"
+
+namespace Png {
+
+// MARK: Chunks ----------------------------------------------------------------
+
+Res<> writeChunk(Io::Writer &writer, Str type, Bytes data) {
+    u32 len = data.len();
+    Array<u8, 8> header = {
+        (u8)(len >> 24), (u8)(len >> 16), (u8)(len >> 8), (u8)len,
+        (u8)type[0], (u8)type[1], (u8)type[2], (u8)type[3]
+    };
+
+    Io::Crc32 crc;
+    crc.update(sub(header, 4, 8));
+    crc.update(data);
+    u32 digest = crc.digest();
+    Array<u8, 4> trailer = {
+        (u8)(digest >> 24), (u8)(digest >> 16), (u8)(digest >> 8), (u8)digest
+    };
+
+    try$(writer.write(header));
+    if (data.len())
+        try$(writer.write(data));
+    try$(writer.write(trailer));
+    return Ok();
+}
+
+Res<usize> Encoder::_Idat::write(Bytes bytes) {
+    if (bytes.len())
+        try$(writeChunk(_writer, Idat::SIG, bytes));
+    return Ok(bytes.len());
+}
+
+// MARK: Filtering -------------------------------------------------------------
+
+static u8 _paeth(u8 a, u8 b, u8 c) {
+    isize p = (isize)a + b - c;
+    isize pa = Math::abs(p - a);
+    isize pb = Math::abs(p - b);
+    isize pc = Math::abs(p - c);
+    if (pa <= pb and pa <= pc)
+        return a;
+    if (pb <= pc)
+        return b;
+    return c;
+}
+
+static void _filter(Filter filter, u8 *out, u8 const *row, u8 const *prior, usize len, usize bpp) {
+    out[0] = toUnderlyingType(filter);
+    out++;
+
+    switch (filter) {
+    case Filter::NONE:
+        memcpy(out, row, len);
+        break;
+
+    case Filter::SUB:
+        for (usize i = 0; i < bpp; i++)
+            out[i] = row[i];
+        for (usize i = bpp; i < len; i++)
+            out[i] = row[i] - row[i - bpp];
+        break;
+
+    case Filter::UP:
+        for (usize i = 0; i < len; i++)
+            out[i] = row[i] - prior[i];
+        break;
+
+    case Filter::AVERAGE:
+        for (usize i = 0; i < bpp; i++)
+            out[i] = row[i] - (prior[i] >> 1);
+        for (usize i = bpp; i < len; i++)
+            out[i] = row[i] - ((row[i - bpp] + prior[i]) >> 1);
+        break;
+
+    case Filter::PAETH:
+        for (usize i = 0; i < bpp; i++)
+            out[i] = row[i] - prior[i];
+        for (usize i = bpp; i < len; i++)
+            out[i] = row[i] - _paeth(row[i - bpp], prior[i], prior[i - bpp]);
+        break;
+    }
+}
+
+// Bytes read as signed, a cheap estimate of how well the row compresses
+static usize _cost(u8 const *filtered, usize len) {
+    usize sum = 0;
+    for (usize i = 0; i < len; i++)
+        sum += Math::abs((i8)filtered[i]);
+    return sum;
+}
+
+// MARK: Encoder ---------------------------------------------------------------
+
+Encoder::Encoder(Io::Writer &writer, Math::Vec2i size, bool alpha, usize level)
+    : _writer(writer),
+      _size(size),
+      _alpha(alpha),
+      _level(min(level, Io::Deflate::MAX_LEVEL)),
+      _idat(writer),
+      _deflate(_idat, _level) {
+    _prior.resize(rowBytes());
+    _row.resize(rowBytes());
+    _filtered.resize((rowBytes() + 1) * 5);
+}
+
+Res<> Encoder::_begin() {
+    if (_started)
+        return Ok();
+    _started = true;
+
+    try$(_writer.write(Decoder::SIG));
+
+    u32 w = _size.x, h = _size.y;
+    Array<u8, 13> ihdr = {
+        (u8)(w >> 24), (u8)(w >> 16), (u8)(w >> 8), (u8)w,
+        (u8)(h >> 24), (u8)(h >> 16), (u8)(h >> 8), (u8)h,
+        8, // bit depth
+        toUnderlyingType(_alpha ? ColorType::RGBA : ColorType::RGB),
+        0, // compression method
+        0, // filter method
+        0, // interlace method
+    };
+    return writeChunk(_writer, Ihdr::SIG, ihdr);
+}
+
+Res<> Encoder::writeRows(Gfx::Pixels rows) {
+    if (rows.width() != _size.x or _rows + rows.height() > _size.y)
+        return Error::invalidInput("rows don't fit the image");
+
+    try$(_begin());
+
+    usize len = rowBytes();
+    usize bpp = channels();
+    usize r = 0, b = 2;
+    if (rows.fmt().is<Gfx::Bgra8888>())
+        std::swap(r, b);
+
+    for (isize y = 0; y < rows.height(); y++) {
+        u8 const *src = static_cast<u8 const *>(rows.scanline(y));
+        u8 *row = _row.buf();
+        if (_alpha and r == 0) {
+            memcpy(row, src, len);
+        } else {
+            for (isize x = 0; x < _size.x; x++, src += 4, row += bpp) {
+                row[0] = src[r];
+                row[1] = src[1];
+                row[2] = src[b];
+                if (_alpha)
+                    row[3] = src[3];
+            }
+        }
+
+        u8 *out = _filtered.buf();
+        if (_level == 0) {
+            _filter(Filter::NONE, out, _row.buf(), _prior.buf(), len, bpp);
+        } else if (_level <= 3) {
+            _filter(Filter::SUB, out, _row.buf(), _prior.buf(), len, bpp);
+        } else {
+            usize best = Limits<usize>::MAX;
+            for (u8 f = 0; f <= toUnderlyingType(Filter::PAETH); f++) {
+                u8 *candidate = _filtered.buf() + f * (len + 1);
+                _filter(Filter{f}, candidate, _row.buf(), _prior.buf(), len, bpp);
+                usize cost = _cost(candidate + 1, len);
+                if (cost < best) {
+                    best = cost;
+                    out = candidate;
+                }
+            }
+        }
+
+        try$(_deflate.write({out, len + 1}));
+        std::swap(_prior, _row);
+        _rows++;
+    }
+
+    return Ok();
+}
+
+Res<> Encoder::finish() {
+    if (_rows != _size.y)
+        return Error::invalidInput("missing rows");
+
+    try$(_begin());
+    try$(_deflate.finish());
+    return writeChunk(_writer, Iend::SIG, {});
+}
+
+} // namespace Png
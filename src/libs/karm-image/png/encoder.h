@@ -0,0 +1,68 @@
+#pragma once
+
+// PNG image encoder
+// References:
+//  - https://www.w3.org/TR/png/
+
+#include <karm-base/vec.h>
+#include <karm-gfx/buffer.h>
+#include <karm-io/deflate.h>
+
+#include "decoder.h"
+
+namespace Png {
+
+// Rows are filtered and compressed as they are written, the compressed
+// stream goes out in IDAT chunks as soon as the deflate blocks are done, so
+// an image can be encoded a band at a time without keeping it whole.
+//
+// The level is the deflate one, from 0 (stored) to 6. Rows are left
+// unfiltered at level 0, get the Sub filter up to level 3, which turns the
+// flat areas of screenshots into runs of zeros, and the filter with the
+// smallest sum of absolute differences from level 4.
+struct Encoder {
+    struct _Idat : public Io::Writer {
+        Io::Writer &_writer;
+
+        _Idat(Io::Writer &writer)
+            : _writer(writer) {}
+
+        Res<usize> write(Bytes bytes) override;
+    };
+
+    Io::Writer &_writer;
+    Math::Vec2i _size;
+    bool _alpha;
+    usize _level;
+
+    _Idat _idat;
+    Io::Deflate _deflate;
+
+    bool _started = false;
+    isize _rows = 0;
+
+    Vec<u8> _prior;
+    Vec<u8> _row;
+    Vec<u8> _filtered; //< A filter byte and the filtered row, for each filter
+
+    Encoder(Io::Writer &writer, Math::Vec2i size, bool alpha = true, usize level = 6);
+
+    usize channels() const {
+        return _alpha ? 4 : 3;
+    }
+
+    usize rowBytes() const {
+        return _size.x * channels();
+    }
+
+    // Encode the next rows of the image, top to bottom
+    Res<> writeRows(Gfx::Pixels rows);
+
+    Res<> finish();
+
+    Res<> _begin();
+};
+
+Res<> writeChunk(Io::Writer &writer, Str type, Bytes data);
+
+} // namespace Png
@@ -0,0 +1,172 @@
+#include <karm-image/loader.h>
+#include <karm-image/png/decoder.h>
+#include <karm-io/fmt.h>
+#include <karm-io/inflate.h>
+#include <karm-test/macros.h>
+
+namespace Png::Tests {
+
+static Mime::Url _suite(Str name) {
+    return "bundle://karm-image.png.tests/pngsuite"_url / name;
+}
+
+struct {
+    Str name;
+    Math::Vec2i pos;
+    Gfx::Color color;
+} PIXELS[] = {
+    {"basn0g01.png", {0, 0}, Gfx::Color::fromRgba(255, 255, 255, 255)},
+    {"basn0g01.png", {31, 31}, Gfx::Color::fromRgba(0, 0, 0, 255)},
+    {"basi0g04.png", {20, 9}, Gfx::Color::fromRgba(119, 119, 119, 255)},
+    {"basi2c08.png", {17, 5}, Gfx::Color::fromRgba(255, 255, 78, 255)},
+    {"basn2c16.png", {10, 20}, Gfx::Color::fromRgba(173, 90, 0, 255)},
+    {"basn3p04.png", {30, 12}, Gfx::Color::fromRgba(0, 68, 255, 255)},
+    {"basn4a08.png", {5, 5}, Gfx::Color::fromRgba(213, 213, 213, 41)},
+    {"basi6a16.png", {13, 29}, Gfx::Color::fromRgba(151, 0, 104, 33)},
+    {"tbrn2c08.png", {0, 0}, Gfx::Color::fromRgba(255, 255, 255, 0)},
+    {"tbbn3p08.png", {0, 0}, Gfx::Color::fromRgba(255, 255, 255, 0)},
+    {"tbbn3p08.png", {16, 16}, Gfx::Color::fromRgba(158, 158, 158, 255)},
+    {"s05i3p02.png", {4, 4}, Gfx::Color::fromRgba(255, 0, 0, 255)},
+};
+
+test$("png-pixels") {
+    for (auto const &[name, pos, color] : PIXELS) {
+        auto image = try$(Image::load(_suite(name)));
+        expectEq$(image.pixels().load(pos), color);
+    }
+
+    return Ok();
+}
+
+test$("png-sizes") {
+    // Odd sizes leave some of the Adam7 passes empty
+    for (isize size = 1; size <= 9; size++) {
+        for (Str mode : {"n"s, "i"s}) {
+            auto name = try$(Io::format("s0{}{}3p0{}.png", size, mode, size <= 4 ? 1 : 2));
+            auto image = try$(Image::load(_suite(name)));
+            expectEq$(image.width(), size);
+            expectEq$(image.height(), size);
+        }
+    }
+
+    return Ok();
+}
+
+test$("png-interlaced") {
+    // Interlaced images must decode to the same pixels as their
+    // sequential counterpart
+    Array const PAIRS = {
+        "0g01"s, "0g02"s, "0g04"s, "0g08"s, "0g16"s, "2c08"s, "2c16"s,
+        "3p01"s, "3p02"s, "3p04"s, "3p08"s, "4a08"s, "4a16"s, "6a08"s, "6a16"s,
+    };
+
+    for (auto pair : PAIRS) {
+        auto seq = try$(Image::load(_suite(try$(Io::format("basn{}.png", pair)))));
+        auto adam7 = try$(Image::load(_suite(try$(Io::format("basi{}.png", pair)))));
+        expectEq$(seq.pixels().bytes(), adam7.pixels().bytes());
+    }
+
+    return Ok();
+}
+
+test$("png-compression") {
+    // The same image at zlib levels 0 (stored blocks) to 9
+    auto ref = try$(Image::load(_suite("z00n2c08.png")));
+    for (Str name : {"z03n2c08.png"s, "z06n2c08.png"s, "z09n2c08.png"s}) {
+        auto image = try$(Image::load(_suite(name)));
+        expectEq$(image.pixels().bytes(), ref.pixels().bytes());
+    }
+
+    return Ok();
+}
+
+test$("png-scaled") {
+    // Formats that can't decode at a smaller size are box filtered down
+    auto full = try$(Image::load(_suite("basn2c08.png")));
+    auto half = try$(Image::load(_suite("basn2c08.png"), Image::Scale::HALF));
+    expectEq$(half.width(), 16);
+    expectEq$(half.height(), 16);
+
+    for (isize y = 0; y < half.height(); y++) {
+        for (isize x = 0; x < half.width(); x++) {
+            u32 red = 2, green = 2, blue = 2;
+            for (isize i = 0; i < 4; i++) {
+                auto c = full.pixels().load({x * 2 + i % 2, y * 2 + i / 2});
+                red += c.red;
+                green += c.green;
+                blue += c.blue;
+            }
+            expectEq$(half.pixels().load({x, y}), Gfx::Color::fromRgba(red / 4, green / 4, blue / 4, 255));
+        }
+    }
+
+    // Partial boxes on the edges are kept
+    auto quarter = try$(Image::load(_suite("s09n3p02.png"), Image::Scale::QUARTER));
+    expectEq$(quarter.width(), 3);
+    expectEq$(quarter.height(), 3);
+
+    return Ok();
+}
+
+test$("png-corrupted") {
+    Array const CORRUPTED = {
+        "xc1n0g08.png"s, // color type 1
+        "xc9n2c08.png"s, // color type 9
+        "xcrn0g04.png"s, // added cr bytes
+        "xcsn0g01.png"s, // incorrect IDAT checksum
+        "xd0n2c08.png"s, // bit depth 0
+        "xd3n2c08.png"s, // bit depth 3
+        "xd9n2c08.png"s, // bit depth 99
+        "xdtn0g01.png"s, // missing IDAT chunk
+        "xhdn0g08.png"s, // incorrect IHDR checksum
+        "xlfn0g04.png"s, // added lf bytes
+        "xs1n0g01.png"s, // signature byte 1 MSBit reset to zero
+        "xs2n0g01.png"s, // signature byte 2 is a 'Q'
+        "xs4n0g01.png"s, // signature byte 4 lowercase
+        "xs7n0g01.png"s, // 7th byte a space instead of control-Z
+    };
+
+    for (auto name : CORRUPTED)
+        expect$(not Image::load(_suite(name)));
+
+    return Ok();
+}
+
+static void _putU32(Vec<u8> &buf, u32 value) {
+    for (isize shift = 24; shift >= 0; shift -= 8)
+        buf.pushBack(value >> shift);
+}
+
+static void _putChunk(Vec<u8> &buf, Str type, Bytes data) {
+    _putU32(buf, data.len());
+    usize start = buf.len();
+    buf.insertMany(buf.len(), bytes(type));
+    buf.insertMany(buf.len(), data);
+
+    Io::Crc32 crc;
+    crc.update(sub(buf, start, buf.len()));
+    _putU32(buf, crc.digest());
+}
+
+test$("png-malformed-idat") {
+    // Chunks and checksums are fine, the deflate stream in IDAT is not
+    Vec<u8> png;
+    png.insertMany(0, Decoder::SIG);
+
+    // 1x1, 8-bit gray
+    Array<u8, 13> ihdr = {0, 0, 0, 1, 0, 0, 0, 1, 8, 0, 0, 0, 0};
+    _putChunk(png, "IHDR", ihdr);
+
+    // A dynamic block with 288 literal/length and 32 distance codes
+    Array<u8, 10> idat = {0x78, 0x01, 0xfd, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+    _putChunk(png, "IDAT", idat);
+    _putChunk(png, "IEND", {});
+
+    auto decoder = try$(Decoder::init(png));
+    auto image = Gfx::Surface::alloc({1, 1});
+    expect$(not decoder.decode(image->mutPixels()));
+
+    return Ok();
+}
+
+} // namespace Png::Tests
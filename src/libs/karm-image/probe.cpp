@@ -0,0 +1,250 @@
+#include <karm-sys/file.h>
+#include <karm-sys/mmap.h>
+
+#include "bmp/decoder.h"
+#include "jpeg/decoder.h"
+#include "png/decoder.h"
+#include "qoi/decoder.h"
+
+//
+#include "probe.h"
+
+namespace Karm::Image {
+
+// MARK: PNG -------------------------------------------------------------------
+
+static u8 _pngChannels(Png::ColorType type) {
+    switch (type) {
+    case Png::ColorType::GRAY:
+    case Png::ColorType::INDEXED:
+        return 1;
+    case Png::ColorType::GRAY_ALPHA:
+        return 2;
+    case Png::ColorType::RGB:
+        return 3;
+    case Png::ColorType::RGBA:
+        return 4;
+    }
+    return 0;
+}
+
+// Chunks are walked up to the image data, without checking their CRC, an
+// animation control chunk must come before it.
+static Res<Info> _probePng(Bytes bytes) {
+    Io::BScan s{bytes};
+    s.skip(8);
+
+    Opt<Png::Ihdr> ihdr;
+    bool animated = false;
+    while (s.rem() >= 8) {
+        usize len = s.nextU32be();
+        Str sig = s.nextStr(4);
+        if (s.rem() < len)
+            return Error::invalidData("chunk length out of bounds");
+
+        if (not ihdr and sig != Png::Ihdr::SIG)
+            return Error::invalidData("missing IHDR chunk");
+
+        if (sig == Png::Ihdr::SIG) {
+            if (len != 13)
+                return Error::invalidData("invalid IHDR chunk");
+            ihdr = Png::Ihdr{s.nextBytes(len)};
+        } else if (sig == "acTL"s) {
+            animated = true;
+            s.skip(len);
+        } else if (sig == Png::Idat::SIG or sig == Png::Iend::SIG) {
+            break;
+        } else {
+            s.skip(len);
+        }
+
+        s.skip(4); // crc
+    }
+
+    if (not ihdr)
+        return Error::invalidData("missing IHDR chunk");
+
+    auto size = ihdr->size();
+    if (size.x <= 0 or size.y <= 0)
+        return Error::invalidData("invalid image size");
+
+    return Ok(Info{
+        .format = Format::PNG,
+        .size = size,
+        .depth = ihdr->bitDepth(),
+        .channels = _pngChannels(Png::ColorType{ihdr->colorType()}),
+        .animated = animated,
+    });
+}
+
+// MARK: QOI -------------------------------------------------------------------
+
+static Res<Info> _probeQoi(Bytes bytes) {
+    auto qoi = try$(Qoi::Decoder::init(bytes));
+    return Ok(Info{
+        .format = Format::QOI,
+        .size = {qoi.width(), qoi.height()},
+        .depth = 8,
+        .channels = qoi.channels(),
+    });
+}
+
+// MARK: BMP -------------------------------------------------------------------
+
+static Res<Info> _probeBmp(Bytes bytes) {
+    Io::BScan s{bytes};
+    if (s.rem() < 54)
+        return Error::invalidData("image too small");
+
+    s.skip(14); // file header
+    if (s.nextU32le() < 40)
+        return Error::invalidData("invalid header size");
+
+    isize width = s.nextI32le();
+    isize height = s.nextI32le();
+    s.skip(2); // planes
+    u16 bpp = s.nextU16le();
+
+    // Rows stored bottom to top, or right to left, are flipped back by the
+    // decoder, their orientation is the one of the pixels it gives back.
+    Math::Vec2i size = {Math::abs(width), Math::abs(height)};
+    if (size.x == 0 or size.y == 0)
+        return Error::invalidData("invalid image size");
+
+    Info info{
+        .format = Format::BMP,
+        .size = size,
+        .depth = 8,
+        .channels = 3,
+    };
+
+    if (bpp <= 8) {
+        info.depth = bpp;
+        info.channels = 1;
+    } else if (bpp == 16) {
+        info.depth = 5;
+    } else if (bpp == 32) {
+        info.channels = 4;
+    } else if (bpp != 24) {
+        return Error::invalidData("invalid bpp");
+    }
+
+    return Ok(info);
+}
+
+// MARK: JPEG ------------------------------------------------------------------
+
+// The orientation tag of the first IFD of an EXIF segment, the TIFF header
+// tells the byte order of everything after it. Other APP1 segments, like
+// XMP, have none.
+static Opt<Orientation> _exifOrientation(Bytes exif) {
+    Io::BScan s{exif};
+    if (s.rem() < 14 or s.nextStr(4) != "Exif"s or s.nextU16be() != 0)
+        return NONE;
+
+    Bytes tiff = s.remBytes();
+    bool le = s.nextStr(2) == "II"s;
+    auto u16At = [&](Io::BScan &r) {
+        return le ? r.nextU16le() : r.nextU16be();
+    };
+    auto u32At = [&](Io::BScan &r) {
+        return le ? r.nextU32le() : r.nextU32be();
+    };
+
+    if (u16At(s) != 42)
+        return Orientation::NORMAL;
+
+    usize ifd = u32At(s);
+    if (ifd + 2 > tiff.len())
+        return Orientation::NORMAL;
+
+    Io::BScan entries{sub(tiff, ifd, tiff.len())};
+    usize count = u16At(entries);
+    for (usize i = 0; i < count and entries.rem() >= 12; i++) {
+        u16 tag = u16At(entries);
+        entries.skip(6); // type and count
+        u16 value = u16At(entries);
+        entries.skip(2);
+
+        if (tag == 0x0112 and value >= 1 and value <= 8)
+            return Orientation{(u8)value};
+    }
+
+    return Orientation::NORMAL;
+}
+
+// Markers are walked up to the start of the frame, EXIF segments come
+// before it.
+static Res<Info> _probeJpeg(Bytes bytes) {
+    Io::BScan s{bytes};
+    s.skip(2); // SOI
+
+    auto orientation = Orientation::NORMAL;
+    while (s.rem() >= 4) {
+        if (s.nextU8be() != 0xFF)
+            return Error::invalidData("invalid marker");
+
+        u8 marker = s.nextU8be();
+        while (marker == 0xFF and not s.ended())
+            marker = s.nextU8be(); // fill bytes
+
+        // Markers without a length
+        if (marker == Jpeg::TEM or (marker >= Jpeg::RST0 and marker <= Jpeg::EOI))
+            continue;
+
+        usize len = s.nextU16be();
+        if (len < 2 or s.rem() < len - 2)
+            return Error::invalidData("marker length out of bounds");
+        Io::BScan segment = s.nextBytes(len - 2);
+
+        if (marker == Jpeg::APP1) {
+            if (auto exif = _exifOrientation(segment.remBytes()))
+                orientation = *exif;
+        } else if (marker >= Jpeg::SOF0 and marker <= Jpeg::SOF15 and
+                   marker != Jpeg::DHT and marker != Jpeg::JPG and marker != Jpeg::DAC) {
+            if (segment.rem() < 6)
+                return Error::invalidData("invalid frame header");
+
+            u8 precision = segment.nextU8be();
+            isize height = segment.nextU16be();
+            isize width = segment.nextU16be();
+            u8 components = segment.nextU8be();
+            if (width == 0 or height == 0)
+                return Error::invalidData("invalid image size");
+
+            return Ok(Info{
+                .format = Format::JPEG,
+                .size = {width, height},
+                .depth = precision,
+                .channels = components,
+                .orientation = orientation,
+            });
+        } else if (marker == Jpeg::SOS) {
+            break;
+        }
+    }
+
+    return Error::invalidData("missing start of frame");
+}
+
+// MARK: Probing ---------------------------------------------------------------
+
+Res<Info> probe(Bytes bytes) {
+    if (Bmp::Decoder::sniff(bytes))
+        return _probeBmp(bytes);
+    else if (Qoi::Decoder::sniff(bytes))
+        return _probeQoi(bytes);
+    else if (Png::Decoder::sniff(bytes))
+        return _probePng(bytes);
+    else if (Jpeg::Decoder::sniff(bytes))
+        return _probeJpeg(bytes);
+    return Error::invalidData("unknown image format");
+}
+
+Res<Info> probe(Mime::Url url) {
+    auto file = try$(Sys::File::open(url));
+    auto map = try$(Sys::mmap().map(file));
+    return probe(map.bytes());
+}
+
+} // namespace Karm::Image
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <karm-mime/url.h>
+
+#include "picture.h"
+
+namespace Karm::Image {
+
+// How the stored pixels must be transformed to show the image upright, with
+// the values of the EXIF orientation tag
+enum struct Orientation : u8 {
+    NORMAL = 1,
+    FLIP_X = 2,
+    ROTATE_180 = 3,
+    FLIP_Y = 4,
+    TRANSPOSE = 5,
+    ROTATE_90 = 6,
+    TRANSVERSE = 7,
+    ROTATE_270 = 8,
+};
+
+struct Info {
+    Format format;
+    Math::Vec2i size;
+
+    u8 depth;    //< Bits per sample, as stored
+    u8 channels; //< Samples per pixel, palette indices count as one
+
+    Orientation orientation = Orientation::NORMAL;
+    bool animated = false;
+
+    // The size of the image once shown upright
+    Math::Vec2i displaySize() const {
+        if (orientation >= Orientation::TRANSPOSE)
+            return {size.y, size.x};
+        return size;
+    }
+};
+
+// Read what an image is without decoding it, only the headers in front of
+// the pixels are looked at, so sizes are known before the pixels are there.
+Res<Info> probe(Bytes bytes);
+
+// Only the pages holding the headers are read from the file
+Res<Info> probe(Mime::Url url);
+
+} // namespace Karm::Image
@@ -1,3 +1,5 @@
+#include <karm-base/simd.h>
+
 #include "decoder.h"
 
 namespace Qoi {
@@ -23,7 +25,121 @@ Karm::Res<Decoder> Decoder::init(Bytes slice) {
     return Ok(dec);
 }
 
+// MARK: Fast Path -------------------------------------------------------------
+
+template <bool BGRA>
+always_inline static u32 _pack(Gfx::Color c) {
+    if constexpr (BGRA)
+        c = {c.blue, c.green, c.red, c.alpha};
+    u32 px;
+    memcpy(&px, &c, sizeof(px));
+    return px;
+}
+
+always_inline static void _fill(u8 *out, u32 px, usize n) {
+    u32x4 v = {px, px, px, px};
+    usize i = 0;
+    for (; i + 4 <= n; i += 4)
+        memcpy(out + i * 4, &v, sizeof(v));
+    for (; i < n; i++)
+        memcpy(out + i * 4, &px, sizeof(px));
+}
+
+template <bool BGRA>
+static Res<> _decode(Decoder const &dec, Gfx::MutPixels dest) {
+    Bytes bytes = dec.bytes();
+    if (bytes.len() < 14 + Decoder::END.len())
+        return Error::invalidData("unexpected end of file");
+
+    // Operations are at most five bytes long, the eight bytes of the end
+    // marker make it safe to read one that starts before them in a go.
+    u8 const *p = bytes.buf() + 14;
+    u8 const *end = bytes.buf() + bytes.len() - Decoder::END.len();
+
+    Array<Gfx::Color, 64> index{};
+    Gfx::Color pixel = Gfx::BLACK;
+    u32 packed = _pack<BGRA>(pixel);
+    usize run = 0;
+
+    isize width = dec.width();
+    for (isize y = 0; y < dec.height(); y++) {
+        u8 *out = static_cast<u8 *>(dest.scanline(y));
+        isize x = 0;
+        while (x < width) {
+            if (run) {
+                usize n = min(run, (usize)(width - x));
+                _fill(out + x * 4, packed, n);
+                x += n;
+                run -= n;
+                continue;
+            }
+
+            if (p >= end)
+                return Error::invalidData("unexpected end of file");
+
+            u8 b1 = *p++;
+            if (b1 == Decoder::RGB) {
+                pixel.red = p[0];
+                pixel.green = p[1];
+                pixel.blue = p[2];
+                p += 3;
+            } else if (b1 == Decoder::RGBA) {
+                pixel.red = p[0];
+                pixel.green = p[1];
+                pixel.blue = p[2];
+                pixel.alpha = p[3];
+                p += 4;
+            } else if ((b1 & Decoder::MASK) == Decoder::INDEX) {
+                pixel = index[b1];
+            } else if ((b1 & Decoder::MASK) == Decoder::DIFF) {
+                pixel.red += ((b1 >> 4) & 0x03) - 2;
+                pixel.green += ((b1 >> 2) & 0x03) - 2;
+                pixel.blue += (b1 & 0x03) - 2;
+            } else if ((b1 & Decoder::MASK) == Decoder::LUMA) {
+                u8 b2 = *p++;
+                auto vg = (b1 & 0x3f) - 32;
+                pixel.red += vg - 8 + ((b2 >> 4) & 0x0f);
+                pixel.green += vg;
+                pixel.blue += vg - 8 + (b2 & 0x0f);
+            } else {
+                // Runs longer than 62 pixels are split by the encoder,
+                // they are joined back into a single fill.
+                run = (b1 & ~Decoder::MASK) + 1;
+                while (p < end and (*p & Decoder::MASK) == Decoder::RUN and *p < Decoder::RGB)
+                    run += (*p++ & ~Decoder::MASK) + 1;
+                index[Decoder::hash(pixel) % index.len()] = pixel;
+                continue;
+            }
+
+            index[Decoder::hash(pixel) % index.len()] = pixel;
+            packed = _pack<BGRA>(pixel);
+            memcpy(out + x * 4, &packed, sizeof(packed));
+            x++;
+        }
+    }
+
+    if (Bytes{p, Decoder::END.len()} != Decoder::END)
+        return Error::invalidData("missing end marker");
+
+    return Ok();
+}
+
 Res<> Decoder::decode(Gfx::MutPixels dest) {
+    if (dest.width() < width() or dest.height() < height())
+        return decodeGeneric(dest);
+
+    if (dest.fmt().is<Gfx::Bgra8888>())
+        return _decode<true>(*this, dest);
+
+    if (dest.fmt().is<Gfx::Rgba8888>())
+        return _decode<false>(*this, dest);
+
+    return decodeGeneric(dest);
+}
+
+// MARK: Generic ---------------------------------------------------------------
+
+Res<> Decoder::decodeGeneric(Gfx::MutPixels dest) {
     usize run = 0;
     Array<Gfx::Color, 64> index{};
     Gfx::Color pixel = Gfx::BLACK;
@@ -52,11 +52,17 @@ struct Decoder : public Io::BChunk {
         MASK = 0b11000000,
     };
 
-    usize hash(Gfx::Color c) {
+    static usize hash(Gfx::Color c) {
         return c.red * 3 + c.green * 5 + c.blue * 7 + c.alpha * 11;
     }
 
+    // Decode straight into the scanlines of the destination, in its own
+    // format, runs are filled a few pixels at a time
     [[gnu::flatten]] Res<> decode(Gfx::MutPixels dest);
+
+    // Decode a pixel at a time through the format of the destination, for
+    // destinations smaller than the image
+    [[gnu::flatten]] Res<> decodeGeneric(Gfx::MutPixels dest);
 };
 
 } // namespace Qoi
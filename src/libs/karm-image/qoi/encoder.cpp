@@ -0,0 +1,115 @@
+#include "encoder.h"
+
+namespace Qoi {
+
+Encoder::Encoder(Io::Writer &writer, Math::Vec2i size, bool alpha)
+    : _writer(writer),
+      _size(size),
+      _alpha(alpha) {
+    _out.resize(max(_rowMax(), 64 * 1024uz));
+}
+
+Res<> Encoder::_begin() {
+    if (_started)
+        return Ok();
+    _started = true;
+
+    u32 w = _size.x, h = _size.y;
+    for (auto b : Decoder::MAGIC)
+        _emit(b);
+    for (u32 v : {w, h})
+        for (usize i = 0; i < 4; i++)
+            _emit(v >> (24 - i * 8));
+    _emit(_alpha ? 4 : 3);
+    _emit(0); // sRGB with linear alpha
+    return Ok();
+}
+
+Res<> Encoder::_flush() {
+    try$(_writer.write(sub(_out, 0, _outLen)));
+    _outLen = 0;
+    return Ok();
+}
+
+void Encoder::_encode(Gfx::Color c) {
+    if (c == _prev) {
+        if (++_run == 62)
+            _endRun();
+        return;
+    }
+
+    _endRun();
+
+    usize i = Decoder::hash(c) % _index.len();
+    if (_index[i] == c) {
+        _emit(Decoder::INDEX | i);
+        _prev = c;
+        return;
+    }
+    _index[i] = c;
+
+    if (c.alpha != _prev.alpha) {
+        _emit(Decoder::RGBA);
+        _emit(c.red);
+        _emit(c.green);
+        _emit(c.blue);
+        _emit(c.alpha);
+        _prev = c;
+        return;
+    }
+
+    i8 vr = c.red - _prev.red;
+    i8 vg = c.green - _prev.green;
+    i8 vb = c.blue - _prev.blue;
+    i8 vgr = vr - vg;
+    i8 vgb = vb - vg;
+
+    if (vr >= -2 and vr <= 1 and vg >= -2 and vg <= 1 and vb >= -2 and vb <= 1) {
+        _emit(Decoder::DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+    } else if (vg >= -32 and vg <= 31 and vgr >= -8 and vgr <= 7 and vgb >= -8 and vgb <= 7) {
+        _emit(Decoder::LUMA | (vg + 32));
+        _emit((vgr + 8) << 4 | (vgb + 8));
+    } else {
+        _emit(Decoder::RGB);
+        _emit(c.red);
+        _emit(c.green);
+        _emit(c.blue);
+    }
+    _prev = c;
+}
+
+Res<> Encoder::writeRows(Gfx::Pixels rows) {
+    if (rows.width() != _size.x or _rows + rows.height() > _size.y)
+        return Error::invalidInput("rows don't fit the image");
+
+    try$(_begin());
+
+    usize r = 0, b = 2;
+    if (rows.fmt().is<Gfx::Bgra8888>())
+        std::swap(r, b);
+
+    for (isize y = 0; y < rows.height(); y++) {
+        if (_outLen + _rowMax() > _out.len())
+            try$(_flush());
+
+        u8 const *src = static_cast<u8 const *>(rows.scanline(y));
+        for (isize x = 0; x < _size.x; x++, src += 4)
+            _encode(Gfx::Color::fromRgba(src[r], src[1], src[b], _alpha ? src[3] : 255));
+        _rows++;
+    }
+
+    return _flush();
+}
+
+Res<> Encoder::finish() {
+    if (_rows != _size.y)
+        return Error::invalidInput("missing rows");
+
+    try$(_begin());
+    _endRun();
+    for (auto b : Decoder::END)
+        _emit(b);
+    return _flush();
+}
+
+} // namespace Qoi
@@ -0,0 +1,64 @@
+#pragma once
+
+// QOI image encoder
+// References:
+//  - https://qoiformat.org/qoi-specification.pdf
+
+#include <karm-base/vec.h>
+#include <karm-gfx/buffer.h>
+#include <karm-io/traits.h>
+
+#include "decoder.h"
+
+namespace Qoi {
+
+// Pixels go through the operations of the format in a single pass, the
+// index, the previous pixel and the pending run carry over from a row to
+// the next, so an image can be encoded a band at a time.
+struct Encoder {
+    Io::Writer &_writer;
+    Math::Vec2i _size;
+    bool _alpha;
+
+    bool _started = false;
+    isize _rows = 0;
+
+    Array<Gfx::Color, 64> _index{};
+    Gfx::Color _prev = Gfx::BLACK;
+    usize _run = 0;
+
+    Vec<u8> _out;
+    usize _outLen = 0;
+
+    Encoder(Io::Writer &writer, Math::Vec2i size, bool alpha = true);
+
+    // Encode the next rows of the image, top to bottom
+    Res<> writeRows(Gfx::Pixels rows);
+
+    Res<> finish();
+
+    // Enough for a row of pixels that all take the longest operation, and
+    // the header or the end marker
+    usize _rowMax() const {
+        return _size.x * 5 + 16;
+    }
+
+    Res<> _begin();
+
+    Res<> _flush();
+
+    always_inline void _emit(u8 byte) {
+        _out[_outLen++] = byte;
+    }
+
+    always_inline void _endRun() {
+        if (_run) {
+            _emit(Decoder::RUN | (_run - 1));
+            _run = 0;
+        }
+    }
+
+    void _encode(Gfx::Color c);
+};
+
+} // namespace Qoi
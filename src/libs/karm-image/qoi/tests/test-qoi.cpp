@@ -0,0 +1,71 @@
+#include <karm-image/loader.h>
+#include <karm-image/qoi/decoder.h>
+#include <karm-io/fmt.h>
+#include <karm-sys/file.h>
+#include <karm-sys/mmap.h>
+#include <karm-test/macros.h>
+
+namespace Qoi::Tests {
+
+static Mime::Url _res(Str name) {
+    return "bundle://karm-image.qoi.tests"_url / name;
+}
+
+static Array const NAMES = {
+    "dice"s, "kodim10"s, "kodim23"s, "qoi_logo"s,
+    "testcard"s, "testcard_rgba"s, "wikipedia_008"s
+};
+
+test$("qoi-reference") {
+    // Every image comes with the same pixels as a PNG
+    for (auto name : NAMES) {
+        auto ref = try$(Image::load(_res(try$(Io::format("{}.png", name)))));
+        auto image = try$(Image::load(_res(try$(Io::format("{}.qoi", name)))));
+        expectEq$(image.pixels().bytes(), ref.pixels().bytes());
+    }
+
+    return Ok();
+}
+
+test$("qoi-formats") {
+    // Decoding straight into BGRA scanlines or a pixel at a time gives the
+    // same colors
+    for (auto name : NAMES) {
+        auto file = try$(Sys::File::open(_res(try$(Io::format("{}.qoi", name)))));
+        auto map = try$(Sys::mmap().map(file));
+        auto qoi = try$(Decoder::init(map.bytes()));
+
+        auto rgba = Gfx::Surface::alloc({qoi.width(), qoi.height()});
+        try$(qoi.decode(*rgba));
+
+        auto generic = Gfx::Surface::alloc({qoi.width(), qoi.height()});
+        try$(qoi.decodeGeneric(*generic));
+        expectEq$(generic->pixels().bytes(), rgba->pixels().bytes());
+
+        auto bgra = Gfx::Surface::alloc({qoi.width(), qoi.height()}, Gfx::BGRA8888);
+        try$(qoi.decode(*bgra));
+        for (isize y = 0; y < qoi.height(); y++)
+            for (isize x = 0; x < qoi.width(); x++)
+                expectEq$(bgra->pixels().load({x, y}), rgba->pixels().load({x, y}));
+    }
+
+    return Ok();
+}
+
+test$("qoi-truncated") {
+    auto file = try$(Sys::File::open(_res("qoi_logo.qoi")));
+    auto map = try$(Sys::mmap().map(file));
+    auto bytes = map.bytes();
+
+    auto qoi = try$(Decoder::init(sub(bytes, 0, bytes.len() / 2)));
+    auto image = Gfx::Surface::alloc({qoi.width(), qoi.height()});
+    expect$(not qoi.decode(*image));
+
+    // Everything but the end marker
+    qoi = try$(Decoder::init(sub(bytes, 0, bytes.len() - 8)));
+    expect$(not qoi.decode(*image));
+
+    return Ok();
+}
+
+} // namespace Qoi::Tests
@@ -0,0 +1,70 @@
+#include <karm-sys/file.h>
+
+#include "bmp/encoder.h"
+#include "png/encoder.h"
+#include "qoi/encoder.h"
+
+//
+#include "saver.h"
+
+namespace Karm::Image {
+
+Res<Format> formatOf(Mime::Url const &url) {
+    auto suffix = url.path.suffix();
+    if (eqCi(suffix, "png"s))
+        return Ok(Format::PNG);
+    if (eqCi(suffix, "qoi"s))
+        return Ok(Format::QOI);
+    if (eqCi(suffix, "bmp"s))
+        return Ok(Format::BMP);
+    return Error::invalidInput("unsupported image format");
+}
+
+// Alpha is the last byte of a pixel in both RGBA and BGRA
+static bool _opaque(Gfx::Pixels pixels) {
+    for (isize y = 0; y < pixels.height(); y++) {
+        u8 const *row = static_cast<u8 const *>(pixels.scanline(y));
+        for (isize x = 0; x < pixels.width(); x++)
+            if (row[x * 4 + 3] != 255)
+                return false;
+    }
+    return true;
+}
+
+static Res<> _encode(auto &encoder, Gfx::Pixels pixels) {
+    try$(encoder.writeRows(pixels));
+    return encoder.finish();
+}
+
+Res<> save(Gfx::Pixels pixels, Io::Writer &writer, Saver const &saver) {
+    bool alpha = not _opaque(pixels);
+    switch (saver.format) {
+    case Format::PNG: {
+        Png::Encoder encoder{writer, pixels.size(), alpha, saver.level};
+        return _encode(encoder, pixels);
+    }
+
+    case Format::QOI: {
+        Qoi::Encoder encoder{writer, pixels.size(), alpha};
+        return _encode(encoder, pixels);
+    }
+
+    case Format::BMP: {
+        Bmp::Encoder encoder{writer, pixels.size(), alpha};
+        return _encode(encoder, pixels);
+    }
+
+    case Format::JPEG:
+        break;
+    }
+
+    return Error::invalidInput("unsupported image format");
+}
+
+Res<> save(Gfx::Pixels pixels, Mime::Url const &url, usize level) {
+    auto format = try$(formatOf(url));
+    auto file = try$(Sys::File::create(url));
+    return save(pixels, file, {format, level});
+}
+
+} // namespace Karm::Image
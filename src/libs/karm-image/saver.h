@@ -0,0 +1,27 @@
+#pragma once
+
+#include <karm-io/traits.h>
+#include <karm-mime/url.h>
+
+#include "picture.h"
+
+namespace Karm::Image {
+
+// The format to save an image in, from the suffix of its url, JPEG images
+// can only be loaded
+Res<Format> formatOf(Mime::Url const &url);
+
+struct Saver {
+    Format format = Format::PNG;
+
+    // How hard PNG images are compressed, from 0 (stored, the fastest) to 6,
+    // level 1 is a good fit for screenshots. QOI and BMP ignore it.
+    usize level = 6;
+};
+
+// Images without any transparency are saved without their alpha channel
+Res<> save(Gfx::Pixels pixels, Io::Writer &writer, Saver const &saver = {});
+
+Res<> save(Gfx::Pixels pixels, Mime::Url const &url, usize level = 6);
+
+} // namespace Karm::Image
@@ -0,0 +1,120 @@
+#include <karm-image/cache.h>
+#include <karm-test/macros.h>
+
+namespace Karm::Image::Tests {
+
+static Mime::Url _pngsuite(Str name) {
+    return "bundle://karm-image.png.tests/pngsuite"_url / name;
+}
+
+test$("image-cache-hits") {
+    auto &cache = globalCache();
+    cache.clear();
+    auto before = cache.stats();
+
+    auto first = try$(load(_pngsuite("basn2c08.png")));
+    auto second = try$(load(_pngsuite("basn2c08.png")));
+    expectEq$(cache.stats().misses, before.misses + 1);
+    expectEq$(cache.stats().hits, before.hits + 1);
+
+    // Both views share the same pixels
+    expectEq$(first.pixels().bytes().buf(), second.pixels().bytes().buf());
+
+    // Another scale is another picture
+    auto half = try$(load(_pngsuite("basn2c08.png"), Scale::HALF));
+    expectEq$(half.width(), 16);
+    expectEq$(cache.stats().misses, before.misses + 2);
+    expectEq$(cache.stats().entries, 2uz);
+
+    return Ok();
+}
+
+test$("image-cache-budget") {
+    Cache cache{3 * 64 * 64 * 4};
+
+    auto key = [](usize i) {
+        return Cache::Key{_pngsuite("basn2c08.png"), TimeStamp::epoch(), (Scale)(1 << i)};
+    };
+
+    for (usize i = 0; i < 4; i++)
+        cache.insert(key(i), Gfx::Surface::alloc({64, 64}));
+
+    // Pictures count for their pixels and a bit more, only two of them fit
+    expectEq$(cache.stats().entries, 2uz);
+    expectEq$(cache.stats().evictions, 2uz);
+    expect$(not cache.lookup(key(0)).has());
+    expect$(not cache.lookup(key(1)).has());
+    expect$(cache.lookup(key(3)).has());
+
+    cache.budget(0);
+    expectEq$(cache.stats().entries, 1uz);
+    expect$(cache.stats().bytes > 64 * 64 * 4);
+
+    cache.clear();
+    expectEq$(cache.stats().entries, 0uz);
+    expectEq$(cache.stats().bytes, 0uz);
+
+    return Ok();
+}
+
+testAsync$("image-load-async") {
+    globalCache().clear();
+
+    auto picture = co_trya$(loadAsync(_pngsuite("basn2c08.png")));
+    if (picture.width() != 32 or picture.height() != 32)
+        co_return Error::other("unexpected picture size");
+
+    // The picture decoded off the loop ends up in the cache
+    auto hits = globalCache().stats().hits;
+    auto cached = co_try$(load(_pngsuite("basn2c08.png")));
+    if (globalCache().stats().hits != hits + 1)
+        co_return Error::other("picture was not cached");
+
+    if (cached.pixels().bytes().buf() != picture.pixels().bytes().buf())
+        co_return Error::other("cached picture differs");
+
+    co_return Ok();
+}
+
+testAsync$("image-load-async-parallel") {
+    // Several pictures decoded side by side, each asked for twice so the
+    // second load waits on the first
+    Array const NAMES = {
+        "basn0g01.png"s,
+        "basn0g08.png"s,
+        "basn2c08.png"s,
+        "basn3p08.png"s,
+        "basn4a08.png"s,
+        "basn6a08.png"s,
+    };
+
+    for (usize round = 0; round < 8; round++) {
+        globalCache().clear();
+
+        usize pending = NAMES.len() * 2;
+        bool failed = false;
+        Async::Promise<> done;
+        auto future = done.future();
+
+        for (usize i = 0; i < pending; i++) {
+            Async::detach(
+                loadAsync(_pngsuite(NAMES[i % NAMES.len()])),
+                [&](Res<Picture> picture) {
+                    failed |= not picture or picture.unwrap().width() != 32;
+                    if (--pending == 0)
+                        done.resolve(Ok());
+                }
+            );
+        }
+        co_trya$(future);
+
+        if (failed)
+            co_return Error::other("picture was not decoded");
+        if (globalCache().stats().entries != NAMES.len())
+            co_return Error::other("pictures were not cached");
+    }
+
+    co_return Ok();
+}
+
+} // namespace Karm::Image::Tests
@@ -0,0 +1,87 @@
+#include <karm-image/probe.h>
+#include <karm-test/macros.h>
+
+namespace Karm::Image::Tests {
+
+static Mime::Url _res(Str name) {
+    return "bundle://karm-image.tests"_url / name;
+}
+
+static Mime::Url _pngsuite(Str name) {
+    return "bundle://karm-image.png.tests/pngsuite"_url / name;
+}
+
+static Mime::Url _bmpsuite(Str name) {
+    return "bundle://karm-image.bmp.tests/bmpsuite"_url / name;
+}
+
+test$("image-probe") {
+    struct {
+        Mime::Url url;
+        Format format;
+        Math::Vec2i size;
+        u8 depth;
+        u8 channels;
+    } INFOS[] = {
+        {_pngsuite("basn2c08.png"), Format::PNG, {32, 32}, 8, 3},
+        {_bmpsuite("valid/1bpp-1x1.bmp"), Format::BMP, {1, 1}, 1, 1},
+        {_res("small.qoi"), Format::QOI, {3, 2}, 8, 4},
+        {_res("rotated.jpg"), Format::JPEG, {33, 47}, 8, 3},
+    };
+
+    for (auto const &[url, format, size, depth, channels] : INFOS) {
+        auto info = try$(probe(url));
+        expect$(info.format == format);
+        expectEq$(info.size, size);
+        expectEq$(info.depth, depth);
+        expectEq$(info.channels, channels);
+        expect$(not info.animated);
+    }
+
+    return Ok();
+}
+
+test$("image-probe-orientation") {
+    // EXIF orientation 6, the image must be turned a quarter to the right
+    auto info = try$(probe(_res("rotated.jpg")));
+    expect$(info.orientation == Orientation::ROTATE_90);
+    expectEq$(info.displaySize(), Math::Vec2i{47, 33});
+
+    // An XMP segment after the EXIF one leaves the orientation alone
+    auto xmp = try$(probe(_res("rotated-xmp.jpg")));
+    expect$(xmp.orientation == Orientation::ROTATE_90);
+    expectEq$(xmp.displaySize(), Math::Vec2i{47, 33});
+
+    auto plain = try$(probe(_pngsuite("basn2c08.png")));
+    expect$(plain.orientation == Orientation::NORMAL);
+    expectEq$(plain.displaySize(), plain.size);
+
+    return Ok();
+}
+
+test$("image-probe-animated") {
+    auto info = try$(probe(_res("animated.png")));
+    expect$(info.animated);
+    expectEq$(info.size, Math::Vec2i{32, 32});
+
+    return Ok();
+}
+
+test$("image-probe-truncated") {
+    // Headers are all that's needed, the pixels can be missing
+    Array<u8, 33> png = {
+        0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00,
+        0x0d, 0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+        0x00, 0x80, 0x08, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    };
+    auto info = try$(probe(png));
+    expectEq$(info.size, Math::Vec2i{256, 128});
+    expectEq$(info.channels, 4);
+
+    expect$(not probe(sub(png, 0, 20)));
+    expect$(not probe(Bytes{}));
+
+    return Ok();
+}
+
+} // namespace Karm::Image::Tests
@@ -0,0 +1,110 @@
+#include <karm-image/bmp/decoder.h>
+#include <karm-image/png/decoder.h>
+#include <karm-image/qoi/decoder.h>
+#include <karm-image/saver.h>
+#include <karm-io/impls.h>
+#include <karm-test/macros.h>
+
+namespace Karm::Image::Tests {
+
+// Gradients, flat areas and a few noisy pixels, so every operation of the
+// encoders gets some use
+static Strong<Gfx::Surface> _synth(Math::Vec2i size, bool alpha, Gfx::Fmt fmt = Gfx::RGBA8888) {
+    auto img = Gfx::Surface::alloc(size, fmt);
+    u32 seed = 0x12345678;
+    for (isize y = 0; y < size.y; y++) {
+        for (isize x = 0; x < size.x; x++) {
+            seed = seed * 1103515245 + 12345;
+            u8 noise = seed >> 24;
+            auto color = Gfx::Color::fromRgba(
+                x * 255 / size.x,
+                x < size.x / 2 ? 32 : noise,
+                y * 255 / size.y,
+                alpha ? (x + y) * 7 : 255
+            );
+            img->mutPixels().store({x, y}, color);
+        }
+    }
+    return img;
+}
+
+template <typename D>
+static Res<Strong<Gfx::Surface>> _decode(Bytes bytes) {
+    auto dec = try$(D::init(bytes));
+    auto img = Gfx::Surface::alloc({dec.width(), dec.height()});
+    try$(dec.decode(*img));
+    return Ok(img);
+}
+
+static Res<Strong<Gfx::Surface>> _roundtrip(Gfx::Pixels pixels, Saver saver) {
+    Io::BufferWriter buf;
+    try$(save(pixels, buf, saver));
+    switch (saver.format) {
+    case Format::PNG:
+        return _decode<Png::Decoder>(buf.bytes());
+    case Format::QOI:
+        return _decode<Qoi::Decoder>(buf.bytes());
+    case Format::BMP:
+        return _decode<Bmp::Decoder>(buf.bytes());
+    case Format::JPEG:
+        break;
+    }
+
+    return Error::invalidInput("unsupported image format");
+}
+
+static bool _same(Gfx::Pixels a, Gfx::Pixels b) {
+    if (a.size() != b.size())
+        return false;
+    for (isize y = 0; y < a.height(); y++)
+        for (isize x = 0; x < a.width(); x++)
+            if (a.load({x, y}) != b.load({x, y}))
+                return false;
+    return true;
+}
+
+test$("image-save-roundtrip") {
+    Array const FORMATS = {Format::PNG, Format::QOI, Format::BMP};
+
+    for (bool alpha : {false, true}) {
+        for (auto fmt : {Gfx::Fmt{Gfx::RGBA8888}, Gfx::Fmt{Gfx::BGRA8888}}) {
+            auto img = _synth({67, 41}, alpha, fmt);
+            for (auto format : FORMATS) {
+                auto out = try$(_roundtrip(*img, {format}));
+                expect$(_same(*img, *out));
+            }
+        }
+    }
+
+    return Ok();
+}
+
+test$("image-save-png-levels") {
+    // Large enough for the compressed stream to span several blocks
+    auto img = _synth({640, 200}, true);
+    usize stored = 0;
+    for (usize level = 0; level <= 6; level++) {
+        Io::BufferWriter buf;
+        try$(save(*img, buf, {Format::PNG, level}));
+        if (level == 0)
+            stored = buf.bytes().len();
+        else
+            expect$(buf.bytes().len() < stored);
+
+        auto out = try$(_decode<Png::Decoder>(buf.bytes()));
+        expect$(_same(*img, *out));
+    }
+
+    return Ok();
+}
+
+test$("image-format-of") {
+    expect$(try$(formatOf("file:/tmp/a.png"_url)) == Format::PNG);
+    expect$(try$(formatOf("file:/tmp/a.QOI"_url)) == Format::QOI);
+    expect$(try$(formatOf("file:/tmp/a.bmp"_url)) == Format::BMP);
+    expect$(not formatOf("file:/tmp/a.jpg"_url));
+
+    return Ok();
+}
+
+} // namespace Karm::Image::Tests
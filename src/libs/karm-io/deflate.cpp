@@ -0,0 +1,629 @@
+#include "deflate.h"
+
+#include "_deflate.h"
+
+namespace Karm::Io {
+
+using namespace _Deflate;
+
+// MARK: Tables ----------------------------------------------------------------
+
+static constexpr Array<u8, 259> LENGTH_SYMBOL = [] {
+    Array<u8, 259> table{};
+    for (usize sym = 0; sym < LENGTH_BASE.len(); sym++)
+        for (usize len = LENGTH_BASE[sym]; len < min(LENGTH_BASE[sym] + (1u << LENGTH_EXTRA[sym]), 259u); len++)
+            table[len] = sym;
+    return table;
+}();
+
+static constexpr u8 _distSymbolSlow(usize dist) {
+    usize sym = 0;
+    while (sym + 1 < DIST_BASE.len() and DIST_BASE[sym + 1] <= dist)
+        sym++;
+    return sym;
+}
+
+// Distances up to 256 are looked up directly, larger ones by their top bits,
+// the codes past 256 all cover a multiple of 128 distances.
+static constexpr Array<u8, 256> DIST_SYMBOL_LO = [] {
+    Array<u8, 256> table{};
+    for (usize i = 0; i < 256; i++)
+        table[i] = _distSymbolSlow(i + 1);
+    return table;
+}();
+
+static constexpr Array<u8, 256> DIST_SYMBOL_HI = [] {
+    Array<u8, 256> table{};
+    for (usize i = 2; i < 256; i++)
+        table[i] = _distSymbolSlow((i << 7) + 1);
+    return table;
+}();
+
+static always_inline usize _distSymbol(usize dist) {
+    return dist <= 256 ? DIST_SYMBOL_LO[dist - 1] : DIST_SYMBOL_HI[(dist - 1) >> 7];
+}
+
+// How hard each level looks for matches: the number of candidates followed
+// along the hash chain, the length that ends the search, the length past
+// which a quarter of the chain is enough, and the length under which a
+// longer match is looked for on the next byte. Without lazy matching, the
+// last one is the longest match whose positions all go into the hash chains.
+struct _Params {
+    usize chain;
+    usize nice;
+    usize good;
+    usize lazy;
+    bool lazyMatching;
+};
+
+static constexpr Array<_Params, Deflate::MAX_LEVEL + 1> PARAMS = {{
+    {0, 0, 0, 0, false},
+    {0, 0, 0, 0, false},
+    {8, 16, 4, 5, false},
+    {32, 32, 4, 6, false},
+    {16, 16, 4, 4, true},
+    {32, 32, 8, 16, true},
+    {128, 128, 8, 16, true},
+}};
+
+// MARK: Huffman ---------------------------------------------------------------
+
+// Code lengths limited to maxBits for the given frequencies, symbols that
+// are used get a length, and a code always has at least two of them so it
+// is complete.
+static void _huffmanLengths(Slice<u32> freqs, MutSlice<u8> lengths, usize maxBits) {
+    struct Sym {
+        u32 freq;
+        u16 sym;
+    };
+
+    Array<Sym, Deflate::LIT_CODES> syms;
+    usize n = 0;
+    for (usize i = 0; i < freqs.len(); i++) {
+        lengths[i] = 0;
+        if (freqs[i])
+            syms[n++] = {freqs[i], (u16)i};
+    }
+
+    for (usize i = 0; n < 2; i++)
+        if (not freqs[i])
+            syms[n++] = {0, (u16)i};
+
+    auto used = mutSub(syms, 0, n);
+    sort(used, [](Sym const &a, Sym const &b) {
+        return a.freq <=> b.freq;
+    });
+
+    // Moffat and Katajainen's in-place computation of minimum redundancy
+    // codes, over the frequencies sorted in ascending order.
+    // https://doi.org/10.1007/3-540-60220-8_79
+    Array<u32, Deflate::LIT_CODES> a;
+    for (usize i = 0; i < n; i++)
+        a[i] = syms[i].freq;
+
+    a[0] += a[1];
+    usize root = 0, leaf = 2;
+    for (usize next = 1; next < n - 1; next++) {
+        if (leaf >= n or a[root] < a[leaf]) {
+            a[next] = a[root];
+            a[root++] = next;
+        } else {
+            a[next] = a[leaf++];
+        }
+
+        if (leaf >= n or (root < next and a[root] < a[leaf])) {
+            a[next] += a[root];
+            a[root++] = next;
+        } else {
+            a[next] += a[leaf++];
+        }
+    }
+
+    a[n - 2] = 0;
+    for (isize next = n - 3; next >= 0; next--)
+        a[next] = a[a[next]] + 1;
+
+    isize avail = 1, taken = 0, depth = 0;
+    isize node = n - 2, next = n - 1;
+    while (avail > 0) {
+        while (node >= 0 and (isize)a[node] == depth) {
+            taken++;
+            node--;
+        }
+        while (avail > taken) {
+            a[next--] = depth;
+            avail--;
+        }
+        avail = 2 * taken;
+        depth++;
+        taken = 0;
+    }
+
+    // Fold the codes that are too long back into the limit, then lengthen
+    // the shortest ones until the code is complete again.
+    Array<u32, 33> counts{};
+    for (usize i = 0; i < n; i++)
+        counts[min(a[i], 32u)]++;
+
+    for (usize i = maxBits + 1; i < counts.len(); i++)
+        counts[maxBits] += counts[i];
+
+    u32 total = 0;
+    for (usize i = 1; i <= maxBits; i++)
+        total += counts[i] << (maxBits - i);
+
+    while (total != (1u << maxBits)) {
+        counts[maxBits]--;
+        for (usize i = maxBits - 1; i > 0; i--) {
+            if (counts[i]) {
+                counts[i]--;
+                counts[i + 1] += 2;
+                break;
+            }
+        }
+        total--;
+    }
+
+    // The most frequent symbols get the shortest codes
+    usize j = n;
+    for (usize len = 1; len <= maxBits; len++)
+        for (usize k = 0; k < counts[len]; k++)
+            lengths[syms[--j].sym] = len;
+}
+
+// Canonical codes for the given lengths, bit reversed so they can be
+// written least significant bit first.
+static void _huffmanCodes(Slice<u8> lengths, MutSlice<u16> codes) {
+    Array<u16, 16> counts{};
+    for (auto len : lengths)
+        counts[len]++;
+    counts[0] = 0;
+
+    Array<u16, 16> nextCode{};
+    u16 code = 0;
+    for (usize bits = 1; bits < 16; bits++) {
+        code = (code + counts[bits - 1]) << 1;
+        nextCode[bits] = code;
+    }
+
+    for (usize i = 0; i < lengths.len(); i++)
+        if (lengths[i])
+            codes[i] = reverseBits(nextCode[lengths[i]]++, lengths[i]);
+}
+
+struct _Code {
+    Array<u8, 288> lengths{};
+    Array<u16, 288> codes{};
+};
+
+static _Code const &_fixedLit() {
+    static _Code c = [] {
+        _Code res;
+        for (usize i = 0; i < 288; i++)
+            res.lengths[i] = i < 144 ? 8 : i < 256 ? 9
+                                       : i < 280 ? 7
+                                                 : 8;
+        _huffmanCodes(res.lengths, res.codes);
+        return res;
+    }();
+    return c;
+}
+
+static _Code const &_fixedDist() {
+    static _Code c = [] {
+        _Code res;
+        for (usize i = 0; i < 30; i++)
+            res.lengths[i] = 5;
+        _huffmanCodes(sub(res.lengths, 0, 30), res.codes);
+        return res;
+    }();
+    return c;
+}
+
+// MARK: Deflate ---------------------------------------------------------------
+
+Deflate::Deflate(Writer &writer, usize level, bool zlib)
+    : _writer(writer),
+      _level(min(level, MAX_LEVEL)),
+      _zlib(zlib) {
+    _buf.resize(WINDOW + 3 * BLOCK + 8);
+    if (_level) {
+        _head.resize(1 << HASH_BITS);
+        _prev.resize(WINDOW);
+        _tokens.ensure(BLOCK + MAX_MATCH);
+    }
+    _out.resize(1024);
+}
+
+Res<usize> Deflate::write(Bytes bytes) {
+    if (_finished)
+        return Error::invalidInput("deflate stream is finished");
+
+    _adler.update(bytes);
+    usize written = bytes.len();
+    usize cap = _buf.len() - 8;
+    while (bytes.len()) {
+        if (_end == cap)
+            _slide();
+
+        usize n = min(bytes.len(), cap - _end);
+        memcpy(_buf.buf() + _end, bytes.buf(), n);
+        _end += n;
+        bytes = next(bytes, n);
+
+        // Keep enough bytes past the block for its last match
+        while (_end - _start >= BLOCK + MAX_MATCH)
+            try$(_compress(false));
+    }
+
+    return Ok(written);
+}
+
+Res<> Deflate::finish() {
+    if (_finished)
+        return Ok();
+
+    while (_end - _start > BLOCK)
+        try$(_compress(false));
+    try$(_compress(true));
+
+    if (_zlib) {
+        _align();
+        u32 adler = _adler.digest();
+        for (usize i = 0; i < 4; i++)
+            _out[_outLen++] = adler >> (24 - i * 8);
+    }
+
+    try$(_writer.write(sub(_out, 0, _outLen)));
+    _outLen = 0;
+    _finished = true;
+    return Ok();
+}
+
+void Deflate::_slide() {
+    usize shift = _start - min(_start, WINDOW);
+    memmove(_buf.buf(), _buf.buf() + shift, _end - shift);
+    _base += shift;
+    _start -= shift;
+    _end -= shift;
+}
+
+// MARK: Matching --------------------------------------------------------------
+
+Deflate::_Match Deflate::_longest(usize i, usize chain, usize nice) const {
+    _Match best{};
+    usize limit = min(MAX_MATCH, _end - i);
+    if (limit < MIN_MATCH)
+        return best;
+
+    u32 pos = _base + i;
+    u32 cand = _head[_hash(i)];
+    usize lastDist = 0;
+    u8 const *buf = _buf.buf();
+
+    for (usize steps = 0; steps < chain; steps++) {
+        usize dist = (u32)(pos - cand);
+        // Past the window, or a stale slot overwritten by a newer position
+        if (dist == 0 or dist > WINDOW or dist <= lastDist)
+            break;
+        lastDist = dist;
+
+        // Only candidates that start the same and go past the best match
+        usize c = i - dist;
+        u32 a, b;
+        memcpy(&a, buf + c, 4);
+        memcpy(&b, buf + i, 4);
+        if (buf[c + best.len] == buf[i + best.len] and not(toLe(a ^ b) & 0xffffff)) {
+            usize len = _common(c, i, limit);
+            if (len > best.len) {
+                best = {len, dist};
+                if (len >= nice or len == limit)
+                    break;
+            }
+        }
+
+        cand = _prev[cand & (WINDOW - 1)];
+    }
+
+    if (best.len < MIN_MATCH)
+        return {};
+    return best;
+}
+
+void Deflate::_rle(usize &i, usize limit) {
+    u8 const *buf = _buf.buf();
+    while (i < limit) {
+        // The byte before the block is still in the window
+        if (_base + i > 0) {
+            usize len = _common(i - 1, i, min(MAX_MATCH, _end - i));
+            if (len >= MIN_MATCH) {
+                _match(len, 1);
+                i += len;
+                continue;
+            }
+        }
+        _literal(buf[i++]);
+    }
+}
+
+void Deflate::_lz77(usize &i, usize limit) {
+    auto [chain, nice, good, lazy, lazyMatching] = PARAMS[_level];
+    u8 const *buf = _buf.buf();
+
+    while (i < limit) {
+        auto m = _longest(i, chain, nice);
+        _insert(i);
+
+        // Give up this match for a longer one starting on the next byte
+        if (lazyMatching and m.len >= MIN_MATCH and m.len < lazy) {
+            while (i + 1 < limit) {
+                auto n = _longest(i + 1, m.len >= good ? chain / 4 : chain, nice);
+                if (n.len <= m.len)
+                    break;
+                _literal(buf[i]);
+                i++;
+                _insert(i);
+                m = n;
+                if (m.len >= lazy)
+                    break;
+            }
+        }
+
+        if (m.len < MIN_MATCH) {
+            _literal(buf[i++]);
+            continue;
+        }
+
+        _match(m.len, m.dist);
+        if (lazyMatching or m.len <= lazy)
+            for (usize j = 1; j < m.len; j++)
+                _insert(i + j);
+        i += m.len;
+    }
+}
+
+// MARK: Blocks ----------------------------------------------------------------
+
+void Deflate::_match(usize len, usize dist) {
+    _tokens.pushBack(len << 16 | dist);
+    _litFreqs[257 + LENGTH_SYMBOL[len]]++;
+    _distFreqs[_distSymbol(dist)]++;
+}
+
+void Deflate::_align() {
+    _put(0, (8 - _nbits % 8) % 8);
+    while (_nbits) {
+        _out[_outLen++] = _bits;
+        _bits >>= 8;
+        _nbits -= 8;
+    }
+}
+
+Res<> Deflate::_compress(bool final) {
+    if (_zlib and not _started) {
+        // Deflate with a 32KiB window, and a hint of the level
+        u8 flevel = _level <= 1 ? 0 : _level < 6 ? 1
+                                                 : 2;
+        u16 header = 0x7800 | flevel << 6;
+        header |= 31 - header % 31;
+        _put(header >> 8, 8);
+        _put(header & 0xff, 8);
+    }
+    _started = true;
+
+    usize limit = final ? _end : min(_start + BLOCK, _end);
+    usize i = _start;
+    if (_level == 0)
+        i = limit;
+    else if (_level == 1)
+        _rle(i, limit);
+    else
+        _lz77(i, limit);
+
+    _emit(sub(_buf, _start, i), final);
+    _start = i;
+    _tokens.clear();
+    _litFreqs = {};
+    _distFreqs = {};
+
+    try$(_writer.write(sub(_out, 0, _outLen)));
+    _outLen = 0;
+    return Ok();
+}
+
+void Deflate::_emit(Bytes raw, bool final) {
+    // Room for the block, the zlib trailer, and the bits left over
+    auto reserve = [&](usize bits) {
+        usize need = _outLen + bits / 8 + 16;
+        if (_out.len() < need)
+            _out.resize(need);
+    };
+
+    usize storedBits = 3 + (8 - (_nbits + 3) % 8) % 8 + 32 + raw.len() * 8;
+    if (_level == 0) {
+        reserve(storedBits);
+        _put(final, 3);
+        _align();
+        _put(raw.len(), 16);
+        _put(~raw.len() & 0xffff, 16);
+        _align();
+        memcpy(_out.buf() + _outLen, raw.buf(), raw.len());
+        _outLen += raw.len();
+        return;
+    }
+
+    _litFreqs[256] = 1;
+
+    Array<u8, LIT_CODES> litLengths;
+    Array<u8, DIST_CODES> distLengths;
+    _huffmanLengths(_litFreqs, litLengths, 15);
+    _huffmanLengths(_distFreqs, distLengths, 15);
+
+    usize hlit = LIT_CODES;
+    while (hlit > 257 and not litLengths[hlit - 1])
+        hlit--;
+    usize hdist = DIST_CODES;
+    while (hdist > 1 and not distLengths[hdist - 1])
+        hdist--;
+
+    // Run length encoding of the code lengths, with the repeat codes 16
+    // to 18 and their extra bits.
+    Array<u8, LIT_CODES + DIST_CODES> lengths;
+    for (usize i = 0; i < hlit; i++)
+        lengths[i] = litLengths[i];
+    for (usize i = 0; i < hdist; i++)
+        lengths[hlit + i] = distLengths[i];
+    usize total = hlit + hdist;
+
+    Array<u8, LIT_CODES + DIST_CODES> clSyms;
+    Array<u8, LIT_CODES + DIST_CODES> clExtras;
+    Array<u32, 19> clFreqs{};
+    usize clLen = 0;
+    auto pushCl = [&](u8 sym, u8 extra) {
+        clSyms[clLen] = sym;
+        clExtras[clLen] = extra;
+        clLen++;
+        clFreqs[sym]++;
+    };
+
+    for (usize i = 0; i < total;) {
+        u8 len = lengths[i];
+        usize run = 1;
+        while (i + run < total and lengths[i + run] == len)
+            run++;
+        i += run;
+
+        if (len == 0) {
+            while (run >= 11) {
+                usize n = min(run, 138uz);
+                pushCl(18, n - 11);
+                run -= n;
+            }
+            if (run >= 3) {
+                pushCl(17, run - 3);
+                run = 0;
+            }
+        } else {
+            pushCl(len, 0);
+            run--;
+            while (run >= 3) {
+                usize n = min(run, 6uz);
+                pushCl(16, n - 3);
+                run -= n;
+            }
+        }
+
+        while (run--)
+            pushCl(len, 0);
+    }
+
+    Array<u8, 19> clLengths;
+    _huffmanLengths(clFreqs, clLengths, 7);
+    usize hclen = 19;
+    while (hclen > 4 and not clLengths[CODE_LENGTH_ORDER[hclen - 1]])
+        hclen--;
+
+    // Pick the cheapest way to write the block
+    static constexpr Array<u8, 19> CL_EXTRA = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 7};
+
+    usize extraBits = 0;
+    for (usize sym = 0; sym < LENGTH_EXTRA.len(); sym++)
+        extraBits += _litFreqs[257 + sym] * LENGTH_EXTRA[sym];
+    for (usize sym = 0; sym < DIST_CODES; sym++)
+        extraBits += _distFreqs[sym] * DIST_EXTRA[sym];
+
+    usize dynamicBits = 3 + 14 + hclen * 3 + extraBits;
+    for (usize sym = 0; sym < 19; sym++)
+        dynamicBits += clFreqs[sym] * (clLengths[sym] + CL_EXTRA[sym]);
+    for (usize sym = 0; sym < LIT_CODES; sym++)
+        dynamicBits += _litFreqs[sym] * litLengths[sym];
+    for (usize sym = 0; sym < DIST_CODES; sym++)
+        dynamicBits += _distFreqs[sym] * distLengths[sym];
+
+    auto const &fixedLit = _fixedLit();
+    auto const &fixedDist = _fixedDist();
+    usize fixedBits = 3 + extraBits;
+    for (usize sym = 0; sym < LIT_CODES; sym++)
+        fixedBits += _litFreqs[sym] * fixedLit.lengths[sym];
+    for (usize sym = 0; sym < DIST_CODES; sym++)
+        fixedBits += _distFreqs[sym] * 5;
+
+    if (storedBits <= min(dynamicBits, fixedBits)) {
+        reserve(storedBits);
+        _put(final, 3);
+        _align();
+        _put(raw.len(), 16);
+        _put(~raw.len() & 0xffff, 16);
+        _align();
+        memcpy(_out.buf() + _outLen, raw.buf(), raw.len());
+        _outLen += raw.len();
+        return;
+    }
+
+    Array<u8, 288> const *lits;
+    Array<u16, 288> const *litCodes;
+    Array<u8, 288> const *dists;
+    Array<u16, 288> const *distCodes;
+
+    _Code dynLit, dynDist;
+    if (fixedBits <= dynamicBits) {
+        reserve(fixedBits);
+        _put(final | 1 << 1, 3);
+        lits = &fixedLit.lengths;
+        litCodes = &fixedLit.codes;
+        dists = &fixedDist.lengths;
+        distCodes = &fixedDist.codes;
+    } else {
+        reserve(dynamicBits);
+        _put(final | 2 << 1, 3);
+        _put(hlit - 257, 5);
+        _put(hdist - 1, 5);
+        _put(hclen - 4, 4);
+        for (usize i = 0; i < hclen; i++)
+            _put(clLengths[CODE_LENGTH_ORDER[i]], 3);
+
+        Array<u16, 19> clCodes{};
+        _huffmanCodes(clLengths, clCodes);
+        for (usize i = 0; i < clLen; i++) {
+            u8 sym = clSyms[i];
+            _put(clCodes[sym], clLengths[sym]);
+            if (CL_EXTRA[sym])
+                _put(clExtras[i], CL_EXTRA[sym]);
+        }
+
+        for (usize i = 0; i < LIT_CODES; i++)
+            dynLit.lengths[i] = litLengths[i];
+        for (usize i = 0; i < DIST_CODES; i++)
+            dynDist.lengths[i] = distLengths[i];
+        _huffmanCodes(sub(dynLit.lengths, 0, LIT_CODES), dynLit.codes);
+        _huffmanCodes(sub(dynDist.lengths, 0, DIST_CODES), dynDist.codes);
+        lits = &dynLit.lengths;
+        litCodes = &dynLit.codes;
+        dists = &dynDist.lengths;
+        distCodes = &dynDist.codes;
+    }
+
+    for (auto token : _tokens) {
+        if (token < 256) {
+            _put((*litCodes)[token], (*lits)[token]);
+            continue;
+        }
+
+        usize len = token >> 16;
+        usize dist = token & 0xffff;
+
+        usize lsym = LENGTH_SYMBOL[len];
+        _put((*litCodes)[257 + lsym], (*lits)[257 + lsym]);
+        if (LENGTH_EXTRA[lsym])
+            _put(len - LENGTH_BASE[lsym], LENGTH_EXTRA[lsym]);
+
+        usize dsym = _distSymbol(dist);
+        _put((*distCodes)[dsym], (*dists)[dsym]);
+        if (DIST_EXTRA[dsym])
+            _put(dist - DIST_BASE[dsym], DIST_EXTRA[dsym]);
+    }
+
+    _put((*litCodes)[256], (*lits)[256]);
+}
+
+} // namespace Karm::Io
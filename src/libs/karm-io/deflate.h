@@ -0,0 +1,142 @@
+#pragma once
+
+#include <karm-base/array.h>
+#include <karm-base/vec.h>
+
+#include "inflate.h"
+#include "traits.h"
+
+namespace Karm::Io {
+
+// Compress into a DEFLATE stream (RFC 1951), optionally wrapped in a zlib
+// header and checksum (RFC 1950). Written bytes are buffered until a block
+// is full, matched against the previous 32KiB and sent to the output
+// writer with the cheapest of stored, fixed or dynamic Huffman codes, so a
+// stream of any size compresses in constant memory.
+//
+// Level 0 only stores, level 1 only looks for runs of the same byte, which
+// is cheap and catches most of the redundancy of filtered image rows, and
+// levels 2 to 6 follow hash chains of growing length, lazily from level 4.
+struct Deflate : public Writer {
+    static constexpr usize WINDOW = 32 * 1024;
+    static constexpr usize BLOCK = 32 * 1024;
+    static constexpr usize MIN_MATCH = 3;
+    static constexpr usize MAX_MATCH = 258;
+    static constexpr usize HASH_BITS = 15;
+    static constexpr usize MAX_LEVEL = 6;
+    static constexpr usize LIT_CODES = 286;
+    static constexpr usize DIST_CODES = 30;
+
+    Writer &_writer;
+    usize _level;
+    bool _zlib;
+    bool _started = false;
+    bool _finished = false;
+
+    // The window followed by the bytes not compressed yet, and some slack
+    // so matches can be compared a word at a time.
+    Vec<u8> _buf;
+    usize _base = 0;  //< Stream position of the start of the buffer
+    usize _start = 0; //< First byte not compressed yet
+    usize _end = 0;
+
+    // Stream positions, truncated to 32 bits, distances are computed with
+    // wrapping arithmetic and candidates are always checked byte by byte.
+    Vec<u32> _head; //< Last position of each hash
+    Vec<u32> _prev; //< Previous position with the same hash, per window slot
+
+    Vec<u32> _tokens; //< A literal byte, or length << 16 | distance
+    Array<u32, LIT_CODES> _litFreqs{};
+    Array<u32, DIST_CODES> _distFreqs{};
+
+    u64 _bits = 0;
+    usize _nbits = 0;
+    Vec<u8> _out;
+    usize _outLen = 0;
+
+    Adler32 _adler{};
+
+    Deflate(Writer &writer, usize level = 6, bool zlib = true);
+
+    Res<usize> write(Bytes bytes) override;
+
+    // Compress what is left, end the stream and write the trailer, nothing
+    // can be written afterward.
+    Res<> finish();
+
+    // MARK: Matching ----------------------------------------------------------
+
+    always_inline u32 _hash(usize i) const {
+        u32 v;
+        memcpy(&v, _buf.buf() + i, 4);
+        return ((toLe(v) & 0xffffff) * 0x9e3779b1u) >> (32 - HASH_BITS);
+    }
+
+    always_inline void _insert(usize i) {
+        if (i + MIN_MATCH > _end)
+            return;
+        u32 pos = _base + i;
+        u32 h = _hash(i);
+        _prev[pos & (WINDOW - 1)] = _head[h];
+        _head[h] = pos;
+    }
+
+    always_inline usize _common(usize a, usize b, usize limit) const {
+        u8 const *buf = _buf.buf();
+        usize n = 0;
+        while (n + 8 <= limit) {
+            u64 x, y;
+            memcpy(&x, buf + a + n, 8);
+            memcpy(&y, buf + b + n, 8);
+            u64 diff = toLe(x ^ y);
+            if (diff)
+                return n + (__builtin_ctzll(diff) >> 3);
+            n += 8;
+        }
+        while (n < limit and buf[a + n] == buf[b + n])
+            n++;
+        return n;
+    }
+
+    struct _Match {
+        usize len = 0;
+        usize dist = 0;
+    };
+
+    _Match _longest(usize i, usize chain, usize nice) const;
+
+    void _rle(usize &i, usize limit);
+
+    void _lz77(usize &i, usize limit);
+
+    // MARK: Blocks ------------------------------------------------------------
+
+    always_inline void _literal(u8 byte) {
+        _tokens.pushBack(byte);
+        _litFreqs[byte]++;
+    }
+
+    void _match(usize len, usize dist);
+
+    always_inline void _put(u32 v, usize n) {
+        _bits |= (u64)v << _nbits;
+        _nbits += n;
+        if (_nbits >= 32) {
+            u32 w = toLe((u32)_bits);
+            memcpy(_out.buf() + _outLen, &w, 4);
+            _outLen += 4;
+            _bits >>= 32;
+            _nbits -= 32;
+        }
+    }
+
+    void _align();
+
+    Res<> _compress(bool final);
+
+    void _emit(Bytes raw, bool final);
+
+    void _slide();
+};
+
+} // namespace Karm::Io
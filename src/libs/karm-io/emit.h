@@ -76,12 +76,13 @@ struct Emit : public Io::TextWriterBase<> {
             return Ok(0);
         }
 
+        // The pending newline counts itself toward the total
         usize written = 0;
         if (_newline)
             written += try$(_insertNewline());
-        written += try$(_writer.writeRune(r));
-        _total += written;
-        return Ok(written);
+        usize rune = try$(_writer.writeRune(r));
+        _total += rune;
+        return Ok(written + rune);
     }
 
     void operator()(Rune r) {
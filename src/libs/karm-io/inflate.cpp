@@ -0,0 +1,444 @@
+#include "inflate.h"
+
+#include "_deflate.h"
+
+namespace Karm::Io {
+
+using namespace _Deflate;
+
+// MARK: Checksums -------------------------------------------------------------
+
+void Adler32::update(Bytes bytes) {
+    // Largest number of bytes before the sums may overflow 32 bits
+    static constexpr usize NMAX = 5552;
+    static constexpr u32 MOD = 65521;
+
+    while (bytes.len()) {
+        usize n = min(bytes.len(), NMAX);
+        for (usize i = 0; i < n; i++) {
+            _a += bytes[i];
+            _b += _a;
+        }
+        _a %= MOD;
+        _b %= MOD;
+        bytes = next(bytes, n);
+    }
+}
+
+static constexpr Array<u32, 256> CRC32_TABLE = [] {
+    Array<u32, 256> table{};
+    for (u32 i = 0; i < 256; i++) {
+        u32 c = i;
+        for (usize k = 0; k < 8; k++)
+            c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        table[i] = c;
+    }
+    return table;
+}();
+
+void Crc32::update(Bytes bytes) {
+    u32 crc = _crc;
+    for (auto b : bytes)
+        crc = CRC32_TABLE[(crc ^ b) & 0xff] ^ (crc >> 8);
+    _crc = crc;
+}
+
+Res<> Inflate::Huffman::build(Slice<u8> lengths) {
+    Array<u16, MAX_BITS + 1> counts{};
+    Array<u16, MAX_BITS + 1> nextCode{};
+
+    fast = {};
+    for (auto l : lengths)
+        counts[l]++;
+    counts[0] = 0;
+
+    for (usize i = 1; i <= MAX_BITS; i++)
+        if (counts[i] > (1u << i))
+            return Error::invalidData("bad huffman code lengths");
+
+    u32 code = 0;
+    u16 symbol = 0;
+    for (usize i = 1; i <= MAX_BITS; i++) {
+        nextCode[i] = code;
+        firstCode[i] = code;
+        firstSymbol[i] = symbol;
+        code += counts[i];
+        if (counts[i] and code - 1 >= (1u << i))
+            return Error::invalidData("oversubscribed huffman code");
+        maxCode[i] = code << (16 - i);
+        code <<= 1;
+        symbol += counts[i];
+    }
+    maxCode[MAX_BITS + 1] = 0x10000;
+
+    for (usize i = 0; i < lengths.len(); i++) {
+        usize len = lengths[i];
+        if (not len)
+            continue;
+
+        usize c = nextCode[len] - firstCode[len] + firstSymbol[len];
+        sizes[c] = len;
+        symbols[c] = i;
+
+        if (len <= FAST_BITS) {
+            u16 entry = len << 9 | i;
+            for (usize j = reverseBits(nextCode[len], len); j < fast.len(); j += 1 << len)
+                fast[j] = entry;
+        }
+
+        nextCode[len]++;
+    }
+
+    return Ok();
+}
+
+static Inflate::Huffman const &_fixedLit() {
+    static Inflate::Huffman h = [] {
+        Array<u8, 288> lengths;
+        for (usize i = 0; i < 288; i++)
+            lengths[i] = i < 144 ? 8 : i < 256 ? 9
+                                   : i < 280 ? 7
+                                             : 8;
+        Inflate::Huffman res;
+        (void)res.build(lengths);
+        return res;
+    }();
+    return h;
+}
+
+static Inflate::Huffman const &_fixedDist() {
+    static Inflate::Huffman h = [] {
+        Array<u8, 30> lengths;
+        for (auto &l : lengths)
+            l = 5;
+        Inflate::Huffman res;
+        (void)res.build(lengths);
+        return res;
+    }();
+    return h;
+}
+
+// MARK: Inflate ---------------------------------------------------------------
+
+Inflate::Inflate(Reader &reader, bool zlib)
+    : _reader(reader),
+      _zlib(zlib),
+      _state(zlib ? _State::HEADER : _State::BLOCK) {
+    _window.resize(WINDOW * 2 + MAX_MATCH + 8);
+}
+
+Res<usize> Inflate::read(MutBytes bytes) {
+    usize n = 0;
+    while (n < bytes.len()) {
+        if (_rpos == _wpos) {
+            if (_state == _State::DONE)
+                break;
+            try$(_fill());
+            continue;
+        }
+
+        usize len = min(bytes.len() - n, _wpos - _rpos);
+        memcpy(bytes.buf() + n, _window.buf() + _rpos, len);
+        _rpos += len;
+        n += len;
+    }
+    return Ok(n);
+}
+
+// MARK: Bits ------------------------------------------------------------------
+
+Res<> Inflate::_pull() {
+    _inLen = try$(_reader.read(mutBytes(_in)));
+    _inPos = 0;
+    return Ok();
+}
+
+void Inflate::_refillSlow() {
+    while (_nbits <= 56) {
+        if (_inPos == _inLen) {
+            if (not _pull() or _inLen == 0) {
+                // Past the end of the input, the stream is truncated if
+                // these bytes are ever used, see _fill()
+                _inLen = 0;
+                _overrun++;
+                _nbits += 8;
+                continue;
+            }
+        }
+        _bits |= (u64)_in[_inPos++] << _nbits;
+        _nbits += 8;
+    }
+}
+
+Res<u16> Inflate::_decodeSlow(Huffman const &h) {
+    u16 k = reverseBits(_bits & 0xffff, 16);
+    usize len = FAST_BITS + 1;
+    while (len <= MAX_BITS and k >= h.maxCode[len])
+        len++;
+
+    if (len > MAX_BITS)
+        return Error::invalidData("invalid huffman code");
+
+    usize c = (k >> (16 - len)) - h.firstCode[len] + h.firstSymbol[len];
+    if (c >= h.sizes.len() or h.sizes[c] != len)
+        return Error::invalidData("invalid huffman code");
+
+    _take(len);
+    return Ok(h.symbols[c]);
+}
+
+// MARK: Blocks ----------------------------------------------------------------
+
+Res<> Inflate::_fill() {
+    // Keep the last window of output for the matches to come
+    usize limit = WINDOW * 2;
+    if (_wpos >= limit) {
+        usize shift = _wpos - WINDOW;
+        if (_zlib)
+            _adler.update(sub(_window, _adlerPos, _wpos));
+        memmove(_window.buf(), _window.buf() + shift, WINDOW);
+        _wpos = _rpos = _adlerPos = WINDOW;
+    }
+
+    while (_wpos < limit and _state != _State::DONE) {
+        switch (_state) {
+        case _State::HEADER:
+            try$(_header());
+            break;
+
+        case _State::BLOCK:
+            try$(_block());
+            break;
+
+        case _State::STORED:
+            try$(_copyStored(limit));
+            break;
+
+        case _State::HUFFMAN:
+            try$(_inflate(limit));
+            break;
+
+        case _State::TRAILER:
+            try$(_trailer());
+            break;
+
+        case _State::DONE:
+            break;
+        }
+
+        // A few bytes of lookahead may run past the end of the input,
+        // using them means the stream is truncated.
+        if (_overrun * 8 > _nbits)
+            return Error::invalidData("unexpected end of deflate stream");
+    }
+
+    return Ok();
+}
+
+Res<> Inflate::_header() {
+    _refill();
+    u32 cmf = _take(8);
+    u32 flg = _take(8);
+
+    if ((cmf * 256 + flg) % 31 != 0)
+        return Error::invalidData("invalid zlib header");
+
+    if ((cmf & 0xf) != 8 or (cmf >> 4) > 7)
+        return Error::invalidData("unsupported zlib compression method");
+
+    if (flg & 0x20)
+        return Error::invalidData("zlib preset dictionaries are not supported");
+
+    _state = _State::BLOCK;
+    return Ok();
+}
+
+Res<> Inflate::_block() {
+    if (_final) {
+        _state = _zlib ? _State::TRAILER : _State::DONE;
+        return Ok();
+    }
+
+    _refill();
+    _final = _take(1);
+    u32 type = _take(2);
+
+    if (type == 0) {
+        _align();
+        u32 len = _take(16);
+        u32 nlen = _take(16);
+        if ((len ^ 0xffff) != nlen)
+            return Error::invalidData("corrupted stored block length");
+        _stored = len;
+        _state = _State::STORED;
+    } else if (type == 1) {
+        _lit = _fixedLit();
+        _dist = _fixedDist();
+        _state = _State::HUFFMAN;
+    } else if (type == 2) {
+        try$(_dynamic());
+        _state = _State::HUFFMAN;
+    } else {
+        return Error::invalidData("invalid deflate block type");
+    }
+
+    return Ok();
+}
+
+Res<> Inflate::_dynamic() {
+    _refill();
+    usize hlit = _take(5) + 257;
+    usize hdist = _take(5) + 1;
+    usize hclen = _take(4) + 4;
+
+    // The fields can count up to 288 and 32 codes, only 286 and 30 exist
+    if (hlit > 286 or hdist > 30)
+        return Error::invalidData("too many literal or distance codes");
+
+    Array<u8, 19> codeLengths{};
+    for (usize i = 0; i < hclen; i++) {
+        _refill();
+        codeLengths[CODE_LENGTH_ORDER[i]] = _take(3);
+    }
+
+    Huffman h;
+    try$(h.build(codeLengths));
+
+    Array<u8, 286 + 32> lengths{};
+    usize n = 0;
+    while (n < hlit + hdist) {
+        _refill();
+        auto sym = try$(_decode(h));
+        if (sym < 16) {
+            lengths[n++] = sym;
+            continue;
+        }
+
+        u8 fill = 0;
+        usize repeat;
+        if (sym == 16) {
+            if (n == 0)
+                return Error::invalidData("code length repeat without a previous length");
+            fill = lengths[n - 1];
+            repeat = _take(2) + 3;
+        } else if (sym == 17) {
+            repeat = _take(3) + 3;
+        } else {
+            repeat = _take(7) + 11;
+        }
+
+        if (n + repeat > hlit + hdist)
+            return Error::invalidData("too many code lengths");
+
+        for (usize i = 0; i < repeat; i++)
+            lengths[n++] = fill;
+    }
+
+    if (lengths[256] == 0)
+        return Error::invalidData("missing end of block code");
+
+    try$(_lit.build(sub(lengths, 0, hlit)));
+    try$(_dist.build(sub(lengths, hlit, hlit + hdist)));
+    return Ok();
+}
+
+Res<> Inflate::_copyStored(usize limit) {
+    // The bit buffer is byte aligned, drain it before the input buffer
+    while (_stored and _wpos < limit and _nbits >= 8) {
+        _window[_wpos++] = _take(8);
+        _stored--;
+    }
+
+    // What's left above the bit count are input bytes copied below
+    if (_nbits == 0)
+        _bits = 0;
+
+    while (_stored and _wpos < limit) {
+        if (_inPos == _inLen) {
+            try$(_pull());
+            if (_inLen == 0)
+                return Error::invalidData("unexpected end of stored block");
+        }
+
+        usize n = min(_stored, limit - _wpos, _inLen - _inPos);
+        memcpy(_window.buf() + _wpos, _in.buf() + _inPos, n);
+        _wpos += n;
+        _inPos += n;
+        _stored -= n;
+    }
+
+    if (not _stored)
+        _state = _State::BLOCK;
+    return Ok();
+}
+
+Res<> Inflate::_inflate(usize limit) {
+    u8 *out = _window.buf();
+    usize pos = _wpos;
+
+    while (pos < limit) {
+        // Enough bits for a length, a distance and their extra bits
+        _refill();
+
+        auto sym = try$(_decode(_lit));
+        if (sym < 256) {
+            out[pos++] = sym;
+            continue;
+        }
+
+        if (sym == 256) {
+            _state = _State::BLOCK;
+            break;
+        }
+
+        sym -= 257;
+        if (sym >= LENGTH_BASE.len())
+            return Error::invalidData("invalid length symbol");
+        usize len = LENGTH_BASE[sym] + _take(LENGTH_EXTRA[sym]);
+
+        auto d = try$(_decode(_dist));
+        if (d >= DIST_BASE.len())
+            return Error::invalidData("invalid distance symbol");
+        usize dist = DIST_BASE[d] + _take(DIST_EXTRA[d]);
+
+        if (dist > pos)
+            return Error::invalidData("distance too far back");
+
+        u8 *dst = out + pos;
+        u8 const *src = dst - dist;
+        if (dist >= 8) {
+            // May write a few bytes past the match, the window has room for it
+            for (usize i = 0; i < len; i += 8)
+                memcpy(dst + i, src + i, 8);
+        } else if (dist == 1) {
+            memset(dst, *src, len);
+        } else {
+            for (usize i = 0; i < len; i++)
+                dst[i] = src[i];
+        }
+        pos += len;
+    }
+
+    _wpos = pos;
+    return Ok();
+}
+
+Res<> Inflate::_trailer() {
+    _adler.update(sub(_window, _adlerPos, _wpos));
+    _adlerPos = _wpos;
+
+    _align();
+    _refill();
+    u32 checksum = _take(8) << 24;
+    checksum |= _take(8) << 16;
+    checksum |= _take(8) << 8;
+    checksum |= _take(8);
+
+    if (checksum != _adler.digest())
+        return Error::invalidData("adler32 checksum mismatch");
+
+    _state = _State::DONE;
+    return Ok();
+}
+
+} // namespace Karm::Io
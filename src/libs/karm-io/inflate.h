@@ -0,0 +1,168 @@
+#pragma once
+
+#include <karm-base/array.h>
+#include <karm-base/vec.h>
+
+#include "traits.h"
+
+namespace Karm::Io {
+
+// MARK: Checksums -------------------------------------------------------------
+
+// https://www.rfc-editor.org/rfc/rfc1950#section-8
+struct Adler32 {
+    u32 _a = 1;
+    u32 _b = 0;
+
+    void update(Bytes bytes);
+
+    u32 digest() const {
+        return _b << 16 | _a;
+    }
+};
+
+// https://www.w3.org/TR/png/#5CRC-algorithm
+struct Crc32 {
+    u32 _crc = 0xffffffff;
+
+    void update(Bytes bytes);
+
+    u32 digest() const {
+        return ~_crc;
+    }
+};
+
+// MARK: Inflate ---------------------------------------------------------------
+
+// Decompress a DEFLATE stream (RFC 1951), optionally wrapped in a zlib
+// header and checksum (RFC 1950). Compressed bytes are pulled from the
+// input reader on demand and the output goes through a sliding window, so
+// a stream of any size decodes in constant memory while the caller reads
+// it piece by piece.
+struct Inflate : public Reader {
+    static constexpr usize WINDOW = 32 * 1024;
+    static constexpr usize MAX_MATCH = 258;
+    static constexpr usize FAST_BITS = 10;
+    static constexpr usize MAX_BITS = 15;
+
+    // A canonical Huffman code, codes of up to FAST_BITS bits are decoded
+    // with a single table lookup, longer ones with a search per length.
+    struct Huffman {
+        Array<u16, 1 << FAST_BITS> fast;  //< length << 9 | symbol, 0 if the code is longer
+        Array<u16, MAX_BITS + 1> firstCode;
+        Array<u16, MAX_BITS + 1> firstSymbol;
+        Array<u32, MAX_BITS + 2> maxCode; //< Past the codes of each length, aligned to 16 bits
+        Array<u8, 288> sizes;
+        Array<u16, 288> symbols;
+
+        Res<> build(Slice<u8> lengths);
+    };
+
+    enum struct _State {
+        HEADER,
+        BLOCK,
+        STORED,
+        HUFFMAN,
+        TRAILER,
+        DONE,
+    };
+
+    Reader &_reader;
+    bool _zlib;
+    _State _state;
+    bool _final = false;
+    usize _stored = 0; //< Bytes left in a stored block
+
+    Array<u8, 4096> _in{};
+    usize _inPos = 0;
+    usize _inLen = 0;
+    usize _overrun = 0; //< Zero bytes made up past the end of the input
+
+    u64 _bits = 0;
+    usize _nbits = 0;
+
+    Huffman _lit{};
+    Huffman _dist{};
+    bool _fixed = false;
+
+    // Twice the window, so matches can be copied without wrapping around.
+    Vec<u8> _window;
+    usize _rpos = 0;
+    usize _wpos = 0;
+
+    Adler32 _adler{};
+    usize _adlerPos = 0;
+
+    Inflate(Reader &reader, bool zlib = true);
+
+    Res<usize> read(MutBytes bytes) override;
+
+    bool ended() const {
+        return _state == _State::DONE and _rpos == _wpos;
+    }
+
+    // MARK: Bits --------------------------------------------------------------
+
+    Res<> _pull();
+
+    always_inline void _refill() {
+        if (_nbits > 56)
+            return;
+
+        if (_inLen - _inPos >= 8) {
+            // The bytes past the ones counted are the next ones of the
+            // input, loading them again later is harmless.
+            u64 v;
+            memcpy(&v, _in.buf() + _inPos, 8);
+            _bits |= toLe(v) << _nbits;
+            usize n = (63 - _nbits) >> 3;
+            _inPos += n;
+            _nbits += n * 8;
+            return;
+        }
+
+        _refillSlow();
+    }
+
+    void _refillSlow();
+
+    always_inline u32 _take(usize n) {
+        u32 v = _bits & ((1ull << n) - 1);
+        _bits >>= n;
+        _nbits -= n;
+        return v;
+    }
+
+    always_inline Res<u16> _decode(Huffman const &h) {
+        u16 fast = h.fast[_bits & ((1 << FAST_BITS) - 1)];
+        if (fast) {
+            _take(fast >> 9);
+            return Ok<u16>(fast & 511);
+        }
+        return _decodeSlow(h);
+    }
+
+    Res<u16> _decodeSlow(Huffman const &h);
+
+    void _align() {
+        _take(_nbits % 8);
+    }
+
+    // MARK: Blocks ------------------------------------------------------------
+
+    Res<> _fill();
+
+    Res<> _header();
+
+    Res<> _block();
+
+    Res<> _dynamic();
+
+    Res<> _copyStored(usize limit);
+
+    Res<> _inflate(usize limit);
+
+    Res<> _trailer();
+};
+
+} // namespace Karm::Io
@@ -0,0 +1,86 @@
+#include <karm-io/deflate.h>
+#include <karm-io/impls.h>
+#include <karm-test/macros.h>
+
+namespace Karm::Io::Tests {
+
+static Res<Vec<u8>> _deflate(Bytes input, usize level, usize chunk = 4096) {
+    BufferWriter buf;
+    Deflate deflate{buf, level};
+    for (usize i = 0; i < input.len(); i += chunk)
+        try$(deflate.write(sub(input, i, min(i + chunk, input.len()))));
+    try$(deflate.finish());
+
+    Vec<u8> out;
+    out.insertMany(0, buf.bytes());
+    return Ok(out);
+}
+
+static Res<Vec<u8>> _inflate(Bytes input) {
+    BufReader reader{input};
+    Inflate inflate{reader};
+
+    Vec<u8> out;
+    Array<u8, 1000> buf;
+    while (true) {
+        auto n = try$(inflate.read(mutBytes(buf)));
+        if (n == 0)
+            break;
+        out.insertMany(out.len(), sub(buf, 0, n));
+    }
+    return Ok(out);
+}
+
+// Text, runs and noise, longer than a block and the window
+static Vec<u8> _sample() {
+    Vec<u8> out;
+    u32 seed = 0xdeadbeef;
+    for (usize i = 0; i < 100000; i++) {
+        seed = seed * 1103515245 + 12345;
+        if ((i / 5000) % 3 == 0)
+            out.pushBack("the quick brown fox jumps over the lazy dog "[i % 44]);
+        else if ((i / 5000) % 3 == 1)
+            out.pushBack((i / 700) & 0xff);
+        else
+            out.pushBack(seed >> 24);
+    }
+    return out;
+}
+
+test$("deflate-roundtrip") {
+    auto sample = _sample();
+    for (usize level = 0; level <= Deflate::MAX_LEVEL; level++) {
+        for (usize chunk : {1uz, 333uz, 100000uz}) {
+            auto compressed = try$(_deflate(sample, level, chunk));
+            auto out = try$(_inflate(compressed));
+            expectEq$(bytes(out), bytes(sample));
+        }
+    }
+
+    return Ok();
+}
+
+test$("deflate-empty") {
+    for (usize level = 0; level <= Deflate::MAX_LEVEL; level++) {
+        auto compressed = try$(_deflate({}, level));
+        auto out = try$(_inflate(compressed));
+        expectEq$(out.len(), 0uz);
+    }
+
+    return Ok();
+}
+
+test$("deflate-levels") {
+    // Runs are all level 1 looks for, higher levels also find the text
+    auto sample = _sample();
+    auto stored = try$(_deflate(sample, 0));
+    auto fast = try$(_deflate(sample, 1));
+    auto best = try$(_deflate(sample, 6));
+    expect$(stored.len() > sample.len());
+    expect$(fast.len() < stored.len());
+    expect$(best.len() < fast.len());
+
+    return Ok();
+}
+
+} // namespace Karm::Io::Tests
@@ -0,0 +1,123 @@
+#include <karm-io/impls.h>
+#include <karm-io/inflate.h>
+#include <karm-test/macros.h>
+
+namespace Karm::Io::Tests {
+
+static Res<Vec<u8>> _inflate(Bytes input, bool zlib = true) {
+    BufReader reader{input};
+    Inflate inflate{reader, zlib};
+
+    Vec<u8> out;
+    Array<u8, 1000> buf;
+    while (true) {
+        auto n = try$(inflate.read(mutBytes(buf)));
+        if (n == 0)
+            break;
+        out.insertMany(out.len(), sub(buf, 0, n));
+    }
+    return Ok(out);
+}
+
+test$("inflate-stored") {
+    // zlib.compress(b"hello, world", 0)
+    Array<u8, 23> input = {
+        0x78, 0x01, 0x01, 0x0c, 0x00, 0xf3, 0xff, 0x68, 0x65, 0x6c, 0x6c, 0x6f,
+        0x2c, 0x20, 0x77, 0x6f, 0x72, 0x6c, 0x64, 0x1d, 0x54, 0x04, 0x89
+    };
+
+    auto out = try$(_inflate(input));
+    expectEq$(Str{(char const *)out.buf(), out.len()}, "hello, world"s);
+
+    return Ok();
+}
+
+test$("inflate-fixed-raw") {
+    // Raw deflate stream with fixed Huffman codes and a long match
+    Array<u8, 10> input = {
+        0xcb, 0x48, 0xcd, 0xc9, 0xc9, 0x57, 0xc8, 0x40, 0x27, 0x01
+    };
+
+    auto out = try$(_inflate(input, false));
+    expectEq$(Str{(char const *)out.buf(), out.len()}, "hello hello hello hello"s);
+
+    return Ok();
+}
+
+test$("inflate-dynamic-window") {
+    // zlib.compress(b"\0" * 100000, 9), the output is larger than the window
+    Vec<u8> input;
+    input.insertMany(0, Array<u8, 17>{
+                            0x78, 0xda, 0xed, 0xc1, 0x31, 0x01, 0x00, 0x00, 0x00,
+                            0xc2, 0xa0, 0xf5, 0x4f, 0x6d, 0x0d, 0x0f, 0xa0,
+                        });
+    for (usize i = 0; i < 96; i++)
+        input.pushBack(0);
+    input.insertMany(input.len(), Array<u8, 7>{0x80, 0x57, 0x03, 0x86, 0xaf, 0x00, 0x01});
+
+    auto out = try$(_inflate(input));
+    expectEq$(out.len(), 100000uz);
+    for (auto b : out)
+        expectEq$(b, 0);
+
+    return Ok();
+}
+
+test$("inflate-corrupted") {
+    Array<u8, 23> input = {
+        0x78, 0x01, 0x01, 0x0c, 0x00, 0xf3, 0xff, 0x68, 0x65, 0x6c, 0x6c, 0x6f,
+        0x2c, 0x20, 0x77, 0x6f, 0x72, 0x6c, 0x64, 0x1d, 0x54, 0x04, 0x89
+    };
+
+    // Truncated stream
+    expect$(not _inflate(sub(input, 0, 15)));
+
+    // Bad checksum
+    input[22] ^= 1;
+    expect$(not _inflate(input));
+
+    // Bad header
+    input[22] ^= 1;
+    input[1] = 0x02;
+    expect$(not _inflate(input));
+
+    return Ok();
+}
+
+test$("inflate-malformed") {
+    // Dynamic blocks with 288 literal/length and 32 distance codes
+    Array<u8, 8> tooManyCodes = {
+        0xfd, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+    };
+    expect$(not _inflate(tooManyCodes, false));
+
+    // 257 literal/length and 32 distance codes
+    Array<u8, 8> tooManyDistances = {
+        0x05, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+    };
+    expect$(not _inflate(tooManyDistances, false));
+
+    // Reserved block type
+    Array<u8, 2> reserved = {0x07, 0x00};
+    expect$(not _inflate(reserved, false));
+
+    return Ok();
+}
+
+test$("inflate-adler32") {
+    Adler32 adler;
+    adler.update(bytes("Wikipedia"s));
+    expectEq$(adler.digest(), 0x11e60398u);
+
+    return Ok();
+}
+
+test$("inflate-crc32") {
+    Crc32 crc;
+    crc.update(bytes("123456789"s));
+    expectEq$(crc.digest(), 0xcbf43926u);
+
+    return Ok();
+}
+
+} // namespace Karm::Io::Tests
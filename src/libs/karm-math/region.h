@@ -0,0 +1,283 @@
+#pragma once
+
+#include <karm-base/limits.h>
+#include <karm-base/vec.h>
+
+#include "rect.h"
+
+namespace Karm::Math {
+
+// A set of pixels described as non overlapping rectangles in y-x banded
+// order (à la pixman): rectangles are grouped into horizontal bands sharing
+// the same top and bottom, bands are sorted top to bottom, the rectangles of
+// a band are sorted left to right and never touch, and vertically adjacent
+// bands with the same horizontal spans are coalesced.
+struct Region {
+    using Inner = Recti;
+
+    enum struct _Op {
+        UNION,
+        INTERSECT,
+        SUBTRACT,
+    };
+
+    struct _Span {
+        isize start;
+        isize end;
+    };
+
+    Vec<Recti> _rects{};
+
+    Region() = default;
+
+    Region(Recti r) {
+        if (r.width > 0 and r.height > 0)
+            _rects.pushBack(r);
+    }
+
+    // MARK: Queries -----------------------------------------------------------
+
+    bool empty() const {
+        return _rects.len() == 0;
+    }
+
+    explicit operator bool() const {
+        return not empty();
+    }
+
+    Recti bound() const {
+        if (empty())
+            return {};
+
+        Recti res = _rects[0];
+        for (auto const &r : _rects)
+            res = res.mergeWith(r);
+        return res;
+    }
+
+    isize area() const {
+        isize res = 0;
+        for (auto const &r : _rects)
+            res += r.area();
+        return res;
+    }
+
+    bool contains(Vec2i p) const {
+        for (auto const &r : _rects) {
+            if (r.contains(p))
+                return true;
+        }
+        return false;
+    }
+
+    // MARK: Operations --------------------------------------------------------
+
+    void clear() {
+        _rects.clear();
+    }
+
+    void add(Recti r) {
+        *this = unite(r);
+    }
+
+    Region unite(Region const &other) const {
+        return _combine(*this, other, _Op::UNION);
+    }
+
+    Region intersect(Region const &other) const {
+        return _combine(*this, other, _Op::INTERSECT);
+    }
+
+    Region subtract(Region const &other) const {
+        return _combine(*this, other, _Op::SUBTRACT);
+    }
+
+    // Trade exactness for fewer rectangles. Rectangles are greedily grouped
+    // while the bounding box of a group covers at most `overdraw` more
+    // pixels than the group itself, the result is the union of the bounding
+    // boxes so no pixel is covered twice.
+    Region simplify(f64 overdraw = 0.25) const {
+        struct Cluster {
+            Recti bound;
+            isize area;
+        };
+
+        Vec<Cluster> clusters;
+        for (auto const &r : _rects) {
+            bool merged = false;
+            for (auto &c : clusters) {
+                auto bound = c.bound.mergeWith(r);
+                if (bound.area() <= (c.area + r.area()) * (1 + overdraw)) {
+                    c.bound = bound;
+                    c.area += r.area();
+                    merged = true;
+                    break;
+                }
+            }
+
+            if (not merged)
+                clusters.pushBack({r, r.area()});
+        }
+
+        Region res;
+        for (auto const &c : clusters)
+            res.add(c.bound);
+        return res;
+    }
+
+    // MARK: Banding -----------------------------------------------------------
+
+    static bool _apply(_Op op, bool a, bool b) {
+        switch (op) {
+        case _Op::UNION:
+            return a or b;
+        case _Op::INTERSECT:
+            return a and b;
+        case _Op::SUBTRACT:
+            return a and not b;
+        }
+        return false;
+    }
+
+    // Collect the spans of the band covering [top, bottom), `cursor` is
+    // advanced past the bands that are above so the sweep stays linear.
+    static void _bandSpans(Slice<Recti> rects, usize &cursor, isize top, Vec<_Span> &spans) {
+        spans.clear();
+
+        while (cursor < rects.len() and rects[cursor].bottom() <= top)
+            cursor++;
+
+        for (usize i = cursor; i < rects.len() and rects[i].top() <= top; i++)
+            spans.pushBack({rects[i].start(), rects[i].end()});
+    }
+
+    static void _combineSpans(Slice<_Span> a, Slice<_Span> b, _Op op, Vec<_Span> &out) {
+        out.clear();
+
+        auto edge = [](Slice<_Span> spans, usize i) {
+            if (i >= spans.len() * 2)
+                return Limits<isize>::MAX;
+            return i % 2 == 0 ? spans[i / 2].start : spans[i / 2].end;
+        };
+
+        usize ia = 0, ib = 0;
+        bool inA = false, inB = false, inside = false;
+        isize start = 0;
+
+        while (ia < a.len() * 2 or ib < b.len() * 2) {
+            isize x = min(edge(a, ia), edge(b, ib));
+
+            while (edge(a, ia) == x) {
+                inA = not inA;
+                ia++;
+            }
+
+            while (edge(b, ib) == x) {
+                inB = not inB;
+                ib++;
+            }
+
+            bool now = _apply(op, inA, inB);
+            if (now and not inside) {
+                start = x;
+                inside = true;
+            } else if (not now and inside) {
+                out.pushBack({start, x});
+                inside = false;
+            }
+        }
+    }
+
+    void _pushBand(isize top, isize bottom, Slice<_Span> spans) {
+        if (spans.len() == 0)
+            return;
+
+        // Coalesce with the previous band if it's directly above and has
+        // the same spans.
+        usize prev = _rects.len();
+        while (prev > 0 and _rects[prev - 1].top() == last(_rects).top())
+            prev--;
+
+        bool coalesce =
+            _rects.len() > 0 and
+            last(_rects).bottom() == top and
+            _rects.len() - prev == spans.len();
+
+        for (usize i = 0; coalesce and i < spans.len(); i++) {
+            auto const &r = _rects[prev + i];
+            coalesce = r.start() == spans[i].start and r.end() == spans[i].end;
+        }
+
+        if (coalesce) {
+            for (usize i = prev; i < _rects.len(); i++)
+                _rects[i].height = bottom - _rects[i].top();
+            return;
+        }
+
+        for (auto const &s : spans)
+            _rects.pushBack({s.start, top, s.end - s.start, bottom - top});
+    }
+
+    static Region _combine(Region const &a, Region const &b, _Op op) {
+        Vec<isize> ys;
+        for (auto const &r : a._rects) {
+            ys.pushBack(r.top());
+            ys.pushBack(r.bottom());
+        }
+
+        for (auto const &r : b._rects) {
+            ys.pushBack(r.top());
+            ys.pushBack(r.bottom());
+        }
+
+        sort(ys, [](auto const &lhs, auto const &rhs) {
+            return lhs <=> rhs;
+        });
+
+        Region res;
+        Vec<_Span> spansA, spansB, spans;
+        usize cursorA = 0, cursorB = 0;
+
+        for (usize i = 0; i + 1 < ys.len(); i++) {
+            isize top = ys[i];
+            isize bottom = ys[i + 1];
+            if (top == bottom)
+                continue;
+
+            _bandSpans(a._rects, cursorA, top, spansA);
+            _bandSpans(b._rects, cursorB, top, spansB);
+            _combineSpans(spansA, spansB, op, spans);
+            res._pushBand(top, bottom, spans);
+        }
+
+        return res;
+    }
+
+    // MARK: Slice -------------------------------------------------------------
+
+    usize len() const {
+        return _rects.len();
+    }
+
+    Recti const *buf() const {
+        return _rects.buf();
+    }
+
+    Recti const &operator[](usize i) const {
+        return _rects[i];
+    }
+
+    Recti const *begin() const {
+        return buf();
+    }
+
+    Recti const *end() const {
+        return buf() + len();
+    }
+
+    void repr(Io::Emit &e) const {
+        e("(region {})", _rects);
+    }
+};
+
+} // namespace Karm::Math
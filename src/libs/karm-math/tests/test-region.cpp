@@ -0,0 +1,71 @@
+#include <karm-math/region.h>
+#include <karm-test/macros.h>
+
+namespace Karm::Math::Tests {
+
+test$("region-union-overlapping") {
+    Region r;
+    r.add({0, 0, 10, 10});
+    r.add({5, 5, 10, 10});
+
+    expectEq$(r.area(), 175);
+    expectEq$(r.len(), 3uz);
+    expect$(r.contains({12, 12}));
+    expectNot$(r.contains({12, 2}));
+
+    return Ok();
+}
+
+test$("region-union-coalesce") {
+    Region r;
+    r.add({0, 0, 10, 10});
+    r.add({0, 10, 10, 10});
+    r.add({10, 0, 10, 20});
+
+    expectEq$(r.len(), 1uz);
+    expectEq$(r.area(), 400);
+
+    return Ok();
+}
+
+test$("region-intersect") {
+    Region a{Recti{0, 0, 10, 10}};
+    Region b{Recti{5, 5, 10, 10}};
+    auto r = a.intersect(b);
+
+    expectEq$(r.len(), 1uz);
+    expectEq$(r.area(), 25);
+    expect$(r.contains({7, 7}));
+
+    expect$(a.intersect(Recti{20, 20, 5, 5}).empty());
+
+    return Ok();
+}
+
+test$("region-subtract") {
+    Region a{Recti{0, 0, 30, 30}};
+    auto r = a.subtract(Recti{10, 10, 10, 10});
+
+    expectEq$(r.area(), 800);
+    expectEq$(r.len(), 4uz);
+    expectNot$(r.contains({15, 15}));
+    expect$(r.contains({5, 15}));
+    expect$(r.contains({25, 15}));
+
+    return Ok();
+}
+
+test$("region-simplify") {
+    Region r;
+    r.add({0, 0, 10, 10});
+    r.add({0, 11, 10, 10});
+    r.add({100, 100, 10, 10});
+
+    auto s = r.simplify();
+    expectEq$(s.len(), 2uz);
+    expectEq$(s.area(), 310);
+
+    return Ok();
+}
+
+} // namespace Karm::Math::Tests
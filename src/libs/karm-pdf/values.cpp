@@ -66,7 +66,9 @@ void File::write(Io::Emit &e) const {
     XRef xref;
 
     for (auto const &[k, v] : body.iter()) {
-        xref.add(e.total(), k.gen);
+        // Pending newlines only count once flushed
+        (void)e.flush();
+        xref.put(k, e.total());
         e("{} {} obj\n", k.num, k.gen);
         v.write(e);
         e("\nendobj\n");
@@ -80,17 +82,22 @@ void File::write(Io::Emit &e) const {
     e("trailer\n");
     Value{trailer}.write(e);
 
-    e("startxref\n");
+    e("\nstartxref\n");
     e("{}\n", startxref);
     e("%%EOF");
 }
 
 void XRef::write(Io::Emit &e) const {
+    // Every entry is 20 bytes long, the first one heads the list of free
+    // objects
     e("0 {}\n", entries.len() + 1);
+    e("0000000000 65535 f \n");
     for (usize i = 0; i < entries.len(); ++i) {
         auto const &entry = entries[i];
         if (entry.used) {
-            e("{:010} {:05} n\n", entry.offset, entry.gen);
+            e("{:010} {:05} n \n", entry.offset, entry.gen);
+        } else {
+            e("0000000000 00000 f \n");
         }
     }
 }
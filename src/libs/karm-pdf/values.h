@@ -77,6 +77,14 @@ struct XRef {
         entries.pushBack({offset, gen, true});
     }
 
+    // Objects can be written out of order, the ones in between are free
+    // until they are
+    void put(Ref ref, usize offset) {
+        if (entries.len() < ref.num)
+            entries.resize(ref.num, {0, 0, false});
+        entries[ref.num - 1] = {offset, ref.gen, true};
+    }
+
     void write(Io::Emit &e) const;
 };
 
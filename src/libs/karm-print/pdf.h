@@ -29,20 +29,22 @@ struct PdfPrinter : public Printer {
 
         // Page
         for (auto &p : _pages) {
+            auto contentsRef = file.add(
+                alloc.alloc(),
+                Pdf::Stream{
+                    .dict = Pdf::Dict{
+                        {"Length"s, p.bytes().len()},
+                    },
+                    .data = p.bytes(),
+                }
+            );
+
             pagesKids.pushBack(file.add(
                 alloc.alloc(),
                 Pdf::Dict{
                     {"Type"s, Pdf::Name{"Page"s}},
                     {"Parent"s, pagesRef},
-                    {
-                        "Contents"s,
-                        Pdf::Stream{
-                            .dict = Pdf::Dict{
-                                {"Length"s, p.bytes().len()},
-                            },
-                            .data = p.bytes(),
-                        },
-                    },
+                    {"Contents"s, contentsRef},
                 }
             ));
         }
@@ -81,4 +83,125 @@ struct PdfPrinter : public Printer {
     }
 };
 
+// Writes each page out as soon as the next one begins, so only the page being
+// drawn is kept in memory. The page tree, the catalog and the
+// cross-reference table follow the last page, once finish() is called.
+struct PdfStreamPrinter : public Printer {
+    Io::Emit &_e;
+    PaperStock _stock;
+
+    Pdf::Ref _alloc;
+    Pdf::Ref _pagesRef;
+    Pdf::Array _pagesKids;
+    Pdf::XRef _xref;
+
+    Io::StringWriter _page;
+    Opt<Pdf::Canvas> _canvas;
+
+    PdfStreamPrinter(Io::Emit &e, PaperStock stock)
+        : _e(e), _stock(stock) {
+        _e("%PDF-1.7\n");
+        _e("%Powered By Karm PDF 🐢🏳️‍⚧️🦔\n");
+
+        // Pages point back to their parent, which is only written at the end
+        _pagesRef = _alloc.alloc();
+    }
+
+    void _beginObject(Pdf::Ref ref) {
+        // Pending newlines only count once flushed
+        (void)_e.flush();
+        _xref.put(ref, _e.total());
+        _e("{} {} obj\n", ref.num, ref.gen);
+    }
+
+    void _endObject() {
+        _e("\nendobj\n");
+    }
+
+    void _writeObject(Pdf::Ref ref, Pdf::Value const &value) {
+        _beginObject(ref);
+        value.write(_e);
+        _endObject();
+    }
+
+    // The content stream is copied from the page straight to the output,
+    // then the page is reused for the next one
+    void _endPage() {
+        if (not _canvas)
+            return;
+
+        (void)_canvas->_e.flush();
+        _canvas = NONE;
+
+        auto contentsRef = _alloc.alloc();
+        _beginObject(contentsRef);
+        Pdf::Value{Pdf::Dict{{"Length"s, _page.bytes().len()}}}.write(_e);
+        _e("\nstream\n");
+        (void)_e.flush();
+        (void)_e.write(_page.bytes());
+        _e("\nendstream");
+        _endObject();
+        _page.clear();
+
+        auto pageRef = _alloc.alloc();
+        _pagesKids.pushBack(pageRef);
+        _writeObject(
+            pageRef,
+            Pdf::Dict{
+                {"Type"s, Pdf::Name{"Page"s}},
+                {"Parent"s, _pagesRef},
+                {"Contents"s, contentsRef},
+            }
+        );
+    }
+
+    Gfx::Canvas &beginPage() override {
+        _endPage();
+        _canvas = Pdf::Canvas{_page};
+        return *_canvas;
+    }
+
+    Res<> finish() {
+        _endPage();
+
+        usize count = _pagesKids.len();
+        _writeObject(
+            _pagesRef,
+            Pdf::Dict{
+                {"Type"s, Pdf::Name{"Pages"s}},
+                {"MediaBox"s, Pdf::Array{usize{0}, usize{0}, _stock.width, _stock.height}},
+                {"Count"s, count},
+                {"Kids"s, std::move(_pagesKids)},
+            }
+        );
+
+        auto catalogRef = _alloc.alloc();
+        _writeObject(
+            catalogRef,
+            Pdf::Dict{
+                {"Type"s, Pdf::Name{"Catalog"s}},
+                {"Pages"s, _pagesRef},
+            }
+        );
+
+        auto startxref = try$(_e.flush());
+        _e("xref\n");
+        _xref.write(_e);
+
+        Pdf::Value trailer = Pdf::Dict{
+            {"Size"s, _xref.entries.len() + 1},
+            {"Root"s, catalogRef},
+        };
+        _e("trailer\n");
+        trailer.write(_e);
+
+        _e("\nstartxref\n");
+        _e("{}\n", startxref);
+        _e("%%EOF");
+        try$(_e.flush());
+
+        return Ok();
+    }
+};
+
 } // namespace Karm::Print
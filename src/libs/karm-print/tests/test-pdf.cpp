@@ -0,0 +1,120 @@
+#include <karm-io/aton.h>
+#include <karm-io/impls.h>
+#include <karm-print/pdf.h>
+#include <karm-test/macros.h>
+
+namespace Karm::Print::Tests {
+
+static void _drawPage(Gfx::Canvas &g, f64 x) {
+    g.beginPath();
+    g.rect({x, 10, 20, 20});
+    g.fill(Gfx::Fill{Gfx::BLACK});
+}
+
+static Str _str(Bytes bytes) {
+    return {(char const *)bytes.buf(), bytes.len()};
+}
+
+// Offsets are in bytes, so is the indexing of a Str
+static Str _from(Str str, usize offset) {
+    return {str.buf() + offset, str.len() - offset};
+}
+
+static Opt<usize> _lastIndexOf(Str str, Str needle) {
+    for (usize i = str.len(); i >= needle.len(); i--)
+        if (startWith(_from(str, i - needle.len()), needle) != Match::NO)
+            return i - needle.len();
+    return NONE;
+}
+
+// Every offset of the cross-reference table must land on the object it
+// names, and the one after startxref on the table itself
+static Res<> _expectXRef(Test::Driver &_driver, Str pdf) {
+    auto startxref = _lastIndexOf(pdf, "startxref\n"s);
+    expect$(startxref);
+
+    auto xref = Io::atou(_from(pdf, *startxref + 10));
+    expect$(xref);
+    expect$(*xref < pdf.len());
+
+    auto section = _from(pdf, *xref);
+    expect$(startWith(section, "xref\n0 "s) != Match::NO);
+    auto size = Io::atou(_from(section, 7));
+    expect$(size);
+
+    // The entries are 20 bytes each, the first one heads the free list
+    auto header = try$(Io::format("xref\n0 {}\n", *size));
+    expect$(startWith(section, header.str()) == Match::PARTIAL);
+    auto table = _from(section, header.len());
+    expect$(table.len() >= *size * 20);
+    expect$(startWith(table, "0000000000 65535 f \n"s) != Match::NO);
+
+    for (usize i = 1; i < *size; i++) {
+        Str entry{table.buf() + i * 20, 20};
+        expect$(entry[17] == 'n' and entry[19] == '\n');
+
+        auto offset = Io::atou(Str{entry.buf(), 10});
+        expect$(offset);
+        expect$(*offset < pdf.len());
+        auto obj = try$(Io::format("{} 0 obj\n", i));
+        expect$(startWith(_from(pdf, *offset), obj.str()) != Match::NO);
+    }
+
+    auto trailer = _lastIndexOf(pdf, "trailer\n"s);
+    expect$(trailer);
+    auto sizeKey = _lastIndexOf(pdf, "/Size "s);
+    expect$(sizeKey);
+    expect$(*sizeKey > *trailer);
+    auto count = Io::atou(_from(pdf, *sizeKey + 6));
+    expect$(count);
+    expectEq$(*count, *size);
+
+    return Ok();
+}
+
+test$("karm-print-pdf-stream") {
+    Io::BufferWriter buf;
+    Io::TextEncoder<> encoder{buf};
+    Io::Emit e{encoder};
+
+    PdfStreamPrinter printer{e, A4};
+    _drawPage(printer.beginPage(), 10);
+    _drawPage(printer.beginPage(), 40);
+    try$(printer.finish());
+
+    auto pdf = _str(buf.bytes());
+    try$(_expectXRef(_driver, pdf));
+
+    // Two pages with their content streams, the page tree and the catalog
+    expect$(startWith(pdf, "%PDF-1.7\n"s) != Match::NO);
+    expect$(_lastIndexOf(pdf, "6 0 obj\n"s));
+    expect$(not _lastIndexOf(pdf, "7 0 obj\n"s));
+
+    return Ok();
+}
+
+test$("karm-print-pdf") {
+    Io::BufferWriter buf;
+    Io::TextEncoder<> encoder{buf};
+    Io::Emit e{encoder};
+
+    PdfPrinter printer;
+    printer._stock = A4;
+    _drawPage(printer.beginPage(), 10);
+    _drawPage(printer.beginPage(), 40);
+    printer.write(e);
+    try$(e.flush());
+
+    auto pdf = _str(buf.bytes());
+    try$(_expectXRef(_driver, pdf));
+
+    // The page tree is allocated first but written after the pages
+    auto pages = _lastIndexOf(pdf, "1 0 obj\n"s);
+    auto page = _lastIndexOf(pdf, "3 0 obj\n"s);
+    expect$(pages and page and *pages > *page);
+    expect$(_lastIndexOf(pdf, "6 0 obj\n"s));
+
+    return Ok();
+}
+
+} // namespace Karm::Print::Tests
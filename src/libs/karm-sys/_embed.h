@@ -1,6 +1,7 @@
 #pragma once
 
 #include <karm-base/cons.h>
+#include <karm-base/func.h>
 #include <karm-base/range.h>
 #include <karm-base/time.h>
 #include <karm-mime/uti.h>
@@ -35,6 +36,8 @@ Res<Strong<Sys::Fd>> createErr();
 
 Res<Vec<Sys::DirEntry>> readDir(Mime::Url const &url);
 
+Res<> createDir(Mime::Url const &url);
+
 Res<Stat> stat(Mime::Url const &url);
 
 // MARK: User interactions -----------------------------------------------------
@@ -89,6 +92,19 @@ Res<> sleepUntil(TimeStamp);
 
 Res<> exit(i32);
 
+// MARK: Threads ---------------------------------------------------------------
+
+usize concurrency();
+
+// Calls task(i) for every i in [0, count) each on its own thread, the calling
+// thread running task(0), and returns once they have all returned. Fails
+// without calling anything on systems without threads.
+Res<> runThreads(usize count, Func<void(usize)> const &task);
+
+// Runs task on a detached thread of its own and returns right away. Fails
+// without calling it on systems without threads.
+Res<> spawnThread(Func<void()> task);
+
 // MARK: Asynchronous I/O ------------------------------------------------------
 
 Sched &globalSched();
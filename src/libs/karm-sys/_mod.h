@@ -15,5 +15,6 @@
 #include "proc.h"
 #include "socket.h"
 #include "stat.h"
+#include "thread.h"
 #include "time.h"
 #include "types.h"
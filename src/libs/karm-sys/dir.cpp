@@ -12,4 +12,11 @@ Res<Dir> Dir::open(Mime::Url url) {
     return Ok(Dir{entries, url});
 }
 
+Res<> Dir::create(Mime::Url url) {
+    auto res = _Embed::createDir(url);
+    if (not res and res.none().code() != Error::ALREADY_EXISTS)
+        return res;
+    return Ok();
+}
+
 } // namespace Karm::Sys
@@ -17,6 +17,9 @@ struct Dir {
 
     static Res<Dir> open(Mime::Url url);
 
+    // Succeeds if the directory already exists, its parent must exist.
+    static Res<> create(Mime::Url url);
+
     auto const &entries() const { return _entries; }
 
     auto const &path() const { return _url; }
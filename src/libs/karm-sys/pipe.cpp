@@ -6,9 +6,10 @@ namespace Karm::Sys {
 
 Res<Pipe> Pipe::create() {
     auto pipe = try$(_Embed::createPipe());
+    // The read end comes first, like with pipe(2)
     return Ok(Pipe{
-        FileWriter{pipe.car, "pipe:"_url},
-        FileReader{pipe.cdr, "pipe:"_url},
+        FileWriter{pipe.cdr, "pipe:"_url},
+        FileReader{pipe.car, "pipe:"_url},
     });
 }
 
@@ -0,0 +1,79 @@
+#include <karm-base/atomic.h>
+#include <karm-sys/thread.h>
+#include <karm-test/macros.h>
+
+namespace Karm::Sys::Tests {
+
+test$("parallel-for") {
+    Array<usize, 1000> out = {};
+    Atomic<usize> calls = 0uz;
+
+    parallelFor(out.len(), [&](usize i) {
+        out[i] = i * i;
+        calls.inc();
+    });
+
+    expectEq$(calls.load(), out.len());
+    for (usize i = 0; i < out.len(); i++)
+        expectEq$(out[i], i * i);
+
+    return Ok();
+}
+
+test$("parallel-for-empty") {
+    bool called = false;
+    parallelFor(0, [&](usize) {
+        called = true;
+    });
+    expect$(not called);
+
+    return Ok();
+}
+
+testAsync$("offload-async") {
+    usize result = 0;
+    co_trya$(offloadAsync([&] {
+        for (usize i = 1; i <= 100; i++)
+            result += i;
+    }));
+
+    if (result != 5050)
+        co_return Error::other("offloaded task did not run");
+
+    co_return Ok();
+}
+
+testAsync$("offload-async-parallel") {
+    // Many offloads in flight at once, each thread ends while the loop picks
+    // up the others
+    static constexpr usize COUNT = 64;
+    Array<usize, COUNT> out = {};
+    usize pending = COUNT;
+    bool failed = false;
+
+    Async::Promise<> done;
+    auto future = done.future();
+    for (usize i = 0; i < COUNT; i++) {
+        Async::detach(
+            offloadAsync([&out, i] {
+                out[i] = i * i;
+            }),
+            [&](Res<> res) {
+                failed |= not res;
+                if (--pending == 0)
+                    done.resolve(Ok());
+            }
+        );
+    }
+    co_trya$(future);
+
+    if (failed)
+        co_return Error::other("offload failed");
+    for (usize i = 0; i < COUNT; i++)
+        if (out[i] != i * i)
+            co_return Error::other("offloaded task did not run");
+
+    co_return Ok();
+}
+
+} // namespace Karm::Sys::Tests
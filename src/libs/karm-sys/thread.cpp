@@ -0,0 +1,72 @@
+#include <karm-base/atomic.h>
+
+#include "pipe.h"
+#include "thread.h"
+
+namespace Karm::Sys {
+
+void parallelFor(usize count, Func<void(usize)> task) {
+    usize workers = min(count, concurrency());
+    if (workers <= 1) {
+        for (usize i = 0; i < count; i++)
+            task(i);
+        return;
+    }
+
+    // Workers pick the next task until there are none left, so uneven
+    // tasks still keep every thread busy
+    Atomic<usize> next = 0uz;
+    Func<void(usize)> worker = [&](usize) {
+        for (usize i = next.fetchInc(); i < count; i = next.fetchInc())
+            task(i);
+    };
+
+    if (not _Embed::runThreads(workers, worker))
+        worker(0);
+}
+
+// Owned by the waiting side, which frees it once the worker has written to
+// the pipe. The worker only reaches it through a plain pointer, nothing
+// reference counted is copied or dropped on its thread. If the waiting frame
+// is destroyed first, the block is leaked rather than freed under the worker.
+struct _Offload {
+    Func<void()> task;
+    Pipe pipe;
+};
+
+Async::Task<> offloadAsync(Func<void()> task, Sched &sched) {
+    if (concurrency() <= 1) {
+        task();
+        co_return Ok();
+    }
+
+    // The scheduler can't be woken up from another thread, the worker
+    // writes to a pipe it waits on instead
+    auto pipe = co_try$(Pipe::create());
+    auto *offload = new _Offload{std::move(task), std::move(pipe)};
+    Fd *in = &*offload->pipe.in.fd();
+
+    auto spawned = _Embed::spawnThread([offload, in] {
+        offload->task();
+        u8 done = 1;
+        (void)in->write({&done, 1});
+    });
+
+    if (not spawned) {
+        offload->task();
+        delete offload;
+        co_return Ok();
+    }
+
+    // The task must be done once this returns, without the loop to wait on
+    // block on the pipe instead
+    u8 done = 0;
+    auto read = co_await sched.readAsync(offload->pipe.out.fd(), {&done, 1});
+    if (not read and not offload->pipe.out.fd()->read({&done, 1}))
+        co_return read.none();
+
+    delete offload;
+    co_return Ok();
+}
+
+} // namespace Karm::Sys
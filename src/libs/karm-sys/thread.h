@@ -0,0 +1,27 @@
+#pragma once
+
+#include <karm-base/func.h>
+
+#include "_embed.h"
+#include "async.h"
+
+namespace Karm::Sys {
+
+// Number of threads that can usefully run side by side, 1 on systems
+// without threads
+inline usize concurrency() {
+    return _Embed::concurrency();
+}
+
+// Runs task(i) for every i in [0, count) on up to concurrency() threads,
+// the calling one included, and returns once all of them are done. The
+// threads are started for each call. On systems without threads the tasks
+// run in order on the calling thread.
+void parallelFor(usize count, Func<void(usize)> task);
+
+// Runs task on a thread of its own, the returned task completes on sched
+// once it's done so its loop keeps running meanwhile. On systems without
+// threads the task runs right away on the calling thread.
+Async::Task<> offloadAsync(Func<void()> task, Sched &sched = globalSched());
+
+} // namespace Karm::Sys
@@ -1,7 +1,13 @@
 #pragma once
 
 #include "base.h"
+#include "coverage.h"
 #include "edit.h"
+#include "fallback.h"
 #include "font.h"
+#include "linebreak.h"
 #include "loader.h"
+#include "measure.h"
 #include "prose.h"
+#include "rope.h"
+#include "shaping.h"
@@ -2,6 +2,7 @@
 
 #include <karm-base/checked.h>
 #include <karm-base/distinct.h>
+#include <karm-base/enum.h>
 #include <karm-base/string.h>
 #include <karm-io/emit.h>
 
@@ -14,6 +15,7 @@ struct Glyph {
     u16 font;
 
     static Glyph const TOFU;
+    static Glyph const NONE; //< A rune merged into the glyph of a previous rune
 
     bool operator==(Glyph const &other) const = default;
 
@@ -21,6 +23,28 @@ struct Glyph {
 };
 
 constexpr Glyph Glyph::TOFU{0, 0};
+constexpr Glyph Glyph::NONE{0xFFFF, 0xFFFF};
+
+// MARK: FontFeatures ----------------------------------------------------------
+
+// OpenType features applied while shaping, they have no effect on fonts
+// without the matching lookups.
+enum struct FontFeatures : u16 {
+    NONE = 0,
+    CCMP = 1 << 0, //< Glyph composition and decomposition
+    LIGA = 1 << 1, //< Standard ligatures
+    CLIG = 1 << 2, //< Contextual ligatures
+    CALT = 1 << 3, //< Contextual alternates
+    RLIG = 1 << 4, //< Required ligatures
+    DLIG = 1 << 5, //< Discretionary ligatures
+    KERN = 1 << 6,
+    MARK = 1 << 7, //< Mark to base positioning
+    MKMK = 1 << 8, //< Mark to mark positioning
+
+    DEFAULT = CCMP | LIGA | CLIG | CALT | RLIG | KERN | MARK | MKMK,
+};
+
+FlagsEnum$(FontFeatures);
 
 // MARK: FontStyle -------------------------------------------------------------
 
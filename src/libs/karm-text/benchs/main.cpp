@@ -0,0 +1,285 @@
+#include <karm-io/aton.h>
+#include <karm-json/stringify.h>
+#include <karm-math/rand.h>
+#include <karm-sys/entry.h>
+#include <karm-sys/time.h>
+#include <karm-text/linebreak.h>
+#include <karm-text/measure.h>
+#include <karm-text/prose.h>
+#include <karm-text/run.h>
+
+namespace Karm::Text::Benchs {
+
+// Scenarios return a checksum of their output so a change in the results
+// of the line breaker shows up next to its timings.
+struct Scenario {
+    Str name;
+    Hash (*run)();
+};
+
+// MARK: Corpus ----------------------------------------------------------------
+
+static Array const LATIN_WORDS = {
+    "the"s, "quick"s, "brown"s, "fox"s, "jumps"s, "over"s, "lazy"s, "dog"s,
+    "(parenthesized)"s, "well-known"s, "3.14"s, "$100"s, "100%"s, "end."s,
+    "question?"s, "https://example.com/a/b"s, "\"quoted\""s, "non breaking"s,
+};
+
+static Vec<Rune> _latin(usize words) {
+    Math::Rand rand{0x5eed};
+    Vec<Rune> runes;
+    for (usize i = 0; i < words; i++) {
+        for (auto rune : iterRunes(LATIN_WORDS[rand.nextInt(LATIN_WORDS.len())]))
+            runes.pushBack(rune);
+        runes.pushBack(rand.nextInt(40) == 0 ? '\n' : ' ');
+    }
+    return runes;
+}
+
+static Vec<Rune> _cjk(usize len) {
+    Math::Rand rand{0x5eed};
+    Vec<Rune> runes;
+    for (usize i = 0; i < len; i++) {
+        if (rand.nextInt(20) == 0)
+            runes.pushBack(rand.nextInt(2) ? U'。' : U'「');
+        else
+            runes.pushBack(0x4e00 + rand.nextInt(0x5000));
+    }
+    return runes;
+}
+
+static Vec<LineSegment> _segments(usize len) {
+    Math::Rand rand{0x5eed};
+    Vec<LineSegment> segments;
+    for (usize i = 0; i < len; i++) {
+        segments.pushBack({
+            .width = rand.nextDouble(10, 80),
+            .trailing = 4,
+            .mandatory = rand.nextInt(200) == 0,
+        });
+    }
+    return segments;
+}
+
+// MARK: Scenarios -------------------------------------------------------------
+
+static Hash _countBreaks(Slice<Rune> runes) {
+    usize allowed = 0;
+    usize mandatory = 0;
+    lineBreaks(runes, [&](usize, Break brk) {
+        if (brk == Break::MANDATORY)
+            mandatory++;
+        else
+            allowed++;
+    });
+    return allowed << 32 | mandatory;
+}
+
+static Hash _breaksLatin() {
+    static auto runes = _latin(100000);
+    return _countBreaks(runes);
+}
+
+static Hash _breaksCjk() {
+    static auto runes = _cjk(500000);
+    return _countBreaks(runes);
+}
+
+static Hash _fit(LineFit fit) {
+    static auto segments = _segments(100000);
+    auto starts = fitLines(segments, 600, fit);
+    return hash(bytes(starts));
+}
+
+static Hash _fitGreedy() {
+    return _fit(LineFit::GREEDY);
+}
+
+static Hash _fitTotal() {
+    return _fit(LineFit::TOTAL_FIT);
+}
+
+static Hash _prose(LineFit fit) {
+    static auto runes = _latin(5000);
+    static Opt<Font> font = NONE;
+    if (not font)
+        font = Font::fallback();
+
+    Prose prose{
+        ProseStyle{
+            .font = *font,
+            .multiline = true,
+        }
+            .withLineFit(fit)
+    };
+    prose.append(runes);
+    prose.layout(400);
+    return prose._lines.len();
+}
+
+static Hash _proseGreedy() {
+    return _prose(LineFit::GREEDY);
+}
+
+static Hash _proseTotal() {
+    return _prose(LineFit::TOTAL_FIT);
+}
+
+// Intrinsic sizing asks for the widths of many short runs, compare
+// measuring them with laying out their cells.
+static Hash _runs(bool layout) {
+    static auto runes = _latin(20000);
+    static Opt<Font> font = NONE;
+    if (not font)
+        font = Font::fallback();
+
+    f64 total = 0;
+    for (usize start = 0; start < runes.len(); start += 64) {
+        auto chunk = sub(runes, start, min(start + 64, runes.len()));
+        if (layout)
+            total += Run::from(*font, chunk).layout().x;
+        else
+            total += measure(*font, chunk).width;
+    }
+    return (Hash)total;
+}
+
+static Hash _runLayout() {
+    return _runs(true);
+}
+
+static Hash _runMeasure() {
+    return _runs(false);
+}
+
+static Array SCENARIOS = {
+    Scenario{"breaks-latin", _breaksLatin},
+    Scenario{"breaks-cjk", _breaksCjk},
+    Scenario{"fit-greedy", _fitGreedy},
+    Scenario{"fit-total", _fitTotal},
+    Scenario{"prose-greedy", _proseGreedy},
+    Scenario{"prose-total", _proseTotal},
+    Scenario{"run-layout", _runLayout},
+    Scenario{"run-measure", _runMeasure},
+};
+
+// MARK: Runner ----------------------------------------------------------------
+
+struct Options {
+    usize warmup = 3;
+    usize iterations = 30;
+    Opt<Str> filter = NONE;
+    bool json = false;
+};
+
+struct Result {
+    Str name;
+    Vec<TimeSpan> samples;
+    Hash checksum;
+
+    TimeSpan percentile(f64 p) const {
+        usize i = min((usize)(p * samples.len()), samples.len() - 1);
+        return samples[i];
+    }
+
+    Json::Value toJson() const {
+        Json::Object obj;
+        obj.put("name"s, String{name});
+        obj.put("iterations"s, (Json::Integer)samples.len());
+        obj.put("min"s, (Json::Integer)first(samples).toUSecs());
+        obj.put("p50"s, (Json::Integer)percentile(0.5).toUSecs());
+        obj.put("p90"s, (Json::Integer)percentile(0.9).toUSecs());
+        obj.put("max"s, (Json::Integer)last(samples).toUSecs());
+        obj.put("checksum"s, (Json::Integer)checksum);
+        return obj;
+    }
+};
+
+static Result _run(Scenario const &scenario, Options const &options) {
+    for (usize i = 0; i < options.warmup; i++)
+        scenario.run();
+
+    Result result{scenario.name, {}, scenario.run()};
+    for (usize i = 0; i < options.iterations; i++) {
+        auto start = Sys::now();
+        scenario.run();
+        result.samples.pushBack(Sys::now() - start);
+    }
+
+    sort(result.samples, [](auto &a, auto &b) {
+        return a.toUSecs() <=> b.toUSecs();
+    });
+
+    return result;
+}
+
+static Res<Options> _parseOptions(Sys::Context &ctx) {
+    auto &args = Sys::useArgs(ctx);
+    Options options;
+
+    auto next = [&](usize &i) -> Res<Str> {
+        if (i + 1 >= args.len())
+            return Error::invalidInput("missing option value");
+        return Ok(args[++i]);
+    };
+
+    auto nextCount = [&](usize &i) -> Res<usize> {
+        auto count = Io::atoi(try$(next(i)));
+        if (not count or *count < 0)
+            return Error::invalidInput("expected a positive number");
+        return Ok(*count);
+    };
+
+    for (usize i = 0; i < args.len(); i++) {
+        auto arg = args[i];
+        if (arg == "--warmup") {
+            options.warmup = try$(nextCount(i));
+        } else if (arg == "--iterations") {
+            options.iterations = max(try$(nextCount(i)), 1uz);
+        } else if (arg == "--filter") {
+            options.filter = try$(next(i));
+        } else if (arg == "--json") {
+            options.json = true;
+        } else {
+            return Error::invalidInput("unknown option");
+        }
+    }
+
+    return Ok(options);
+}
+
+} // namespace Karm::Text::Benchs
+
+Async::Task<> entryPointAsync(Sys::Context &ctx) {
+    using namespace Text::Benchs;
+
+    auto options = co_try$(_parseOptions(ctx));
+
+    Json::Array arr;
+    for (auto &scenario : SCENARIOS) {
+        if (options.filter and scenario.name != *options.filter)
+            continue;
+
+        auto result = _run(scenario, options);
+
+        if (options.json) {
+            arr.pushBack(result.toJson());
+            continue;
+        }
+
+        Sys::println(
+            "{}: min {} p50 {} p90 {} max {} checksum {:x}",
+            result.name,
+            first(result.samples),
+            result.percentile(0.5),
+            result.percentile(0.9),
+            last(result.samples),
+            result.checksum
+        );
+    }
+
+    if (options.json)
+        Sys::println("{}", co_try$(Json::stringify(arr)));
+
+    co_return Ok();
+}
@@ -1,5 +1,9 @@
+#include <karm-io/impls.h>
 #include <karm-logger/logger.h>
 #include <karm-pkg/bundle.h>
+#include <karm-sys/dir.h>
+#include <karm-sys/file.h>
+#include <karm-sys/stat.h>
 #include <karm-sys/time.h>
 
 #include "book.h"
@@ -7,13 +11,193 @@
 
 namespace Karm::Text {
 
+// MARK: Lazy Fontface ---------------------------------------------------------
+
+Fontface &LazyFontface::_load() const {
+    if (not _face) {
+        auto maybeFace = loadFontface(_url);
+        if (not maybeFace) {
+            logWarn("failed to load font {}: {}", _url, maybeFace.none());
+            _face = Fontface::fallback();
+        } else {
+            _face = maybeFace.take();
+        }
+    }
+    return **_face;
+}
+
+FontMetrics LazyFontface::metrics() const {
+    return _load().metrics();
+}
+
+FontAttrs LazyFontface::attrs() const {
+    return _attrs;
+}
+
+Glyph LazyFontface::glyph(Rune rune) {
+    return _load().glyph(rune);
+}
+
+f64 LazyFontface::advance(Glyph glyph) {
+    return _load().advance(glyph);
+}
+
+f64 LazyFontface::kern(Glyph prev, Glyph curr) {
+    return _load().kern(prev, curr);
+}
+
+void LazyFontface::contour(Gfx::Canvas &g, Glyph glyph) const {
+    _load().contour(g, glyph);
+}
+
+Coverage LazyFontface::coverage() const {
+    return _coverage;
+}
+
+ShapedWord LazyFontface::shape(Slice<Rune> runes, FontFeatures features) {
+    return _load().shape(runes, features);
+}
+
+u64 LazyFontface::digest() const {
+    return (1000003 * hash(bytes(_url.str()))) ^ _mtime._value;
+}
+
+// MARK: Font Index ------------------------------------------------------------
+
+Mime::Url fontIndexUrl() {
+    return "location://home/.cache/karm-fonts.index"_url;
+}
+
+static Res<Str> _readStr(Io::BScan &s) {
+    if (s.rem() < 4)
+        return Error::invalidData("truncated font index");
+    usize len = s.nextU32le();
+    if (s.rem() < len)
+        return Error::invalidData("truncated font index");
+    return Ok(s.nextStr(len));
+}
+
+static void _writeStr(Io::BEmit &e, Str str) {
+    e.writeU32le(str.len());
+    e.writeStr(str);
+}
+
+Res<Vec<FontInfo>> readFontIndex(Bytes bytes) {
+    Io::BScan s{bytes};
+    if (s.rem() < 12 or
+        s.nextU32le() != FONT_INDEX_MAGIC or
+        s.nextU32le() != FONT_INDEX_VERSION)
+        return Error::invalidData("unsupported font index");
+
+    usize count = s.nextU32le();
+    Vec<FontInfo> infos;
+    for (usize i = 0; i < count; i++) {
+        auto url = Mime::Url::parse(try$(_readStr(s)));
+        auto family = try$(_readStr(s));
+
+        if (s.rem() < 8 + 2 + 2 + 1 + 1 + 4)
+            return Error::invalidData("truncated font index");
+
+        TimeStamp mtime{s.nextU64le()};
+        FontAttrs attrs{
+            .family = family,
+            .weight = FontWeight{s.nextU16le()},
+            .stretch = FontStretch{s.nextU16le()},
+            .style = (FontStyle)s.nextU8le(),
+            .monospace = (Monospace)s.nextU8le(),
+        };
+
+        if (attrs.style >= FontStyle::NO_MATCH or
+            attrs.monospace >= Monospace::_LEN)
+            return Error::invalidData("invalid font attributes");
+
+        usize ranges = s.nextU32le();
+        if (s.rem() < ranges * 8)
+            return Error::invalidData("truncated font index");
+
+        Coverage coverage;
+        coverage._ranges.ensure(ranges);
+        for (usize j = 0; j < ranges; j++) {
+            Rune start = s.nextU32le();
+            Rune size = s.nextU32le();
+            coverage.add(Range<Rune>{start, size});
+        }
+
+        infos.pushBack({
+            .url = url,
+            .attrs = attrs,
+            .face = makeStrong<LazyFontface>(url, attrs, coverage, mtime),
+            .coverage = coverage,
+            .mtime = mtime,
+        });
+    }
+
+    return Ok(infos);
+}
+
+Res<> writeFontIndex(Io::BEmit &e, Slice<FontInfo> infos) {
+    e.writeU32le(FONT_INDEX_MAGIC);
+    e.writeU32le(FONT_INDEX_VERSION);
+    e.writeU32le(infos.len());
+
+    for (auto &info : infos) {
+        _writeStr(e, info.url.str());
+        _writeStr(e, info.attrs.family);
+        e.writeU64le(info.mtime._value);
+        e.writeU16le(info.attrs.weight.value());
+        e.writeU16le(info.attrs.stretch.value());
+        e.writeU8le(toUnderlyingType(info.attrs.style));
+        e.writeU8le(toUnderlyingType(info.attrs.monospace));
+
+        auto ranges = info.coverage.ranges();
+        e.writeU32le(ranges.len());
+        for (auto const &r : ranges) {
+            e.writeU32le(r.start);
+            e.writeU32le(r.size);
+        }
+    }
+
+    return Ok();
+}
+
+static Res<Vec<FontInfo>> _loadIndex(Mime::Url const &url) {
+    auto file = try$(Sys::File::open(url));
+    auto map = try$(Sys::mmap().map(file));
+    return readFontIndex(map.bytes());
+}
+
+static Res<> _saveIndex(Mime::Url const &url, Slice<FontInfo> infos) {
+    Io::BufferWriter buf;
+    Io::BEmit e{buf};
+    try$(writeFontIndex(e, infos));
+
+    try$(Sys::Dir::create(url.parent()));
+    auto file = try$(Sys::File::create(url));
+    try$(file.write(buf.bytes()));
+    return Ok();
+}
+
 // MARK: Font loading ----------------------------------------------------------
 
 Res<> FontBook::loadAll() {
     auto start = Sys::now();
 
+    auto indexUrl = fontIndexUrl();
+    Vec<FontInfo> index;
+    if (auto maybeIndex = _loadIndex(indexUrl))
+        index = maybeIndex.take();
+    else
+        logDebug("no usable font index at {}: {}", indexUrl, maybeIndex.none());
+
+    // Fonts are looked up by path in the index, urls don't have a total
+    // order since their port is optional
+    sort(index, [](auto const &lhs, auto const &rhs) {
+        return lhs.url.path <=> rhs.url.path;
+    });
+
     auto bundles = try$(Pkg::installedBundles());
     usize count = 0;
+    usize indexed = 0;
     for (auto &bundle : bundles) {
         auto maybeDir = Sys::Dir::open(bundle.url() / "fonts");
         if (not maybeDir)
@@ -27,6 +211,24 @@ Res<> FontBook::loadAll() {
 
             auto fontUrl = dir.path() / diren.name;
 
+            auto maybeStat = Sys::stat(fontUrl);
+            if (not maybeStat)
+                continue;
+            auto mtime = maybeStat.unwrap().modifyTime;
+
+            // Fonts that didn't change since the index was written are
+            // taken as is, their file isn't even opened.
+            auto i = search(index, [&](auto const &info) {
+                return info.url.path <=> fontUrl.path;
+            });
+
+            if (i and index[*i].url == fontUrl and index[*i].mtime == mtime) {
+                add(index[*i]);
+                count++;
+                indexed++;
+                continue;
+            }
+
             auto maybeFace = loadFontface(fontUrl);
             if (not maybeFace)
                 continue;
@@ -37,25 +239,45 @@ Res<> FontBook::loadAll() {
                 .url = fontUrl,
                 .attrs = face->attrs(),
                 .face = face,
+                .coverage = face->coverage(),
+                .mtime = mtime,
             });
             count++;
         }
     }
 
+    // Rewrite the index if a font was added, changed or removed
+    if (indexed != count or indexed != index.len()) {
+        if (auto res = _saveIndex(indexUrl, _faces); not res)
+            logWarn("failed to write font index to {}: {}", indexUrl, res.none());
+    }
+
     auto ibmVga = Fontface::fallback();
 
     add({
         .url = ""_url,
         .attrs = ibmVga->attrs(),
         .face = ibmVga,
+        .coverage = ibmVga->coverage(),
     });
 
     auto elapsed = Sys::now() - start;
-    logDebug("Loaded {} fonts in {}", count, elapsed);
+    logDebug("Loaded {} fonts ({} from the index) in {}", count, indexed, elapsed);
 
     return Ok();
 }
 
+static Opt<FontBook> _installedFonts = NONE;
+
+FontBook const &installedFonts() {
+    if (not _installedFonts) {
+        _installedFonts = FontBook{};
+        if (auto res = _installedFonts->loadAll(); not res)
+            logWarn("failed to load installed fonts: {}", res.none());
+    }
+    return *_installedFonts;
+}
+
 // MARK: Family Gathering ------------------------------------------------------
 
 static Str _nextWord(Io::SScan &s) {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <karm-base/set.h>
+#include <karm-io/bscan.h>
 #include <karm-mime/url.h>
 #include <karm-sys/mmap.h>
 
@@ -27,10 +28,72 @@ struct FontInfo {
     Mime::Url url;
     FontAttrs attrs;
     Strong<Fontface> face;
+    Coverage coverage = {};
+    TimeStamp mtime = {};
 };
 
 Str commonFamily(Str lhs, Str rhs);
 
+// MARK: Lazy Fontface ---------------------------------------------------------
+
+// A fontface known from the font index, its file is only mapped and parsed
+// the first time something else than its attributes or coverage is needed.
+struct LazyFontface : public Fontface {
+    Mime::Url _url;
+    FontAttrs _attrs;
+    Coverage _coverage;
+    TimeStamp _mtime;
+    mutable Opt<Strong<Fontface>> _face = NONE;
+
+    LazyFontface(Mime::Url url, FontAttrs attrs, Coverage coverage, TimeStamp mtime)
+        : _url(std::move(url)),
+          _attrs(std::move(attrs)),
+          _coverage(std::move(coverage)),
+          _mtime(mtime) {}
+
+    bool loaded() const {
+        return _face.has();
+    }
+
+    Fontface &_load() const;
+
+    FontMetrics metrics() const override;
+
+    FontAttrs attrs() const override;
+
+    Glyph glyph(Rune rune) override;
+
+    f64 advance(Glyph glyph) override;
+
+    f64 kern(Glyph prev, Glyph curr) override;
+
+    void contour(Gfx::Canvas &g, Glyph glyph) const override;
+
+    Coverage coverage() const override;
+
+    ShapedWord shape(Slice<Rune> runes, FontFeatures features) override;
+
+    // Known from the url and modification time of the file, so the file
+    // doesn't have to be loaded.
+    u64 digest() const override;
+};
+
+// MARK: Font Index ------------------------------------------------------------
+
+// The attributes and coverage of every installed font, keyed by url and
+// modification time, so the fonts don't have to be parsed at startup.
+static constexpr u32 FONT_INDEX_MAGIC = 0x5846'464b; // "KFFX"
+static constexpr u32 FONT_INDEX_VERSION = 1;
+
+Mime::Url fontIndexUrl();
+
+// Entries are read back with a LazyFontface.
+Res<Vec<FontInfo>> readFontIndex(Bytes bytes);
+
+Res<> writeFontIndex(Io::BEmit &e, Slice<FontInfo> infos);
+
+// MARK: Font Book -------------------------------------------------------------
+
 struct FontBook {
     Vec<FontInfo> _faces;
     Array<String, toUnderlyingType(GenericFamily::_LEN)> _genericFamily;
@@ -41,6 +104,8 @@ struct FontBook {
 
     Strong<Fontface> load(Mime::Url url, Opt<FontAttrs> attrs = NONE);
 
+    // Load every installed font, reusing the font index for the fonts that
+    // didn't change since it was written and rewriting it otherwise.
     Res<> loadAll();
 
     Vec<String> families() const;
@@ -54,4 +119,7 @@ struct FontBook {
     Vec<Strong<Fontface>> queryFamily(String family) const;
 };
 
+// The fonts installed on the system, loaded on first use.
+FontBook const &installedFonts();
+
 } // namespace Karm::Text
@@ -1,8 +1,16 @@
+#include <karm-io/aton.h>
+#include <karm-io/funcs.h>
 #include <karm-sys/entry.h>
 #include <karm-sys/file.h>
 #include <karm-sys/mmap.h>
+#include <karm-sys/time.h>
 #include <karm-text/book.h>
+#include <karm-text/edit.h>
+#include <karm-text/fallback.h>
 #include <karm-text/loader.h>
+#include <karm-text/prose.h>
+#include <karm-text/run.h>
+#include <karm-text/shaping.h>
 #include <karm-text/ttf.h>
 
 static void _dumpGpos(Ttf::Gpos const &gpos) {
@@ -78,6 +86,27 @@ Async::Task<> entryPointAsync(Sys::Context &ctx) {
     } else if (verb == "dump-db") {
         Text::FontBook book;
         co_try$(book.loadAll());
+        for (auto &info : book._faces)
+            Sys::println("{} {#} {}", info.url, info.attrs.family, info.coverage);
+        co_return Ok();
+    } else if (verb == "dump-fallback") {
+        if (args.len() != 2)
+            co_return Error::invalidInput("Usage: karm-text.cli dump-fallback <text>");
+
+        Text::FontBook book;
+        co_try$(book.loadAll());
+
+        auto fallback = Text::FontFallback::make(book, {});
+
+        Vec<Rune> runes;
+        for (auto rune : iterRunes(args[1]))
+            runes.pushBack(rune);
+
+        fallback->segment(runes, [&](urange range, usize face) {
+            Sys::println("{} {#}", range, fallback->face(face).attrs().family);
+        });
+        Sys::println("{}", fallback->stats());
+
         co_return Ok();
     } else if (verb == "dump-attr") {
         if (args.len() != 2)
@@ -88,8 +117,99 @@ Async::Task<> entryPointAsync(Sys::Context &ctx) {
 
         Sys::println("{}", font->attrs());
         co_return Ok();
+    } else if (verb == "bench-shape") {
+        if (args.len() != 3)
+            co_return Error::invalidInput("Usage: karm-text.cli bench-shape <font-url> <text-url>");
+
+        auto fontUrl = co_try$(Mime::parseUrlOrPath(args[1]));
+        auto textUrl = co_try$(Mime::parseUrlOrPath(args[2]));
+
+        auto start = Sys::now();
+        auto font = co_try$(Text::loadFont(16, fontUrl));
+        auto loadElapsed = Sys::now() - start;
+
+        auto file = co_try$(Sys::File::open(textUrl));
+        auto text = co_try$(Io::readAllUtf8(file));
+
+        start = Sys::now();
+        auto run = Text::Run::from(font, text.str());
+        auto size = run.layout();
+        auto shapeElapsed = Sys::now() - start;
+
+        // Same text again, every word is now in the shaping cache
+        start = Sys::now();
+        auto warmRun = Text::Run::from(font, text.str());
+        warmRun.layout();
+        auto warmElapsed = Sys::now() - start;
+
+        Sys::println("font loaded in {}", loadElapsed);
+        Sys::println("shaped {} runes ({} bytes) in {} (warm cache {})", run._runes.len(), text.len(), shapeElapsed, warmElapsed);
+        Sys::println("run size: {}", size);
+        Sys::println("{}", Text::globalShapingCache().stats());
+        co_return Ok();
+    } else if (verb == "bench-edit") {
+        if (args.len() > 2)
+            co_return Error::invalidInput("Usage: karm-text.cli bench-edit [lines]");
+
+        usize lineCount = 100000;
+        if (args.len() == 2) {
+            auto n = Io::atoi(args[1]);
+            if (not n or *n <= 0)
+                co_return Error::invalidInput("expected a positive number of lines");
+            lineCount = *n;
+        }
+
+        Io::StringWriter sw;
+        for (usize i = 0; i < lineCount; i++)
+            co_try$(Io::format(sw, "{}: The quick brown fox jumps over the lazy dog\n", i));
+
+        Text::Model model;
+        model.load(sw.str());
+
+        Text::Prose prose{{
+            .font = Text::Font::fallback(),
+            .multiline = true,
+        }};
+        prose.append(model.runes());
+
+        auto start = Sys::now();
+        prose.layout(640);
+        auto fullElapsed = Sys::now() - start;
+
+        // Type in the middle of the document, after each keystroke the
+        // prose replays the edit and is laid out again like Ui::input does.
+        usize synced = model.generation();
+        model._cur = {model.runes().len() / 2, model.runes().len() / 2};
+
+        Str typed = "Lorem ipsum dolor sit amet, consectetur adipiscing elit.\n";
+        Vec<TimeSpan> samples;
+        for (auto rune : iterRunes(typed)) {
+            model.insert(rune);
+
+            start = Sys::now();
+            for (auto const &change : model.changesSince(synced).unwrap())
+                prose.replace({change.pos, change.removed}, change.inserted);
+            synced = model.generation();
+            prose.layout(640);
+            samples.pushBack(Sys::now() - start);
+        }
+
+        sort(samples, [](auto &a, auto &b) {
+            return a.toUSecs() <=> b.toUSecs();
+        });
+
+        Sys::println("{} lines, {} runes", lineCount, prose._runes.len());
+        Sys::println("full layout in {}", fullElapsed);
+        Sys::println(
+            "keystroke: min {} p50 {} p99 {} max {}",
+            first(samples),
+            samples[samples.len() / 2],
+            samples[min(samples.len() * 99 / 100, samples.len() - 1)],
+            last(samples)
+        );
+        co_return Ok();
     } else {
-        Sys::errln("unknown verb: {} (expected: dump-ttf, dump-db, dump-attr)", verb);
+        Sys::errln("unknown verb: {} (expected: dump-ttf, dump-db, dump-fallback, dump-attr, bench-shape, bench-edit)", verb);
         co_return Error::invalidInput();
     }
 }
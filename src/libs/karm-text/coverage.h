@@ -0,0 +1,188 @@
+#pragma once
+
+#include <karm-base/range.h>
+#include <karm-base/vec.h>
+#include <karm-io/emit.h>
+
+namespace Karm::Text {
+
+// The set of runes a fontface has a glyph for, stored as sorted, non
+// overlapping and non contiguous ranges. Fonts cover a handful of blocks
+// so this stays small enough to be kept in the font index.
+struct Coverage {
+    Vec<Range<Rune>> _ranges{};
+
+    // MARK: Queries -----------------------------------------------------------
+
+    Slice<Range<Rune>> ranges() const {
+        return _ranges;
+    }
+
+    bool empty() const {
+        return _ranges.len() == 0;
+    }
+
+    // Number of runes in the set.
+    usize len() const {
+        usize res = 0;
+        for (auto const &r : _ranges)
+            res += r.size;
+        return res;
+    }
+
+    bool contains(Rune rune) const {
+        usize lo = 0, hi = _ranges.len();
+        while (lo < hi) {
+            usize mid = (lo + hi) / 2;
+            auto const &r = _ranges[mid];
+            if (rune < r.start)
+                hi = mid;
+            else if (rune >= r.end())
+                lo = mid + 1;
+            else
+                return true;
+        }
+        return false;
+    }
+
+    // MARK: Operations --------------------------------------------------------
+
+    void clear() {
+        _ranges.clear();
+    }
+
+    // Adding runes in increasing order is O(1), which is how fonts are
+    // scanned, other ranges are merged into place.
+    void add(Range<Rune> range) {
+        if (range.empty())
+            return;
+
+        if (empty() or range.start > last(_ranges).end()) {
+            _ranges.pushBack(range);
+            return;
+        }
+
+        if (range.start >= last(_ranges).start) {
+            auto &l = last(_ranges);
+            l = Range<Rune>::fromStartEnd(l.start, max(l.end(), range.end()));
+            return;
+        }
+
+        Vec<Range<Rune>> ranges;
+        ranges.ensure(_ranges.len() + 1);
+        bool inserted = false;
+        auto push = [&](Range<Rune> r) {
+            if (ranges.len() and r.start <= last(ranges).end()) {
+                auto &l = last(ranges);
+                l = Range<Rune>::fromStartEnd(l.start, max(l.end(), r.end()));
+            } else {
+                ranges.pushBack(r);
+            }
+        };
+
+        for (auto const &r : _ranges) {
+            if (not inserted and range.start < r.start) {
+                push(range);
+                inserted = true;
+            }
+            push(r);
+        }
+
+        if (not inserted)
+            push(range);
+
+        _ranges = std::move(ranges);
+    }
+
+    void add(Rune rune) {
+        add(Range<Rune>{rune, 1});
+    }
+
+    void add(Coverage const &other) {
+        for (auto const &r : other._ranges)
+            add(r);
+    }
+
+    bool operator==(Coverage const &other) const {
+        return sub(_ranges) == sub(other._ranges);
+    }
+
+    void repr(Io::Emit &e) const {
+        e("(coverage runes:{} ranges:{})", len(), _ranges.len());
+    }
+};
+
+// A coverage compressed into a two level bitmap for O(1) lookups. Runes are
+// grouped in pages of 256, empty and full pages are shared so a font
+// covering whole blocks costs two bytes per page.
+struct CoverageBitmap {
+    static constexpr usize PAGE_SHIFT = 8;
+    static constexpr usize PAGE_SIZE = 1 << PAGE_SHIFT;
+    static constexpr usize PAGE_WORDS = PAGE_SIZE / 64;
+    static constexpr u16 EMPTY = 0;
+    static constexpr u16 FULL = 1;
+
+    Vec<u16> _pages{}; //< rune >> PAGE_SHIFT -> page, stops after the last non empty page
+    Vec<u64> _words{}; //< page * PAGE_WORDS -> bits
+
+    CoverageBitmap() {
+        _words.resize(PAGE_WORDS * 2, 0);
+        for (usize i = 0; i < PAGE_WORDS; i++)
+            _words[FULL * PAGE_WORDS + i] = ~0ull;
+    }
+
+    CoverageBitmap(Coverage const &coverage)
+        : CoverageBitmap() {
+        for (auto const &r : coverage.ranges())
+            _add(r);
+    }
+
+    void _add(Range<Rune> range) {
+        for (Rune rune = range.start; rune < range.end();) {
+            usize p = rune >> PAGE_SHIFT;
+            Rune pageStart = p << PAGE_SHIFT;
+            Rune pageEnd = min(pageStart + (Rune)PAGE_SIZE, range.end());
+
+            if (p >= _pages.len())
+                _pages.resize(p + 1, EMPTY);
+
+            auto &page = _pages[p];
+            if (page == FULL) {
+                rune = pageEnd;
+                continue;
+            }
+
+            if (rune == pageStart and pageEnd == pageStart + PAGE_SIZE and page == EMPTY) {
+                page = FULL;
+                rune = pageEnd;
+                continue;
+            }
+
+            if (page == EMPTY) {
+                page = _words.len() / PAGE_WORDS;
+                _words.resize(_words.len() + PAGE_WORDS, 0);
+            }
+
+            for (; rune < pageEnd; rune++) {
+                usize bit = rune & (PAGE_SIZE - 1);
+                _words[page * PAGE_WORDS + bit / 64] |= 1ull << (bit % 64);
+            }
+        }
+    }
+
+    bool contains(Rune rune) const {
+        usize p = rune >> PAGE_SHIFT;
+        if (p >= _pages.len())
+            return false;
+
+        usize bit = rune & (PAGE_SIZE - 1);
+        return (_words[_pages[p] * PAGE_WORDS + bit / 64] >> (bit % 64)) & 1;
+    }
+
+    // Memory used by the bitmap in bytes.
+    usize bytes() const {
+        return _pages.len() * sizeof(u16) + _words.len() * sizeof(u64);
+    }
+};
+
+} // namespace Karm::Text
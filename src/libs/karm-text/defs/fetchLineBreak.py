@@ -0,0 +1,106 @@
+# Fetch LineBreak.txt from the Unicode Character Database and print out the
+# LINE_BREAK() macro calls for the ranges of runes sharing a line breaking
+# class, adjacent ranges of the same class are merged and runes that end up
+# as XX are left out, it's the default of lineBreakClass().
+#
+# They are followed by the UNASSIGNED_PICTOGRAPHIC() calls for the reserved
+# Extended_Pictographic runes of emoji-data.txt, LB30b keeps them together
+# with an emoji modifier.
+#
+# The version is pinned to the one the rules of linebreak.cpp implement,
+# later versions add classes LineBreakClass doesn't have.
+
+import requests
+
+VERSION = "14.0.0"
+UCD = f"https://www.unicode.org/Public/{VERSION}/ucd"
+
+# Unlisted runes don't all default to XX, the header of the file documents
+# these blocks as ID and PR but only later versions spell them out as
+# @missing lines.
+DEFAULTS = [
+    (0x3400, 0x4DBF, "ID"),  # CJK Unified Ideographs Extension A
+    (0x4E00, 0x9FFF, "ID"),  # CJK Unified Ideographs
+    (0xF900, 0xFAFF, "ID"),  # CJK Compatibility Ideographs
+    (0x20000, 0x2FFFD, "ID"),  # Plane 2
+    (0x30000, 0x3FFFD, "ID"),  # Plane 3
+    (0x1F000, 0x1FAFF, "ID"),  # Extended_Pictographic
+    (0x1FC00, 0x1FFFD, "ID"),  # Extended_Pictographic
+    (0x20A0, 0x20CF, "PR"),  # Currency Symbols
+]
+
+
+def parseRange(runes):
+    if ".." in runes:
+        start, end = [int(rune, 16) for rune in runes.split("..")]
+    else:
+        start = end = int(runes, 16)
+    return start, end
+
+
+r = requests.get(f"{UCD}/LineBreak.txt")
+r.raise_for_status()
+
+missing = []
+ranges = []
+for line in r.text.splitlines():
+    if line.startswith("# @missing:"):
+        runes, cls = [field.strip() for field in line[len("# @missing:") :].split(";")]
+        missing.append((*parseRange(runes), cls))
+        continue
+
+    line, _, comment = line.partition("#")
+    line = line.strip()
+    if not line:
+        continue
+
+    runes, cls = [field.strip() for field in line.split(";")]
+
+    # LB1, complex context runes that are marks resolve to CM, the comment
+    # starts with their general category
+    if cls == "SA" and comment.split()[0] in ("Mn", "Mc"):
+        cls = "CM"
+
+    ranges.append((*parseRange(runes), cls))
+
+# Listed runes win over the defaults, which win over the @missing lines
+classes = ["XX"] * 0x110000
+for start, end, cls in missing + DEFAULTS + ranges:
+    for rune in range(start, end + 1):
+        classes[rune] = cls
+
+merged = []
+for rune, cls in enumerate(classes):
+    if merged and merged[-1][2] == cls:
+        merged[-1] = (merged[-1][0], rune, cls)
+    else:
+        merged.append((rune, rune, cls))
+
+for start, end, cls in merged:
+    if cls != "XX":
+        print(f"LINE_BREAK(0x{start:04X}, 0x{end:04X}, {cls})")
+
+r = requests.get(f"{UCD}/emoji/emoji-data.txt")
+r.raise_for_status()
+
+# Reserved runes are listed on their own lines, named after their code point
+pictographics = []
+for line in r.text.splitlines():
+    if "#" not in line:
+        continue
+
+    data, comment = line.split("#", 1)
+    fields = [field.strip() for field in data.split(";")]
+    if len(fields) != 2 or fields[1] != "Extended_Pictographic":
+        continue
+    if "<reserved-" not in comment:
+        continue
+
+    start, end = parseRange(fields[0])
+    if pictographics and pictographics[-1][1] + 1 == start:
+        pictographics[-1] = (pictographics[-1][0], end)
+    else:
+        pictographics.append((start, end))
+
+for start, end in sorted(pictographics):
+    print(f"UNASSIGNED_PICTOGRAPHIC(0x{start:04X}, 0x{end:04X})")
@@ -0,0 +1,108 @@
+# Generate the line breaking conformance cases of the karm-text tests, in the
+# format of LineBreakTest.txt. Sequences of sample runes, one per class, are
+# broken by ICU's root line break iterator (PyICU), an implementation of
+# UAX #14 independent from linebreak.cpp.
+#
+# Every pair of samples is tried alone, across a space, a combining mark and
+# both, then random sequences of up to seven samples follow. The seed is
+# fixed so the output only changes with ICU. The samples have the same class
+# in Unicode 14, the version line-break.inc is pinned to, and in the versions
+# of ICU since.
+#
+# ICU tailors the default rules in two places, these samples are left out:
+# - NU, PR and PO, ICU implements LB25 with its regular expression while
+#   linebreak.cpp keeps to the pairs of the rule.
+# - HY, ICU doesn't break after a word-initial hyphen before a letter.
+
+import os
+import random
+
+import icu
+
+SAMPLES = {
+    "BK": 0x000B,
+    "CR": 0x000D,
+    "LF": 0x000A,
+    "CM": 0x0308,
+    "NL": 0x0085,
+    "WJ": 0x2060,
+    "ZW": 0x200B,
+    "GL": 0x00A0,
+    "SP": 0x0020,
+    "ZWJ": 0x200D,
+    "B2": 0x2014,
+    "BA": 0x0009,
+    "BB": 0x00B4,
+    "CB": 0xFFFC,
+    "CL": 0x007D,
+    "CP": 0x0029,
+    "EX": 0x0021,
+    "IN": 0x2024,
+    "NS": 0x17D6,
+    "OP": 0x0028,
+    "QU": 0x0022,
+    "IS": 0x002C,
+    "SY": 0x002F,
+    "AI": 0x00A7,
+    "AL": 0x0023,
+    "CJ": 0x3041,
+    "EB": 0x261D,
+    "EM": 0x1F3FB,
+    "H2": 0xAC00,
+    "H3": 0xAC01,
+    "HL": 0x05D0,
+    "ID": 0x231A,
+    "JL": 0x1100,
+    "JV": 0x1160,
+    "JT": 0x11A8,
+    "RI": 0x1F1E6,
+    "SA": 0x0E01,
+    "XX": 0xE000,
+    "CM (Mn)": 0x0301,
+    "ID (unassigned pictographic)": 0x1FFFD,
+    "AL (Arabic)": 0x0600,
+    "ID (unassigned Mahjong)": 0x1F02C,
+}
+
+RANDOM_SEQUENCES = 2000
+
+iterator = icu.BreakIterator.createLineInstance(icu.Locale.getRoot())
+
+
+def breaks(runes):
+    iterator.setText("".join(chr(rune) for rune in runes))
+
+    # Boundaries are offsets in UTF-16 code units
+    boundaries = set()
+    boundary = iterator.first()
+    while boundary != icu.BreakIterator.DONE:
+        boundaries.add(boundary)
+        boundary = iterator.nextBoundary()
+
+    line = []
+    offset = 0
+    for i, rune in enumerate(runes):
+        line.append("÷" if i > 0 and offset in boundaries else "×")
+        line.append(f"{rune:04X}")
+        offset += 2 if rune > 0xFFFF else 1
+    line.append("÷")
+    return " ".join(line)
+
+
+samples = list(SAMPLES.values())
+sequences = []
+for a in samples:
+    for b in samples:
+        for between in [[], [0x0020], [0x0308], [0x0308, 0x0020]]:
+            sequences.append([a, *between, b])
+
+random.seed(1)
+for _ in range(RANDOM_SEQUENCES):
+    sequences.append([random.choice(samples) for _ in range(random.randint(2, 7))])
+
+path = os.path.join(os.path.dirname(__file__), "../tests/res/line-break-icu.txt")
+with open(path, "w", encoding="utf-8") as f:
+    f.write(f"# Generated by defs/genLineBreakTest.py with ICU {icu.ICU_VERSION}\n")
+    f.write(f"# Unicode {icu.UNICODE_VERSION}\n")
+    for sequence in sequences:
+        f.write(breaks(sequence) + "\n")
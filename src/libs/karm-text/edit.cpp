@@ -97,10 +97,22 @@ Opt<Action> Action::fromEvent(App::Event &e) {
 
 // MARK: Model -----------------------------------------------------------------
 
+void Model::_journal(Change change) {
+    // The older half goes, views in sync with the model every frame are
+    // never that far behind
+    if (_changes.len() >= MAX_CHANGES) {
+        usize count = _changes.len() / 2;
+        _changes.removeRange(0, count);
+        _dropped += count;
+    }
+    _changes.pushBack(std::move(change));
+}
+
 void Model::_do(Record &r) {
     switch (r.op) {
     case INSERT:
-        _buf.insert(r.pos, r.rune);
+        _buf.insert(r.pos, {&r.rune, 1});
+        _journal({r.pos, 0, {r.rune}});
         break;
 
     case MOVE:
@@ -115,22 +127,24 @@ void Model::_do(Record &r) {
     case DELETE:
         auto start = min(_cur.head, r.pos);
         auto end = max(_cur.head, r.pos);
-        auto slice = sub(_buf, start, end);
-        r.buf = slice;
+        r.buf = _buf.collect({start, end - start});
         r.pos = start;
 
         _cur.head = start;
         _cur.tail = start;
 
-        _buf.removeRange(start, end - start);
+        _buf.remove({start, end - start});
+        _journal({start, end - start, {}});
         break;
     }
 }
 
 void Model::_undo(Record &r) {
+    // The text is restored from the snapshot, the inverse of the edit is
+    // still journaled so views can follow along.
     switch (r.op) {
     case INSERT:
-        _buf.removeAt(r.pos);
+        _journal({r.pos, 1, {}});
         break;
 
     case MOVE:
@@ -138,10 +152,11 @@ void Model::_undo(Record &r) {
         break;
 
     case DELETE:
-        _buf.insertMany(r.pos, r.buf);
+        _journal({r.pos, 0, r.buf});
         break;
     }
 
+    _buf = r.before;
     _cur = r.cur;
 }
 
@@ -155,6 +170,7 @@ void Model::_push(Op op, usize pos, Rune rune) {
     record.rune = rune;
     record.cur = _cur;
     record.group = _group;
+    record.before = _buf;
     _do(record);
 
     _index++;
@@ -246,17 +262,11 @@ usize Model::_nextWord(usize pos) const {
 }
 
 usize Model::_lineStart(usize pos) const {
-    while (pos != 0 and _buf[pos - 1] != '\n')
-        pos--;
-
-    return pos;
+    return _buf.lineStart(_buf.lineOf(pos));
 }
 
 usize Model::_lineEnd(usize pos) const {
-    while (pos != _buf.len() and _buf[pos] != '\n')
-        pos++;
-
-    return pos;
+    return _buf.lineEnd(_buf.lineOf(pos));
 }
 
 usize Model::_prevLine(usize pos) const {
@@ -405,7 +415,9 @@ void Model::selectAll() {
 
 String Model::copy() {
     StringBuilder sb;
-    sb.append(sub(_buf, _cur.head, _cur.tail));
+    _buf.iterChunks(urange::fromStartEnd(_cur.head, _cur.tail), [&](Slice<Rune> chunk) {
+        sb.append(chunk);
+    });
     return sb.take();
 }
 
@@ -6,6 +6,8 @@
 #include <karm-base/vec.h>
 #include <karm-sys/async.h>
 
+#include "rope.h"
+
 namespace Karm::Text {
 
 struct Action {
@@ -85,28 +87,66 @@ struct Model {
         Cur cur;
         Vec<Rune> buf;
         usize group;
+        Rope before; //< Snapshot of the text before the record was applied
+    };
+
+    // Edits of the buffer in the order they happened, views replay them
+    // to update their presentation incrementally.
+    struct Change {
+        usize pos;
+        usize removed;
+        Vec<Rune> inserted;
     };
 
-    Vec<Rune> _buf;
+    // Only the latest changes are journaled, views that fell further
+    // behind rebuild their presentation from the runes instead.
+    static constexpr usize MAX_CHANGES = 256;
+
+    Rope _buf;
+    Vec<Change> _changes;
+    usize _dropped = 0; //< Changes no longer in the journal
     Vec<Record> _records;
     usize _index{};
     usize _group{};
     Cur _cur{};
 
     Model(Str text = "") {
+        Vec<Rune> runes;
         for (auto r : iterRunes(text))
-            _buf.pushBack(r);
+            runes.pushBack(r);
+        _buf = Rope{runes};
     }
 
-    Slice<Rune> runes() const {
+    Rope const &runes() const {
         return _buf;
     }
 
+    // Loaded text isn't journaled, views rebuild from the runes
     void load(Str text) {
+        Vec<Rune> runes;
         for (auto r : iterRunes(text))
-            _buf.pushBack(r);
+            runes.pushBack(r);
+        _buf.insert(_buf.len(), runes);
+
+        _dropped = generation() + 1;
+        _changes.clear();
     }
 
+    // Counts every change made to the buffer
+    usize generation() const {
+        return _dropped + _changes.len();
+    }
+
+    // The changes made since the given generation, none if the journal
+    // doesn't go back that far
+    Opt<Slice<Change>> changesSince(usize generation) const {
+        if (generation < _dropped or generation - _dropped > _changes.len())
+            return NONE;
+        return next(_changes, generation - _dropped);
+    }
+
+    void _journal(Change change);
+
     // MARK: Operations
 
     void _do(Record &r);
@@ -0,0 +1,263 @@
+#include <karm-base/ctype.h>
+
+#include "fallback.h"
+
+namespace Karm::Text {
+
+FontFallback::FontFallback(Vec<Strong<Fontface>> faces) {
+    if (isEmpty(faces))
+        faces.pushBack(Fontface::fallback());
+
+    _candidates.ensure(faces.len());
+    usize base = 0;
+    for (auto &face : faces) {
+        _candidates.pushBack({.face = face, .base = (u16)base});
+        base += face->fonts();
+    }
+}
+
+static usize _score(FontAttrs attrs, FontQuery const &query) {
+    usize score = 0;
+    if (attrs.style != query.style)
+        score += 10000;
+    score += attrs.stretch.delta(query.stretch);
+    score += attrs.weight.delta(query.weight);
+    return score;
+}
+
+static Strong<FontFallback> _make(FontBook const &book, Opt<Strong<Fontface>> primary, FontQuery const &query) {
+    Vec<Strong<Fontface>> faces;
+
+    Opt<FontAttrs> primaryAttrs = NONE;
+    if (primary) {
+        faces.pushBack(*primary);
+        primaryAttrs = (*primary)->attrs();
+    }
+
+    Vec<Pair<usize>> order;
+    for (usize i = 0; i < book._faces.len(); i++) {
+        auto &info = book._faces[i];
+
+        // The primary face may have been loaded on its own, outside the book
+        if (primary and
+            (&info.face.unwrap() == &primary->unwrap() or
+             (info.attrs <=> *primaryAttrs) == 0))
+            continue;
+
+        order.pushBack({_score(info.attrs, query), i});
+    }
+
+    sort(order, [](auto const &lhs, auto const &rhs) {
+        if (lhs.car != rhs.car)
+            return lhs.car <=> rhs.car;
+        return lhs.cdr <=> rhs.cdr;
+    });
+
+    for (auto &[_, i] : order)
+        faces.pushBack(book._faces[i].face);
+
+    return makeStrong<FontFallback>(std::move(faces));
+}
+
+Strong<FontFallback> FontFallback::make(FontBook const &book, FontQuery query) {
+    return _make(book, book.queryClosest(query), query);
+}
+
+Strong<FontFallback> FontFallback::make(FontBook const &book, Strong<Fontface> primary) {
+    auto attrs = primary->attrs();
+    return _make(
+        book,
+        primary,
+        {
+            .family = attrs.family.str(),
+            .weight = attrs.weight,
+            .stretch = attrs.stretch,
+            .style = attrs.style,
+        }
+    );
+}
+
+// MARK: Resolution ------------------------------------------------------------
+
+bool FontFallback::_covers(usize face, Rune rune) {
+    // The primary face answers for most runes
+    if (face == 0)
+        _pick(0);
+
+    auto &candidate = _candidates[face];
+    if (candidate.bitmap)
+        return candidate.bitmap->contains(rune);
+
+    if (not candidate.coverage)
+        candidate.coverage = candidate.face->coverage();
+    return candidate.coverage->contains(rune);
+}
+
+void FontFallback::_pick(usize face) {
+    auto &candidate = _candidates[face];
+    if (candidate.bitmap)
+        return;
+
+    if (not candidate.coverage)
+        candidate.coverage = candidate.face->coverage();
+    candidate.bitmap = CoverageBitmap{*candidate.coverage};
+    candidate.coverage = NONE;
+    _stats.bitmaps++;
+}
+
+usize FontFallback::resolve(Rune rune) {
+    // Control characters are never drawn, don't let them pick a face
+    if (rune < 0x20)
+        return 0;
+
+    auto &slot = _cache[rune % CACHE_SIZE];
+    if (slot.rune == rune) {
+        _stats.hits++;
+        return slot.face;
+    }
+
+    _stats.misses++;
+
+    usize face = 0;
+    if (not _uncovered.has(rune)) {
+        bool found = false;
+        for (usize i = 0; i < _candidates.len(); i++) {
+            if (_covers(i, rune)) {
+                _pick(i);
+                face = i;
+                found = true;
+                break;
+            }
+        }
+
+        // Don't search every face again once the slot is reused
+        if (not found) {
+            _uncovered.put(rune);
+            _stats.uncovered++;
+        }
+    }
+
+    slot = {rune, (u16)face};
+    return face;
+}
+
+usize FontFallback::resolve(Slice<Rune> cluster) {
+    if (cluster.len() == 1)
+        return resolve(first(cluster));
+
+    for (usize i = 0; i < _candidates.len(); i++) {
+        if (_coversAll(i, cluster)) {
+            _pick(i);
+            return i;
+        }
+    }
+
+    return resolve(first(cluster));
+}
+
+bool FontFallback::_coversAll(usize face, Slice<Rune> cluster) {
+    for (auto rune : cluster) {
+        if (not _covers(face, rune))
+            return false;
+    }
+    return true;
+}
+
+bool FontFallback::_isMark(Rune rune) {
+    return (rune >= 0x0300 and rune <= 0x036F) or // Combining diacritical marks
+           (rune >= 0x1AB0 and rune <= 0x1AFF) or
+           (rune >= 0x1DC0 and rune <= 0x1DFF) or
+           (rune >= 0x200C and rune <= 0x200D) or // Joiners
+           (rune >= 0x20D0 and rune <= 0x20FF) or // Combining marks for symbols
+           (rune >= 0xFE00 and rune <= 0xFE0F) or // Variation selectors
+           (rune >= 0xFE20 and rune <= 0xFE2F) or
+           (rune >= 0xE0100 and rune <= 0xE01EF);
+}
+
+bool FontFallback::_isSticky(Rune rune) {
+    if (isAscii(rune))
+        return not isAsciiAlphaNum(rune);
+    return rune == 0xA0 or rune == 0x200B; // No-break and zero width space
+}
+
+usize FontFallback::_candidateOf(Glyph glyph) const {
+    // Bases grow with the candidates, find the last one at or before the glyph
+    usize lo = 0;
+    usize hi = _candidates.len();
+    while (hi - lo > 1) {
+        usize mid = lo + (hi - lo) / 2;
+        if (_candidates[mid].base <= glyph.font)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// MARK: Fontface --------------------------------------------------------------
+
+FontMetrics FontFallback::metrics() const {
+    return first(_candidates).face->metrics();
+}
+
+FontAttrs FontFallback::attrs() const {
+    return first(_candidates).face->attrs();
+}
+
+Glyph FontFallback::glyph(Rune rune) {
+    auto &candidate = _candidates[resolve(rune)];
+    auto res = candidate.face->glyph(rune);
+    res.font += candidate.base;
+    return res;
+}
+
+f64 FontFallback::advance(Glyph glyph) {
+    auto i = _candidateOf(glyph);
+    return _candidates[i].face->advance(_inner(i, glyph));
+}
+
+f64 FontFallback::kern(Glyph prev, Glyph curr) {
+    auto i = _candidateOf(prev);
+    if (_candidateOf(curr) != i)
+        return 0;
+    return _candidates[i].face->kern(_inner(i, prev), _inner(i, curr));
+}
+
+void FontFallback::contour(Gfx::Canvas &g, Glyph glyph) const {
+    auto i = _candidateOf(glyph);
+    _candidates[i].face->contour(g, _inner(i, glyph));
+}
+
+Coverage FontFallback::coverage() const {
+    Coverage res;
+    for (auto &candidate : _candidates)
+        res.add(candidate.face->coverage());
+    return res;
+}
+
+ShapedWord FontFallback::shape(Slice<Rune> runes, FontFeatures features) {
+    ShapedWord word;
+    segment(runes, [&](urange range, usize face) {
+        auto shaped = _candidates[face].face->shape(sub(runes, range.start, range.end()), features);
+        word.append(shaped, range.start, _candidates[face].base);
+    });
+    return word;
+}
+
+usize FontFallback::fonts() const {
+    auto &candidate = last(_candidates);
+    return candidate.base + candidate.face->fonts();
+}
+
+u64 FontFallback::digest() const {
+    u64 res = 0;
+    for (auto &candidate : _candidates) {
+        auto d = candidate.face->digest();
+        if (not d)
+            return 0;
+        res = (1000003 * res) ^ d;
+    }
+    return res;
+}
+
+} // namespace Karm::Text
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <karm-base/array.h>
+#include <karm-base/set.h>
+
+#include "book.h"
+#include "font.h"
+
+namespace Karm::Text {
+
+struct FallbackStats {
+    usize hits = 0;
+    usize misses = 0;
+    usize bitmaps = 0;   //< Coverage bitmaps built so far
+    usize uncovered = 0; //< Runes no face covers
+
+    void repr(Io::Emit &e) const {
+        e("(fallback-stats hits:{} misses:{} bitmaps:{} uncovered:{})", hits, misses, bitmaps, uncovered);
+    }
+};
+
+// Picks a fontface per rune among a list of candidates in priority order,
+// the first one is the primary face and is used for runes no candidate
+// covers. Glyphs carry their face in `Glyph::font`, like for a FontFamily,
+// so a fallback can be used anywhere a fontface is expected. Each candidate
+// takes as many of these values as it has fonts(), so a family or another
+// fallback can be a candidate too.
+struct FontFallback : public Fontface {
+    static constexpr usize CACHE_SIZE = 1024;
+    static constexpr Rune NO_RUNE = 0xFFFFFFFF;
+
+    // Most candidates are only probed for the odd rune the faces before
+    // them miss, so they are looked up in their coverage and only get a
+    // bitmap once they are picked.
+    struct Candidate {
+        Strong<Fontface> face;
+        u16 base = 0;                      //< First `Glyph::font` of the face
+        Opt<Coverage> coverage = NONE;     //< Fetched on first probe
+        Opt<CoverageBitmap> bitmap = NONE; //< Built once the face is picked
+    };
+
+    struct Slot {
+        Rune rune = NO_RUNE;
+        u16 face = 0;
+    };
+
+    Vec<Candidate> _candidates;
+    Array<Slot, CACHE_SIZE> _cache{};
+    Set<Rune> _uncovered{}; //< Runes already searched for in every face
+    FallbackStats _stats{};
+
+    FontFallback(Vec<Strong<Fontface>> faces);
+
+    // The closest face to `query` first, then the other faces of the book
+    // ordered by how well they match the style and weight of the query.
+    static Strong<FontFallback> make(FontBook const &book, FontQuery query);
+
+    // `primary` first, then the faces of the book ordered by how close they
+    // are to it.
+    static Strong<FontFallback> make(FontBook const &book, Strong<Fontface> primary);
+
+    // MARK: Resolution --------------------------------------------------------
+
+    bool _covers(usize face, Rune rune);
+
+    void _pick(usize face);
+
+    usize resolve(Rune rune);
+
+    Fontface &face(usize index) {
+        return *_candidates[index].face;
+    }
+
+    // The candidate a glyph comes from, and the glyph as that face knows it.
+    usize _candidateOf(Glyph glyph) const;
+
+    Glyph _inner(usize candidate, Glyph glyph) const {
+        glyph.font -= _candidates[candidate].base;
+        return glyph;
+    }
+
+    // Pick the first face covering every rune of a cluster (a base rune and
+    // the marks following it), or the face of the base rune if none does.
+    usize resolve(Slice<Rune> cluster);
+
+    // Split `runes` into segments of runes using the same face in a single
+    // pass, `emit` is called with the range of each segment and the index
+    // of its face. Spaces and common punctuation stay on the face of the
+    // preceding cluster when it covers them.
+    void segment(Slice<Rune> runes, auto emit) {
+        usize start = 0;
+        usize curr = 0;
+
+        for (usize i = 0; i < runes.len();) {
+            usize end = i + 1;
+            while (end < runes.len() and _isMark(runes[end]))
+                end++;
+
+            auto cluster = sub(runes, i, end);
+
+            usize face;
+            if (i > start and _isSticky(runes[i]) and _coversAll(curr, cluster))
+                face = curr;
+            else
+                face = resolve(cluster);
+
+            if (i == 0) {
+                curr = face;
+            } else if (face != curr) {
+                emit(urange{start, i - start}, curr);
+                start = i;
+                curr = face;
+            }
+
+            i = end;
+        }
+
+        if (start < runes.len())
+            emit(urange{start, runes.len() - start}, curr);
+    }
+
+    bool _coversAll(usize face, Slice<Rune> cluster);
+
+    static bool _isMark(Rune rune);
+
+    static bool _isSticky(Rune rune);
+
+    FallbackStats stats() const {
+        return _stats;
+    }
+
+    // MARK: Fontface ----------------------------------------------------------
+
+    FontMetrics metrics() const override;
+
+    FontAttrs attrs() const override;
+
+    Glyph glyph(Rune rune) override;
+
+    f64 advance(Glyph glyph) override;
+
+    f64 kern(Glyph prev, Glyph curr) override;
+
+    void contour(Gfx::Canvas &g, Glyph glyph) const override;
+
+    Coverage coverage() const override;
+
+    // Each segment is shaped by its face, see segment().
+    ShapedWord shape(Slice<Rune> runes, FontFeatures features) override;
+
+    u64 digest() const override;
+
+    usize fonts() const override;
+};
+
+} // namespace Karm::Text
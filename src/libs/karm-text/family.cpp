@@ -86,25 +86,25 @@ FontAttrs FontFamily::attrs() const {
     return attrs;
 }
 
-Glyph FontFamily::glyph(Rune rune) {
-    Glyph res = Glyph::TOFU;
-
+usize FontFamily::_member(Rune rune) {
     for (usize i = 0; i < _members.len(); i++) {
         auto &member = _members[i];
         if (member.ranges and not member.ranges->contains(rune)) {
             continue;
         }
 
-        res = member.face->glyph(rune);
-        if (res != Glyph::TOFU) {
-            res.font = i;
-            break;
-        }
+        if (member.face->glyph(rune) != Glyph::TOFU)
+            return i;
     }
 
-    if (res == Glyph::TOFU)
-        logWarn("failed to find glyph for rune: {:x}", rune);
+    logWarn("failed to find glyph for rune: {:x}", rune);
+    return 0;
+}
 
+Glyph FontFamily::glyph(Rune rune) {
+    auto i = _member(rune);
+    auto res = _members[i].face->glyph(rune);
+    res.font = i;
     return res;
 }
 
@@ -128,4 +128,65 @@ void FontFamily::contour(Gfx::Canvas &g, Glyph glyph) const {
     g.scale(_adjust.sizeAdjust * member.adjust.sizeAdjust);
     member.face->contour(g, glyph);
 }
+
+Coverage FontFamily::coverage() const {
+    Coverage res;
+    for (auto &member : _members) {
+        auto faceCoverage = member.face->coverage();
+        if (not member.ranges) {
+            res.add(faceCoverage);
+            continue;
+        }
+
+        for (auto const &r : member.ranges->_r) {
+            for (auto const &c : faceCoverage.ranges()) {
+                auto start = max(r.start, c.start);
+                auto end = min(r.end(), c.end());
+                if (start < end)
+                    res.add(Range<Rune>::fromStartEnd(start, end));
+            }
+        }
+    }
+    return res;
+}
+
+ShapedWord FontFamily::shape(Slice<Rune> runes, FontFeatures features) {
+    ShapedWord word;
+
+    auto emit = [&](usize start, usize end, usize i) {
+        auto &member = _members[i];
+        auto shaped = member.face->shape(sub(runes, start, end), features);
+        word.append(shaped, start, i, member.adjust.sizeAdjust * _adjust.sizeAdjust);
+    };
+
+    usize start = 0;
+    usize curr = 0;
+    for (usize i = 0; i < runes.len(); i++) {
+        auto member = _member(runes[i] == '\n' ? ' ' : runes[i]);
+        if (i == 0) {
+            curr = member;
+        } else if (member != curr) {
+            emit(start, i, curr);
+            start = i;
+            curr = member;
+        }
+    }
+
+    if (start < runes.len())
+        emit(start, runes.len(), curr);
+
+    return word;
+}
+
+u64 FontFamily::digest() const {
+    u64 res = hash(_adjust.sizeAdjust);
+    for (auto &member : _members) {
+        auto d = member.face->digest();
+        if (not d)
+            return 0;
+        res = (1000003 * res) ^ d ^ hash(member.adjust.sizeAdjust);
+    }
+    return res;
+}
+
 } // namespace Karm::Text
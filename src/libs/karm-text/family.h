@@ -52,6 +52,9 @@ struct FontFamily : public Fontface {
 
     FontAttrs attrs() const override;
 
+    // The member drawing `rune`, the first one if none has a glyph for it.
+    usize _member(Rune rune);
+
     Glyph glyph(Rune rune) override;
 
     f64 advance(Glyph glyph) override;
@@ -59,6 +62,17 @@ struct FontFamily : public Fontface {
     f64 kern(Glyph prev, Glyph curr) override;
 
     void contour(Gfx::Canvas &g, Glyph glyph) const override;
+
+    Coverage coverage() const override;
+
+    // Runes are shaped by their member, a run at a time.
+    ShapedWord shape(Slice<Rune> runes, FontFeatures features) override;
+
+    u64 digest() const override;
+
+    usize fonts() const override {
+        return _members.len();
+    }
 };
 
 } // namespace Karm::Text
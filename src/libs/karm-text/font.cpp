@@ -6,10 +6,58 @@
 
 namespace Karm::Text {
 
+void ShapedWord::append(ShapedWord const &other, usize start, u16 font, f64 scale) {
+    glyphs.ensure(glyphs.len() + other.glyphs.len());
+    for (auto g : other.glyphs) {
+        g.glyph.font += font;
+        g.runes.start += start;
+        g.xpos = width + g.xpos * scale;
+        g.ypos *= scale;
+        g.adv *= scale;
+        glyphs.pushBack(g);
+    }
+    width += other.width * scale;
+}
+
 Strong<Fontface> Fontface::fallback() {
     return makeStrong<VgaFontface>();
 }
 
+ShapedWord Fontface::shape(Slice<Rune> runes, FontFeatures features) {
+    ShapedWord word;
+    word.glyphs.ensure(runes.len());
+
+    bool kerning = (features & FontFeatures::KERN) == FontFeatures::KERN;
+
+    f64 xpos = 0;
+    bool first = true;
+    Glyph prev = Glyph::TOFU;
+    for (usize i = 0; i < runes.len(); i++) {
+        auto glyph = this->glyph(runes[i] == '\n' ? ' ' : runes[i]);
+
+        if (not first and kerning)
+            xpos += kern(prev, glyph);
+        first = false;
+
+        auto adv = advance(glyph);
+        word.glyphs.pushBack({
+            .glyph = glyph,
+            .runes = {i, 1},
+            .xpos = xpos,
+            .adv = adv,
+        });
+        xpos += adv;
+        prev = glyph;
+    }
+    word.width = xpos;
+
+    return word;
+}
+
+u64 Fontface::digest() const {
+    return 0;
+}
+
 Font Font::fallback() {
     return {
         .fontface = Fontface::fallback(),
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <karm-base/ranges.h>
+#include <karm-base/range.h>
 #include <karm-base/rc.h>
+#include <karm-base/vec.h>
 #include <karm-gfx/canvas.h>
 #include <karm-math/rect.h>
 
 #include "base.h"
+#include "coverage.h"
 
 namespace Karm::Text {
 
@@ -50,6 +53,31 @@ struct FontMeasure {
     Math::Vec2f baseline;
 };
 
+// MARK: Shaped Words ----------------------------------------------------------
+
+// Positions are in em units, so a shaped word is independent of the font
+// size and the same entry is shared by every size of a fontface.
+struct ShapedGlyph {
+    Glyph glyph;
+    urange runes; //< The runes of the word this glyph stands for
+    f64 xpos = 0; //< Position of the glyph within the word
+    f64 ypos = 0; //< Offset of the glyph from the baseline, downward
+    f64 adv = 0;  //< Advance of the glyph
+};
+
+struct ShapedWord {
+    Vec<ShapedGlyph> glyphs;
+    f64 width = 0;
+
+    // Append the glyphs of a word shaped from the runes starting at `start`
+    // with a face of a family or a fallback, scaled by `scale`. `font` is
+    // added to the faces of the glyphs, a composite face numbers its own
+    // from zero.
+    void append(ShapedWord const &other, usize start, u16 font, f64 scale = 1);
+};
+
+// MARK: Fontface --------------------------------------------------------------
+
 struct Fontface {
     static Strong<Fontface> fallback();
 
@@ -66,15 +94,42 @@ struct Fontface {
     virtual f64 kern(Glyph prev, Glyph curr) = 0;
 
     virtual void contour(Gfx::Canvas &g, Glyph glyph) const = 0;
+
+    // The runes for which glyph() returns something else than TOFU.
+    virtual Coverage coverage() const = 0;
+
+    // Map runes to positioned glyphs. The default maps each rune to its
+    // glyph and applies pair kerning, fonts with layout tables override it
+    // to substitute and position glyphs according to `features`.
+    virtual ShapedWord shape(Slice<Rune> runes, FontFeatures features);
+
+    // A hash of the font data, the same from one run to the next as long as
+    // the font doesn't change. Zero for faces that can't tell.
+    virtual u64 digest() const;
+
+    // How many values `Glyph::font` takes in the glyphs of this face, one
+    // per member for a family or a fallback.
+    virtual usize fonts() const {
+        return 1;
+    }
 };
 
 struct Font {
     Strong<Fontface> fontface;
     f64 fontsize;
     f64 lineheight = 1.2;
+    FontFeatures features = FontFeatures::DEFAULT;
 
     static Font fallback();
 
+    // Fonts are the same when they draw with the same face
+    bool operator==(Font const &other) const {
+        return &fontface.unwrap() == &other.fontface.unwrap() and
+               fontsize == other.fontsize and
+               lineheight == other.lineheight and
+               features == other.features;
+    }
+
     FontMetrics metrics() const;
 
     Glyph glyph(Rune rune);
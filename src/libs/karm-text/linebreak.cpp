@@ -0,0 +1,397 @@
+#include <karm-base/array.h>
+
+#include "linebreak.h"
+
+namespace Karm::Text {
+
+using enum LineBreakClass;
+
+// MARK: Classes ---------------------------------------------------------------
+
+struct LineBreakRange {
+    Rune start;
+    Rune end;
+    LineBreakClass cls;
+};
+
+static constexpr Array LINE_BREAK_RANGES = {
+#define LINE_BREAK(START, END, CLASS) LineBreakRange{START, END, CLASS},
+#define UNASSIGNED_PICTOGRAPHIC(START, END)
+#include "defs/line-break.inc"
+#undef UNASSIGNED_PICTOGRAPHIC
+#undef LINE_BREAK
+};
+
+// Reserved runes that will be emojis, they are all ID
+static constexpr Array UNASSIGNED_PICTOGRAPHIC_RANGES = {
+#define LINE_BREAK(START, END, CLASS)
+#define UNASSIGNED_PICTOGRAPHIC(START, END) LineBreakRange{START, END, ID},
+#include "defs/line-break.inc"
+#undef UNASSIGNED_PICTOGRAPHIC
+#undef LINE_BREAK
+};
+
+static constexpr auto ASCII_LINE_BREAK_CLASSES = [] {
+    Array<LineBreakClass, 128> classes{};
+    for (auto &cls : classes)
+        cls = XX;
+    for (auto const &range : LINE_BREAK_RANGES)
+        for (Rune r = range.start; r <= range.end and r < 128; r++)
+            classes[r] = range.cls;
+    return classes;
+}();
+
+LineBreakClass lineBreakClass(Rune rune) {
+    if (rune < 128)
+        return ASCII_LINE_BREAK_CLASSES[rune];
+
+    auto index = search(LINE_BREAK_RANGES, [&](LineBreakRange const &range) {
+        if (rune < range.start)
+            return 1;
+        if (rune > range.end)
+            return -1;
+        return 0;
+    });
+
+    if (not index)
+        return XX;
+    return LINE_BREAK_RANGES[*index].cls;
+}
+
+static bool _isUnassignedPictographic(Rune rune) {
+    auto index = search(UNASSIGNED_PICTOGRAPHIC_RANGES, [&](LineBreakRange const &range) {
+        if (rune < range.start)
+            return 1;
+        if (rune > range.end)
+            return -1;
+        return 0;
+    });
+    return index.has();
+}
+
+// LB1: Resolve the classes that are tailored or depend on the script, the
+// complex context marks are already CM in the table
+static LineBreakClass _resolve(LineBreakClass cls) {
+    switch (cls) {
+    case AI:
+    case SG:
+    case XX:
+    case SA:
+        return AL;
+
+    case CJ:
+        return NS;
+
+    default:
+        return cls;
+    }
+}
+
+// MARK: Pair Table ------------------------------------------------------------
+
+static constexpr bool _isAny(LineBreakClass cls, auto... classes) {
+    return ((cls == classes) or ...);
+}
+
+// Rules LB11 to LB31 for a pair of classes with or without spaces in
+// between, the rules depending on more than the pair are handled by the
+// breaker.
+static constexpr bool _pairBreaks(LineBreakClass a, LineBreakClass b, bool spaces) {
+    // LB11
+    if (b == WJ or (not spaces and a == WJ))
+        return false;
+
+    // LB12, LB12a
+    if (not spaces and a == GL)
+        return false;
+    if (not spaces and b == GL and not _isAny(a, BA, HY))
+        return false;
+
+    // LB13
+    if (_isAny(b, CL, CP, EX, IS, SY))
+        return false;
+
+    // LB14 to LB17
+    if (a == OP)
+        return false;
+    if (a == QU and b == OP)
+        return false;
+    if (_isAny(a, CL, CP) and b == NS)
+        return false;
+    if (a == B2 and b == B2)
+        return false;
+
+    // LB18
+    if (spaces)
+        return true;
+
+    // LB19, LB20
+    if (a == QU or b == QU)
+        return false;
+    if (a == CB or b == CB)
+        return true;
+
+    // LB21, LB21b, LB22
+    if (_isAny(b, BA, HY, NS) or a == BB)
+        return false;
+    if (a == SY and b == HL)
+        return false;
+    if (b == IN)
+        return false;
+
+    // LB23, LB23a, LB24
+    if (_isAny(a, AL, HL) and b == NU)
+        return false;
+    if (a == NU and _isAny(b, AL, HL))
+        return false;
+    if (a == PR and _isAny(b, ID, EB, EM))
+        return false;
+    if (_isAny(a, ID, EB, EM) and b == PO)
+        return false;
+    if (_isAny(a, PR, PO) and _isAny(b, AL, HL))
+        return false;
+    if (_isAny(a, AL, HL) and _isAny(b, PR, PO))
+        return false;
+
+    // LB25, in its pair form
+    if (_isAny(a, CL, CP, NU) and _isAny(b, PO, PR))
+        return false;
+    if (_isAny(a, PO, PR) and _isAny(b, OP, NU))
+        return false;
+    if (_isAny(a, HY, IS, NU, SY) and b == NU)
+        return false;
+
+    // LB26, LB27
+    if (a == JL and _isAny(b, JL, JV, H2, H3))
+        return false;
+    if (_isAny(a, JV, H2) and _isAny(b, JV, JT))
+        return false;
+    if (_isAny(a, JT, H3) and b == JT)
+        return false;
+    if (_isAny(a, JL, JV, JT, H2, H3) and b == PO)
+        return false;
+    if (a == PR and _isAny(b, JL, JV, JT, H2, H3))
+        return false;
+
+    // LB28, LB29, LB30
+    if (_isAny(a, AL, HL) and _isAny(b, AL, HL))
+        return false;
+    if (a == IS and _isAny(b, AL, HL))
+        return false;
+    if (_isAny(a, AL, HL, NU) and b == OP)
+        return false;
+    if (a == CP and _isAny(b, AL, HL, NU))
+        return false;
+
+    // LB30b
+    if (a == EB and b == EM)
+        return false;
+
+    // LB31
+    return true;
+}
+
+static constexpr usize CLASS_COUNT = toUnderlyingType(_LEN);
+
+static_assert(CLASS_COUNT <= 64, "a row of the pair table must fit in a u64");
+
+// One bit per class pair, for breaks between adjacent runes (direct) and
+// for breaks with spaces in between (indirect).
+struct PairTable {
+    Array<u64, CLASS_COUNT> direct;
+    Array<u64, CLASS_COUNT> indirect;
+
+    bool breaks(LineBreakClass a, LineBreakClass b, bool spaces) const {
+        auto const &rows = spaces ? indirect : direct;
+        return (rows[toUnderlyingType(a)] >> toUnderlyingType(b)) & 1;
+    }
+};
+
+static constexpr PairTable PAIR_TABLE = [] {
+    PairTable table{};
+    for (usize a = 0; a < CLASS_COUNT; a++) {
+        for (usize b = 0; b < CLASS_COUNT; b++) {
+            auto ca = static_cast<LineBreakClass>(a);
+            auto cb = static_cast<LineBreakClass>(b);
+            if (_pairBreaks(ca, cb, false))
+                table.direct[a] |= 1ull << b;
+            if (_pairBreaks(ca, cb, true))
+                table.indirect[a] |= 1ull << b;
+        }
+    }
+    return table;
+}();
+
+// MARK: Break Opportunities ---------------------------------------------------
+
+Break LineBreaker::next(Rune rune) {
+    auto cls = _resolve(lineBreakClass(rune));
+    auto prev = _prev;
+    _prev = cls;
+
+    Break brk = Break::NONE;
+
+    if (_start) {
+        // LB2
+        _start = false;
+    } else if (_isAny(prev, BK, LF, NL) or (prev == CR and cls != LF)) {
+        // LB4, LB5
+        *this = {};
+        _start = false;
+        _prev = cls;
+        brk = Break::MANDATORY;
+    } else if (_isAny(cls, BK, CR, LF, NL)) {
+        // LB6
+        return Break::NONE;
+    } else if (cls == SP) {
+        // LB7
+        _spaces = true;
+        return Break::NONE;
+    } else if (cls == ZW) {
+        // LB7
+        _before = ZW;
+        _spaces = false;
+        return Break::NONE;
+    } else if (_before == ZW) {
+        // LB8
+        brk = Break::ALLOWED;
+    } else if (_isAny(cls, CM, ZWJ) and not _isAny(prev, SP, ZW)) {
+        // LB9, the mark takes the class of the rune it's attached to
+        return Break::NONE;
+    } else if (prev == ZWJ) {
+        // LB8a
+        brk = Break::NONE;
+    } else if (_hebrewDash and not _spaces and cls != CB) {
+        // LB21a
+        brk = Break::NONE;
+    } else if (_before == RI and cls == RI and not _spaces and _oddRegional) {
+        // LB30a
+        brk = Break::NONE;
+    } else if (_pictographic and cls == EM and not _spaces) {
+        // LB30b
+        brk = Break::NONE;
+    } else {
+        brk = PAIR_TABLE.breaks(_before, _isAny(cls, CM, ZWJ) ? AL : cls, _spaces)
+                  ? Break::ALLOWED
+                  : Break::NONE;
+    }
+
+    // LB10
+    if (_isAny(cls, CM, ZWJ))
+        cls = AL;
+
+    if (cls == SP) {
+        _spaces = true;
+        return brk;
+    }
+
+    if (_isAny(cls, BK, CR, LF, NL))
+        return brk;
+
+    _hebrewDash = _isAny(cls, HY, BA) and _before == HL and not _spaces;
+    _oddRegional = cls == RI and not (_before == RI and not _spaces and _oddRegional);
+    _pictographic = cls == ID and _isUnassignedPictographic(rune);
+    _before = cls;
+    _spaces = false;
+    return brk;
+}
+
+// MARK: Line Fitting ----------------------------------------------------------
+
+static Vec<usize> _fitGreedy(Slice<LineSegment> segments, f64 width) {
+    Vec<usize> starts;
+    f64 adv = 0;
+    bool empty = true;
+    for (usize i = 0; i < segments.len(); i++) {
+        auto const &segment = segments[i];
+        if (not empty and adv + segment.width > width) {
+            starts.pushBack(i);
+            adv = 0;
+        }
+
+        adv += segment.width + segment.trailing;
+        empty = false;
+
+        if (segment.mandatory and i + 1 < segments.len()) {
+            starts.pushBack(i + 1);
+            adv = 0;
+            empty = true;
+        }
+    }
+    return starts;
+}
+
+static constexpr f64 LINE_PENALTY = 10;
+static constexpr f64 OVERFULL_DEMERITS = 1e12;
+
+// Knuth and Plass demerits of a line, without the penalties of hyphens and
+// consecutive lines of different tightness.
+static f64 _demerits(f64 slack, f64 width) {
+    f64 ratio = slack / width;
+    f64 badness = 100 * ratio * ratio * ratio;
+    return (LINE_PENALTY + badness) * (LINE_PENALTY + badness);
+}
+
+// Find the breaks minimizing the sum of the demerits of a paragraph, the
+// last line is free as long as it fits. Lines can't be longer than the
+// width so each segment only looks back at the few ones that fit with it.
+static void _fitParagraph(Slice<LineSegment> segments, usize start, usize end, f64 width, Vec<usize> &starts) {
+    usize len = end - start;
+    Vec<f64> cost;
+    Vec<usize> from;
+    cost.resize(len + 1, 0);
+    from.resize(len + 1, 0);
+
+    for (usize j = 1; j <= len; j++) {
+        cost[j] = Limits<f64>::MAX;
+        f64 lineWidth = 0;
+        for (usize i = j; i > 0; i--) {
+            auto const &segment = segments[start + i - 1];
+            lineWidth += segment.width + (i == j ? 0 : segment.trailing);
+
+            f64 demerits;
+            if (lineWidth > width) {
+                if (i != j)
+                    break;
+                demerits = OVERFULL_DEMERITS;
+            } else if (j == len) {
+                demerits = 0;
+            } else {
+                demerits = _demerits(width - lineWidth, width);
+            }
+
+            if (cost[i - 1] + demerits < cost[j]) {
+                cost[j] = cost[i - 1] + demerits;
+                from[j] = i - 1;
+            }
+        }
+    }
+
+    usize first = starts.len();
+    for (usize j = from[len]; j > 0; j = from[j])
+        starts.pushBack(start + j);
+    reverse(mutSub(starts, first, starts.len()));
+}
+
+static Vec<usize> _fitTotal(Slice<LineSegment> segments, f64 width) {
+    Vec<usize> starts;
+    usize start = 0;
+    for (usize i = 0; i < segments.len(); i++) {
+        if (not segments[i].mandatory and i + 1 < segments.len())
+            continue;
+
+        _fitParagraph(segments, start, i + 1, width, starts);
+        if (i + 1 < segments.len())
+            starts.pushBack(i + 1);
+        start = i + 1;
+    }
+    return starts;
+}
+
+Vec<usize> fitLines(Slice<LineSegment> segments, f64 width, LineFit fit) {
+    if (fit == LineFit::TOTAL_FIT and width > 0)
+        return _fitTotal(segments, width);
+    return _fitGreedy(segments, width);
+}
+
+} // namespace Karm::Text
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <karm-base/vec.h>
+
+#include "base.h"
+
+// https://www.unicode.org/reports/tr14/
+
+namespace Karm::Text {
+
+// MARK: Classes ---------------------------------------------------------------
+
+// https://www.unicode.org/reports/tr14/#Table1
+enum struct LineBreakClass : u8 {
+    BK, //< Mandatory break
+    CR, //< Carriage return
+    LF, //< Line feed
+    CM, //< Combining mark
+    NL, //< Next line
+    SG, //< Surrogate
+    WJ, //< Word joiner
+    ZW, //< Zero width space
+    GL, //< Non-breaking glue
+    SP, //< Space
+    ZWJ, //< Zero width joiner
+
+    B2, //< Break opportunity before and after
+    BA, //< Break after
+    BB, //< Break before
+    HY, //< Hyphen
+    CB, //< Contingent break opportunity
+
+    CL, //< Close punctuation
+    CP, //< Close parenthesis
+    EX, //< Exclamation and interrogation
+    IN, //< Inseparable
+    NS, //< Nonstarter
+    OP, //< Open punctuation
+    QU, //< Quotation
+    IS, //< Infix numeric separator
+    NU, //< Numeric
+    PO, //< Postfix numeric
+    PR, //< Prefix numeric
+    SY, //< Symbols allowing break after
+
+    AI, //< Ambiguous
+    AL, //< Alphabetic
+    CJ, //< Conditional japanese starter
+    EB, //< Emoji base
+    EM, //< Emoji modifier
+    H2, //< Hangul LV syllable
+    H3, //< Hangul LVT syllable
+    HL, //< Hebrew letter
+    ID, //< Ideographic
+    JL, //< Hangul L jamo
+    JV, //< Hangul V jamo
+    JT, //< Hangul T jamo
+    RI, //< Regional indicator
+    SA, //< Complex context dependent (South East Asian)
+    XX, //< Unknown
+
+    _LEN,
+};
+
+LineBreakClass lineBreakClass(Rune rune);
+
+// MARK: Break Opportunities ---------------------------------------------------
+
+enum struct Break : u8 {
+    NONE,
+    ALLOWED,
+    MANDATORY,
+};
+
+// Finds the break opportunities of a text one rune at a time, using the
+// pair table approach of UAX #14 with the rules that need more context
+// (spaces, combining marks, regional indicators, reserved emojis and hebrew
+// hyphenation) tracked as state.
+struct LineBreaker {
+    LineBreakClass _before = LineBreakClass::SP; //< Last class that isn't a space or a mark
+    LineBreakClass _prev = LineBreakClass::BK;   //< Class of the previous rune
+    bool _start = true;
+    bool _spaces = false;     //< Spaces since `_before`
+    bool _hebrewDash = false; //< `_before` is a hyphen after a hebrew letter
+    bool _oddRegional = false;
+    bool _pictographic = false; //< `_before` is a reserved Extended_Pictographic rune
+
+    void reset() {
+        *this = {};
+    }
+
+    // The break opportunity between the previous rune and this one.
+    Break next(Rune rune);
+
+    // The break opportunity at the end of the text.
+    Break end() const {
+        return _start ? Break::NONE : Break::MANDATORY;
+    }
+};
+
+// Call `emit(index, brk)` for every break opportunity of `runes`, the
+// break is before the rune at `index`. The end of the text is reported as
+// a mandatory break at `runes.len()`.
+void lineBreaks(Slice<Rune> runes, auto emit) {
+    LineBreaker breaker;
+    for (usize i = 0; i < runes.len(); i++) {
+        auto brk = breaker.next(runes[i]);
+        if (brk != Break::NONE)
+            emit(i, brk);
+    }
+
+    if (breaker.end() != Break::NONE)
+        emit(runes.len(), breaker.end());
+}
+
+// MARK: Line Fitting ----------------------------------------------------------
+
+enum struct LineFit {
+    GREEDY,    //< Fill each line as much as possible, cheap and stable while typing
+    TOTAL_FIT, //< Minimize the raggedness of the whole paragraph, for print
+};
+
+// The text between two break opportunities.
+struct LineSegment {
+    f64 width;
+    f64 trailing = 0;       //< Width of the trailing spaces, they may hang past the end of the line
+    bool mandatory = false; //< The line must end after this segment
+};
+
+// Decide where lines start, the first line always starts at segment 0 and
+// is not included. Segments wider than the line get a line of their own.
+Vec<usize> fitLines(Slice<LineSegment> segments, f64 width, LineFit fit = LineFit::GREEDY);
+
+} // namespace Karm::Text
@@ -0,0 +1,18 @@
+#include "measure.h"
+
+namespace Karm::Text {
+
+TextMeasure measure(Font &font, Slice<Rune> runes) {
+    TextMeasure res;
+    f64 line = 0;
+    measureSegments(font, runes, [&](urange, LineSegment const &segment) {
+        res.longestWord = max(res.longestWord, segment.width);
+        line += segment.width + segment.trailing;
+        res.width = max(res.width, line);
+        if (segment.mandatory)
+            line = 0;
+    });
+    return res;
+}
+
+} // namespace Karm::Text
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "linebreak.h"
+#include "shaping.h"
+
+namespace Karm::Text {
+
+struct TextMeasure {
+    f64 width = 0;       //< Widest line if nothing is wrapped, the max-content width
+    f64 longestWord = 0; //< Widest segment without its trailing spaces, the min-content width
+
+    void repr(Io::Emit &e) const {
+        e("(text-measure width:{} longest-word:{})", width, longestWord);
+    }
+};
+
+// Split a text at its break opportunities and measure the pieces straight
+// from the advances in the shaping cache, without laying out any glyph.
+// `emit(runes, segment)` is called once per segment in order, breaks
+// inside a ligature are ignored.
+void measureSegments(Font &font, Slice<Rune> runes, auto emit) {
+    auto &cache = globalShapingCache();
+    bool kerning = (font.features & FontFeatures::KERN) == FontFeatures::KERN;
+    Glyph prev = Glyph::TOFU;
+    bool first = true;
+
+    LineBreaker breaker;
+    usize fed = 0; //< Runes given to the breaker so far
+
+    f64 xpos = 0;
+    usize segmentStart = 0;
+    f64 segmentPos = 0;
+    f64 inkEnd = 0; //< End of the last glyph that isn't a space
+    f64 penEnd = 0;
+
+    for (usize start = 0; start < runes.len();) {
+        auto end = wordEnd(runes, start);
+        auto &word = cache.shape(font.fontface, font.features, sub(runes, start, end));
+
+        for (usize i = 0; i < word.glyphs.len(); i++) {
+            auto &g = word.glyphs[i];
+            if (i == 0 and not first and kerning)
+                xpos += font.kern(prev, g.glyph);
+
+            Break brk = Break::NONE;
+            usize head = start + g.runes.start;
+            for (; fed < start + g.runes.end(); fed++) {
+                auto b = breaker.next(runes[fed]);
+                if (fed == head)
+                    brk = b;
+            }
+
+            f64 pos = xpos + g.xpos * font.fontsize;
+            if (brk != Break::NONE and head > segmentStart) {
+                emit(
+                    urange::fromStartEnd(segmentStart, head),
+                    LineSegment{inkEnd - segmentPos, penEnd - inkEnd, brk == Break::MANDATORY}
+                );
+                segmentStart = head;
+                segmentPos = inkEnd = penEnd = pos;
+            }
+
+            f64 glyphEnd = pos + g.adv * font.fontsize;
+            penEnd = max(penEnd, glyphEnd);
+            if (not isAsciiSpace(runes[head]))
+                inkEnd = max(inkEnd, glyphEnd);
+        }
+
+        if (any(word.glyphs)) {
+            xpos += word.width * font.fontsize;
+            prev = last(word.glyphs).glyph;
+            first = false;
+        }
+
+        // Runes without a glyph of their own still count for line breaking
+        for (; fed < end; fed++)
+            breaker.next(runes[fed]);
+
+        start = end;
+    }
+
+    if (segmentStart < runes.len()) {
+        emit(
+            urange::fromStartEnd(segmentStart, runes.len()),
+            LineSegment{inkEnd - segmentPos, penEnd - inkEnd, false}
+        );
+    }
+}
+
+// The intrinsic widths of a text, at the cost of a cache lookup per word.
+TextMeasure measure(Font &font, Slice<Rune> runes);
+
+} // namespace Karm::Text
@@ -1,4 +1,5 @@
 #include "prose.h"
+#include "shaping.h"
 
 namespace Karm::Text {
 
@@ -12,120 +13,306 @@ Prose::Prose(ProseStyle style, Str str) : _style(style) {
 
 // MARK: Prose --------------------------------------------------------------
 
-void Prose::_beginBlock() {
+void Prose::_beginBlock(usize runeStart) {
     _blocks.pushBack({
-        .runeRange = _runes.len(),
+        .runeRange = runeStart,
         .cellRange = _cells.len(),
     });
 }
 
-void Prose::append(Rune rune) {
-    if (any(_blocks) and last(_blocks).newline(*this))
-        _beginBlock();
-
-    if (any(_blocks) and last(_blocks).spaces(*this))
-        _beginBlock();
-
-    auto glyph = _style.font.glyph(rune == '\n' ? ' ' : rune);
+void Prose::_appendCell(usize index, Rune rune) {
+    // Blocks go from one break opportunity to the next
+    if (_breaker.next(rune) != Break::NONE and not last(_blocks).empty())
+        _beginBlock(index);
 
+    // Glyphs are resolved when the blocks are measured
     _cells.pushBack({
-        .runeRange = {_runes.len(), 1},
-        .glyph = glyph,
+        .runeRange = {index, 1},
+        .rune = rune,
+        .glyph = Glyph::TOFU,
     });
 
-    _runes.pushBack(rune);
     last(_blocks).cellRange.size++;
-    last(_blocks).runeRange.end(_runes.len());
+    last(_blocks).runeRange.end(index + 1);
+}
+
+void Prose::append(Rune rune) {
+    append(Slice<Rune>{&rune, 1});
 }
 
 void Prose::clear() {
     _runes.clear();
     _cells.clear();
     _blocks.clear();
+    _breaker.reset();
     _blocksMeasured = false;
-    _beginBlock();
+    _beginBlock(0);
     _lines.clear();
+    _dirtyBlocks = NONE;
+    _wrapWidth = NONE;
 }
 
 void Prose::append(Slice<Rune> runes) {
-    _runes.ensure(_runes.len() + runes.len());
-    for (auto rune : runes) {
-        append(rune);
+    usize start = _runes.len();
+    _runes.insert(start, runes);
+    _cells.ensure(_cells.len() + runes.len());
+    for (usize i = 0; i < runes.len(); i++)
+        _appendCell(start + i, runes[i]);
+    _blocksMeasured = false;
+    _wrapWidth = NONE;
+}
+
+// MARK: Edit ---------------------------------------------------------------
+
+// Index of the first element for which `pred` is false, the slice must be
+// partitioned with regard to `pred`.
+static usize _partition(Sliceable auto const &slice, auto pred) {
+    usize lo = 0;
+    usize hi = slice.len();
+    while (lo < hi) {
+        usize mid = (lo + hi) / 2;
+        if (pred(slice[mid]))
+            lo = mid + 1;
+        else
+            hi = mid;
     }
+    return lo;
 }
 
-// MARK: Layout -------------------------------------------------------------
+void Prose::_segment(urange runeRange, usize cellStart, Vec<Cell> &cells, Vec<Block> &blocks, LineBreaker &breaker) const {
+    breaker.reset();
+    usize i = runeRange.start;
+    _runes.iterChunks(runeRange, [&](Slice<Rune> chunk) {
+        for (auto rune : chunk) {
+            bool split = breaker.next(rune) != Break::NONE;
+            if (split or i == runeRange.start) {
+                blocks.pushBack({
+                    .runeRange = i,
+                    .cellRange = cellStart + cells.len(),
+                });
+            }
+
+            cells.pushBack({
+                .runeRange = {i, 1},
+                .rune = rune,
+                .glyph = Glyph::TOFU,
+            });
 
-void Prose::_measureBlocks() {
-    for (auto &block : _blocks) {
-        auto adv = 0.0f;
-        bool first = true;
-        Glyph prev = Glyph::TOFU;
-        for (auto &cell : block.cells(*this)) {
-            if (not first)
-                adv += _style.font.kern(prev, cell.glyph);
-            else
-                first = false;
-
-            cell.pos = adv;
-            cell.adv = _style.font.advance(cell.glyph);
-            adv += cell.adv;
-            prev = cell.glyph;
+            last(blocks).cellRange.size++;
+            last(blocks).runeRange.size++;
+            i++;
         }
-        block.width = adv;
+    });
+}
+
+void Prose::replace(urange range, Slice<Rune> runes) {
+    // Nothing to preserve, the next layout starts from scratch anyway
+    if (not _blocksMeasured or not _wrapWidth) {
+        Rope text = _runes;
+        text.replace(range, runes);
+        clear();
+        append(text);
+        return;
     }
+
+    // Blocks never span a newline and line breaking starts over after
+    // one, so the paragraphs touched by the edit can be segmented again in
+    // isolation. Without multiline everything
+    // ends up on a single line so the whole text is one paragraph.
+    usize start = range.start;
+    usize end = range.end();
+    if (_style.multiline) {
+        start = _runes.lineStart(_runes.lineOf(start));
+        end = _runes.lineEnd(_runes.lineOf(end));
+        if (end < _runes.len())
+            end++;
+    } else {
+        start = 0;
+        end = _runes.len();
+    }
+
+    usize b0 = _partition(_blocks, [&](Block const &b) {
+        return b.runeRange.start < start;
+    });
+
+    usize b1 = end == _runes.len()
+                   ? _blocks.len()
+                   : _partition(_blocks, [&](Block const &b) {
+                         return b.runeRange.start < end;
+                     });
+
+    // Merge with the blocks damaged by previous edits, the lines of the
+    // paragraphs in between are dropped and wrapped again as well.
+    if (_dirtyBlocks) {
+        b0 = min(b0, _dirtyBlocks->start);
+        b1 = max(b1, _dirtyBlocks->end());
+        start = b0 < _blocks.len() ? _blocks[b0].runeRange.start : _runes.len();
+        end = b1 < _blocks.len() ? _blocks[b1].runeRange.start : _runes.len();
+    }
+
+    usize l0 = _partition(_lines, [&](Line const &l) {
+        return l.blockRange.start < b0;
+    });
+
+    usize l1 = b1 == _blocks.len()
+                   ? _lines.len()
+                   : _partition(_lines, [&](Line const &l) {
+                         return l.blockRange.start < b1;
+                     });
+
+    usize c0 = b0 < _blocks.len() ? _blocks[b0].cellRange.start : _cells.len();
+    usize c1 = b1 < _blocks.len() ? _blocks[b1].cellRange.start : _cells.len();
+
+    // Splice the runes and segment the paragraphs again
+    _runes.replace(range, runes);
+    isize runeDelta = (isize)runes.len() - (isize)range.size;
+
+    Vec<Cell> cells;
+    Vec<Block> blocks;
+    LineBreaker breaker;
+    _segment({start, (usize)(end + runeDelta) - start}, c0, cells, blocks, breaker);
+
+    // Appending picks up where the last paragraph ends
+    if ((usize)(end + runeDelta) == _runes.len())
+        _breaker = breaker;
+
+    // An empty text still has one empty block, like after clear()
+    if (_runes.empty())
+        blocks.pushBack({.runeRange = 0, .cellRange = 0});
+
+    isize cellDelta = (isize)cells.len() - (isize)(c1 - c0);
+    isize blockDelta = (isize)blocks.len() - (isize)(b1 - b0);
+
+    _cells.removeRange(c0, c1 - c0);
+    _cells.insertMany(c0, cells);
+    for (usize i = c0 + cells.len(); i < _cells.len(); i++)
+        _cells[i].runeRange.start += runeDelta;
+
+    _blocks.removeRange(b0, b1 - b0);
+    _blocks.insertMany(b0, blocks);
+    for (usize i = b0 + blocks.len(); i < _blocks.len(); i++) {
+        _blocks[i].runeRange.start += runeDelta;
+        _blocks[i].cellRange.start += cellDelta;
+    }
+
+    _lines.removeRange(l0, l1 - l0);
+    for (usize i = l0; i < _lines.len(); i++) {
+        _lines[i].runeRange.start += runeDelta;
+        _lines[i].blockRange.start += blockDelta;
+    }
+
+    _dirtyBlocks = urange{b0, blocks.len()};
+    _dirtyLine = l0;
 }
 
-void Prose::_wrapLines(f64 width) {
-    _lines.clear();
+// MARK: Layout -------------------------------------------------------------
 
-    Line line{{}, {}};
-    bool first = true;
+void Prose::_measureBlocks(urange blocks) {
+    auto &cache = globalShapingCache();
+    Vec<Rune> runes;
+    for (auto &block : mutSub(_blocks, blocks)) {
+        auto cells = block.cells(*this);
+        runes.clear();
+        for (auto const &cell : cells)
+            runes.pushBack(cell.rune);
+
+        // Cells stay one per rune so editing doesn't depend on shaping, the
+        // other runes of a ligature keep a zero width cell at its end.
+        block.width = cache.layout(_style.font, runes, [&](urange runes, Glyph glyph, f64 pos, f64 ypos, f64 adv) {
+            for (usize i = runes.start; i < runes.end(); i++) {
+                bool head = i == runes.start;
+                cells[i].glyph = head ? glyph : Glyph::NONE;
+                cells[i].pos = head ? pos : pos + adv;
+                cells[i].ypos = head ? ypos : 0;
+                cells[i].adv = head ? adv : 0;
+            }
+        });
+    }
+}
+
+usize Prose::_wrapParagraph(usize start, f64 width, Vec<Line> &lines) {
+    if (_style.lineFit == LineFit::TOTAL_FIT and _style.wordwrap and _style.multiline)
+        return _fitParagraph(start, width, lines);
+
+    Line line{_blocks[start].runeRange.start, {start, 0}};
     f64 adv = 0;
-    for (usize i = 0; i < _blocks.len(); i++) {
+    for (usize i = start; i < _blocks.len(); i++) {
         auto &block = _blocks[i];
-        if (adv + block.width > width and _style.wordwrap and _style.multiline and not first) {
-            _lines.pushBack(line);
+        if (adv + block.width > width and _style.wordwrap and _style.multiline and line.blockRange.any()) {
+            lines.pushBack(line);
             line = {block.runeRange, {i, 1}};
             adv = block.width;
-
-            if (block.newline(*this)) {
-                _lines.pushBack(line);
-                line = {block.runeRange.end(), {i + 1, 0}};
-                adv = 0;
-            }
         } else {
             line.blockRange.size++;
             line.runeRange.end(block.runeRange.end());
+            adv += block.width;
+        }
 
-            if (block.newline(*this) and _style.multiline) {
-                _lines.pushBack(line);
-                line = {block.runeRange.end(), {i + 1, 0}};
-                adv = 0;
-            } else {
-                adv += block.width;
-            }
+        if (block.newline(*this) and _style.multiline) {
+            lines.pushBack(line);
+            return i + 1;
         }
-        first = false;
     }
 
-    _lines.pushBack(line);
+    lines.pushBack(line);
+    return _blocks.len();
 }
 
-f64 Prose::_layoutVerticaly() {
-    auto m = _style.font.metrics();
-    f64 baseline = m.linegap / 2;
-    for (auto &line : _lines) {
-        baseline += m.ascend;
-        line.baseline = baseline;
-        baseline += m.linegap + m.descend;
+usize Prose::_fitParagraph(usize start, f64 width, Vec<Line> &lines) {
+    // The spaces at the end of a block hang past the end of the line
+    Vec<LineSegment> segments;
+    usize end = start;
+    while (end < _blocks.len()) {
+        auto const &block = _blocks[end++];
+        auto cells = block.cells(*this);
+
+        f64 trailing = 0;
+        for (usize i = cells.len(); i > 0 and cells[i - 1].space(*this); i--)
+            trailing += cells[i - 1].adv;
+        segments.pushBack({block.width - trailing, trailing});
+
+        if (block.newline(*this))
+            break;
     }
-    return baseline - m.linegap / 2;
+
+    auto starts = fitLines(segments, width, LineFit::TOTAL_FIT);
+    starts.pushBack(segments.len());
+
+    usize from = start;
+    for (auto to : starts) {
+        Line line{_blocks[from].runeRange.start, {from, start + to - from}};
+        line.runeRange.end(_blocks[start + to - 1].runeRange.end());
+        lines.pushBack(line);
+        from = start + to;
+    }
+
+    return end;
+}
+
+void Prose::_wrapLines(urange blocks, f64 width, Vec<Line> &lines) {
+    usize i = blocks.start;
+    while (i < blocks.end())
+        i = _wrapParagraph(i, width, lines);
+
+    // A trailing newline opens an empty line at the end of the text
+    if (blocks.end() == _blocks.len() and
+        last(_blocks).newline(*this) and
+        _style.multiline)
+        lines.pushBack({_runes.len(), {_blocks.len(), 0}});
+}
+
+f64 Prose::_layoutVerticaly(usize from) {
+    // Lines all have the same height, so the position of a line doesn't
+    // depend on the ones above and lines can be moved without a full pass.
+    auto m = _style.font.metrics();
+    f64 step = m.ascend + m.linegap + m.descend;
+    for (usize i = from; i < _lines.len(); i++)
+        _lines[i].baseline = m.linegap / 2 + i * step + m.ascend;
+    return _lines.len() * step;
 }
 
-f64 Prose::_layoutHorizontaly(f64 width) {
-    f64 maxWidth = 0;
-    for (auto &line : _lines) {
+void Prose::_layoutHorizontaly(urange lines, f64 width) {
+    for (auto &line : mutSub(_lines, lines)) {
         if (not line.blockRange.any())
             continue;
 
@@ -137,7 +324,6 @@ f64 Prose::_layoutHorizontaly(f64 width) {
 
         auto lastBlock = _blocks[line.blockRange.end() - 1];
         line.width = lastBlock.pos + lastBlock.width;
-        maxWidth = max(maxWidth, line.width);
         auto free = width - line.width;
 
         switch (_style.align) {
@@ -155,8 +341,6 @@ f64 Prose::_layoutHorizontaly(f64 width) {
             break;
         }
     }
-
-    return maxWidth;
 }
 
 Math::Vec2f Prose::layout(f64 width) {
@@ -166,14 +350,42 @@ Math::Vec2f Prose::layout(f64 width) {
     // Blocks measurements can be reused between layouts changes
     // only line wrapping need to be re-done
     if (not _blocksMeasured) {
-        _measureBlocks();
+        _measureBlocks({0, _blocks.len()});
         _blocksMeasured = true;
+        _dirtyBlocks = NONE;
+        _wrapWidth = NONE;
+    } else if (_dirtyBlocks) {
+        _measureBlocks(*_dirtyBlocks);
+    }
+
+    urange dirtyLines;
+    if (not _wrapWidth or *_wrapWidth != width) {
+        _lines.clear();
+        _wrapLines({0, _blocks.len()}, width, _lines);
+        dirtyLines = {0, _lines.len()};
+    } else if (_dirtyBlocks) {
+        // Only the edited paragraphs are wrapped again, the lines after
+        // them only need to be moved down
+        Vec<Line> lines;
+        _wrapLines(*_dirtyBlocks, width, lines);
+        _lines.insertMany(_dirtyLine, lines);
+        dirtyLines = {_dirtyLine, lines.len()};
+    } else {
+        return _size;
     }
 
-    _wrapLines(width);
-    auto textHeight = _layoutVerticaly();
-    auto textWidth = _layoutHorizontaly(width);
-    return {textWidth, textHeight};
+    _wrapWidth = width;
+    _dirtyBlocks = NONE;
+
+    _layoutHorizontaly(dirtyLines, width);
+    f64 textHeight = _layoutVerticaly(dirtyLines.start);
+
+    f64 textWidth = 0;
+    for (auto const &line : _lines)
+        textWidth = max(textWidth, line.width);
+
+    _size = {textWidth, textHeight};
+    return _size;
 }
 
 // MARK: Paint -------------------------------------------------------------
@@ -187,7 +399,9 @@ void Prose::paint(Gfx::Canvas &g) {
     for (auto const &line : _lines) {
         for (auto &block : line.blocks(*this)) {
             for (auto &cell : block.cells(*this)) {
-                g.fill(_style.font, cell.glyph, {block.pos + cell.pos, line.baseline});
+                if (cell.glyph == Glyph::NONE)
+                    continue;
+                g.fill(_style.font, cell.glyph, {block.pos + cell.pos, line.baseline + cell.ypos});
             }
         }
     }
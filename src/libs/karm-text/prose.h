@@ -4,6 +4,8 @@
 #include <karm-logger/logger.h>
 
 #include "font.h"
+#include "linebreak.h"
+#include "rope.h"
 
 namespace Karm::Text {
 
@@ -19,6 +21,9 @@ struct ProseStyle {
     Opt<Gfx::Color> color = NONE;
     bool wordwrap = true;
     bool multiline = false;
+    LineFit lineFit = LineFit::GREEDY;
+
+    bool operator==(ProseStyle const &other) const = default;
 
     ProseStyle withSize(f64 size) const {
         ProseStyle style = *this;
@@ -55,35 +60,31 @@ struct ProseStyle {
         style.multiline = multiline;
         return style;
     }
+
+    ProseStyle withLineFit(LineFit lineFit) const {
+        ProseStyle style = *this;
+        style.lineFit = lineFit;
+        return style;
+    }
 };
 
 struct Prose {
+    // One per rune, the rune is copied from the rope so wrapping doesn't
+    // have to walk down the tree for every cell.
     struct Cell {
         urange runeRange;
-        Glyph glyph;
-        f64 pos = 0; //< Position of the glyph within the block
-        f64 adv = 0; //< Advance of the glyph
-
-        MutSlice<Rune> runes(Prose &t) {
-            return mutSub(t._runes, runeRange);
+        Rune rune;
+        Glyph glyph;  //< Glyph::NONE for runes merged into a ligature
+        f64 pos = 0;  //< Position of the glyph within the block
+        f64 ypos = 0; //< Offset of the glyph from the baseline
+        f64 adv = 0;  //< Advance of the glyph
+
+        bool newline(Prose const &) const {
+            return rune == '\n';
         }
 
-        Slice<Rune> runes(Prose const &t) const {
-            return sub(t._runes, runeRange);
-        }
-
-        bool newline(Prose const &t) const {
-            auto r = runes(t);
-            if (not r)
-                return false;
-            return last(r) == '\n';
-        }
-
-        bool space(Prose const &t) const {
-            auto r = runes(t);
-            if (not r)
-                return false;
-            return last(r) == '\n' or isAsciiSpace(last(r));
+        bool space(Prose const &) const {
+            return rune == '\n' or isAsciiSpace(rune);
         }
     };
 
@@ -136,21 +137,31 @@ struct Prose {
 
     ProseStyle _style;
 
-    Vec<Rune> _runes;
+    Rope _runes;
     Vec<Cell> _cells;
     Vec<Block> _blocks;
     Vec<Line> _lines;
+    LineBreaker _breaker; //< State at the end of the text, see append()
 
     // Various cached values
     bool _blocksMeasured = false;
     f64 _spaceWidth{};
     f64 _lineHeight{};
 
+    // Incremental layout, see replace()
+    Opt<urange> _dirtyBlocks = NONE; //< Blocks edited since the last layout
+    usize _dirtyLine = 0;            //< Where the lines of the dirty blocks go
+    Opt<f64> _wrapWidth = NONE;      //< Width the lines were wrapped at
+    Math::Vec2f _size{};
+
     Prose(ProseStyle style, Str str = "");
 
     // MARK: Prose --------------------------------------------------------------
 
-    void _beginBlock();
+    void _beginBlock(usize runeStart);
+
+    // Segment a rune already at `index` in the rope.
+    void _appendCell(usize index, Rune rune);
 
     void append(Rune rune);
 
@@ -158,21 +169,55 @@ struct Prose {
 
     template <typename E>
     void append(_Str<E> str) {
+        Vec<Rune> runes;
         for (auto rune : iterRunes(str))
-            append(rune);
+            runes.pushBack(rune);
+        append(runes);
     }
 
     void append(Slice<Rune> runes);
 
+    void append(Rope const &rope) {
+        rope.iterChunks([&](Slice<Rune> chunk) {
+            append(chunk);
+        });
+    }
+
+    // MARK: Edit ---------------------------------------------------------------
+
+    // Split whole paragraphs into blocks at their break opportunities.
+    void _segment(urange runeRange, usize cellStart, Vec<Cell> &cells, Vec<Block> &blocks, LineBreaker &breaker) const;
+
+    // Replace a range of runes, only the paragraphs touched by the edit
+    // are measured and wrapped again on the next layout. The runes and the
+    // paragraph bounds come from the rope in O(log n), but cells, blocks
+    // and lines are flat arrays of absolute offsets: an edit still splices
+    // them and shifts the offsets after it, and layout() takes the width
+    // of the text over every line. Both are linear passes over a few
+    // integers per rune, no rune is copied or shaped again.
+    void replace(urange range, Slice<Rune> runes);
+
+    void insert(usize index, Slice<Rune> runes) {
+        replace({index, 0}, runes);
+    }
+
+    void remove(urange range) {
+        replace(range, {});
+    }
+
     // MARK: Layout -------------------------------------------------------------
 
-    void _measureBlocks();
+    void _measureBlocks(urange blocks);
+
+    usize _wrapParagraph(usize start, f64 width, Vec<Line> &lines);
+
+    usize _fitParagraph(usize start, f64 width, Vec<Line> &lines);
 
-    void _wrapLines(f64 width);
+    void _wrapLines(urange blocks, f64 width, Vec<Line> &lines);
 
-    f64 _layoutVerticaly();
+    f64 _layoutVerticaly(usize from = 0);
 
-    f64 _layoutHorizontaly(f64 width);
+    void _layoutHorizontaly(urange lines, f64 width);
 
     Math::Vec2f layout(f64 width);
 
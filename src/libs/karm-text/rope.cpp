@@ -0,0 +1,324 @@
+#include "rope.h"
+
+namespace Karm::Text {
+
+using Link = Rope::Link;
+using Node = Rope::Node;
+
+// MARK: Nodes -----------------------------------------------------------------
+
+static usize _len(Link const &link) {
+    return link ? (*link)->len : 0;
+}
+
+static usize _newlines(Link const &link) {
+    return link ? (*link)->newlines : 0;
+}
+
+static u8 _height(Link const &link) {
+    return link ? (*link)->height : 0;
+}
+
+static Strong<Node> _leaf(Slice<Rune> runes) {
+    Node node;
+    node.runes = runes;
+    node.len = runes.len();
+    for (auto rune : runes)
+        if (rune == '\n')
+            node.newlines++;
+    return makeStrong<Node>(std::move(node));
+}
+
+static Strong<Node> _node(Strong<Node> left, Strong<Node> right) {
+    // Small neighbouring leaves are merged so typing one rune at a time
+    // doesn't end up with one leaf per rune.
+    if (left->leaf() and right->leaf() and
+        left->len + right->len <= Rope::LEAF_MAX) {
+        Node node;
+        node.runes.ensure(left->len + right->len);
+        node.runes.pushBack(left->runes);
+        node.runes.pushBack(right->runes);
+        node.len = left->len + right->len;
+        node.newlines = left->newlines + right->newlines;
+        return makeStrong<Node>(std::move(node));
+    }
+
+    Node node;
+    node.len = left->len + right->len;
+    node.newlines = left->newlines + right->newlines;
+    node.height = max(left->height, right->height) + 1;
+    node.left = std::move(left);
+    node.right = std::move(right);
+    return makeStrong<Node>(std::move(node));
+}
+
+static Link _build(Slice<Rune> runes) {
+    if (not runes.len())
+        return NONE;
+
+    if (runes.len() <= Rope::LEAF_MAX)
+        return _leaf(runes);
+
+    // Split on a leaf boundary so the leaves are all full but the last one
+    usize leaves = (runes.len() + Rope::LEAF_MAX - 1) / Rope::LEAF_MAX;
+    usize mid = (leaves / 2) * Rope::LEAF_MAX;
+    return _node(
+        *_build(sub(runes, 0, mid)),
+        *_build(sub(runes, mid, runes.len()))
+    );
+}
+
+// MARK: Balancing -------------------------------------------------------------
+
+// Build a node from two subtrees whose heights differ by at most two,
+// rotating it back into balance when needed.
+static Strong<Node> _balance(Strong<Node> left, Strong<Node> right) {
+    if (left->height > right->height + 1) {
+        auto ll = *left->left;
+        auto lr = *left->right;
+        if (ll->height >= lr->height)
+            return _node(ll, _node(lr, right));
+        return _node(_node(ll, *lr->left), _node(*lr->right, right));
+    }
+
+    if (right->height > left->height + 1) {
+        auto rl = *right->left;
+        auto rr = *right->right;
+        if (rr->height >= rl->height)
+            return _node(_node(left, rl), rr);
+        return _node(_node(left, *rl->left), _node(*rl->right, rr));
+    }
+
+    return _node(left, right);
+}
+
+// Concatenate two trees, the taller one is walked down along its edge
+// until both sides have the same height.
+static Link _join(Link left, Link right) {
+    if (not left)
+        return right;
+
+    if (not right)
+        return left;
+
+    auto l = *left;
+    auto r = *right;
+
+    if (l->height > r->height + 1)
+        return _balance(*l->left, *_join(l->right, r));
+
+    if (r->height > l->height + 1)
+        return _balance(*_join(l, r->left), *r->right);
+
+    // Give small leaves on the edges a chance to be merged
+    if (not l->leaf() and r->leaf() and (*l->right)->leaf() and
+        (*l->right)->len + r->len <= Rope::LEAF_MAX)
+        return _balance(*l->left, _node(*l->right, r));
+
+    if (l->leaf() and not r->leaf() and (*r->left)->leaf() and
+        l->len + (*r->left)->len <= Rope::LEAF_MAX)
+        return _balance(_node(l, *r->left), *r->right);
+
+    return _node(l, r);
+}
+
+static Pair<Link> _split(Link const &link, usize at) {
+    if (not link)
+        return {NONE, NONE};
+
+    auto &node = **link;
+    if (at == 0)
+        return {NONE, link};
+
+    if (at >= node.len)
+        return {link, NONE};
+
+    if (node.leaf())
+        return {
+            _leaf(sub(node.runes, 0, at)),
+            _leaf(sub(node.runes, at, node.len)),
+        };
+
+    usize split = _len(node.left);
+    if (at == split)
+        return {node.left, node.right};
+
+    if (at < split) {
+        auto [a, b] = _split(node.left, at);
+        return {a, _join(b, node.right)};
+    }
+
+    auto [a, b] = _split(node.right, at - split);
+    return {_join(node.left, a), b};
+}
+
+// Edit a single leaf in place of the tree when the edit fits in it, the
+// shape of the tree doesn't change so no balancing is needed.
+static Link _editLeaf(Strong<Node> node, urange range, Slice<Rune> runes) {
+    if (node->leaf()) {
+        usize len = node->len - range.size + runes.len();
+        if (len == 0 or len > Rope::LEAF_MAX)
+            return NONE;
+
+        Vec<Rune> buf;
+        buf.ensure(len);
+        buf.insertMany(buf.len(), sub(node->runes, 0, range.start));
+        buf.insertMany(buf.len(), runes);
+        buf.insertMany(buf.len(), sub(node->runes, range.end(), node->len));
+        return _leaf(buf);
+    }
+
+    auto left = *node->left;
+    auto right = *node->right;
+
+    if (range.end() <= left->len) {
+        auto edited = _editLeaf(left, range, runes);
+        if (not edited)
+            return NONE;
+        return _node(*edited, right);
+    }
+
+    if (range.start >= left->len) {
+        range.start -= left->len;
+        auto edited = _editLeaf(right, range, runes);
+        if (not edited)
+            return NONE;
+        return _node(left, *edited);
+    }
+
+    return NONE;
+}
+
+// MARK: Rope ------------------------------------------------------------------
+
+Rope::Rope(Slice<Rune> runes)
+    : _root(_build(runes)) {}
+
+usize Rope::len() const {
+    return _len(_root);
+}
+
+usize Rope::lines() const {
+    return _newlines(_root) + 1;
+}
+
+Rune Rope::operator[](usize index) const {
+    if (index >= len()) [[unlikely]]
+        panic("index out of bounds");
+
+    auto *node = &**_root;
+    while (not node->leaf()) {
+        usize split = (*node->left)->len;
+        if (index < split) {
+            node = &**node->left;
+        } else {
+            index -= split;
+            node = &**node->right;
+        }
+    }
+    return node->runes[index];
+}
+
+usize Rope::lineOf(usize index) const {
+    if (not _root)
+        return 0;
+
+    usize line = 0;
+    auto *node = &**_root;
+    index = min(index, node->len);
+    while (not node->leaf()) {
+        auto &left = **node->left;
+        if (index <= left.len) {
+            node = &left;
+        } else {
+            line += left.newlines;
+            index -= left.len;
+            node = &**node->right;
+        }
+    }
+
+    for (usize i = 0; i < index; i++)
+        if (node->runes[i] == '\n')
+            line++;
+
+    return line;
+}
+
+usize Rope::lineStart(usize line) const {
+    if (line == 0)
+        return 0;
+
+    if (line > _newlines(_root))
+        return len();
+
+    // Look for the `line`th newline, the line starts right after it
+    usize index = 0;
+    auto *node = &**_root;
+    while (not node->leaf()) {
+        auto &left = **node->left;
+        if (line <= left.newlines) {
+            node = &left;
+        } else {
+            line -= left.newlines;
+            index += left.len;
+            node = &**node->right;
+        }
+    }
+
+    for (usize i = 0; i < node->len; i++) {
+        if (node->runes[i] == '\n' and --line == 0)
+            return index + i + 1;
+    }
+
+    return len();
+}
+
+usize Rope::lineEnd(usize line) const {
+    if (line + 1 >= lines())
+        return len();
+    return lineStart(line + 1) - 1;
+}
+
+Vec<Rune> Rope::collect(urange range) const {
+    Vec<Rune> res;
+    res.ensure(range.size);
+    iterChunks(range, [&](Slice<Rune> chunk) {
+        res.pushBack(chunk);
+    });
+    return res;
+}
+
+void Rope::insert(usize index, Slice<Rune> runes) {
+    if (not runes.len())
+        return;
+
+    index = min(index, len());
+
+    if (_root) {
+        if (auto edited = _editLeaf(*_root, {index, 0}, runes)) {
+            _root = edited;
+            return;
+        }
+    }
+
+    auto [left, right] = _split(_root, index);
+    _root = _join(_join(left, _build(runes)), right);
+}
+
+void Rope::remove(urange range) {
+    if (range.empty() or range.start >= len())
+        return;
+
+    range.size = min(range.end(), len()) - range.start;
+
+    if (auto edited = _editLeaf(*_root, range, {})) {
+        _root = edited;
+        return;
+    }
+
+    auto [left, rest] = _split(_root, range.start);
+    auto [removed, right] = _split(rest, range.size);
+    _root = _join(left, right);
+}
+
+} // namespace Karm::Text
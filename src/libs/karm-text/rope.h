@@ -0,0 +1,117 @@
+#pragma once
+
+#include <karm-base/range.h>
+#include <karm-base/rc.h>
+#include <karm-base/vec.h>
+
+namespace Karm::Text {
+
+// A persistent rope of runes, the runes are stored in the leaves of a
+// height balanced tree. Nodes are never modified once built and are shared
+// between the versions of the text, so copying a rope is O(1) and an edit
+// only allocates the path from the root to the edited leaves. This makes
+// it cheap to keep snapshots of the text around, eg. for undo.
+struct Rope {
+    static constexpr usize LEAF_MAX = 256;
+
+    struct Node;
+
+    using Link = Opt<Strong<Node>>;
+
+    struct Node {
+        Link left = NONE;
+        Link right = NONE;
+        Vec<Rune> runes = {}; //< Only used by leaves
+        usize len = 0;
+        usize newlines = 0;
+        u8 height = 1;
+
+        bool leaf() const {
+            return not left;
+        }
+    };
+
+    Link _root = NONE;
+
+    Rope() = default;
+
+    Rope(Slice<Rune> runes);
+
+    // MARK: Queries -----------------------------------------------------------
+
+    usize len() const;
+
+    // Number of lines, a text without any newline has one line.
+    usize lines() const;
+
+    bool empty() const {
+        return len() == 0;
+    }
+
+    Rune operator[](usize index) const;
+
+    // Index of the line containing the rune at `index`.
+    usize lineOf(usize index) const;
+
+    // Index of the first rune of `line`, or the length of the text if the
+    // line doesn't exist.
+    usize lineStart(usize line) const;
+
+    usize lineEnd(usize line) const;
+
+    // Call `cb` with the runes of `range` in order, as contiguous slices.
+    void iterChunks(urange range, auto cb) const {
+        _iterChunks(_root, range, cb);
+    }
+
+    void iterChunks(auto cb) const {
+        iterChunks({0, len()}, cb);
+    }
+
+    Vec<Rune> collect(urange range) const;
+
+    Vec<Rune> collect() const {
+        return collect({0, len()});
+    }
+
+    // MARK: Edits -------------------------------------------------------------
+
+    void insert(usize index, Slice<Rune> runes);
+
+    void remove(urange range);
+
+    void replace(urange range, Slice<Rune> runes) {
+        remove(range);
+        insert(range.start, runes);
+    }
+
+    void clear() {
+        _root = NONE;
+    }
+
+    // MARK: Internals ---------------------------------------------------------
+
+    static void _iterChunks(Link const &link, urange range, auto &cb) {
+        if (not link or range.empty())
+            return;
+
+        auto &node = **link;
+        if (node.leaf()) {
+            cb(sub(node.runes, range));
+            return;
+        }
+
+        usize split = (*node.left)->len;
+        if (range.start < split) {
+            usize end = min(range.end(), split);
+            _iterChunks(node.left, urange::fromStartEnd(range.start, end), cb);
+        }
+
+        if (range.end() > split) {
+            usize start = max(range.start, split);
+            _iterChunks(node.right, urange::fromStartEnd(start - split, range.end() - split), cb);
+        }
+    }
+};
+
+} // namespace Karm::Text
@@ -1,4 +1,5 @@
 #include "run.h"
+#include "shaping.h"
 
 namespace Karm::Text {
 
@@ -15,15 +16,15 @@ Run Run::from(Font font, Slice<Rune> runes) {
 void Run::clear() {
     _runes.clear();
     _cells.clear();
+    _width = 0;
+    _shaped = false;
+    _measure = NONE;
 }
 
 void Run::append(Rune rune) {
-    auto glyph = _font.glyph(rune == '\n' ? ' ' : rune);
-    _cells.pushBack({
-        .runeRange = {_runes.len(), 1},
-        .glyph = glyph,
-    });
     _runes.pushBack(rune);
+    _shaped = false;
+    _measure = NONE;
 }
 
 void Run::append(Slice<Rune> runes) {
@@ -44,21 +45,23 @@ f64 Run::lineheight() {
 }
 
 Math::Vec2f Run::layout() {
-    auto xpos = 0.0f;
-    bool first = true;
-    Glyph prev = Glyph::TOFU;
-    for (auto &cell : _cells) {
-        if (not first)
-            xpos += _font.kern(prev, cell.glyph);
-        else
-            first = false;
-
-        cell.xpos = xpos;
-        cell.adv = _font.advance(cell.glyph);
-        xpos += cell.adv;
-        prev = cell.glyph;
+    // Glyphs are only looked up once the run is complete, words are
+    // shaped through the cache so repeated words are shaped only once.
+    // There is one cell per shaped glyph, not per rune.
+    if (not _shaped) {
+        _cells.clear();
+        _cells.ensure(_runes.len());
+        _width = globalShapingCache().layout(_font, _runes, [&](urange runes, Glyph glyph, f64 xpos, f64 ypos, f64 adv) {
+            _cells.pushBack({
+                .runeRange = runes,
+                .glyph = glyph,
+                .xpos = xpos,
+                .ypos = ypos,
+                .adv = adv,
+            });
+        });
+        _shaped = true;
     }
-    _width = xpos;
 
     return {
         _width,
@@ -66,4 +69,10 @@ Math::Vec2f Run::layout() {
     };
 }
 
+TextMeasure Run::measure() {
+    if (not _measure)
+        _measure = Text::measure(_font, _runes);
+    return *_measure;
+}
+
 } // namespace Karm::Text
@@ -4,14 +4,16 @@
 
 #include "base.h"
 #include "font.h"
+#include "measure.h"
 
 namespace Karm::Text {
 
 struct Run {
     struct Cell {
-        urange runeRange;
+        urange runeRange; //< Several runes for a ligature
         Glyph glyph;
         f64 xpos = 0; //< Position of the glyph within the block
+        f64 ypos = 0; //< Offset of the glyph from the baseline
         f64 adv = 0;  //< Advance of the glyph
 
         MutSlice<Rune> runes(Run &t) {
@@ -41,6 +43,8 @@ struct Run {
     Vec<Rune> _runes{};
     Vec<Cell> _cells{};
     f64 _width = 0;
+    bool _shaped = false; //< Cells are up to date with the runes
+    Opt<TextMeasure> _measure = NONE;
 
     static Run from(Font font);
 
@@ -71,6 +75,9 @@ struct Run {
 
     Math::Vec2f layout();
 
+    // The intrinsic widths of the run, without laying out its cells.
+    TextMeasure measure();
+
     static void _fillGlyph(Gfx::Canvas &g, Font const &font, Math::Vec2f baseline, Glyph glyph);
 
     void paint(Gfx::Canvas &g) const;
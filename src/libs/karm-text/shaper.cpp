@@ -0,0 +1,636 @@
+#include "shaper.h"
+
+namespace Karm::Text {
+
+// MARK: Acceleration Structures -----------------------------------------------
+
+TtfShaper::GlyphCoverage TtfShaper::GlyphCoverage::from(Ttf::CoverageTable const &table) {
+    GlyphCoverage res;
+    table.forEach([&](usize glyph, usize index) {
+        if (glyph <= 0xFFFF and index <= 0xFFFF)
+            res._entries.pushBack((u32)(glyph << 16 | index));
+    });
+    sort(res._entries);
+    return res;
+}
+
+Opt<usize> TtfShaper::GlyphCoverage::indexOf(u16 glyph) const {
+    usize lo = 0, hi = _entries.len();
+    while (lo < hi) {
+        usize mid = lo + (hi - lo) / 2;
+        if ((_entries[mid] >> 16) < glyph)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo < _entries.len() and (_entries[lo] >> 16) == glyph)
+        return _entries[lo] & 0xFFFF;
+    return NONE;
+}
+
+void TtfShaper::GlyphCoverage::addTo(Vec<u64> &digest) const {
+    for (auto entry : _entries) {
+        usize glyph = entry >> 16;
+        if (glyph / 64 < digest.len())
+            digest[glyph / 64] |= 1ull << (glyph % 64);
+    }
+}
+
+TtfShaper::GlyphClasses TtfShaper::GlyphClasses::from(Opt<Ttf::ClassDef> classDef) {
+    GlyphClasses res;
+    if (not classDef)
+        return res;
+
+    classDef->forEach([&](usize glyph, usize glyphClass) {
+        if (glyph > 0xFFFF)
+            return;
+        if (glyph >= res._classes.len())
+            res._classes.resize(glyph + 1, 0);
+        res._classes[glyph] = glyphClass;
+    });
+    return res;
+}
+
+// MARK: Compilation -----------------------------------------------------------
+
+TtfShaper::TtfShaper(Ttf::Parser const &parser)
+    : _gsub(parser._gsub),
+      _gpos(parser._gpos),
+      _numGlyphs(parser.numGlyphs()),
+      _unitPerEm(parser.unitPerEm()) {
+    _glyphClasses = GlyphClasses::from(parser._gdef.glyphClassDef());
+    _markAttachClasses = GlyphClasses::from(parser._gdef.markAttachClassDef());
+
+    if (_gsub.present())
+        _gsubLookups.resize(_gsub.lookupList().len());
+
+    if (_gpos.present())
+        _gposLookups.resize(_gpos.lookupList().len());
+}
+
+static Opt<FontFeatures> _featureOf(Str tag) {
+    if (tag == "ccmp")
+        return FontFeatures::CCMP;
+    if (tag == "liga")
+        return FontFeatures::LIGA;
+    if (tag == "clig")
+        return FontFeatures::CLIG;
+    if (tag == "calt")
+        return FontFeatures::CALT;
+    if (tag == "rlig")
+        return FontFeatures::RLIG;
+    if (tag == "dlig")
+        return FontFeatures::DLIG;
+    if (tag == "mark")
+        return FontFeatures::MARK;
+    if (tag == "mkmk")
+        return FontFeatures::MKMK;
+    return NONE;
+}
+
+// Collect the lookups of the selected features for the default language
+// system of the latin script, or of the default script.
+static void _collectLookups(auto const &table, FontFeatures features, Vec<u16> &lookups) {
+    auto scripts = table.scriptList();
+    auto maybeScript = scripts.lookup("latn");
+    if (not maybeScript)
+        maybeScript = scripts.lookup("DFLT");
+    if (not maybeScript)
+        return;
+
+    auto script = maybeScript.unwrap();
+    if (not script.template get<Ttf::ScriptTable::DefaultLangSysOffset>())
+        return;
+
+    auto langSys = script.defaultLangSys();
+    auto featureList = table.featureList();
+
+    auto add = [&](Ttf::FeatureTable feature) {
+        for (auto lookupIndex : feature.iterLookups())
+            lookups.pushBack(lookupIndex);
+    };
+
+    usize required = langSys.template get<Ttf::LangSys::ReqFeatureIndex>();
+    if (required != 0xFFFF and required < featureList.len())
+        add(featureList.at(required));
+
+    for (auto featureIndex : langSys.iterFeatures()) {
+        if (featureIndex >= featureList.len())
+            continue;
+
+        auto feature = featureList.at(featureIndex);
+        auto flag = _featureOf(feature.tag);
+        if (flag and (features & *flag) == *flag)
+            add(feature);
+    }
+
+    sort(lookups);
+
+    // Features often share lookups, each one is applied once
+    usize len = 0;
+    for (usize i = 0; i < lookups.len(); i++) {
+        if (len == 0 or lookups[len - 1] != lookups[i])
+            lookups[len++] = lookups[i];
+    }
+    lookups.trunc(len);
+}
+
+TtfShaper::Plan const &TtfShaper::plan(FontFeatures features) {
+    for (auto &plan : _plans) {
+        if (plan.features == features)
+            return plan;
+    }
+
+    Plan plan{features};
+    if (_gsub.present())
+        _collectLookups(_gsub, features, plan.gsub);
+    if (_gpos.present())
+        _collectLookups(_gpos, features, plan.gpos);
+
+    _plans.pushBack(std::move(plan));
+    return last(_plans);
+}
+
+TtfShaper::Lookup const *TtfShaper::lookup(bool gpos, usize index) {
+    auto &lookups = gpos ? _gposLookups : _gsubLookups;
+    if (index >= lookups.len())
+        return nullptr;
+
+    if (not lookups[index]) {
+        auto list = gpos ? _gpos.lookupList() : _gsub.lookupList();
+        lookups[index] = _compile(gpos, list.at(index));
+    }
+
+    return &*lookups[index];
+}
+
+TtfShaper::Lookup TtfShaper::_compile(bool gpos, Ttf::LookupTable table) {
+    Lookup lookup{gpos, table.lookupFlag()};
+    lookup.digest.resize((_numGlyphs + 63) / 64, 0);
+
+    u16 extensionType = gpos
+                            ? (u16)Ttf::GposLookupType::EXTENSION_POSITIONING
+                            : (u16)Ttf::GsubLookupType::EXTENSION;
+
+    for (usize i = 0; i < table.len(); i++) {
+        Subtable subtable{
+            .type = table.lookupType(),
+            .format = 0,
+            .bytes = table.subtableBytes(i),
+        };
+
+        if (subtable.type == extensionType) {
+            Ttf::ExtensionSubtable extension{subtable.bytes};
+            subtable.type = extension.extensionLookupType();
+            subtable.bytes = extension.extension();
+        }
+
+        subtable.format = Ttf::LookupSubtableBase{subtable.bytes}.format();
+
+        if (not gpos and subtable.type == (u16)Ttf::GsubLookupType::SINGLE) {
+            subtable.coverage = GlyphCoverage::from(Ttf::SingleSubstitution{subtable.bytes}.coverage());
+        } else if (not gpos and subtable.type == (u16)Ttf::GsubLookupType::LIGATURE) {
+            subtable.coverage = GlyphCoverage::from(Ttf::LigatureSubstitution{subtable.bytes}.coverage());
+        } else if (not gpos and subtable.type == (u16)Ttf::GsubLookupType::CHAINED_CONTEXT) {
+            Ttf::ChainedContext context{subtable.bytes};
+
+            if (subtable.format == 1 or subtable.format == 2) {
+                subtable.coverage = GlyphCoverage::from(context.coverage());
+                if (subtable.format == 2) {
+                    subtable.backtrackClasses = GlyphClasses::from(context.backtrackClassDef());
+                    subtable.inputClasses = GlyphClasses::from(context.inputClassDef());
+                    subtable.lookaheadClasses = GlyphClasses::from(context.lookaheadClassDef());
+                }
+
+                context.forEachRule([&](usize set, Ttf::ChainedSequenceRule rule) {
+                    if (set >= subtable.ruleSets.len())
+                        subtable.ruleSets.resize(set + 1);
+                    subtable.ruleSets[set].pushBack(std::move(rule));
+                });
+            } else if (subtable.format == 3) {
+                auto coverages = context.coverages();
+                if (isEmpty(coverages.input))
+                    continue;
+
+                for (auto &coverage : coverages.backtrack)
+                    subtable.backtrack.pushBack(GlyphCoverage::from(coverage));
+                for (auto &coverage : coverages.input)
+                    subtable.input.pushBack(GlyphCoverage::from(coverage));
+                for (auto &coverage : coverages.lookahead)
+                    subtable.lookahead.pushBack(GlyphCoverage::from(coverage));
+                subtable.lookups = std::move(coverages.lookups);
+                subtable.coverage = first(subtable.input);
+            } else {
+                continue;
+            }
+        } else if (gpos and (subtable.type == (u16)Ttf::GposLookupType::MARK_TO_BASE_ATTACHMENT or
+                             subtable.type == (u16)Ttf::GposLookupType::MARK_TO_MARK_ATTACHMENT)) {
+            Ttf::MarkAttachment attachment{subtable.bytes};
+            subtable.coverage = GlyphCoverage::from(attachment.markCoverage());
+            subtable.baseCoverage = GlyphCoverage::from(attachment.baseCoverage());
+        } else {
+            // FIXME: Multiple, alternate and non-chained context substitutions,
+            //        single, cursive, mark to ligature and contextual
+            //        positioning aren't supported. Pair adjustments are
+            //        applied through kern().
+            continue;
+        }
+
+        subtable.coverage.addTo(lookup.digest);
+        lookup.subtables.pushBack(std::move(subtable));
+    }
+
+    return lookup;
+}
+
+// MARK: Shaping ---------------------------------------------------------------
+
+ShapedWord TtfShaper::shape(Fontface &face, Slice<Rune> runes, FontFeatures features) {
+    auto &plan = this->plan(features);
+
+    Vec<Item> items;
+    items.ensure(runes.len());
+    for (usize i = 0; i < runes.len(); i++) {
+        auto glyph = face.glyph(runes[i] == '\n' ? ' ' : runes[i]);
+        items.pushBack({
+            .glyph = glyph.index,
+            .font = glyph.font,
+            .glyphClass = (Ttf::GlyphClass)_glyphClasses.classOf(glyph.index),
+            .runes = {i, 1},
+        });
+    }
+
+    for (auto index : plan.gsub) {
+        auto *lookup = this->lookup(false, index);
+        if (lookup and any(lookup->subtables))
+            _substitute(*lookup, items);
+    }
+
+    bool kerning = (features & FontFeatures::KERN) == FontFeatures::KERN;
+
+    Vec<Position> positions;
+    positions.resize(items.len());
+
+    Opt<Glyph> prev = NONE;
+    for (usize i = 0; i < items.len(); i++) {
+        auto &item = items[i];
+        Glyph glyph{item.glyph, item.font};
+        bool mark = item.glyphClass == Ttf::GlyphClass::MARK;
+
+        if (kerning and prev and not mark)
+            positions[i].kern = face.kern(*prev, glyph);
+        positions[i].adv = face.advance(glyph);
+
+        if (not mark)
+            prev = glyph;
+    }
+
+    for (auto index : plan.gpos) {
+        auto *lookup = this->lookup(true, index);
+        if (lookup and any(lookup->subtables))
+            _attach(*lookup, items, positions);
+    }
+
+    ShapedWord word;
+    word.glyphs.ensure(items.len());
+
+    f64 xpos = 0;
+    for (usize i = 0; i < items.len(); i++) {
+        auto &pos = positions[i];
+
+        ShapedGlyph glyph{
+            .glyph = {items[i].glyph, items[i].font},
+            .runes = items[i].runes,
+            .adv = pos.adv,
+        };
+
+        // Bases come first, so they are already placed
+        if (pos.base) {
+            auto &base = word.glyphs[*pos.base];
+            glyph.xpos = base.xpos + pos.dx;
+            glyph.ypos = base.ypos - pos.dy;
+        } else {
+            xpos += pos.kern;
+            glyph.xpos = xpos;
+        }
+
+        xpos += pos.adv;
+        word.glyphs.pushBack(glyph);
+    }
+    word.width = xpos;
+
+    return word;
+}
+
+// MARK: Substitution ----------------------------------------------------------
+
+bool TtfShaper::_skip(Lookup const &lookup, Item const &item) const {
+    using LookupFlags = Ttf::LookupTable::LookupFlags;
+
+    switch (item.glyphClass) {
+    case Ttf::GlyphClass::BASE:
+        return lookup.flag & LookupFlags::IGNORE_BASE_GLYPHS;
+
+    case Ttf::GlyphClass::LIGATURE:
+        return lookup.flag & LookupFlags::IGNORE_LIGATURES;
+
+    case Ttf::GlyphClass::MARK: {
+        if (lookup.flag & LookupFlags::IGNORE_MARKS)
+            return true;
+
+        // FIXME: Mark filtering sets aren't supported.
+        usize attachmentType = lookup.flag >> 8;
+        return attachmentType and _markAttachClasses.classOf(item.glyph) != attachmentType;
+    }
+
+    default:
+        return false;
+    }
+}
+
+Opt<usize> TtfShaper::_next(Lookup const &lookup, Slice<Item> items, usize i) const {
+    for (usize j = i + 1; j < items.len(); j++) {
+        if (not items[j].deleted and not _skip(lookup, items[j]))
+            return j;
+    }
+    return NONE;
+}
+
+Opt<usize> TtfShaper::_prev(Lookup const &lookup, Slice<Item> items, usize i) const {
+    for (usize j = i; j-- > 0;) {
+        if (not items[j].deleted and not _skip(lookup, items[j]))
+            return j;
+    }
+    return NONE;
+}
+
+void TtfShaper::_substitute(Lookup const &lookup, Vec<Item> &items) {
+    for (usize i = 0; i < items.len();) {
+        auto &item = items[i];
+        if (item.deleted or not lookup.mayApply(item.glyph) or _skip(lookup, item)) {
+            i++;
+            continue;
+        }
+
+        auto next = _substituteAt(lookup, items, i, 0);
+        i = next ? *next : i + 1;
+    }
+
+    // Ligature components are removed once per lookup instead of once per
+    // ligature, so the pass stays linear.
+    usize len = 0;
+    for (usize i = 0; i < items.len(); i++) {
+        if (not items[i].deleted)
+            items[len++] = items[i];
+    }
+    items.trunc(len);
+}
+
+Opt<usize> TtfShaper::_substituteAt(Lookup const &lookup, MutSlice<Item> items, usize i, usize depth) {
+    auto &item = items[i];
+
+    for (auto const &subtable : lookup.subtables) {
+        auto coverageIndex = subtable.coverage.indexOf(item.glyph);
+        if (not coverageIndex)
+            continue;
+
+        switch ((Ttf::GsubLookupType)subtable.type) {
+        case Ttf::GsubLookupType::SINGLE: {
+            Ttf::SingleSubstitution single{subtable.bytes};
+            item.glyph = single.substitute(item.glyph, *coverageIndex);
+            item.glyphClass = (Ttf::GlyphClass)_glyphClasses.classOf(item.glyph);
+            return i + 1;
+        }
+
+        case Ttf::GsubLookupType::LIGATURE: {
+            if (auto next = _ligate(lookup, subtable, items, i))
+                return next;
+            break;
+        }
+
+        case Ttf::GsubLookupType::CHAINED_CONTEXT: {
+            if (auto next = _chain(lookup, subtable, items, i, depth))
+                return next;
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+
+    return NONE;
+}
+
+Opt<usize> TtfShaper::_ligate(Lookup const &lookup, Subtable const &subtable, MutSlice<Item> items, usize i) {
+    Ttf::LigatureSubstitution ligatures{subtable.bytes};
+    auto coverageIndex = subtable.coverage.indexOf(items[i].glyph).unwrap();
+
+    Array<usize, MAX_CONTEXT> components{};
+    Opt<Ttf::Ligature> match = NONE;
+
+    ligatures.forEachLigature(coverageIndex, [&](Ttf::Ligature ligature) {
+        if (match or ligature.componentCount() > MAX_CONTEXT)
+            return;
+
+        usize j = i;
+        for (usize k = 1; k < ligature.componentCount(); k++) {
+            auto next = _next(lookup, items, j);
+            if (not next or items[*next].glyph != ligature.component(k))
+                return;
+            j = components[k] = *next;
+        }
+
+        match = ligature;
+    });
+
+    if (not match)
+        return NONE;
+
+    // The ligature stands for every rune from its first to its last
+    // component, skipped marks in between keep their own glyph.
+    auto &item = items[i];
+    usize end = item.runes.end();
+    for (usize k = 1; k < match->componentCount(); k++) {
+        auto &component = items[components[k]];
+        end = max(end, component.runes.end());
+        component.deleted = true;
+    }
+
+    item.glyph = match->ligatureGlyph();
+    item.glyphClass = (Ttf::GlyphClass)_glyphClasses.classOf(item.glyph);
+    item.runes.end(end);
+
+    usize last = match->componentCount() > 1 ? components[match->componentCount() - 1] : i;
+    return last + 1;
+}
+
+Opt<usize> TtfShaper::_chain(Lookup const &lookup, Subtable const &subtable, MutSlice<Item> items, usize i, usize depth) {
+    Array<usize, MAX_CONTEXT> positions{};
+    Ttf::ChainedSequenceRule const *matched = nullptr;
+    usize inputLen = 0;
+
+    if (subtable.format == 1 or subtable.format == 2) {
+        usize set = subtable.format == 1
+                        ? subtable.coverage.indexOf(items[i].glyph).unwrap()
+                        : subtable.inputClasses.classOf(items[i].glyph);
+
+        if (set >= subtable.ruleSets.len())
+            return NONE;
+
+        for (auto const &rule : subtable.ruleSets[set]) {
+            auto match = [&](Sequence sequence, usize k, u16 glyph) -> bool {
+                if (subtable.format == 1) {
+                    switch (sequence) {
+                    case Sequence::BACKTRACK:
+                        return rule.backtrack[k] == glyph;
+                    case Sequence::INPUT:
+                        return rule.input[k - 1] == glyph;
+                    case Sequence::LOOKAHEAD:
+                        return rule.lookahead[k] == glyph;
+                    }
+                }
+
+                switch (sequence) {
+                case Sequence::BACKTRACK:
+                    return rule.backtrack[k] == subtable.backtrackClasses.classOf(glyph);
+                case Sequence::INPUT:
+                    return rule.input[k - 1] == subtable.inputClasses.classOf(glyph);
+                case Sequence::LOOKAHEAD:
+                    return rule.lookahead[k] == subtable.lookaheadClasses.classOf(glyph);
+                }
+
+                return false;
+            };
+
+            if (_matchContext(
+                    lookup, items, i,
+                    rule.backtrack.len(), rule.input.len() + 1, rule.lookahead.len(),
+                    match, positions
+                )) {
+                matched = &rule;
+                inputLen = rule.input.len() + 1;
+                break;
+            }
+        }
+
+        if (not matched)
+            return NONE;
+    } else {
+        auto match = [&](Sequence sequence, usize k, u16 glyph) -> bool {
+            switch (sequence) {
+            case Sequence::BACKTRACK:
+                return subtable.backtrack[k].indexOf(glyph).has();
+            case Sequence::INPUT:
+                return subtable.input[k].indexOf(glyph).has();
+            case Sequence::LOOKAHEAD:
+                return subtable.lookahead[k].indexOf(glyph).has();
+            }
+            return false;
+        };
+
+        if (not _matchContext(
+                lookup, items, i,
+                subtable.backtrack.len(), subtable.input.len(), subtable.lookahead.len(),
+                match, positions
+            ))
+            return NONE;
+
+        inputLen = subtable.input.len();
+    }
+
+    usize end = positions[inputLen - 1] + 1;
+
+    // A nested ligature merges glyphs of the input, the sequence index of
+    // the next records refers to what is left of it. The first glyph of the
+    // input is never merged into another one.
+    auto resync = [&] {
+        inputLen = 1;
+        for (usize j = positions[0]; inputLen < MAX_CONTEXT;) {
+            auto next = _next(lookup, items, j);
+            if (not next or *next >= end)
+                break;
+            j = positions[inputLen++] = *next;
+        }
+    };
+
+    auto const &lookups = matched ? matched->lookups : subtable.lookups;
+    if (depth < MAX_NESTING) {
+        for (auto const &record : lookups) {
+            if (record.sequenceIndex >= inputLen)
+                continue;
+
+            auto *nested = this->lookup(false, record.lookupIndex);
+            auto pos = positions[record.sequenceIndex];
+            if (not nested or not nested->mayApply(items[pos].glyph))
+                continue;
+
+            if (_substituteAt(*nested, items, pos, depth + 1))
+                resync();
+        }
+    }
+
+    return end;
+}
+
+// MARK: Positioning -----------------------------------------------------------
+
+void TtfShaper::_attach(Lookup const &lookup, Slice<Item> items, MutSlice<Position> positions) {
+    for (usize i = 1; i < items.len(); i++) {
+        auto const &item = items[i];
+        if (item.glyphClass != Ttf::GlyphClass::MARK or
+            not lookup.mayApply(item.glyph) or
+            _skip(lookup, item))
+            continue;
+
+        for (auto const &subtable : lookup.subtables) {
+            auto markIndex = subtable.coverage.indexOf(item.glyph);
+            if (not markIndex)
+                continue;
+
+            // Marks attach to the closest base before them, or to the mark
+            // right before them for mark to mark attachment.
+            Opt<usize> target = NONE;
+            if (subtable.type == (u16)Ttf::GposLookupType::MARK_TO_BASE_ATTACHMENT) {
+                for (usize j = i; j-- > 0;) {
+                    if (items[j].glyphClass != Ttf::GlyphClass::MARK) {
+                        target = j;
+                        break;
+                    }
+                }
+            } else {
+                target = _prev(lookup, items, i);
+                if (target and items[*target].glyphClass != Ttf::GlyphClass::MARK)
+                    target = NONE;
+            }
+
+            if (not target)
+                continue;
+
+            auto baseIndex = subtable.baseCoverage.indexOf(items[*target].glyph);
+            if (not baseIndex)
+                continue;
+
+            Ttf::MarkAttachment attachment{subtable.bytes};
+            auto markArray = attachment.markArray();
+            if (*markIndex >= markArray.len())
+                continue;
+
+            auto baseAnchor = attachment.baseAnchor(*baseIndex, markArray.markClass(*markIndex));
+            if (not baseAnchor)
+                continue;
+
+            // Only the marks that get attached stop advancing the pen
+            auto markAnchor = markArray.anchor(*markIndex);
+            auto &mark = positions[i];
+            mark.base = *target;
+            mark.dx = (baseAnchor->x() - markAnchor.x()) / _unitPerEm;
+            mark.dy = (baseAnchor->y() - markAnchor.y()) / _unitPerEm;
+            mark.adv = 0;
+            break;
+        }
+    }
+}
+
+} // namespace Karm::Text
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <karm-base/array.h>
+#include <karm-base/vec.h>
+
+#include "font.h"
+#include "ttf/parser.h"
+
+namespace Karm::Text {
+
+// Applies the GSUB and GPOS lookups of an OpenType font. The tables are
+// compiled into flat acceleration structures the first time a feature set
+// uses them, so shaping a word is a linear walk over its glyphs per lookup
+// with array lookups and binary searches instead of table traversals.
+struct TtfShaper {
+    static constexpr usize MAX_NESTING = 4;
+    static constexpr usize MAX_CONTEXT = 16; //< Longest input sequence or ligature
+
+    // The (glyph, coverage index) pairs of a coverage table.
+    struct GlyphCoverage {
+        Vec<u32> _entries{}; //< glyph << 16 | coverage index, sorted
+
+        static GlyphCoverage from(Ttf::CoverageTable const &table);
+
+        Opt<usize> indexOf(u16 glyph) const;
+
+        // Set the bit of every covered glyph in a digest.
+        void addTo(Vec<u64> &digest) const;
+    };
+
+    // A class definition table flattened to an array indexed by glyph,
+    // glyphs past its end are in class 0.
+    struct GlyphClasses {
+        Vec<u16> _classes{};
+
+        static GlyphClasses from(Opt<Ttf::ClassDef> classDef);
+
+        u16 classOf(u16 glyph) const {
+            if (glyph >= _classes.len())
+                return 0;
+            return _classes[glyph];
+        }
+    };
+
+    struct Subtable {
+        u16 type; //< Lookup type once extensions are resolved
+        u16 format;
+        Bytes bytes;
+        GlyphCoverage coverage{}; //< Of the first glyph, or the mark
+
+        // Mark attachment
+        GlyphCoverage baseCoverage{};
+
+        // Chained contexts, format 1 and 2
+        GlyphClasses backtrackClasses{};
+        GlyphClasses inputClasses{};
+        GlyphClasses lookaheadClasses{};
+        Vec<Vec<Ttf::ChainedSequenceRule>> ruleSets{};
+
+        // Chained contexts, format 3
+        Vec<GlyphCoverage> backtrack{};
+        Vec<GlyphCoverage> input{};
+        Vec<GlyphCoverage> lookahead{};
+        Vec<Ttf::SequenceLookup> lookups{};
+    };
+
+    struct Lookup {
+        bool gpos;
+        u16 flag;
+        Vec<u64> digest{}; //< One bit per glyph any subtable may apply to
+        Vec<Subtable> subtables{};
+
+        bool mayApply(u16 glyph) const {
+            usize word = glyph / 64;
+            return word < digest.len() and (digest[word] >> (glyph % 64)) & 1;
+        }
+    };
+
+    // The lookups selected by a feature set, in lookup list order.
+    struct Plan {
+        FontFeatures features;
+        Vec<u16> gsub{};
+        Vec<u16> gpos{};
+    };
+
+    struct Item {
+        u16 glyph;
+        u16 font; //< See Glyph::font
+        Ttf::GlyphClass glyphClass;
+        urange runes;
+        bool deleted = false;
+    };
+
+    Ttf::Gsub _gsub{};
+    Ttf::Gpos _gpos{};
+    usize _numGlyphs = 0;
+    f64 _unitPerEm = 1;
+
+    GlyphClasses _glyphClasses{};
+    GlyphClasses _markAttachClasses{};
+    Vec<Opt<Lookup>> _gsubLookups{}; //< Indexed like the lookup list
+    Vec<Opt<Lookup>> _gposLookups{};
+    Vec<Plan> _plans{};
+
+    TtfShaper() = default;
+
+    TtfShaper(Ttf::Parser const &parser);
+
+    bool present() const {
+        return _gsub.present() or _gpos.present();
+    }
+
+    ShapedWord shape(Fontface &face, Slice<Rune> runes, FontFeatures features);
+
+    // MARK: Compilation -------------------------------------------------------
+
+    Plan const &plan(FontFeatures features);
+
+    Lookup const *lookup(bool gpos, usize index);
+
+    Lookup _compile(bool gpos, Ttf::LookupTable table);
+
+    // MARK: Substitution ------------------------------------------------------
+
+    bool _skip(Lookup const &lookup, Item const &item) const;
+
+    Opt<usize> _next(Lookup const &lookup, Slice<Item> items, usize i) const;
+
+    Opt<usize> _prev(Lookup const &lookup, Slice<Item> items, usize i) const;
+
+    void _substitute(Lookup const &lookup, Vec<Item> &items);
+
+    // Apply the first matching subtable of a lookup at `i`, returns the
+    // index of the next glyph to look at if it did.
+    Opt<usize> _substituteAt(Lookup const &lookup, MutSlice<Item> items, usize i, usize depth);
+
+    Opt<usize> _ligate(Lookup const &lookup, Subtable const &subtable, MutSlice<Item> items, usize i);
+
+    Opt<usize> _chain(Lookup const &lookup, Subtable const &subtable, MutSlice<Item> items, usize i, usize depth);
+
+    // Match the backtrack, input and lookahead sequences of a rule around
+    // `i`, `match(sequence, k, glyph)` tells if the glyph is the k-th one of
+    // a sequence, the first input glyph is already known to match.
+    enum struct Sequence {
+        BACKTRACK,
+        INPUT,
+        LOOKAHEAD,
+    };
+
+    bool _matchContext(
+        Lookup const &lookup, Slice<Item> items, usize i,
+        usize backtrack, usize input, usize lookahead,
+        auto match, Array<usize, MAX_CONTEXT> &positions
+    ) const {
+        if (input > MAX_CONTEXT)
+            return false;
+
+        positions[0] = i;
+        usize j = i;
+        for (usize k = 1; k < input; k++) {
+            auto next = _next(lookup, items, j);
+            if (not next or not match(Sequence::INPUT, k, items[*next].glyph))
+                return false;
+            j = positions[k] = *next;
+        }
+
+        for (usize k = 0; k < lookahead; k++) {
+            auto next = _next(lookup, items, j);
+            if (not next or not match(Sequence::LOOKAHEAD, k, items[*next].glyph))
+                return false;
+            j = *next;
+        }
+
+        j = i;
+        for (usize k = 0; k < backtrack; k++) {
+            auto prev = _prev(lookup, items, j);
+            if (not prev or not match(Sequence::BACKTRACK, k, items[*prev].glyph))
+                return false;
+            j = *prev;
+        }
+
+        return true;
+    }
+
+    // MARK: Positioning -------------------------------------------------------
+
+    // Glyphs follow the pen, attached marks are placed against their base
+    // once every lookup is applied.
+    struct Position {
+        f64 kern = 0; //< Before the glyph
+        f64 adv = 0;
+        Opt<usize> base = NONE;
+        f64 dx = 0; //< From the base
+        f64 dy = 0; //< From the base, upward, in em units
+    };
+
+    void _attach(Lookup const &lookup, Slice<Item> items, MutSlice<Position> positions);
+};
+
+} // namespace Karm::Text
@@ -0,0 +1,104 @@
+#include <karm-base/ctype.h>
+
+#include "shaping.h"
+
+namespace Karm::Text {
+
+// MARK: Words -----------------------------------------------------------------
+
+static bool _isSeparator(Rune rune) {
+    return rune == '\n' or isAsciiSpace(rune);
+}
+
+usize wordEnd(Slice<Rune> runes, usize start) {
+    if (start >= runes.len())
+        return runes.len();
+
+    if (_isSeparator(runes[start]))
+        return start + 1;
+
+    usize end = start + 1;
+    while (end < runes.len() and not _isSeparator(runes[end]))
+        end++;
+    return end;
+}
+
+// MARK: Shaping Cache ---------------------------------------------------------
+
+static Hash _hashWord(Fontface &fontface, FontFeatures features, Slice<Rune> runes) {
+    // The generic slice hasher is order independent, anagrams would
+    // always collide.
+    Fnv fnv;
+    fnv.mix((usize)&fontface);
+    fnv.mix(toUnderlyingType(features));
+    for (auto rune : runes)
+        fnv.mix(rune);
+    return fnv.h;
+}
+
+ShapingCache::ShapingCache(usize budget)
+    : _lru(budget) {}
+
+ShapingCache::~ShapingCache() {
+    clear();
+}
+
+ShapedWord const &ShapingCache::shape(Strong<Fontface> fontface, FontFeatures features, Slice<Rune> word) {
+    auto hash = _hashWord(*fontface, features, word);
+
+    auto *entry = _lru.lookup(hash, [&](Entry const &e) {
+        return &e.fontface.unwrap() == &fontface.unwrap() and
+               e.features == features and
+               sub(e.runes) == word;
+    });
+
+    if (entry) {
+        _stats.hits++;
+        _lru.touch(entry);
+        return entry->word;
+    }
+
+    _stats.misses++;
+
+    entry = new Entry{
+        .hash = hash,
+        .fontface = fontface,
+        .features = features,
+        .runes = word,
+        .word = fontface->shape(word, features),
+    };
+
+    entry->bytes =
+        sizeof(Entry) +
+        entry->runes.len() * sizeof(Rune) +
+        entry->word.glyphs.len() * sizeof(ShapedGlyph);
+
+    _lru.insert(entry);
+    _lru.evict(entry);
+
+    return entry->word;
+}
+
+void ShapingCache::budget(usize bytes) {
+    _lru.budget(bytes);
+}
+
+void ShapingCache::clear() {
+    _lru.clear();
+}
+
+ShapingStats ShapingCache::stats() const {
+    auto stats = _stats;
+    stats.evictions = _lru.evictions();
+    stats.entries = _lru.len();
+    stats.bytes = _lru.bytes();
+    stats.budget = _lru._budget;
+    return stats;
+}
+
+ShapingCache &globalShapingCache() {
+    static ShapingCache cache;
+    return cache;
+}
+
+} // namespace Karm::Text
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <karm-base/lru.h>
+#include <karm-base/vec.h>
+#include <karm-io/emit.h>
+
+#include "font.h"
+
+namespace Karm::Text {
+
+// MARK: Words -----------------------------------------------------------------
+
+// Words are maximal sequences of non-space runes, each space or newline
+// is a word of its own so they are shared between all the words.
+usize wordEnd(Slice<Rune> runes, usize start);
+
+// MARK: Shaping Cache ---------------------------------------------------------
+
+struct ShapingStats {
+    usize hits = 0;
+    usize misses = 0;
+    usize evictions = 0;
+    usize entries = 0;
+    usize bytes = 0;
+    usize budget = 0;
+
+    f64 hitRate() const {
+        auto lookups = hits + misses;
+        if (not lookups)
+            return 0;
+        return hits / (f64)lookups;
+    }
+
+    void repr(Io::Emit &e) const {
+        e("(shaping-stats hits:{} misses:{} hit-rate:{} evictions:{} entries:{} bytes:{}/{})", hits, misses, hitRate(), evictions, entries, bytes, budget);
+    }
+};
+
+// Maps (fontface, features, word) to its shaped glyphs, entries are evicted in least
+// recently used order once their memory footprint exceeds the budget.
+struct ShapingCache {
+    static constexpr usize DEFAULT_BUDGET = 4 * 1024 * 1024;
+
+    struct Entry {
+        Hash hash;
+        Strong<Fontface> fontface;
+        FontFeatures features;
+        Vec<Rune> runes;
+        ShapedWord word;
+        usize bytes = 0;
+
+        Entry *chain = nullptr; //< Next entry in the same bucket
+        LlItem<Entry> item{};
+    };
+
+    BudgetLru<Entry> _lru;
+    ShapingStats _stats{};
+
+    ShapingCache(usize budget = DEFAULT_BUDGET);
+
+    ~ShapingCache();
+
+    ShapingCache(ShapingCache const &) = delete;
+
+    ShapingCache &operator=(ShapingCache const &) = delete;
+
+    // The returned word is only valid until the next call to shape().
+    ShapedWord const &shape(Strong<Fontface> fontface, FontFeatures features, Slice<Rune> word);
+
+    // Shape a sequence of runes word by word, `emit` is called once per
+    // glyph with the runes it stands for, its glyph, position and advance
+    // scaled to the font size. A ligature stands for several runes and
+    // marks may be offset vertically. Kerning between words is applied at
+    // the boundaries so the result is the same as shaping the whole
+    // sequence at once.
+    f64 layout(Font &font, Slice<Rune> runes, auto emit) {
+        f64 xpos = 0;
+        bool first = true;
+        bool kerning = (font.features & FontFeatures::KERN) == FontFeatures::KERN;
+        Glyph prev = Glyph::TOFU;
+
+        for (usize start = 0; start < runes.len();) {
+            auto end = wordEnd(runes, start);
+            auto &word = shape(font.fontface, font.features, sub(runes, start, end));
+
+            for (usize i = 0; i < word.glyphs.len(); i++) {
+                auto &g = word.glyphs[i];
+                if (i == 0 and not first and kerning)
+                    xpos += font.kern(prev, g.glyph);
+                emit(
+                    urange{start + g.runes.start, g.runes.size},
+                    g.glyph,
+                    xpos + g.xpos * font.fontsize,
+                    g.ypos * font.fontsize,
+                    g.adv * font.fontsize
+                );
+            }
+
+            if (any(word.glyphs)) {
+                xpos += word.width * font.fontsize;
+                prev = last(word.glyphs).glyph;
+                first = false;
+            }
+
+            start = end;
+        }
+
+        return xpos;
+    }
+
+    void budget(usize bytes);
+
+    void clear();
+
+    ShapingStats stats() const;
+};
+
+ShapingCache &globalShapingCache();
+
+} // namespace Karm::Text
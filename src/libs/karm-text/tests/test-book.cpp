@@ -1,4 +1,5 @@
 #include <karm-test/macros.h>
+#include <karm-io/impls.h>
 #include <karm-text/book.h>
 
 namespace Karm::Text::Tests {
@@ -14,4 +15,71 @@ test$("karm-text-common-family") {
     return Ok();
 }
 
+test$("karm-text-coverage") {
+    Coverage coverage;
+    coverage.add('c');
+    coverage.add('d');
+    coverage.add(Range<Rune>{'x', 3});
+    coverage.add('a');
+    coverage.add('b');
+
+    expectEq$(coverage.ranges().len(), 2uz);
+    expectEq$(coverage.len(), 7uz);
+    expect$(coverage.contains('a'));
+    expect$(coverage.contains('d'));
+    expect$(not coverage.contains('e'));
+    expect$(coverage.contains('z'));
+    expect$(not coverage.contains('{'));
+
+    coverage.add(Range<Rune>{'c', 'y' - 'c'});
+    expectEq$(coverage.ranges().len(), 1uz);
+    expectEq$(coverage.len(), 26uz);
+
+    return Ok();
+}
+
+test$("karm-text-font-index") {
+    Coverage coverage;
+    coverage.add(Range<Rune>{0x20, 0x5f});
+    coverage.add(0x2022);
+
+    FontAttrs attrs{
+        .family = "Inter"s,
+        .weight = FontWeight::BOLD,
+        .stretch = FontStretch::CONDENSED,
+        .style = FontStyle::ITALIC,
+    };
+
+    Vec<FontInfo> infos;
+    infos.pushBack({
+        .url = "bundle://fonts-inter/fonts/Inter-BoldItalic.ttf"_url,
+        .attrs = attrs,
+        .face = Fontface::fallback(),
+        .coverage = coverage,
+        .mtime = TimeStamp{1234},
+    });
+
+    Io::BufferWriter buf;
+    Io::BEmit e{buf};
+    try$(writeFontIndex(e, infos));
+
+    auto index = try$(readFontIndex(buf.bytes()));
+    expectEq$(index.len(), 1uz);
+    expect$(index[0].url == infos[0].url);
+    expect$(index[0].mtime == TimeStamp{1234});
+    expect$(index[0].coverage == coverage);
+
+    // Answering from the index must not touch the font file
+    auto &face = static_cast<LazyFontface &>(index[0].face.unwrap());
+    expectEq$(face.attrs().family, attrs.family);
+    expect$(face.attrs().weight == FontWeight::BOLD);
+    expect$(face.attrs().style == FontStyle::ITALIC);
+    expect$(face.coverage() == coverage);
+    expect$(not face.loaded());
+
+    expect$(not readFontIndex(sub(buf.bytes(), 0, buf.bytes().len() - 1)));
+
+    return Ok();
+}
+
 } // namespace Karm::Text::Tests
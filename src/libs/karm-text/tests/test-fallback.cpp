@@ -0,0 +1,181 @@
+#include <karm-test/macros.h>
+#include <karm-text/fallback.h>
+
+namespace Karm::Text::Tests {
+
+// A fontface with a glyph for every rune of its coverage.
+struct FakeFontface : public Fontface {
+    Coverage _coverage;
+    f64 _advance;
+
+    FakeFontface(Coverage coverage, f64 advance = 1)
+        : _coverage(std::move(coverage)), _advance(advance) {}
+
+    FontMetrics metrics() const override {
+        return {};
+    }
+
+    FontAttrs attrs() const override {
+        return {};
+    }
+
+    Glyph glyph(Rune rune) override {
+        if (not _coverage.contains(rune))
+            return Glyph::TOFU;
+        return {(u16)rune, 0};
+    }
+
+    // A glyph naming another face is a bug of the composite face around it
+    f64 advance(Glyph glyph) override {
+        return glyph.font == 0 ? _advance : -1;
+    }
+
+    f64 kern(Glyph, Glyph) override {
+        return 0;
+    }
+
+    void contour(Gfx::Canvas &, Glyph) const override {}
+
+    Coverage coverage() const override {
+        return _coverage;
+    }
+};
+
+static Strong<Fontface> _fakeFace(Slice<Range<Rune>> ranges, f64 advance = 1) {
+    Coverage coverage;
+    for (auto r : ranges)
+        coverage.add(r);
+    return makeStrong<FakeFontface>(coverage, advance);
+}
+
+static Vec<Rune> _runes(Str str) {
+    Vec<Rune> runes;
+    for (auto rune : iterRunes(str))
+        runes.pushBack(rune);
+    return runes;
+}
+
+test$("karm-text-coverage-bitmap") {
+    Coverage coverage;
+    coverage.add(Range<Rune>{0x20, 0x5f});
+    coverage.add(Range<Rune>{0x4e00, 0x200});
+    coverage.add(0x1f600);
+
+    CoverageBitmap bitmap{coverage};
+
+    for (Rune rune : Array<Rune, 10>{0, 0x1f, 0x20, 0x7e, 0x7f, 0x4dff, 0x4e00, 0x4fff, 0x5000, 0x1f600}) {
+        expectEq$(bitmap.contains(rune), coverage.contains(rune));
+    }
+    expect$(not bitmap.contains(0x10ffff));
+
+    // The two full pages are shared
+    expectEq$(bitmap._words.len(), CoverageBitmap::PAGE_WORDS * 4);
+
+    return Ok();
+}
+
+test$("karm-text-fallback-resolve") {
+    Array<Range<Rune>, 1> latin{Range<Rune>{0x20, 0x5f}};
+    Array<Range<Rune>, 1> cjk{Range<Rune>{0x4e00, 0x5200}};
+    Array<Range<Rune>, 2> marks{Range<Rune>{0x41, 0x1a}, Range<Rune>{0x300, 0x70}};
+
+    FontFallback fallback{{_fakeFace(latin), _fakeFace(cjk), _fakeFace(marks)}};
+
+    expectEq$(fallback.resolve('a'), 0uz);
+    expectEq$(fallback.resolve(U'世'), 1uz);
+    expectEq$(fallback.resolve(0x301), 2uz);
+    expectEq$(fallback.resolve(0x10ffff), 0uz);
+
+    expectEq$(fallback.glyph(U'世').font, 1);
+    expectEq$(fallback.stats().misses, 4uz);
+
+    fallback.resolve('a');
+    expectEq$(fallback.stats().hits, 2uz);
+
+    return Ok();
+}
+
+test$("karm-text-fallback-nested") {
+    Array<Range<Rune>, 1> latin{Range<Rune>{0x20, 0x5f}};
+    Array<Range<Rune>, 1> cjk{Range<Rune>{0x4e00, 0x5200}};
+    Array<Range<Rune>, 1> marks{Range<Rune>{0x300, 0x70}};
+
+    // The faces of the inner fallback come after the latin one
+    auto inner = makeStrong<FontFallback>(Vec<Strong<Fontface>>{_fakeFace(cjk, 2), _fakeFace(marks, 3)});
+    FontFallback fallback{{_fakeFace(latin), inner}};
+    expectEq$(fallback.fonts(), 3uz);
+
+    auto a = fallback.glyph('a');
+    auto ideograph = fallback.glyph(U'世');
+    auto mark = fallback.glyph(0x301);
+    expectEq$(a.font, 0);
+    expectEq$(ideograph.font, 1);
+    expectEq$(mark.font, 2);
+
+    // Each face gets its glyphs back as it made them
+    expectEq$(fallback.advance(a), 1.0);
+    expectEq$(fallback.advance(ideograph), 2.0);
+    expectEq$(fallback.advance(mark), 3.0);
+
+    auto word = fallback.shape(_runes("a世"), FontFeatures::NONE);
+    expectEq$(word.glyphs.len(), 2uz);
+    expectEq$(word.glyphs[0].glyph.font, 0);
+    expectEq$(word.glyphs[1].glyph.font, 1);
+    expectEq$(word.width, 3.0);
+
+    return Ok();
+}
+
+test$("karm-text-fallback-misses") {
+    Array<Range<Rune>, 1> latin{Range<Rune>{0x20, 0x5f}};
+    Array<Range<Rune>, 1> cjk{Range<Rune>{0x4e00, 0x5200}};
+    Array<Range<Rune>, 1> marks{Range<Rune>{0x300, 0x70}};
+
+    FontFallback fallback{{_fakeFace(latin), _fakeFace(cjk), _fakeFace(marks)}};
+
+    // Only the faces that get picked build a bitmap
+    fallback.resolve('a');
+    expectEq$(fallback.stats().bitmaps, 1uz);
+    fallback.resolve(U'世');
+    expectEq$(fallback.stats().bitmaps, 2uz);
+
+    expectEq$(fallback.resolve(0x10ffff), 0uz);
+    expectEq$(fallback.stats().bitmaps, 2uz);
+    expectEq$(fallback.stats().uncovered, 1uz);
+
+    // Once its cache slot is reused, the rune isn't searched for again
+    expectEq$(0x4fff % FontFallback::CACHE_SIZE, 0x10ffff % FontFallback::CACHE_SIZE);
+    expectEq$(fallback.resolve(0x4fff), 1uz);
+    expectEq$(fallback.resolve(0x10ffff), 0uz);
+    expectEq$(fallback.stats().uncovered, 1uz);
+
+    return Ok();
+}
+
+test$("karm-text-fallback-segment") {
+    Array<Range<Rune>, 1> latin{Range<Rune>{0x20, 0x5f}};
+    Array<Range<Rune>, 2> cjk{Range<Rune>{0x20, 0x1}, Range<Rune>{0x4e00, 0x5200}};
+    Array<Range<Rune>, 2> marks{Range<Rune>{0x41, 0x1a}, Range<Rune>{0x300, 0x70}};
+
+    FontFallback fallback{{_fakeFace(latin), _fakeFace(cjk), _fakeFace(marks)}};
+
+    auto runes = _runes("hi 世界 ok E\u0301!");
+
+    Vec<Pair<usize>> segments;
+    fallback.segment(runes, [&](urange range, usize face) {
+        segments.pushBack({range.start, face});
+    });
+
+    // The space after 世界 stays on the CJK face, the accent goes with its
+    // base on the only face covering both and the "!" goes back to latin.
+    expectEq$(segments.len(), 5uz);
+    expectEq$(segments[0], (Pair<usize>{0, 0}));
+    expectEq$(segments[1], (Pair<usize>{3, 1}));
+    expectEq$(segments[2], (Pair<usize>{6, 0}));
+    expectEq$(segments[3], (Pair<usize>{9, 2}));
+    expectEq$(segments[4], (Pair<usize>{11, 0}));
+
+    return Ok();
+}
+
+} // namespace Karm::Text::Tests
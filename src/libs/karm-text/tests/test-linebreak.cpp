@@ -0,0 +1,212 @@
+#include <karm-io/aton.h>
+#include <karm-io/expr.h>
+#include <karm-io/funcs.h>
+#include <karm-sys/file.h>
+#include <karm-test/macros.h>
+#include <karm-text/linebreak.h>
+#include <karm-text/prose.h>
+
+namespace Karm::Text::Tests {
+
+// One line per rule, in the format of LineBreakTest.txt from the Unicode
+// Character Database, × is no break and ÷ a break opportunity.
+static Array const LINE_BREAK_RULES = {
+    "× 0023 × 0023 ÷"s,                   // AL × AL
+    "× 0023 × 0020 ÷ 0023 ÷"s,            // LB18
+    "× 0023 × 0020 × 0020 ÷ 0023 ÷"s,     // LB18
+    "× 0023 × 0308 × 0023 ÷"s,            // LB9
+    "× 0023 × 0308 × 0020 ÷ 0023 ÷"s,     // LB9
+    "× 0020 ÷ 0308 ÷"s,                   // LB10
+    "× 0041 × 0308 × 200D × 0041 ÷"s,     // LB8a, LB9
+    "× 0023 × 200D × 0023 ÷"s,            // LB8a
+    "× 0020 ÷ 0023 ÷"s,                   // LB18
+    "× 0020 × 0020 ÷ 0023 ÷"s,            // LB18
+    "× 0020 × 0029 ÷"s,                   // LB13
+    "× 0023 × 000A ÷ 0023 ÷"s,            // LB5
+    "× 0023 × 000D × 000A ÷"s,            // LB5
+    "× 000D × 000A ÷ 0023 ÷"s,            // LB5
+    "× 000D ÷ 0023 ÷"s,                   // LB5
+    "× 000A ÷ 000A ÷"s,                   // LB5
+    "× 000B ÷ 0023 ÷"s,                   // LB4
+    "× 0085 ÷ 0023 ÷"s,                   // LB5
+    "× 200B ÷ 0023 ÷"s,                   // LB8
+    "× 200B × 0020 ÷ 0023 ÷"s,            // LB8
+    "× 200B ÷ 0308 ÷"s,                   // LB8
+    "× 0023 × 200B ÷ 0023 ÷"s,            // LB7
+    "× 0023 × 2060 × 0023 ÷"s,            // LB11
+    "× 00A0 × 0023 ÷"s,                   // LB12
+    "× 0023 × 00A0 × 0023 ÷"s,            // LB12a
+    "× 0020 ÷ 00A0 ÷"s,                   // LB12a
+    "× 0023 × 0021 ÷"s,                   // LB13
+    "× 0023 × 002F ÷ 0023 ÷"s,            // LB13
+    "× 0028 × 0023 ÷"s,                   // LB14
+    "× 0028 × 0020 × 0023 ÷"s,            // LB14
+    "× 0028 × 0308 × 0020 × 0023 ÷"s,     // LB14
+    "× 0029 × 0020 × 3005 ÷"s,            // LB16
+    "× 2014 × 0020 × 2014 ÷"s,            // LB17
+    "× 0023 × 0009 ÷ 0023 ÷"s,            // LB21
+    "× 0023 × 002D ÷ 0023 ÷"s,            // LB21
+    "× 0031 × 002C × 0031 ÷"s,            // LB25
+    "× 0024 × 0031 ÷"s,                   // LB25
+    "× 0031 × 0025 ÷"s,                   // LB25
+    "× 1100 × 1161 × 11A8 ÷"s,            // LB26
+    "× 4E00 ÷ 4E00 ÷"s,                   // LB31
+    "× 4E00 × 3002 ÷ 4E00 ÷"s,            // LB13
+    "× 1F1E6 × 1F1E7 ÷ 1F1E8 × 1F1E9 ÷"s, // LB30a
+    "× 1F1E6 × 0308 × 1F1E7 ÷ 1F1E8 ÷"s,  // LB30a
+    "× 261D × 1F3FB ÷"s,                  // LB30b
+    "× 1FFFD × 1F3FB ÷"s,                 // LB30b
+};
+
+struct LineBreakTest {
+    Vec<Rune> runes;
+    Vec<bool> breaks; //< Before each rune and at the end
+};
+
+static LineBreakTest _parseLineBreakTest(Str str) {
+    LineBreakTest test;
+    Io::SScan s{str};
+    while (not s.ended()) {
+        s.eat(Re::space());
+        if (s.skip("×"))
+            test.breaks.pushBack(false);
+        else if (s.skip("÷"))
+            test.breaks.pushBack(true);
+        else if (auto rune = Io::atou(s, {.base = 16}))
+            test.runes.pushBack(*rune);
+        else
+            s.next();
+    }
+    return test;
+}
+
+static Res<> _expectBreaks(Test::Driver &_driver, LineBreakTest const &test) {
+    Vec<bool> breaks;
+    LineBreaker breaker;
+    for (auto rune : test.runes)
+        breaks.pushBack(breaker.next(rune) != Break::NONE);
+    breaks.pushBack(breaker.end() != Break::NONE);
+
+    expectEq$(breaks.len(), test.breaks.len());
+    for (usize i = 0; i < breaks.len(); i++)
+        expectEq$(breaks[i], test.breaks[i]);
+
+    return Ok();
+}
+
+test$("karm-text-linebreak-rules") {
+    for (auto line : LINE_BREAK_RULES)
+        try$(_expectBreaks(_driver, _parseLineBreakTest(line)));
+
+    return Ok();
+}
+
+test$("karm-text-linebreak-conformance") {
+    // Generated with defs/genLineBreakTest.py, broken by ICU
+    auto file = try$(Sys::File::open("bundle://karm-text.tests/line-break-icu.txt"_url));
+    auto text = try$(Io::readAllUtf8(file));
+
+    usize count = 0;
+    Io::SScan s{text};
+    while (not s.ended()) {
+        auto line = s.token(Re::until('\n'_re));
+        s.skip('\n');
+
+        Io::SScan l{line};
+        auto test = _parseLineBreakTest(l.token(Re::until('#'_re)));
+        if (not test.runes.len())
+            continue;
+
+        try$(_expectBreaks(_driver, test));
+        count++;
+    }
+
+    expectGt$(count, 0uz);
+
+    return Ok();
+}
+
+test$("karm-text-linebreak-mandatory") {
+    Vec<Rune> runes;
+    for (auto rune : iterRunes("ab cd\nef"s))
+        runes.pushBack(rune);
+
+    Vec<Cons<usize, Break>> breaks;
+    lineBreaks(runes, [&](usize index, Break brk) {
+        breaks.pushBack({index, brk});
+    });
+
+    expectEq$(breaks.len(), 3uz);
+    expectEq$(breaks[0].car, 3uz);
+    expect$(breaks[0].cdr == Break::ALLOWED);
+    expectEq$(breaks[1].car, 6uz);
+    expect$(breaks[1].cdr == Break::MANDATORY);
+    expectEq$(breaks[2].car, 8uz);
+    expect$(breaks[2].cdr == Break::MANDATORY);
+
+    return Ok();
+}
+
+test$("karm-text-linebreak-fit-greedy") {
+    Array segments = {
+        LineSegment{4, 1},
+        LineSegment{4, 1},
+        LineSegment{4, 1},
+        LineSegment{12, 0},
+        LineSegment{1, 0, true},
+        LineSegment{1, 0},
+    };
+
+    auto starts = fitLines(segments, 10, LineFit::GREEDY);
+    expectEq$(starts.len(), 4uz);
+    expectEq$(starts[0], 2uz);
+    expectEq$(starts[1], 3uz);
+    expectEq$(starts[2], 4uz);
+    expectEq$(starts[3], 5uz);
+
+    return Ok();
+}
+
+test$("karm-text-linebreak-fit-total") {
+    // Greedy fills the first line and leaves the second one ragged, total
+    // fit evens them out, the last line is free.
+    Array segments = {
+        LineSegment{5, 1},
+        LineSegment{1, 1},
+        LineSegment{4, 1},
+        LineSegment{6, 0},
+    };
+
+    auto greedy = fitLines(segments, 10, LineFit::GREEDY);
+    expectEq$(greedy.len(), 2uz);
+    expectEq$(greedy[0], 2uz);
+    expectEq$(greedy[1], 3uz);
+
+    auto total = fitLines(segments, 10, LineFit::TOTAL_FIT);
+    expectEq$(total.len(), 2uz);
+    expectEq$(total[0], 1uz);
+    expectEq$(total[1], 3uz);
+
+    return Ok();
+}
+
+test$("karm-text-linebreak-prose-blocks") {
+    Prose prose{
+        {
+            .font = Font::fallback(),
+            .multiline = true,
+        },
+        "foo-bar (baz)\nqux"
+    };
+
+    // "foo-" "bar " "(baz)\n" "qux"
+    expectEq$(prose._blocks.len(), 4uz);
+    expectEq$(prose._blocks[0].runeRange, (urange{0, 4}));
+    expectEq$(prose._blocks[1].runeRange, (urange{4, 4}));
+    expectEq$(prose._blocks[2].runeRange, (urange{8, 6}));
+    expectEq$(prose._blocks[3].runeRange, (urange{14, 3}));
+
+    return Ok();
+}
+
+} // namespace Karm::Text::Tests
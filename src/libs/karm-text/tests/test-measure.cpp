@@ -0,0 +1,60 @@
+#include <karm-test/macros.h>
+#include <karm-text/measure.h>
+#include <karm-text/run.h>
+
+namespace Karm::Text::Tests {
+
+static Vec<Rune> _runes(Str str) {
+    Vec<Rune> runes;
+    for (auto rune : iterRunes(str))
+        runes.pushBack(rune);
+    return runes;
+}
+
+test$("karm-text-measure-widths") {
+    auto font = Font::fallback();
+
+    auto run = Run::from(font, "a bb ccc dd"s);
+    auto m = measure(font, run._runes);
+    expectEq$(m.width, run.layout().x);
+
+    auto longest = Run::from(font, "ccc"s);
+    expectEq$(m.longestWord, longest.layout().x);
+
+    return Ok();
+}
+
+test$("karm-text-measure-newlines") {
+    auto font = Font::fallback();
+
+    auto m = measure(font, _runes("aaaa\nbb"));
+    auto line = Run::from(font, "aaaa\n"s);
+    expectEq$(m.width, line.layout().x);
+
+    return Ok();
+}
+
+test$("karm-text-measure-segments") {
+    auto font = Font::fallback();
+    auto runes = _runes("foo-bar baz");
+
+    Vec<urange> ranges;
+    Vec<LineSegment> segments;
+    measureSegments(font, runes, [&](urange r, LineSegment const &s) {
+        ranges.pushBack(r);
+        segments.pushBack(s);
+    });
+
+    expectEq$(ranges.len(), 3uz);
+    expectEq$(ranges[0], (urange{0, 4}));
+    expectEq$(ranges[1], (urange{4, 4}));
+    expectEq$(ranges[2], (urange{8, 3}));
+
+    expectEq$(segments[0].trailing, 0.0);
+    expect$(segments[1].trailing > 0);
+    expectEq$(segments[2].trailing, 0.0);
+
+    return Ok();
+}
+
+} // namespace Karm::Text::Tests
@@ -21,4 +21,47 @@ test$("karm-text-model-moves") {
     return Ok();
 }
 
+test$("karm-text-model-journal") {
+    Model mdl{"foo"};
+    usize gen = mdl.generation();
+
+    mdl.moveEnd();
+    mdl.insert('!');
+    expectEq$(mdl.generation(), gen + 1);
+
+    auto changes = try$(mdl.changesSince(gen));
+    expectEq$(changes.len(), 1uz);
+    expectEq$(changes[0].pos, 3uz);
+    expectEq$(changes[0].removed, 0uz);
+    expectEq$(changes[0].inserted.len(), 1uz);
+
+    expectEq$(try$(mdl.changesSince(mdl.generation())).len(), 0uz);
+    expect$(not mdl.changesSince(mdl.generation() + 1));
+
+    // Loaded text isn't journaled, views must rebuild
+    gen = mdl.generation();
+    mdl.load("bar");
+    expect$(not mdl.changesSince(gen));
+    expectEq$(try$(mdl.changesSince(mdl.generation())).len(), 0uz);
+
+    return Ok();
+}
+
+test$("karm-text-model-journal-bounded") {
+    Model mdl{""};
+    usize gen = mdl.generation();
+
+    for (usize i = 0; i < Model::MAX_CHANGES * 4; i++)
+        mdl.insert('a');
+
+    expect$(mdl._changes.len() <= Model::MAX_CHANGES);
+    expectEq$(mdl.generation(), gen + Model::MAX_CHANGES * 4);
+
+    // Views that fell too far behind can't replay the edits
+    expect$(not mdl.changesSince(gen));
+    expectEq$(try$(mdl.changesSince(mdl.generation() - 1)).len(), 1uz);
+
+    return Ok();
+}
+
 } // namespace Karm::Text::Tests
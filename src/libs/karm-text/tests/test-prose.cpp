@@ -0,0 +1,120 @@
+#include <karm-test/macros.h>
+#include <karm-text/prose.h>
+
+namespace Karm::Text::Tests {
+
+static Vec<Rune> _runes(Str str) {
+    Vec<Rune> runes;
+    for (auto rune : iterRunes(str))
+        runes.pushBack(rune);
+    return runes;
+}
+
+static ProseStyle _style() {
+    return {
+        .font = Font::fallback(),
+        .multiline = true,
+    };
+}
+
+// Laying out the edited prose must give the same result as laying out a
+// fresh prose with the same text.
+static Res<> _expectSameLayout(Test::Driver &_driver, Prose &edited, f64 width) {
+    Prose fresh{_style()};
+    fresh.append(edited._runes);
+
+    auto editedSize = edited.layout(width);
+    auto freshSize = fresh.layout(width);
+
+    expectEq$(editedSize, freshSize);
+    expectEq$(edited._blocks.len(), fresh._blocks.len());
+    expectEq$(edited._lines.len(), fresh._lines.len());
+
+    for (usize i = 0; i < fresh._blocks.len(); i++) {
+        expectEq$(edited._blocks[i].runeRange, fresh._blocks[i].runeRange);
+        expectEq$(edited._blocks[i].cellRange, fresh._blocks[i].cellRange);
+        expectEq$(edited._blocks[i].width, fresh._blocks[i].width);
+    }
+
+    for (usize i = 0; i < fresh._lines.len(); i++) {
+        expectEq$(edited._lines[i].runeRange, fresh._lines[i].runeRange);
+        expectEq$(edited._lines[i].blockRange, fresh._lines[i].blockRange);
+        expectEq$(edited._lines[i].baseline, fresh._lines[i].baseline);
+        expectEq$(edited._lines[i].width, fresh._lines[i].width);
+    }
+
+    return Ok();
+}
+
+test$("karm-text-prose-incremental-insert") {
+    Prose prose{_style(), "hello world\nfoo bar baz\nlast line"};
+    prose.layout(64);
+
+    prose.insert(6, _runes("big "));
+    try$(_expectSameLayout(_driver, prose, 64));
+
+    prose.insert(prose._runes.len(), _runes("\n"));
+    try$(_expectSameLayout(_driver, prose, 64));
+
+    prose.insert(prose._runes.len(), _runes("x"));
+    try$(_expectSameLayout(_driver, prose, 64));
+
+    return Ok();
+}
+
+test$("karm-text-prose-incremental-remove") {
+    Prose prose{_style(), "hello world\nfoo bar baz\nlast line"};
+    prose.layout(64);
+
+    // Joins the two first paragraphs
+    prose.remove({11, 1});
+    try$(_expectSameLayout(_driver, prose, 64));
+
+    prose.remove({0, prose._runes.len()});
+    try$(_expectSameLayout(_driver, prose, 64));
+
+    return Ok();
+}
+
+test$("karm-text-prose-incremental-several-edits") {
+    Prose prose{_style(), "one\ntwo\nthree\nfour\nfive"};
+    prose.layout(200);
+
+    // Several edits in different paragraphs between two layouts
+    prose.insert(0, _runes("zero "));
+    prose.insert(prose._runes.len(), _runes(" six"));
+    prose.remove({10, 2});
+    try$(_expectSameLayout(_driver, prose, 200));
+
+    // Only the width changes
+    try$(_expectSameLayout(_driver, prose, 32));
+
+    return Ok();
+}
+
+test$("karm-text-prose-incremental-large") {
+    // Spans many leaves of the rope
+    auto line = _runes("the quick brown fox jumps over the lazy dog\n");
+    Vec<Rune> text;
+    for (usize i = 0; i < 64; i++)
+        text.pushBack(line);
+
+    Prose prose{_style()};
+    prose.append(text);
+    prose.layout(120);
+
+    usize mid = prose._runes.len() / 2;
+    prose.insert(mid, _runes("typed "));
+    prose.insert(mid + 6, _runes("\n"));
+    try$(_expectSameLayout(_driver, prose, 120));
+
+    prose.remove({mid - 300, 600});
+    try$(_expectSameLayout(_driver, prose, 120));
+
+    for (usize i = 0; i < prose._cells.len(); i++)
+        expectEq$(prose._cells[i].rune, prose._runes[i]);
+
+    return Ok();
+}
+
+} // namespace Karm::Text::Tests
@@ -0,0 +1,110 @@
+#include <karm-math/rand.h>
+#include <karm-test/macros.h>
+#include <karm-text/rope.h>
+
+namespace Karm::Text::Tests {
+
+static Vec<Rune> _runes(Str str) {
+    Vec<Rune> runes;
+    for (auto rune : iterRunes(str))
+        runes.pushBack(rune);
+    return runes;
+}
+
+test$("karm-text-rope-edits") {
+    Rope rope{_runes("hello world")};
+    expectEq$(rope.len(), 11uz);
+
+    rope.insert(5, _runes(","));
+    expectEq$(rope.collect(), _runes("hello, world"));
+
+    rope.remove({0, 7});
+    expectEq$(rope.collect(), _runes("world"));
+
+    rope.replace({0, 5}, _runes("rope"));
+    expectEq$(rope.collect(), _runes("rope"));
+    expectEq$(rope[2], (Rune)'p');
+
+    // Ranges are clamped to the end of the text
+    rope.remove({2, 10});
+    expectEq$(rope.collect(), _runes("ro"));
+    rope.remove({5, 1});
+    expectEq$(rope.collect(), _runes("ro"));
+
+    return Ok();
+}
+
+test$("karm-text-rope-lines") {
+    Rope rope{_runes("foo\nbar\n\nbaz")};
+
+    expectEq$(rope.lines(), 4uz);
+    expectEq$(rope.lineStart(0), 0uz);
+    expectEq$(rope.lineStart(1), 4uz);
+    expectEq$(rope.lineStart(2), 8uz);
+    expectEq$(rope.lineStart(3), 9uz);
+    expectEq$(rope.lineStart(4), 12uz);
+
+    expectEq$(rope.lineEnd(0), 3uz);
+    expectEq$(rope.lineEnd(2), 8uz);
+    expectEq$(rope.lineEnd(3), 12uz);
+
+    expectEq$(rope.lineOf(0), 0uz);
+    expectEq$(rope.lineOf(3), 0uz);
+    expectEq$(rope.lineOf(4), 1uz);
+    expectEq$(rope.lineOf(12), 3uz);
+
+    return Ok();
+}
+
+test$("karm-text-rope-snapshots") {
+    Rope rope{_runes("abc")};
+    Rope snapshot = rope;
+
+    rope.insert(3, _runes("def"));
+    expectEq$(rope.collect(), _runes("abcdef"));
+    expectEq$(snapshot.collect(), _runes("abc"));
+
+    return Ok();
+}
+
+test$("karm-text-rope-random-edits") {
+    // Compare against a flat buffer with edits large enough to span many
+    // leaves, the lines queries are checked along the way.
+    Math::Rand rand{0x5eed};
+    Vec<Rune> expected;
+    Rope rope;
+
+    for (usize i = 0; i < 500; i++) {
+        usize at = rand.nextInt(0, expected.len() + 1);
+        if (expected.len() and rand.nextInt(0, 3) == 0) {
+            usize len = rand.nextInt(0, min(expected.len() - at, 2000uz) + 1);
+            expected.removeRange(at, len);
+            rope.remove({at, len});
+        } else {
+            Vec<Rune> runes;
+            usize len = rand.nextInt(1, 1000);
+            for (usize j = 0; j < len; j++)
+                runes.pushBack(rand.nextInt(0, 16) == 0 ? '\n' : 'a' + rand.nextInt(0, 26));
+            expected.insertMany(at, runes);
+            rope.insert(at, runes);
+        }
+
+        expectEq$(rope.len(), expected.len());
+    }
+
+    expectEq$(rope.collect(), expected);
+
+    usize line = 0;
+    for (usize i = 0; i < expected.len(); i++) {
+        expectEq$(rope.lineOf(i), line);
+        if (expected[i] == '\n') {
+            line++;
+            expectEq$(rope.lineStart(line), i + 1);
+        }
+    }
+    expectEq$(rope.lines(), line + 1);
+
+    return Ok();
+}
+
+} // namespace Karm::Text::Tests
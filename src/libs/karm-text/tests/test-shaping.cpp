@@ -0,0 +1,164 @@
+#include <karm-test/macros.h>
+#include <karm-text/fallback.h>
+#include <karm-text/loader.h>
+#include <karm-text/run.h>
+#include <karm-text/shaping.h>
+
+namespace Karm::Text::Tests {
+
+static Vec<Rune> _runes(Str str) {
+    Vec<Rune> runes;
+    for (auto rune : iterRunes(str))
+        runes.pushBack(rune);
+    return runes;
+}
+
+static Res<Strong<Fontface>> _notoSans() {
+    return loadFontface("bundle://fonts-noto-sans/fonts/NotoSans-Regular.ttf"_url);
+}
+
+static bool _near(f64 lhs, f64 rhs) {
+    return Math::epsilonEq(lhs, rhs, 1e-6);
+}
+
+test$("karm-text-word-end") {
+    auto runes = _runes("foo  bar\nbaz");
+
+    expectEq$(wordEnd(runes, 0), 3uz);
+    expectEq$(wordEnd(runes, 3), 4uz);
+    expectEq$(wordEnd(runes, 4), 5uz);
+    expectEq$(wordEnd(runes, 5), 8uz);
+    expectEq$(wordEnd(runes, 8), 9uz);
+    expectEq$(wordEnd(runes, 9), 12uz);
+
+    return Ok();
+}
+
+test$("karm-text-shaping-cache-hits") {
+    ShapingCache cache;
+    auto font = Font::fallback();
+    auto runes = _runes("the cat and the dog");
+
+    cache.layout(font, runes, [](urange, Glyph, f64, f64, f64) {});
+
+    // the, cat, and, dog and a single space
+    expectEq$(cache.stats().misses, 5uz);
+    expectEq$(cache.stats().hits, 4uz);
+
+    cache.layout(font, runes, [](urange, Glyph, f64, f64, f64) {});
+    expectEq$(cache.stats().misses, 5uz);
+    expectEq$(cache.stats().hits, 13uz);
+
+    return Ok();
+}
+
+test$("karm-text-shaping-cache-budget") {
+    ShapingCache cache;
+    auto font = Font::fallback();
+
+    cache.layout(font, _runes("one two three four five"), [](urange, Glyph, f64, f64, f64) {});
+    expectEq$(cache.stats().entries, 6uz);
+
+    cache.budget(cache.stats().bytes / 2);
+    expectLteq$(cache.stats().bytes, cache.stats().budget);
+    expectGt$(cache.stats().evictions, 0uz);
+    expectLt$(cache.stats().entries, 6uz);
+
+    return Ok();
+}
+
+test$("karm-text-shaping-cache-features") {
+    ShapingCache cache;
+    auto font = Font::fallback();
+    auto runes = _runes("ab");
+
+    auto &word = cache.shape(font.fontface, FontFeatures::DEFAULT, runes);
+    expectEq$(word.glyphs.len(), 2uz);
+    expectEq$(word.glyphs[1].runes, (urange{1, 1}));
+    expectEq$(word.glyphs[1].ypos, 0.0);
+
+    // Each feature set is shaped and cached on its own
+    cache.shape(font.fontface, FontFeatures::NONE, runes);
+    cache.shape(font.fontface, FontFeatures::DEFAULT, runes);
+    expectEq$(cache.stats().misses, 2uz);
+    expectEq$(cache.stats().hits, 1uz);
+
+    return Ok();
+}
+
+test$("karm-text-shaping-cache-layout") {
+    auto font = Font::fallback();
+    auto run = Run::from(font, "hello world"s);
+    auto size = run.layout();
+
+    // The VGA font is monospaced, each glyph is one advance wide
+    auto adv = font.advance(font.glyph('a'));
+    expectEq$(run._cells.len(), 11uz);
+    expectEq$(size.x, adv * 11);
+    expectEq$(run._cells[6].xpos, adv * 6);
+
+    return Ok();
+}
+
+test$("karm-text-shaping-ttf-ligature") {
+    auto face = try$(_notoSans());
+
+    auto fi = face->shape(_runes("fi"), FontFeatures::DEFAULT);
+    expectEq$(fi.glyphs.len(), 1uz);
+    expectEq$(fi.glyphs[0].runes, (urange{0, 2}));
+    expect$(_near(fi.width, face->advance(fi.glyphs[0].glyph)));
+
+    // Ligatures can have more than two components
+    auto ffi = face->shape(_runes("ffi"), FontFeatures::DEFAULT);
+    expectEq$(ffi.glyphs.len(), 1uz);
+    expectEq$(ffi.glyphs[0].runes, (urange{0, 3}));
+    expectNe$(ffi.glyphs[0].glyph.index, fi.glyphs[0].glyph.index);
+
+    auto plain = face->shape(_runes("fi"), FontFeatures::NONE);
+    expectEq$(plain.glyphs.len(), 2uz);
+    expectEq$(plain.glyphs[0].glyph.index, face->glyph('f').index);
+    expectEq$(plain.glyphs[1].glyph.index, face->glyph('i').index);
+
+    return Ok();
+}
+
+test$("karm-text-shaping-ttf-mark") {
+    auto face = try$(_notoSans());
+
+    auto word = face->shape(_runes("x\u0301"), FontFeatures::DEFAULT);
+    expectEq$(word.glyphs.len(), 2uz);
+
+    auto &base = word.glyphs[0];
+    auto &mark = word.glyphs[1];
+    expectEq$(mark.runes, (urange{1, 1}));
+    expectEq$(mark.adv, 0.0);
+    expect$(_near(word.width, face->advance(face->glyph('x'))));
+
+    // The acute sits on the top anchor of the x, 535 units to its right
+    expect$(_near(mark.xpos, base.xpos + 0.535));
+    expect$(_near(mark.ypos, base.ypos));
+
+    return Ok();
+}
+
+test$("karm-text-shaping-fallback") {
+    auto noto = try$(_notoSans());
+    FontFallback fallback{{Fontface::fallback(), noto}};
+
+    // The VGA font has no combining acute, the whole cluster goes to Noto
+    auto word = fallback.shape(_runes("ab x\u0301"), FontFeatures::DEFAULT);
+    expectEq$(word.glyphs.len(), 5uz);
+    expectEq$(word.glyphs[0].glyph.font, 0);
+    expectEq$(word.glyphs[2].glyph.font, 0);
+    expectEq$(word.glyphs[3].glyph.font, 1);
+    expectEq$(word.glyphs[4].glyph.font, 1);
+    expectEq$(word.glyphs[4].runes, (urange{4, 1}));
+
+    // The mark is still placed against its base once appended
+    expect$(_near(word.glyphs[4].xpos, word.glyphs[3].xpos + 0.535));
+    expect$(_near(word.width, word.glyphs[3].xpos + noto->advance(noto->glyph('x'))));
+
+    return Ok();
+}
+
+} // namespace Karm::Text::Tests
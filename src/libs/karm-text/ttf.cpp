@@ -1,3 +1,5 @@
+#include <karm-base/hash.h>
+
 #include "ttf.h"
 
 namespace Karm::Text {
@@ -9,8 +11,89 @@ Res<Strong<TtfFontface>> TtfFontface::load(Sys::Mmap &&mmap) {
 
 TtfFontface::TtfFontface(Sys::Mmap &&mmap, Ttf::Parser parser)
     : _mmap(std::move(mmap)),
-      _parser(std::move(parser)) {
+      _parser(std::move(parser)),
+      _shaper(_parser) {
     _unitPerEm = _parser.unitPerEm();
+    _buildCmap();
+    _buildAdvances();
+    _buildKerns();
+}
+
+void TtfFontface::_buildCmap() {
+    _cmapPages.resize(CMAP_PAGE_COUNT);
+    _cmapEntries.resize(CMAP_PAGE_SIZE);
+
+    _parser._cmapTable.forEach([&](Rune rune, u16 glyph) {
+        if (rune > 0x10FFFF)
+            return;
+
+        auto &page = _cmapPages[rune >> CMAP_PAGE_SHIFT];
+        if (page == 0) {
+            page = _cmapEntries.len() / CMAP_PAGE_SIZE;
+            _cmapEntries.resize(_cmapEntries.len() + CMAP_PAGE_SIZE);
+        }
+
+        _cmapEntries[page * CMAP_PAGE_SIZE + (rune & (CMAP_PAGE_SIZE - 1))] = glyph;
+    });
+}
+
+void TtfFontface::_buildAdvances() {
+    auto numGlyphs = _parser.numGlyphs();
+    _advances.ensure(numGlyphs);
+    for (usize i = 0; i < numGlyphs; i++) {
+        auto hmtx = _parser._hmtx.metrics(i, _parser._hhea);
+        _advances.pushBack(hmtx.advanceWidth / _unitPerEm);
+    }
+}
+
+void TtfFontface::_buildKerns() {
+    if (not _parser._gpos.present())
+        return;
+
+    auto numGlyphs = _parser.numGlyphs();
+
+    _parser._gpos.forEachKernSubtable([&](Ttf::LookupSubtable const &subtable) {
+        if (auto *glyphPair = subtable.is<Ttf::GlyphPairAdjustment>()) {
+            glyphPair->forEach([&](usize prev, usize curr, Pair<Ttf::ValueRecord> adjustments) {
+                _kernPairs.pushBack({
+                    (u32)(prev << 16 | curr),
+                    adjustments.car.xAdvance / _unitPerEm,
+                });
+            });
+        } else if (auto *classPair = subtable.is<Ttf::ClassPairAdjustment>()) {
+            KernClasses classes;
+            classes.prevClasses.resize(numGlyphs, NO_CLASS);
+            classes.currClasses.resize(numGlyphs, NO_CLASS);
+            classes.currClassCount = classPair->class2Count();
+
+            usize prevClassCount = classPair->class1Count();
+            classPair->classDef1().forEach([&](usize glyph, usize glyphClass) {
+                if (glyph < numGlyphs and glyphClass < prevClassCount)
+                    classes.prevClasses[glyph] = glyphClass;
+            });
+
+            classPair->classDef2().forEach([&](usize glyph, usize glyphClass) {
+                if (glyph < numGlyphs and glyphClass < classes.currClassCount)
+                    classes.currClasses[glyph] = glyphClass;
+            });
+
+            classes.kerns.ensure(prevClassCount * classes.currClassCount);
+            for (usize i = 0; i < prevClassCount; i++) {
+                for (usize j = 0; j < classes.currClassCount; j++) {
+                    auto adjustments = classPair->adjustmentsForClasses(i, j);
+                    classes.kerns.pushBack(adjustments.car.xAdvance / _unitPerEm);
+                }
+            }
+
+            _kernClasses.pushBack(std::move(classes));
+        }
+    });
+
+    // Stable so the first subtable defining a pair wins, like when walking
+    // the lookups in order.
+    stableSort(_kernPairs, [](auto const &a, auto const &b) {
+        return a.glyphs <=> b.glyphs;
+    });
 }
 
 FontMetrics TtfFontface::metrics() const {
@@ -49,35 +132,87 @@ FontAttrs TtfFontface::attrs() const {
 }
 
 Glyph TtfFontface::glyph(Rune rune) {
-    auto glyph = _cachedEntries.tryGet(rune);
-    if (glyph.has())
-        return glyph.unwrap();
-    auto g = _parser.glyph(rune);
-    _cachedEntries.put(rune, g);
-    return g;
+    if (rune > 0x10FFFF)
+        return Glyph::TOFU;
+
+    auto page = _cmapPages[rune >> CMAP_PAGE_SHIFT];
+    return Glyph{_cmapEntries[page * CMAP_PAGE_SIZE + (rune & (CMAP_PAGE_SIZE - 1))], 0};
 }
 
 f64 TtfFontface::advance(Glyph glyph) {
-    auto advance = _cachedAdvances.tryGet(glyph);
-    if (advance.has())
-        return advance.unwrap();
-    auto a = _parser.glyphMetrics(glyph).advance / _unitPerEm;
-    _cachedAdvances.put(glyph, a);
-    return a;
+    if (glyph.index >= _advances.len())
+        return 0;
+    return _advances[glyph.index];
 }
 
 f64 TtfFontface::kern(Glyph prev, Glyph curr) {
-    auto kern = _cachedKerns.tryGet({prev, curr});
-    if (kern.has())
-        return kern.unwrap();
+    u32 glyphs = (u32)prev.index << 16 | curr.index;
+
+    // Lower bound on the sorted pairs
+    usize lo = 0, hi = _kernPairs.len();
+    while (lo < hi) {
+        usize mid = lo + (hi - lo) / 2;
+        if (_kernPairs[mid].glyphs < glyphs)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo < _kernPairs.len() and _kernPairs[lo].glyphs == glyphs)
+        return _kernPairs[lo].kern;
+
+    for (auto const &classes : _kernClasses) {
+        if (prev.index >= classes.prevClasses.len() or
+            curr.index >= classes.currClasses.len())
+            continue;
 
-    auto k = _parser.glyphKern(prev, curr) / _unitPerEm;
-    _cachedKerns.put({prev, curr}, k);
-    return k;
+        auto prevClass = classes.prevClasses[prev.index];
+        auto currClass = classes.currClasses[curr.index];
+        if (prevClass == NO_CLASS or currClass == NO_CLASS)
+            continue;
+
+        return classes.kerns[prevClass * classes.currClassCount + currClass];
+    }
+
+    return 0;
 }
 
 void TtfFontface::contour(Gfx::Canvas &g, Glyph glyph) const {
     g.scale(1.0 / _unitPerEm);
     _parser.glyphContour(g, glyph);
 }
+
+Coverage TtfFontface::coverage() const {
+    // The dense cmap is already in rune order, so this is a linear walk over
+    // the populated pages.
+    Coverage res;
+    for (usize p = 0; p < CMAP_PAGE_COUNT; p++) {
+        auto page = _cmapPages[p];
+        if (page == 0)
+            continue;
+
+        for (usize i = 0; i < CMAP_PAGE_SIZE; i++) {
+            if (_cmapEntries[page * CMAP_PAGE_SIZE + i])
+                res.add((Rune)((p << CMAP_PAGE_SHIFT) | i));
+        }
+    }
+    return res;
+}
+
+u64 TtfFontface::digest() const {
+    // The table directory holds a checksum of every table, no need to go
+    // over the whole file
+    auto s = _parser.begin();
+    s.nextU32be();
+    usize len = 12 + 16 * s.nextU16be();
+    auto bytes = _parser._slice;
+    return hash(sub(bytes, 0, min(len, bytes.len()))) ^ bytes.len();
+}
+
+ShapedWord TtfFontface::shape(Slice<Rune> runes, FontFeatures features) {
+    if (not _shaper.present())
+        return Fontface::shape(runes, features);
+    return _shaper.shape(*this, runes, features);
+}
+
 } // namespace Karm::Text
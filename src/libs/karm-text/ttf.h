@@ -1,21 +1,51 @@
 #pragma once
 
-#include <karm-base/map.h>
+#include <karm-base/vec.h>
 #include <karm-sys/mmap.h>
 
 #include "font.h"
+#include "shaper.h"
 #include "ttf/parser.h"
 
 namespace Karm::Text {
 
 struct TtfFontface : public Fontface {
+    static constexpr usize CMAP_PAGE_SHIFT = 8;
+    static constexpr usize CMAP_PAGE_SIZE = 1 << CMAP_PAGE_SHIFT;
+    static constexpr usize CMAP_PAGE_COUNT = (0x10FFFF >> CMAP_PAGE_SHIFT) + 1;
+    static constexpr u16 NO_CLASS = 0xFFFF;
+
+    struct KernPair {
+        u32 glyphs; //< prev << 16 | curr
+        f64 kern;
+    };
+
+    struct KernClasses {
+        Vec<u16> prevClasses;
+        Vec<u16> currClasses;
+        usize currClassCount;
+        Vec<f64> kerns;
+    };
+
     Sys::Mmap _mmap;
     Ttf::Parser _parser;
-    Map<Rune, Glyph> _cachedEntries;
-    Map<Glyph, f64> _cachedAdvances;
-    Map<Cons<Glyph>, f64> _cachedKerns;
     f64 _unitPerEm = 0;
 
+    // Lookup tables built once at load time so that glyph(), advance() and
+    // kern() never have to walk the font tables.
+    Vec<u16> _cmapPages;   //< rune >> CMAP_PAGE_SHIFT -> page, page 0 is empty
+    Vec<u16> _cmapEntries; //< page * CMAP_PAGE_SIZE + (rune & 0xff) -> glyph
+    Vec<f64> _advances;
+    Vec<KernPair> _kernPairs; //< sorted by glyphs
+    Vec<KernClasses> _kernClasses;
+    TtfShaper _shaper;
+
+    void _buildCmap();
+
+    void _buildAdvances();
+
+    void _buildKerns();
+
     static Res<Strong<TtfFontface>> load(Sys::Mmap &&mmap);
 
     TtfFontface(Sys::Mmap &&mmap, Ttf::Parser parser);
@@ -31,6 +61,12 @@ struct TtfFontface : public Fontface {
     f64 kern(Glyph prev, Glyph curr) override;
 
     void contour(Gfx::Canvas &g, Glyph glyph) const override;
+
+    Coverage coverage() const override;
+
+    ShapedWord shape(Slice<Rune> runes, FontFeatures features) override;
+
+    u64 digest() const override;
 };
 
 } // namespace Karm::Text
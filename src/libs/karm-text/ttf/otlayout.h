@@ -2,6 +2,7 @@
 
 #include <karm-base/cons.h>
 #include <karm-base/opt.h>
+#include <karm-base/vec.h>
 #include <karm-io/bscan.h>
 #include <karm-logger/logger.h>
 
@@ -159,6 +160,27 @@ struct CoverageTable : public Io::BChunk {
 
         return NONE;
     }
+
+    // Call `cb(glyphId, coverageIndex)` for every covered glyph
+    void forEach(auto cb) const {
+        auto s = begin().skip(4);
+
+        if (format() == 1) {
+            for (auto i : range(len()))
+                cb((usize)s.nextU16be(), i);
+        }
+
+        if (format() == 2) {
+            for (auto i : range(len())) {
+                (void)i;
+                usize start = s.nextU16be();
+                usize end = s.nextU16be();
+                usize index = s.nextU16be();
+                for (usize glyph = start; glyph <= end; glyph++)
+                    cb(glyph, index + glyph - start);
+            }
+        }
+    }
 };
 
 struct LookupSubtableBase : public Io::BChunk {
@@ -265,6 +287,36 @@ struct GlyphPairAdjustment : public LookupSubtableBase {
 
         return NONE;
     }
+
+    // Call `cb(prev, curr, adjustments)` for every pair of the subtable
+    void forEach(auto cb) const {
+        auto s = begin();
+
+        // Read the table header
+        /* format = */ s.nextU16be();
+        auto coverageOffset = s.nextU16be();
+        auto valueFormat1 = s.nextU16be();
+        auto valueFormat2 = s.nextU16be();
+        auto pairSetCount = s.nextU16be();
+
+        CoverageTable coverage{begin().skip(coverageOffset).remBytes()};
+        coverage.forEach([&](usize prev, usize coverageIndex) {
+            if (coverageIndex >= pairSetCount)
+                return;
+
+            auto pairSetOffset = begin().skip(10 + coverageIndex * 2).nextU16be();
+            auto pairSetTable = begin().skip(pairSetOffset);
+            auto pairValueCount = pairSetTable.nextU16be();
+
+            for (usize i : range(pairValueCount)) {
+                (void)i;
+                usize curr = pairSetTable.nextU16be();
+                ValueRecord value1 = ValueRecord::read(pairSetTable, valueFormat1);
+                ValueRecord value2 = ValueRecord::read(pairSetTable, valueFormat2);
+                cb(prev, curr, Pair<ValueRecord>{value1, value2});
+            }
+        });
+    }
 };
 
 // https://learn.microsoft.com/en-us/typography/opentype/spec/chapter2#class-definition-table
@@ -296,12 +348,71 @@ struct ClassDef : public Io::BChunk {
 
         return NONE;
     }
+
+    // Call `cb(glyphId, glyphClass)` for every glyph with an explicit class
+    void forEach(auto cb) const {
+        auto s = begin();
+        auto format = s.nextU16be();
+
+        if (format == 1) {
+            usize startGlyph = s.nextU16be();
+            auto glyphCount = s.nextU16be();
+            for (usize i : range(glyphCount))
+                cb(startGlyph + i, (usize)s.nextU16be());
+        }
+
+        if (format == 2) {
+            auto classRangeCount = s.nextU16be();
+            for (usize i : range(classRangeCount)) {
+                (void)i;
+                usize startGlyph = s.nextU16be();
+                usize endGlyph = s.nextU16be();
+                usize glyphClass = s.nextU16be();
+                for (usize glyph = startGlyph; glyph <= endGlyph; glyph++)
+                    cb(glyph, glyphClass);
+            }
+        }
+    }
 };
 
 // https://learn.microsoft.com/en-us/typography/opentype/spec/gpos#pair-adjustment-positioning-format-2-class-pair-adjustment
 struct ClassPairAdjustment : public LookupSubtableBase {
     static constexpr int FORMAT = 2;
 
+    using ValueFormat1 = Io::BField<u16be, 4>;
+    using ValueFormat2 = Io::BField<u16be, 6>;
+    using ClassDef1Offset = Io::BField<u16be, 8>;
+    using ClassDef2Offset = Io::BField<u16be, 10>;
+    using Class1Count = Io::BField<u16be, 12>;
+    using Class2Count = Io::BField<u16be, 14>;
+
+    usize class1Count() const { return get<Class1Count>(); }
+
+    usize class2Count() const { return get<Class2Count>(); }
+
+    ClassDef classDef1() const {
+        return ClassDef{begin().skip(get<ClassDef1Offset>()).remBytes()};
+    }
+
+    ClassDef classDef2() const {
+        return ClassDef{begin().skip(get<ClassDef2Offset>()).remBytes()};
+    }
+
+    Pair<ValueRecord> adjustmentsForClasses(usize prevClass, usize currClass) const {
+        u16 valueFormat1 = get<ValueFormat1>();
+        u16 valueFormat2 = get<ValueFormat2>();
+
+        auto class2Size = ValueRecord::len(valueFormat1) + ValueRecord::len(valueFormat2);
+        auto class1Size = class2Count() * class2Size;
+
+        auto s = begin().skip(16 + (prevClass * class1Size) + (currClass * class2Size));
+
+        ValueRecord value1 = ValueRecord::read(s, valueFormat1);
+        ValueRecord value2 = ValueRecord::read(s, valueFormat2);
+
+        return Pair<ValueRecord>{value1, value2};
+    }
+
     Opt<Pair<ValueRecord>> adjustments(usize prev, usize curr) {
         auto s = begin();
 
@@ -335,6 +446,135 @@ struct ClassPairAdjustment : public LookupSubtableBase {
     }
 };
 
+// https://learn.microsoft.com/en-us/typography/opentype/spec/gsub#lookuptype-7-extension-substitution
+// Same layout for GPOS lookup type 9, the subtable is resolved to the
+// extension lookup type before being interpreted.
+struct ExtensionSubtable : public LookupSubtableBase {
+    using ExtensionLookupType = Io::BField<u16be, 2>;
+    using ExtensionOffset = Io::BField<u32be, 4>;
+
+    u16 extensionLookupType() const { return get<ExtensionLookupType>(); }
+
+    Bytes extension() const {
+        return begin().skip(get<ExtensionOffset>()).remBytes();
+    }
+};
+
+// https://learn.microsoft.com/en-us/typography/opentype/spec/chapter2#sequence-lookup-record
+struct SequenceLookup {
+    u16 sequenceIndex;
+    u16 lookupIndex;
+};
+
+struct ChainedSequenceRule {
+    Vec<u16> backtrack; //< Closest glyph first
+    Vec<u16> input;     //< Without the first glyph
+    Vec<u16> lookahead;
+    Vec<SequenceLookup> lookups;
+};
+
+// https://learn.microsoft.com/en-us/typography/opentype/spec/chapter2#chained-sequence-context-format-1-simple-glyph-contexts
+// Shared by GSUB lookup type 6 and GPOS lookup type 8. Format 1 rules are
+// sequences of glyphs and format 2 rules are sequences of classes, both
+// use the same rule layout. Format 3 has a single rule made of coverages.
+struct ChainedContext : public LookupSubtableBase {
+    using CoverageOffset = Io::BField<u16be, 2>;
+    using BacktrackClassDefOffset = Io::BField<u16be, 4>;
+    using InputClassDefOffset = Io::BField<u16be, 6>;
+    using LookaheadClassDefOffset = Io::BField<u16be, 8>;
+
+    CoverageTable coverage() const {
+        return CoverageTable{begin().skip(get<CoverageOffset>()).remBytes()};
+    }
+
+    ClassDef backtrackClassDef() const {
+        return ClassDef{begin().skip(get<BacktrackClassDefOffset>()).remBytes()};
+    }
+
+    ClassDef inputClassDef() const {
+        return ClassDef{begin().skip(get<InputClassDefOffset>()).remBytes()};
+    }
+
+    ClassDef lookaheadClassDef() const {
+        return ClassDef{begin().skip(get<LookaheadClassDefOffset>()).remBytes()};
+    }
+
+    static Vec<u16> _readGlyphs(Io::BScan &s, usize count) {
+        Vec<u16> res;
+        res.ensure(count);
+        for (usize i = 0; i < count; i++)
+            res.pushBack(s.nextU16be());
+        return res;
+    }
+
+    static Vec<SequenceLookup> _readLookups(Io::BScan &s) {
+        usize count = s.nextU16be();
+        Vec<SequenceLookup> res;
+        res.ensure(count);
+        for (usize i = 0; i < count; i++) {
+            auto sequenceIndex = s.nextU16be();
+            auto lookupIndex = s.nextU16be();
+            res.pushBack({sequenceIndex, lookupIndex});
+        }
+        return res;
+    }
+
+    // Call `cb(setIndex, rule)` for every rule of a format 1 or 2 subtable,
+    // the set index is the coverage index of the first glyph for format 1
+    // and its input class for format 2.
+    void forEachRule(auto cb) const {
+        auto s = begin().skip(format() == 1 ? 4 : 10);
+        usize setCount = s.nextU16be();
+
+        for (usize set = 0; set < setCount; set++) {
+            auto setOffset = s.nextU16be();
+            if (not setOffset)
+                continue;
+
+            auto ruleSet = begin().skip(setOffset);
+            usize ruleCount = ruleSet.nextU16be();
+            for (usize i = 0; i < ruleCount; i++) {
+                auto r = begin().skip(setOffset).skip(ruleSet.nextU16be());
+
+                ChainedSequenceRule rule;
+                rule.backtrack = _readGlyphs(r, r.nextU16be());
+                usize inputCount = r.nextU16be();
+                rule.input = _readGlyphs(r, inputCount ? inputCount - 1 : 0);
+                rule.lookahead = _readGlyphs(r, r.nextU16be());
+                rule.lookups = _readLookups(r);
+                cb(set, std::move(rule));
+            }
+        }
+    }
+
+    struct Coverages {
+        Vec<CoverageTable> backtrack; //< Closest glyph first
+        Vec<CoverageTable> input;     //< Including the first glyph
+        Vec<CoverageTable> lookahead;
+        Vec<SequenceLookup> lookups;
+    };
+
+    // The single rule of a format 3 subtable.
+    Coverages coverages() const {
+        auto s = begin().skip(2);
+        auto readCoverages = [&] {
+            usize count = s.nextU16be();
+            Vec<CoverageTable> res;
+            res.ensure(count);
+            for (usize i = 0; i < count; i++)
+                res.pushBack(CoverageTable{begin().skip(s.nextU16be()).remBytes()});
+            return res;
+        };
+
+        Coverages res;
+        res.backtrack = readCoverages();
+        res.input = readCoverages();
+        res.lookahead = readCoverages();
+        res.lookups = _readLookups(s);
+        return res;
+    }
+};
+
 using LookupSubtable = Union<
     GlyphPairAdjustment,
     ClassPairAdjustment>;
@@ -364,6 +604,11 @@ struct LookupTable : public Io::BChunk {
                    : 0;
     }
 
+    Bytes subtableBytes(usize i) const {
+        auto off = begin().skip(6 + i * 2).nextU16be();
+        return begin().skip(off).remBytes();
+    }
+
     LookupSubtable at(usize i) const {
         auto off = begin().skip(6 + i * 2).nextU16be();
         auto subtable = begin().skip(off);
@@ -3,6 +3,7 @@
 #include <karm-logger/logger.h>
 
 #include "table-cmap.h"
+#include "table-gdef.h"
 #include "table-glyf.h"
 #include "table-gpos.h"
 #include "table-gsub.h"
@@ -51,6 +52,8 @@ struct Parser {
     Loca _loca;
     Hhea _hhea;
     Hmtx _hmtx;
+    Maxp _maxp;
+    Gdef _gdef;
     Gpos _gpos;
     Gsub _gsub;
     Name _name;
@@ -117,6 +120,8 @@ struct Parser {
         font._loca = try$(font.requireTable<Loca>());
         font._hhea = try$(font.requireTable<Hhea>());
         font._hmtx = try$(font.requireTable<Hmtx>());
+        font._maxp = try$(font.requireTable<Maxp>());
+        font._gdef = font.lookupTable<Gdef>();
         font._gpos = font.lookupTable<Gpos>();
         font._gsub = font.lookupTable<Gsub>();
         font._name = font.lookupTable<Name>();
@@ -248,6 +253,10 @@ struct Parser {
         };
     }
 
+    usize numGlyphs() const {
+        return _maxp.numGlyphs();
+    }
+
     f64 unitPerEm() const {
         return _head.unitPerEm();
     }
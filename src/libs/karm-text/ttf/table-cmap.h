@@ -47,7 +47,10 @@ struct Cmap : public Io::BChunk {
                 }
 
                 auto offset = idRangeOffset + (r - startCode) * 2;
-                return Text::Glyph(s.skip(offset).nextU16be());
+                u16 glyph = s.skip(offset).nextU16be();
+                if (glyph == 0)
+                    return Text::Glyph(0);
+                return Text::Glyph((glyph + idDelta) & 0xFFFF);
             }
 
             logWarn("ttf: glyph not found for rune {x}", r);
@@ -78,6 +81,62 @@ struct Cmap : public Io::BChunk {
             return Text::Glyph(0);
         }
 
+        void _forEachType4(auto cb) const {
+            u16 segCountX2 = begin().skip(6).nextU16be();
+            u16 segCount = segCountX2 / 2;
+
+            for (usize i = 0; i < segCount; i++) {
+                u16 endCode = begin().skip(14 + i * 2).peekU16be();
+                // + 2 for reserved padding
+                u16 startCode = begin().skip(14 + segCountX2 + 2 + i * 2).peekU16be();
+                u16 idDelta = begin().skip(14 + segCountX2 * 2 + 2 + i * 2).peekI16be();
+                auto rangeScan = begin().skip(14 + segCountX2 * 3 + 2 + i * 2);
+                u16 idRangeOffset = rangeScan.peekU16be();
+
+                // The last segment only maps 0xFFFF to the missing glyph
+                if (startCode == 0xFFFF)
+                    continue;
+
+                for (u32 r = startCode; r <= endCode; r++) {
+                    u16 glyph = 0;
+                    if (idRangeOffset == 0) {
+                        glyph = (r + idDelta) & 0xFFFF;
+                    } else {
+                        auto s = rangeScan;
+                        glyph = s.skip(idRangeOffset + (r - startCode) * 2).peekU16be();
+                        if (glyph != 0)
+                            glyph = (glyph + idDelta) & 0xFFFF;
+                    }
+
+                    if (glyph != 0)
+                        cb((Rune)r, glyph);
+                }
+            }
+        }
+
+        void _forEachType12(auto cb) const {
+            auto s = begin().skip(12);
+            u32 nGroups = s.nextU32be();
+
+            for (u32 i = 0; i < nGroups; i++) {
+                u32 startCode = s.nextU32be();
+                u32 endCode = min(s.nextU32be(), 0x10FFFFu);
+                u32 glyphOffset = s.nextU32be();
+
+                for (u32 r = startCode; r <= endCode; r++)
+                    cb((Rune)r, (u16)(glyphOffset + (r - startCode)));
+            }
+        }
+
+        // Call `cb(rune, glyphIndex)` for every rune mapped by the table
+        void forEach(auto cb) const {
+            if (type == 4) {
+                _forEachType4(cb);
+            } else if (type == 12) {
+                _forEachType12(cb);
+            }
+        }
+
         Text::Glyph glyphIdFor(Rune r) const {
             if (type == 4) {
                 return _glyphIdForType4(r);
@@ -0,0 +1,36 @@
+#pragma once
+
+// https://learn.microsoft.com/en-us/typography/opentype/spec/gdef
+
+#include "otlayout.h"
+
+namespace Ttf {
+
+enum struct GlyphClass : u16 {
+    NONE = 0,
+    BASE = 1,
+    LIGATURE = 2,
+    MARK = 3,
+    COMPONENT = 4,
+};
+
+struct Gdef : public Io::BChunk {
+    static constexpr Str SIG = "GDEF";
+
+    using GlyphClassDefOffset = Io::BField<u16be, 4>;
+    using MarkAttachClassDefOffset = Io::BField<u16be, 10>;
+
+    Opt<ClassDef> glyphClassDef() const {
+        if (not present() or not get<GlyphClassDefOffset>())
+            return NONE;
+        return ClassDef{begin().skip(get<GlyphClassDefOffset>()).remBytes()};
+    }
+
+    Opt<ClassDef> markAttachClassDef() const {
+        if (not present() or not get<MarkAttachClassDefOffset>())
+            return NONE;
+        return ClassDef{begin().skip(get<MarkAttachClassDefOffset>()).remBytes()};
+    }
+};
+
+} // namespace Ttf
@@ -21,6 +21,74 @@ enum struct GposLookupType : u16 {
     EXTENSION_POSITIONING = 9,
 };
 
+// https://learn.microsoft.com/en-us/typography/opentype/spec/gpos#anchor-tables
+// The three formats start with the same coordinates, contour points and
+// device tables are ignored.
+struct Anchor : public Io::BChunk {
+    using XCoordinate = Io::BField<i16be, 2>;
+    using YCoordinate = Io::BField<i16be, 4>;
+
+    i16 x() const { return get<XCoordinate>(); }
+
+    i16 y() const { return get<YCoordinate>(); }
+};
+
+// https://learn.microsoft.com/en-us/typography/opentype/spec/gpos#mark-array-table
+struct MarkArray : public Io::BChunk {
+    using MarkCount = Io::BField<u16be, 0>;
+
+    usize len() const { return get<MarkCount>(); }
+
+    u16 markClass(usize i) const {
+        return begin().skip(2 + i * 4).nextU16be();
+    }
+
+    Anchor anchor(usize i) const {
+        auto off = begin().skip(2 + i * 4 + 2).nextU16be();
+        return Anchor{begin().skip(off).remBytes()};
+    }
+};
+
+// https://learn.microsoft.com/en-us/typography/opentype/spec/gpos#lookup-type-4-mark-to-base-attachment-positioning-subtable
+// Mark to mark attachment (lookup type 6) has the same layout, with the
+// preceding mark in place of the base.
+struct MarkAttachment : public LookupSubtableBase {
+    using MarkCoverageOffset = Io::BField<u16be, 2>;
+    using BaseCoverageOffset = Io::BField<u16be, 4>;
+    using MarkClassCount = Io::BField<u16be, 6>;
+    using MarkArrayOffset = Io::BField<u16be, 8>;
+    using BaseArrayOffset = Io::BField<u16be, 10>;
+
+    CoverageTable markCoverage() const {
+        return CoverageTable{begin().skip(get<MarkCoverageOffset>()).remBytes()};
+    }
+
+    CoverageTable baseCoverage() const {
+        return CoverageTable{begin().skip(get<BaseCoverageOffset>()).remBytes()};
+    }
+
+    usize markClassCount() const { return get<MarkClassCount>(); }
+
+    MarkArray markArray() const {
+        return MarkArray{begin().skip(get<MarkArrayOffset>()).remBytes()};
+    }
+
+    Opt<Anchor> baseAnchor(usize baseIndex, usize markClass) const {
+        auto baseArray = begin().skip(get<BaseArrayOffset>());
+        if (baseIndex >= baseArray.peekU16be() or markClass >= markClassCount())
+            return NONE;
+
+        auto off = begin()
+                       .skip(get<BaseArrayOffset>())
+                       .skip(2 + (baseIndex * markClassCount() + markClass) * 2)
+                       .nextU16be();
+        if (not off)
+            return NONE;
+
+        return Anchor{baseArray.skip(off).remBytes()};
+    }
+};
+
 struct Gpos : public Io::BChunk {
     static constexpr Str SIG = "GPOS";
 
@@ -40,32 +108,55 @@ struct Gpos : public Io::BChunk {
         return LookupList{begin().skip(get<LookupListOffset>()).remBytes()};
     }
 
-    Res<Pair<ValueRecord>> adjustments(usize prev, usize curr) const {
+    Opt<FeatureTable> kernFeature() const {
         // 1. Locate the current script in the GPOS ScriptList table.
 
         // FIXME: We assume that the script is always "latn".
-        auto scriptTable = try$(scriptList().lookup("latn"));
+        auto scriptTable = scriptList().lookup("latn");
+        if (not scriptTable)
+            return NONE;
 
         // 2. If the language system is known, search the script for the correct
         //    LangSys table; otherwise, use the script’s default LangSys table.
 
         // FIXME: We assume that the language system is always "dflt".
-        auto langSys = scriptTable.defaultLangSys();
+        auto langSys = scriptTable.unwrap().defaultLangSys();
 
         // 3. The LangSys table provides index numbers into the GPOS FeatureList
         //    table to access a required feature and a number of additional features.
-        Opt<FeatureTable> kernFeatureTable;
         for (auto featureIndex : langSys.iterFeatures()) {
             auto featureTable = featureList().at(featureIndex);
 
             // 4. Inspect the featureTag of each feature, and select the feature
             //    tables to apply to an input glyph string.
-            if (featureTable.tag == "kern") {
-                kernFeatureTable = featureTable;
-                break;
-            }
+            if (featureTable.tag == "kern")
+                return featureTable;
+        }
+
+        return NONE;
+    }
+
+    // Call `cb(subtable)` for every pair adjustment subtable of the kern
+    // feature, in the order they should be applied.
+    void forEachKernSubtable(auto cb) const {
+        auto kernFeatureTable = kernFeature();
+        if (not kernFeatureTable)
+            return;
+
+        for (auto lookupIndex : kernFeatureTable->iterLookups()) {
+            auto lookupTable = lookupList().at(lookupIndex);
+
+            // FIXME: We only support pair adjustment lookups.
+            if (lookupTable.lookupType() != (u16)GposLookupType::PAIR_ADJUSTMENT)
+                continue;
+
+            for (auto lookupSubtable : lookupTable.iter())
+                cb(lookupSubtable);
         }
+    }
 
+    Res<Pair<ValueRecord>> adjustments(usize prev, usize curr) const {
+        auto kernFeatureTable = kernFeature();
         if (not kernFeatureTable)
             return Ok(Pair<ValueRecord>{});
 
@@ -1,9 +1,80 @@
 #pragma once
 
+// https://learn.microsoft.com/en-us/typography/opentype/spec/gsub
+
 #include "otlayout.h"
 
 namespace Ttf {
 
+enum struct GsubLookupType : u16 {
+    SINGLE = 1,
+    MULTIPLE = 2,
+    ALTERNATE = 3,
+    LIGATURE = 4,
+    CONTEXT = 5,
+    CHAINED_CONTEXT = 6,
+    EXTENSION = 7,
+    REVERSE_CHAINED_CONTEXT = 8,
+};
+
+// https://learn.microsoft.com/en-us/typography/opentype/spec/gsub#lookuptype-1-single-substitution-subtable
+struct SingleSubstitution : public LookupSubtableBase {
+    using CoverageOffset = Io::BField<u16be, 2>;
+    using DeltaGlyphId = Io::BField<i16be, 4>;
+    using GlyphCount = Io::BField<u16be, 4>;
+
+    CoverageTable coverage() const {
+        return CoverageTable{begin().skip(get<CoverageOffset>()).remBytes()};
+    }
+
+    u16 substitute(u16 glyph, usize coverageIndex) const {
+        if (format() == 1)
+            return (u16)(glyph + get<DeltaGlyphId>());
+
+        if (coverageIndex >= get<GlyphCount>())
+            return glyph;
+        return begin().skip(6 + coverageIndex * 2).nextU16be();
+    }
+};
+
+// https://learn.microsoft.com/en-us/typography/opentype/spec/gsub#ligature-table
+struct Ligature : public Io::BChunk {
+    using LigatureGlyph = Io::BField<u16be, 0>;
+    using ComponentCount = Io::BField<u16be, 2>;
+
+    u16 ligatureGlyph() const { return get<LigatureGlyph>(); }
+
+    // Including the first component, which isn't stored
+    usize componentCount() const { return get<ComponentCount>(); }
+
+    u16 component(usize i) const {
+        return begin().skip(4 + (i - 1) * 2).nextU16be();
+    }
+};
+
+// https://learn.microsoft.com/en-us/typography/opentype/spec/gsub#lookuptype-4-ligature-substitution-subtable
+struct LigatureSubstitution : public LookupSubtableBase {
+    using CoverageOffset = Io::BField<u16be, 2>;
+    using LigatureSetCount = Io::BField<u16be, 4>;
+
+    CoverageTable coverage() const {
+        return CoverageTable{begin().skip(get<CoverageOffset>()).remBytes()};
+    }
+
+    // Call `cb(ligature)` for the ligatures starting with the glyph at
+    // `coverageIndex` in order of preference.
+    void forEachLigature(usize coverageIndex, auto cb) const {
+        if (coverageIndex >= get<LigatureSetCount>())
+            return;
+
+        auto setOffset = begin().skip(6 + coverageIndex * 2).nextU16be();
+        auto set = begin().skip(setOffset);
+        usize count = set.nextU16be();
+        for (usize i = 0; i < count; i++)
+            cb(Ligature{begin().skip(setOffset).skip(set.nextU16be()).remBytes()});
+    }
+};
+
 struct Gsub : public Io::BChunk {
     static constexpr Str SIG = "GSUB";
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <karm-base/array.h>
+#include <karm-base/hash.h>
 #include <karm-gfx/canvas.h>
 
 #include "font.h"
@@ -58,6 +59,20 @@ struct VgaFontface : public Fontface {
             }
         }
     }
+
+    u64 digest() const override {
+        return hash(bytes(DATA));
+    }
+
+    Coverage coverage() const override {
+        // Code point 0 is the tofu, every other code point of the code page
+        // has a glyph.
+        Coverage res;
+        Ibm437Mapper mapper;
+        for (usize i = 1; i < 256; i++)
+            res.add((Rune)mapper(i));
+        return res;
+    }
 };
 
 } // namespace Karm::Text
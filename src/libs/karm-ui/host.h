@@ -3,6 +3,7 @@
 #include <karm-app/host.h>
 #include <karm-base/ring.h>
 #include <karm-gfx/context.h>
+#include <karm-math/region.h>
 #include <karm-text/loader.h>
 
 #include "node.h"
@@ -14,7 +15,7 @@ struct Host : public Node {
     Child _root;
     Opt<Res<>> _res;
     Gfx::Context _g;
-    Vec<Math::Recti> _dirty;
+    Math::Region _dirty;
     PerfGraph _perf;
 
     bool _shouldLayout{};
@@ -71,12 +72,16 @@ struct Host : public Node {
 
     void paint() {
         if (debugShowPerfGraph)
-            _dirty.pushBack({0, 0, 256, 100});
+            _dirty.add({0, 0, 256, 100});
+
+        // Overlapping invalidations are merged by the region, simplifying
+        // it trades a little overdraw for fewer paint passes.
+        auto damage = _dirty.simplify();
 
         _g.begin(mutPixels());
 
         _perf.record(PerfEvent::PAINT);
-        for (auto &d : _dirty) {
+        for (auto &d : damage) {
             paint(_g, d);
         }
         auto elapsed = _perf.end();
@@ -89,7 +94,7 @@ struct Host : public Node {
 
         _g.end();
 
-        flip(_dirty);
+        flip(damage);
         _dirty.clear();
     }
 
@@ -117,7 +122,7 @@ struct Host : public Node {
 
     void bubble(App::Event &event) override {
         if (auto *e = event.is<Node::PaintEvent>()) {
-            _dirty.pushBack(e->bound);
+            _dirty.add(e->bound);
             event.accept();
         } else if (auto *e = event.is<Node::LayoutEvent>()) {
             _shouldLayout = true;
@@ -139,6 +144,9 @@ struct Host : public Node {
     Res<> run() {
         _shouldLayout = true;
 
+        // Apps keep their rasterized glyphs from one run to the next
+        Gfx::globalGlyphCache().persist(true);
+
         auto lastFrame = Sys::now();
         auto nextFrame = lastFrame;
         bool nextFrameScheduled = false;
@@ -168,10 +176,10 @@ struct Host : public Node {
                 layout(bound());
                 _shouldLayout = false;
                 _shouldAnimate = true;
-                _dirty.pushBack(bound());
+                _dirty.add(bound());
             }
 
-            if (_dirty.len() > 0) {
+            if (not _dirty.empty()) {
                 paint();
                 _dirty.clear();
             }
@@ -180,6 +188,10 @@ struct Host : public Node {
             nextFrameScheduled = false;
         }
 
+        // Keep the glyphs rasterized during this session for the next one
+        if (auto res = Gfx::globalGlyphCache().flush(); not res)
+            logWarn("failed to save glyph cache: {}", res.none());
+
         return _res.unwrap();
     }
 };
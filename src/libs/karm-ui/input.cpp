@@ -272,25 +272,37 @@ struct Input : public View<Input> {
     OnChange<Text::Action> _onChange;
 
     Opt<Text::Prose> _text;
+    usize _synced = 0; //< Generation of the model the prose is at
 
     Input(Text::ProseStyle style, Strong<Text::Model> model, OnChange<Text::Action> onChange)
         : _style(style), _model(model), _onChange(std::move(onChange)) {}
 
     void reconcile(Input &o) override {
+        // NOTE: The prose follows the edits of the model incrementally,
+        //       it only needs to be rebuilt when the model or the style
+        //       is replaced.
+        if (&o._model.unwrap() != &_model.unwrap() or o._style != _style)
+            _text = NONE;
+
         _style = o._style;
         _model = o._model;
         _onChange = std::move(o._onChange);
-
-        // NOTE: The model might have changed,
-        //       so we need to invalidate the presentation.
-        _text = NONE;
     }
 
     Text::Prose &_ensureText() {
-        if (not _text) {
+        Opt<Slice<Text::Model::Change>> changes = NONE;
+        if (_text)
+            changes = _model->changesSince(_synced);
+
+        if (changes) {
+            for (auto const &change : *changes)
+                _text->replace({change.pos, change.removed}, change.inserted);
+        } else {
             _text = Text::Prose(_style);
             _text->append(_model->runes());
         }
+        _synced = _model->generation();
+
         return *_text;
     }
 
@@ -1,3 +1,6 @@
+#include <karm-text/fallback.h>
+#include <karm-text/loader.h>
+
 #include "view.h"
 
 #include "box.h"
@@ -6,11 +9,17 @@ namespace Karm::Ui {
 
 // MARK: Text ------------------------------------------------------------------
 
+// Runes missing from the bundled faces are drawn with the installed fonts
+static Strong<Text::Fontface> _loadFontface(Mime::Url url) {
+    auto primary = Text::loadFontfaceOrFallback(url).unwrap();
+    return Text::FontFallback::make(Text::installedFonts(), primary);
+}
+
 static Opt<Strong<Text::Fontface>> _regularFontface = NONE;
 
 Strong<Text::Fontface> regularFontface() {
     if (not _regularFontface) {
-        _regularFontface = Text::loadFontfaceOrFallback("bundle://fonts-inter/fonts/Inter-Regular.ttf"_url).unwrap();
+        _regularFontface = _loadFontface("bundle://fonts-inter/fonts/Inter-Regular.ttf"_url);
     }
     return *_regularFontface;
 }
@@ -19,7 +28,7 @@ static Opt<Strong<Text::Fontface>> _mediumFontface = NONE;
 
 Strong<Text::Fontface> mediumFontface() {
     if (not _mediumFontface) {
-        _mediumFontface = Text::loadFontfaceOrFallback("bundle://fonts-inter/fonts/Inter-Medium.ttf"_url).unwrap();
+        _mediumFontface = _loadFontface("bundle://fonts-inter/fonts/Inter-Medium.ttf"_url);
     }
     return *_mediumFontface;
 }
@@ -28,7 +37,7 @@ static Opt<Strong<Text::Fontface>> _boldFontface = NONE;
 
 Strong<Text::Fontface> boldFontface() {
     if (not _boldFontface) {
-        _boldFontface = Text::loadFontfaceOrFallback("bundle://fonts-inter/fonts/Inter-Bold.ttf"_url).unwrap();
+        _boldFontface = _loadFontface("bundle://fonts-inter/fonts/Inter-Bold.ttf"_url);
     }
     return *_boldFontface;
 }
@@ -37,7 +46,7 @@ static Opt<Strong<Text::Fontface>> _italicFontface = NONE;
 
 Strong<Text::Fontface> italicFontface() {
     if (not _italicFontface) {
-        _italicFontface = Text::loadFontfaceOrFallback("bundle://fonts-inter/fonts/Inter-Italic.ttf"_url).unwrap();
+        _italicFontface = _loadFontface("bundle://fonts-inter/fonts/Inter-Italic.ttf"_url);
     }
     return *_italicFontface;
 }
@@ -46,7 +55,7 @@ static Opt<Strong<Text::Fontface>> _codeFontface = NONE;
 
 Strong<Text::Fontface> codeFontface() {
     if (not _codeFontface) {
-        _codeFontface = Text::loadFontfaceOrFallback("bundle://fonts-fira-code/fonts/FiraCode-Regular.ttf"_url).unwrap();
+        _codeFontface = _loadFontface("bundle://fonts-fira-code/fonts/FiraCode-Regular.ttf"_url);
     }
     return *_codeFontface;
 }
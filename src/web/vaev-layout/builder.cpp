@@ -1,3 +1,4 @@
+#include <karm-text/fallback.h>
 #include <karm-text/loader.h>
 #include <vaev-dom/document.h>
 #include <vaev-dom/element.h>
@@ -86,7 +87,8 @@ static Opt<Strong<Text::Fontface>> _regularFontface = NONE;
 
 Strong<Text::Fontface> regularFontface() {
     if (not _regularFontface) {
-        _regularFontface = Text::loadFontfaceOrFallback("bundle://fonts-inter/fonts/Inter-Regular.ttf"_url).unwrap();
+        auto primary = Text::loadFontfaceOrFallback("bundle://fonts-inter/fonts/Inter-Regular.ttf"_url).unwrap();
+        _regularFontface = Text::FontFallback::make(Text::installedFonts(), primary);
     }
     return *_regularFontface;
 }
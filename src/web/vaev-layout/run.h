@@ -26,7 +26,11 @@ struct Run : public Frag {
     }
 
     Px computeIntrinsicSize(Context &, Axis axis, IntrinsicSize, Px) override {
-        return Px{_run->layout()[axis.index()]};
+        // Runs don't wrap, so their min-content and max-content widths
+        // are both the width of the whole run
+        if (axis == Axis::HORIZONTAL)
+            return Px{_run->measure().width};
+        return Px{_run->lineheight()};
     }
 
     void makePaintables(Paint::Stack &s) override {